@@ -4,16 +4,76 @@
  Autor: Enigma Studios (exercício)
  Descrição:
   - Árvore binária (mapa da mansão) com salas que podem conter pistas.
-  - BST armazena as pistas coletadas (em ordem alfabética). Cada nó tem contagem para pistas repetidas.
+  - BST armazena as pistas coletadas (em ordem alfabética, por chaves de colação). Cada nó tem contagem para pistas repetidas.
   - Tabela hash associa cada pista a um suspeito (chave = pista string, valor = nome do suspeito).
   - Navegação interativa a partir do Hall de Entrada: esquerda (e), direita (d), sair (s).
   - Ao final, jogador acusa um suspeito; se >= 2 pistas coletadas apontam para esse suspeito => acusação sustentada.
+  - Cenários (mansão + associações pista -> suspeito) podem ser importados de JSON por um parser em fluxo (SAX).
+  - Formato binário de cenário com CRC32C por seção (SSE4.2 quando disponível), verificado em paralelo.
+  - Diário de sessão e instantâneos comprimidos (LZ estilo LZ4) por um thread de compressão.
+  - Persistência assíncrona em lotes via io_uring (fallback: pool de threads com writev).
+  - Sessões (estado de cada jogador) avançam por passoSessao, sem E/S; o laço interativo é um hospedeiro.
+  - Sessões hospedadas ociosas expiram por uma roda de temporização hierárquica.
+  - Mansão generalizada como grafo (salas com qualquer número de saídas, ciclos) em formato CSR.
+  - Resumos por subárvore (pistas por suspeito) respondem "ainda dá para sustentar a acusação?" em O(1).
+  - Regras de acusação ("A & (B | C) & !D", @"Suspeito">=N) compiladas para bytecode sobre bitsets de pistas.
+  - Registro de diagnóstico assíncrono: anéis SPSC por thread, formatados por um thread de fundo.
+  - Armazenamento de sessões em camadas: sessões paradas vão para arquivo (CLOCK, orçamento de memória).
+  - Sessões em memória compartilhada POSIX (deslocamentos, alocador e índice sem travas) entre processos.
+  - Replays compactos (2 bits por movimento) reproduzidos por tabela indexada por sala.
+  - Pistas citadas em teorias livres encontradas numa passada (Aho-Corasick com tabela compacta).
+  - Busca de pistas por palavras (índice invertido com postagens varint e interseção galopante).
+  - Registro de suspeitos com ids densos e vetores por campo (nomes, pistas, pontuação, listas).
+  - Suspeitos com evidências quase idênticas detectados por MinHash + LSH (revisão de cenários).
+  - Perfilador por amostragem embutido (SIGPROF, ponteiros de quadro, pilhas dobradas por fase).
+  - Contadores de hardware (perf_event_open) por fase e por laço de benchmark: IPC e falhas.
+  - Linha de base de benchmarks com metadados e comparação estatística (IC 95%, teste de Welch).
+  - Carga de treino para PGO (-fprofile-generate/-fprofile-use) a partir de replays.
+  - Testes diferenciais: sequências aleatórias na referência e em cada motor otimizado.
+  - Ordenação de pistas em lote: radix MSD + quicksort multichave, com variante paralela.
+  - Dicionário ordenado de pistas com codificação por prefixo para catálogos congelados e instantâneos.
 */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define TEM_IO_URING 1
+#endif
+#endif
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <elf.h>
+#include <link.h>
+#define TEM_PERFILADOR 1
+#endif
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#define TEM_PERF_EVENT 1
+#endif
+#endif
 
 /* =========================
    Definições básicas
@@ -21,7 +81,7 @@
 typedef struct Sala {
     char *nome;            // nome da sala
     char *pista;           // pista associada (NULL se não houver)
-    int pistaColetada;     // flag para indicar se a pista já foi coletada
+    uint32_t id;           // índice em pré-ordem (ver numerarSalas); indexa o estado das sessões
     struct Sala *esq;      // caminho esquerdo
     struct Sala *dir;      // caminho direito
 } Sala;
@@ -29,6 +89,8 @@ typedef struct Sala {
 /* Nó da BST para pistas coletadas */
 typedef struct PistaNode {
     char *pista;
+    unsigned char *chave;       // chave de colação (ordem alfabética; ver gerarChaveColacao)
+    uint32_t tamChave;
     int contador;               // número de vezes que a pista foi coletada (pode ser 1)
     struct PistaNode *esq;
     struct PistaNode *dir;
@@ -37,12 +99,14 @@ typedef struct PistaNode {
 /* Entrada da tabela hash (lista encadeada para tratamento de colisões) */
 typedef struct HashEntry {
     char *pista;            // chave
-    char *suspeito;         // valor associado
+    uint32_t id;            // identificador denso da pista (ordem de inserção), usado pelas regras
+    uint32_t idSuspeito;    // id do suspeito no registro de suspeitos
     struct HashEntry *prox;
 } HashEntry;
 
 #define HASH_SIZE 31       // tamanho da tabela hash (primo pequeno)
 HashEntry *tabelaHash[HASH_SIZE];
+uint32_t totalPistasHash = 0;   // próximo id de pista a atribuir
 
 /* =========================
    Funções auxiliares de string
@@ -58,6 +122,21 @@ char *strdup_safe(const char *s) {
     return r;
 }
 
+/*
+ alocar_safe: realoca p para n elementos de tam bytes (p NULL: bloco novo zerado);
+ em falta de memória ou estouro de n * tam encerra com "Falha ao alocar memória para <contexto>"
+*/
+void *alocar_safe(void *p, size_t n, size_t tam, const char *contexto) {
+    if (n == 0) n = 1;
+    if (tam && n > SIZE_MAX / tam) p = NULL;
+    else p = p ? realloc(p, n * tam) : calloc(n, tam);
+    if (!p) {
+        fprintf(stderr, "Falha ao alocar memória para %s\n", contexto);
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
 /* trim newline */
 void trim_nl(char *s) {
     if (!s) return;
@@ -66,6 +145,23 @@ void trim_nl(char *s) {
     if (s[n-1] == '\n') s[n-1] = '\0';
 }
 
+/* relógio monotônico em segundos (medições de desempenho) */
+double agoraSegundos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/* gerador pseudoaleatório xorshift64* (reprodutível entre plataformas) */
+uint64_t aleatorio(uint64_t *estado) {
+    uint64_t x = *estado;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *estado = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
 /* transforma para minúsculas para comparação case-insensitive */
 void to_lower_inplace(char *s) {
     if (!s) return;
@@ -84,7 +180,7 @@ Sala *criarSala(const char *nome, const char *pista) {
     }
     s->nome = strdup_safe(nome);
     s->pista = pista ? strdup_safe(pista) : NULL;
-    s->pistaColetada = 0;
+    s->id = 0;
     s->esq = s->dir = NULL;
     return s;
 }
@@ -99,37 +195,879 @@ void liberarSalas(Sala *root) {
     free(root);
 }
 
+/* coletarSalasPreOrdem: vetor com todas as salas em pré-ordem (iterativo; o chamador libera) */
+Sala **coletarSalasPreOrdem(Sala *raiz, size_t *numSalas) {
+    size_t n = 0, cap = 64, topo = 0, capPilha = 64;
+    Sala **salas = (Sala **) malloc(cap * sizeof(Sala *));
+    Sala **pilha = (Sala **) malloc(capPilha * sizeof(Sala *));
+    if (!salas || !pilha) {
+        fprintf(stderr, "Falha ao alocar memória para percurso de salas\n");
+        exit(EXIT_FAILURE);
+    }
+    if (raiz) pilha[topo++] = raiz;
+    while (topo) {
+        Sala *s = pilha[--topo];
+        if (n == cap) {
+            cap *= 2;
+            salas = (Sala **) realloc(salas, cap * sizeof(Sala *));
+        }
+        if (topo + 2 > capPilha) {
+            capPilha *= 2;
+            pilha = (Sala **) realloc(pilha, capPilha * sizeof(Sala *));
+        }
+        if (!salas || !pilha) {
+            fprintf(stderr, "Falha ao alocar memória para percurso de salas\n");
+            exit(EXIT_FAILURE);
+        }
+        salas[n++] = s;
+        if (s->dir) pilha[topo++] = s->dir;
+        if (s->esq) pilha[topo++] = s->esq;
+    }
+    free(pilha);
+    *numSalas = n;
+    return salas;
+}
+
+/* numerarSalas: atribui ids densos em pré-ordem; retorna o número de salas */
+size_t numerarSalas(Sala *raiz) {
+    size_t n;
+    Sala **salas = coletarSalasPreOrdem(raiz, &n);
+    for (size_t i = 0; i < n; ++i) salas[i]->id = (uint32_t) i;
+    free(salas);
+    return n;
+}
+
+/* =========================
+   Chaves de colação (ordem alfabética em português)
+   ========================= */
+/*
+ strcmp ordena por bytes: maiúsculas antes de todas as minúsculas e letras acentuadas
+ (UTF-8) depois do 'z'. Cada pista recebe, ao entrar na BST, uma chave binária em três
+ níveis, como nas chaves de ordenação do Unicode:
+   nível 1: letra base (sem acento e sem caixa), dígitos, espaço e símbolos
+   nível 2: acento de cada letra   (sem acento < agudo < grave < circunflexo < til < ...)
+   nível 3: caixa                  (minúscula < maiúscula)
+ separados pelo byte 0x01 (menor que qualquer peso). Comparar duas chaves com memcmp
+ dá a ordem alfabética: "ácido" fica entre "abajur" e "adaga", "Zé" antes de "zebra"
+ (já no nível 1, por ser prefixo) e "zé" antes de "Zé" só no nível 3. Os níveis 2 e 3
+ têm os pesos 0x02 finais removidos (não mudam a ordem) e costumam ficar vazios.
+ Empates exatos de chave são decididos por strcmp.
+*/
+enum {
+    AC_NENHUM = 2, AC_AGUDO, AC_GRAVE, AC_CIRCUNFLEXO, AC_TIL, AC_TREMA, AC_ANEL, AC_CEDILHA, AC_OUTRO
+};
+
+/* letra base e acento de U+00C0..U+00DF (minúsculas: +0x20); base 0 = não é letra simples */
+static const struct { char base; unsigned char acento; } letrasLatin1[32] = {
+    { 'a', AC_GRAVE }, { 'a', AC_AGUDO }, { 'a', AC_CIRCUNFLEXO }, { 'a', AC_TIL },
+    { 'a', AC_TREMA }, { 'a', AC_ANEL }, { 'a', AC_OUTRO }, { 'c', AC_CEDILHA },
+    { 'e', AC_GRAVE }, { 'e', AC_AGUDO }, { 'e', AC_CIRCUNFLEXO }, { 'e', AC_TREMA },
+    { 'i', AC_GRAVE }, { 'i', AC_AGUDO }, { 'i', AC_CIRCUNFLEXO }, { 'i', AC_TREMA },
+    { 'd', AC_OUTRO }, { 'n', AC_TIL }, { 'o', AC_GRAVE }, { 'o', AC_AGUDO },
+    { 'o', AC_CIRCUNFLEXO }, { 'o', AC_TIL }, { 'o', AC_TREMA }, { 0, 0 },          /* × */
+    { 'o', AC_OUTRO }, { 'u', AC_GRAVE }, { 'u', AC_AGUDO }, { 'u', AC_CIRCUNFLEXO },
+    { 'u', AC_TREMA }, { 'y', AC_AGUDO }, { 't', AC_OUTRO }, { 0, 0 }               /* Þ, ß */
+};
+
+/* peso de nível 1 dos caracteres ASCII de um único byte de chave (0 = tratar no caso geral) */
+static unsigned char pesosAscii[128];
+
+static void iniciarPesosAscii(void) {
+    for (int c = 'a'; c <= 'z'; ++c) pesosAscii[c] = pesosAscii[c - 'a' + 'A'] = (unsigned char) (0x20 + c - 'a');
+    for (int c = '0'; c <= '9'; ++c) pesosAscii[c] = (unsigned char) (0x10 + c - '0');
+    pesosAscii[' '] = pesosAscii['\t'] = pesosAscii['\n'] = pesosAscii['\r'] = 0x02;
+}
+
+/* decodifica um caractere UTF-8; bytes inválidos viram U+DC80..U+DCFF (como no Python) */
+static uint32_t lerUtf8(const unsigned char **p) {
+    const unsigned char *s = *p;
+    uint32_t cp = s[0];
+    int extra = cp >= 0xF0 && cp < 0xF5 ? 3 : cp >= 0xE0 ? 2 : cp >= 0xC2 && cp < 0xE0 ? 1 : 0;
+    if (cp >= 0x80 && extra == 0) {
+        *p = s + 1;
+        return 0xDC00 + cp;
+    }
+    cp &= 0x7F >> extra;
+    for (int i = 1; i <= extra; ++i) {
+        if ((s[i] & 0xC0) != 0x80) {
+            *p = s + 1;
+            return 0xDC00 + s[0];
+        }
+        cp = (cp << 6) | (s[i] & 0x3F);
+    }
+    *p = s + 1 + extra;
+    return cp;
+}
+
+typedef struct EscritorChave {
+    unsigned char *dst;
+    size_t cap, tam;
+} EscritorChave;
+
+static inline void pesoChave(EscritorChave *e, unsigned char b) {
+    if (e->tam < e->cap) e->dst[e->tam] = b;
+    e->tam++;
+}
+
+/*
+ gerarChaveColacao: escreve a chave de texto em dst (até cap bytes) e retorna o tamanho
+ total; se for maior que cap, chamar de novo com um buffer desse tamanho.
+*/
+size_t gerarChaveColacao(const char *texto, unsigned char *dst, size_t cap) {
+    EscritorChave e = { dst, cap, 0 };
+    if (!pesosAscii['a']) iniciarPesosAscii();
+    size_t n = strlen(texto);
+    /* níveis 2 e 3 vão para o fim da chave; guardados à parte (no máximo 2 unidades por byte) */
+    unsigned char local[512];
+    unsigned char *niveis = 4 * n <= sizeof(local) ? local : (unsigned char *) malloc(4 * n);
+    if (!niveis) {
+        fprintf(stderr, "Falha ao alocar memória para chave de colação\n");
+        exit(EXIT_FAILURE);
+    }
+    unsigned char *acentos = niveis, *caixas = niveis + 2 * n;
+    size_t unidades = 0, fimAcentos = 0, fimCaixas = 0;
+
+    const unsigned char *p = (const unsigned char *) texto;
+    while (*p) {
+        if (*p < 0x80 && pesosAscii[*p]) {
+            /* caminho rápido: letra, dígito ou espaço ASCII */
+            unsigned char c = *p++;
+            pesoChave(&e, pesosAscii[c]);
+            acentos[unidades] = AC_NENHUM;
+            caixas[unidades++] = (c >= 'A' && c <= 'Z') ? 3 : 2;
+            if (c >= 'A' && c <= 'Z') fimCaixas = unidades;
+            continue;
+        }
+        uint32_t cp = lerUtf8(&p);
+        char base = 0;
+        unsigned char acento = AC_NENHUM, caixa = 2;
+        if (cp < 0x80 && isalpha((int) cp)) {
+            base = (char) tolower((int) cp);
+            caixa = isupper((int) cp) ? 3 : 2;
+        } else if (cp >= 0xC0 && cp <= 0xFF && cp != 0xD7 && cp != 0xF7) {
+            if (cp == 0xDF) {                       /* ß = "ss" */
+                pesoChave(&e, (unsigned char) (0x20 + 's' - 'a'));
+                acentos[unidades] = AC_NENHUM;
+                caixas[unidades++] = 2;
+                base = 's';
+                acento = AC_OUTRO;
+            } else if (cp == 0xFF) {
+                base = 'y';
+                acento = AC_TREMA;
+            } else {
+                base = letrasLatin1[(cp - 0xC0) & 0x1F].base;
+                acento = letrasLatin1[(cp - 0xC0) & 0x1F].acento;
+                caixa = cp < 0xE0 ? 3 : 2;
+            }
+        }
+        if (base) {
+            pesoChave(&e, (unsigned char) (0x20 + base - 'a'));
+        } else if (cp == ' ' || cp == '\t' || cp == '\n' || cp == '\r' || cp == 0xA0) {
+            pesoChave(&e, 0x02);
+        } else if (cp < 0x80 && isdigit((int) cp)) {
+            pesoChave(&e, (unsigned char) (0x10 + cp - '0'));
+        } else if (cp >= 0x21 && cp <= 0xFF) {     /* pontuação e símbolos latinos */
+            pesoChave(&e, 0x03);
+            pesoChave(&e, (unsigned char) cp);
+        } else {                                    /* demais: depois das letras, por código */
+            pesoChave(&e, 0xF0);
+            pesoChave(&e, (unsigned char) (cp >> 16));
+            pesoChave(&e, (unsigned char) (cp >> 8));
+            pesoChave(&e, (unsigned char) cp);
+        }
+        acentos[unidades] = acento;
+        caixas[unidades++] = caixa;
+        if (acento != AC_NENHUM) fimAcentos = unidades;
+        if (caixa != 2) fimCaixas = unidades;
+    }
+    pesoChave(&e, 0x01);
+    for (size_t i = 0; i < fimAcentos; ++i) pesoChave(&e, acentos[i]);
+    pesoChave(&e, 0x01);
+    for (size_t i = 0; i < fimCaixas; ++i) pesoChave(&e, caixas[i]);
+    if (niveis != local) free(niveis);
+    return e.tam;
+}
+
+/* chave de colação com armazenamento local para textos curtos */
+typedef struct ChaveColacao {
+    unsigned char local[192];
+    unsigned char *dados;
+    size_t tam;
+} ChaveColacao;
+
+static void prepararChave(ChaveColacao *c, const char *texto) {
+    c->dados = c->local;
+    c->tam = gerarChaveColacao(texto, c->local, sizeof(c->local));
+    if (c->tam > sizeof(c->local)) {
+        c->dados = (unsigned char *) malloc(c->tam);
+        if (!c->dados) {
+            fprintf(stderr, "Falha ao alocar memória para chave de colação\n");
+            exit(EXIT_FAILURE);
+        }
+        gerarChaveColacao(texto, c->dados, c->tam);
+    }
+}
+
+static void descartarChave(ChaveColacao *c) {
+    if (c->dados != c->local) free(c->dados);
+}
+
+/* compararChaves: memcmp das chaves; a mais curta vem antes quando uma é prefixo da outra */
+static inline int compararChaves(const unsigned char *a, size_t na, const unsigned char *b, size_t nb) {
+    int cmp = memcmp(a, b, na < nb ? na : nb);
+    if (cmp != 0) return cmp;
+    return na < nb ? -1 : (na > nb ? 1 : 0);
+}
+
+/* compararPistasColacao: ordem alfabética de duas pistas (calcula as duas chaves) */
+int compararPistasColacao(const char *a, const char *b) {
+    ChaveColacao ca, cb;
+    prepararChave(&ca, a);
+    prepararChave(&cb, b);
+    int cmp = compararChaves(ca.dados, ca.tam, cb.dados, cb.tam);
+    descartarChave(&ca);
+    descartarChave(&cb);
+    return cmp != 0 ? cmp : strcmp(a, b);
+}
+
+/* =========================
+   Ordenação de cadeias em lote (radix MSD e quicksort multichave)
+   ========================= */
+/*
+ Montar catálogos, dicionários congelados e listagens ordenadas exige ordenar milhões de
+ pistas. qsort com strcmp relê os prefixos comuns a cada comparação, e com
+ compararPistasColacao ainda gera as duas chaves de novo. Aqui cada item aponta para a
+ sua chave (bytes com tamanho; 0x00 é permitido) e a ordenação examina um byte por vez:
+  - radix MSD: conta os itens pelo byte na profundidade d (257 baldes; o balde 0 é "a
+    chave acabou") e os espalha num vetor auxiliar; cada balde segue com d + 1. Se todos
+    caem no mesmo balde (prefixo comum), só avança d, sem mover nada. O byte de cada item
+    é lido uma vez por passada e guardado ao lado (bytes[]);
+  - abaixo de RADIX_MIN itens, quicksort multichave (Bentley-Sedgewick): partição em três
+    pelo byte d, e a parte igual segue com d + 1; abaixo de INSERCAO_MAX, inserção;
+  - chaves idênticas: a ordem vem de uma função de desempate (strcmp do texto, id mais
+    novo primeiro...), por mergesort no mesmo vetor auxiliar.
+ Para a ordem alfabética, as chaves de colação de todas as pistas são geradas de uma vez
+ em arenas contíguas (ArenaChaves), sem uma alocação por pista.
+ Variante paralela: as chaves são geradas em fatias, uma por thread; depois o thread
+ chamador divide o vetor com passadas de radix até que cada balde tenha no máximo
+ 1/(8 x threads) dos itens, e os baldes são ordenados, do maior para o menor, por threads
+ que pegam o próximo com um contador atômico (o chamador também trabalha).
+*/
+#define RADIX_MIN 128
+#define INSERCAO_MAX 16
+#define MAX_THREADS_ORDENACAO 64
+
+typedef struct ItemOrdenacao {
+    const unsigned char *chave;
+    uint32_t tam;
+    uint32_t indice;            // posição original (desempate e reordenação pelo chamador)
+} ItemOrdenacao;
+
+typedef struct Ordenador {
+    int (*desempate)(uint32_t a, uint32_t b, void *ctx);    // chaves idênticas; NULL = por índice
+    void *ctx;
+    ItemOrdenacao *base;        // vetor ordenado; aux e bytes usam os mesmos deslocamentos
+    ItemOrdenacao *aux;
+    uint16_t *bytes;
+} Ordenador;
+
+static inline int byteOrdenacao(const ItemOrdenacao *it, size_t d) {
+    return d < it->tam ? it->chave[d] + 1 : 0;
+}
+
+static inline int desempatarItens(const Ordenador *o, const ItemOrdenacao *a, const ItemOrdenacao *b) {
+    if (o->desempate) return o->desempate(a->indice, b->indice, o->ctx);
+    return (a->indice > b->indice) - (a->indice < b->indice);
+}
+
+/* compara dois itens cujos d primeiros bytes são iguais */
+static int compararItensDesde(const Ordenador *o, const ItemOrdenacao *a, const ItemOrdenacao *b, size_t d) {
+    size_t na = a->tam - d, nb = b->tam - d;
+    int cmp = memcmp(a->chave + d, b->chave + d, na < nb ? na : nb);
+    if (cmp == 0) cmp = (na > nb) - (na < nb);
+    return cmp != 0 ? cmp : desempatarItens(o, a, b);
+}
+
+/* ordenarEmpates: itens de chave idêntica, pela função de desempate (mergesort) */
+static void ordenarEmpates(const Ordenador *o, ItemOrdenacao *v, size_t n) {
+    if (n <= INSERCAO_MAX) {
+        for (size_t i = 1; i < n; ++i) {
+            ItemOrdenacao x = v[i];
+            size_t j = i;
+            for (; j > 0 && desempatarItens(o, &x, &v[j - 1]) < 0; --j) v[j] = v[j - 1];
+            v[j] = x;
+        }
+        return;
+    }
+    size_t m = n / 2;
+    ordenarEmpates(o, v, m);
+    ordenarEmpates(o, v + m, n - m);
+    if (desempatarItens(o, &v[m - 1], &v[m]) <= 0) return;
+    ItemOrdenacao *aux = o->aux + (v - o->base);
+    memcpy(aux, v, n * sizeof(ItemOrdenacao));
+    size_t i = 0, j = m, k = 0;
+    while (i < m && j < n) v[k++] = desempatarItens(o, &aux[j], &aux[i]) < 0 ? aux[j++] : aux[i++];
+    while (i < m) v[k++] = aux[i++];
+    while (j < n) v[k++] = aux[j++];
+}
+
+static void quicksortMultichave(const Ordenador *o, ItemOrdenacao *v, size_t n, size_t d) {
+    while (n > INSERCAO_MAX) {
+        int a = byteOrdenacao(&v[0], d), b = byteOrdenacao(&v[n / 2], d), c = byteOrdenacao(&v[n - 1], d);
+        int pivo = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+        /* [0, lt) < pivo, [lt, gt) == pivo, [gt, n) > pivo */
+        size_t lt = 0, i = 0, gt = n;
+        while (i < gt) {
+            int x = byteOrdenacao(&v[i], d);
+            ItemOrdenacao t = v[i];
+            if (x < pivo) {
+                v[i++] = v[lt];
+                v[lt++] = t;
+            } else if (x > pivo) {
+                v[i] = v[--gt];
+                v[gt] = t;
+            } else {
+                i++;
+            }
+        }
+        quicksortMultichave(o, v, lt, d);
+        quicksortMultichave(o, v + gt, n - gt, d);
+        if (pivo == 0) {
+            ordenarEmpates(o, v + lt, gt - lt);
+            return;
+        }
+        v += lt;
+        n = gt - lt;
+        d++;
+    }
+    for (size_t i = 1; i < n; ++i) {
+        ItemOrdenacao x = v[i];
+        size_t j = i;
+        for (; j > 0 && compararItensDesde(o, &x, &v[j - 1], d) < 0; --j) v[j] = v[j - 1];
+        v[j] = x;
+    }
+}
+
+/*
+ passadaRadix: conta e distribui v pelo byte d. Retorna o balde único (sem mover nada)
+ quando todos os itens caem nele, ou -1 depois de distribuir; inicio[b] e contagem[b]
+ descrevem os baldes.
+*/
+static int passadaRadix(const Ordenador *o, ItemOrdenacao *v, size_t n, size_t d, size_t *contagem, size_t *inicio) {
+    uint16_t *bytes = o->bytes + (v - o->base);
+    memset(contagem, 0, 257 * sizeof(size_t));
+    for (size_t i = 0; i < n; ++i) {
+        bytes[i] = (uint16_t) byteOrdenacao(&v[i], d);
+        contagem[bytes[i]]++;
+    }
+    if (contagem[bytes[0]] == n) return bytes[0];
+    size_t pos[257], soma = 0;
+    for (int b = 0; b < 257; ++b) {
+        inicio[b] = pos[b] = soma;
+        soma += contagem[b];
+    }
+    ItemOrdenacao *aux = o->aux + (v - o->base);
+    for (size_t i = 0; i < n; ++i) aux[pos[bytes[i]]++] = v[i];
+    memcpy(v, aux, n * sizeof(ItemOrdenacao));
+    return -1;
+}
+
+static void radixMsd(const Ordenador *o, ItemOrdenacao *v, size_t n, size_t d) {
+    while (n >= RADIX_MIN) {
+        size_t contagem[257], inicio[257];
+        int unico = passadaRadix(o, v, n, d, contagem, inicio);
+        if (unico == 0) {
+            ordenarEmpates(o, v, n);
+            return;
+        }
+        if (unico > 0) {
+            d++;
+            continue;
+        }
+        ordenarEmpates(o, v, contagem[0]);
+        for (int b = 1; b < 257; ++b) {
+            if (contagem[b] > 1) radixMsd(o, v + inicio[b], contagem[b], d + 1);
+        }
+        return;
+    }
+    quicksortMultichave(o, v, n, d);
+}
+
+/* --- variante paralela --- */
+typedef struct TarefaOrdenacao {
+    size_t inicio, n, d;
+    int empates;                // só falta o desempate (chaves idênticas)
+} TarefaOrdenacao;
+
+typedef struct FilaOrdenacao {
+    const Ordenador *o;
+    TarefaOrdenacao *tarefas;
+    size_t numTarefas, cap;
+    _Atomic size_t proxima;
+} FilaOrdenacao;
+
+static void acrescentarTarefaOrdenacao(FilaOrdenacao *f, size_t inicio, size_t n, size_t d, int empates) {
+    if (f->numTarefas == f->cap) {
+        f->cap = f->cap ? f->cap * 2 : 1024;
+        f->tarefas = (TarefaOrdenacao *) realloc(f->tarefas, f->cap * sizeof(TarefaOrdenacao));
+        if (!f->tarefas) {
+            fprintf(stderr, "Falha ao alocar memória para ordenação\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    TarefaOrdenacao t = { inicio, n, d, empates };
+    f->tarefas[f->numTarefas++] = t;
+}
+
+static void *trabalhadorOrdenacao(void *arg) {
+    FilaOrdenacao *f = (FilaOrdenacao *) arg;
+    size_t i;
+    while ((i = atomic_fetch_add(&f->proxima, 1)) < f->numTarefas) {
+        const TarefaOrdenacao *t = &f->tarefas[i];
+        if (t->empates) ordenarEmpates(f->o, f->o->base + t->inicio, t->n);
+        else radixMsd(f->o, f->o->base + t->inicio, t->n, t->d);
+    }
+    return NULL;
+}
+
+static int compararTarefasOrdenacao(const void *a, const void *b) {
+    size_t x = ((const TarefaOrdenacao *) a)->n, y = ((const TarefaOrdenacao *) b)->n;
+    return (x < y) - (x > y);       // maiores primeiro
+}
+
+/* numThreadsOrdenacao: 0 = um por núcleo */
+static int numThreadsOrdenacao(int threads) {
+    if (threads <= 0) {
+        long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = nucleos > 1 ? (int) nucleos : 1;
+    }
+    return threads > MAX_THREADS_ORDENACAO ? MAX_THREADS_ORDENACAO : threads;
+}
+
+static void executarEmThreads(void *(*trabalhador)(void *), void *args, size_t tamArg, int numThreads) {
+    pthread_t threads[MAX_THREADS_ORDENACAO];
+    int criados = 0;
+    for (int t = 1; t < numThreads; ++t) {
+        if (pthread_create(&threads[criados], NULL, trabalhador, (char *) args + (size_t) t * tamArg) == 0) {
+            criados++;
+        } else {
+            trabalhador((char *) args + (size_t) t * tamArg);
+        }
+    }
+    trabalhador(args);              // o thread chamador também trabalha
+    for (int t = 0; t < criados; ++t) pthread_join(threads[t], NULL);
+}
+
+static void *trabalhadorFilaOrdenacao(void *arg) {
+    return trabalhadorOrdenacao(*(FilaOrdenacao **) arg);
+}
+
+static void ordenarItensParalelo(const Ordenador *o, size_t n, int numThreads) {
+    FilaOrdenacao f;
+    memset(&f, 0, sizeof(f));
+    f.o = o;
+    atomic_init(&f.proxima, 0);
+    size_t limite = n / (8 * (size_t) numThreads);
+    if (limite < RADIX_MIN) limite = RADIX_MIN;
+
+    /* divisão: pilha de faixas ainda grandes demais para uma tarefa */
+    FilaOrdenacao pilha;
+    memset(&pilha, 0, sizeof(pilha));
+    acrescentarTarefaOrdenacao(&pilha, 0, n, 0, 0);
+    while (pilha.numTarefas > 0) {
+        TarefaOrdenacao t = pilha.tarefas[--pilha.numTarefas];
+        if (t.n <= limite) {
+            acrescentarTarefaOrdenacao(&f, t.inicio, t.n, t.d, 0);
+            continue;
+        }
+        size_t contagem[257], inicio[257];
+        int unico = passadaRadix(o, o->base + t.inicio, t.n, t.d, contagem, inicio);
+        if (unico >= 0) {
+            acrescentarTarefaOrdenacao(unico == 0 ? &f : &pilha, t.inicio, t.n, t.d + 1, unico == 0);
+            continue;
+        }
+        if (contagem[0] > 1) acrescentarTarefaOrdenacao(&f, t.inicio, contagem[0], t.d, 1);
+        for (int b = 1; b < 257; ++b) {
+            if (contagem[b] > 1) acrescentarTarefaOrdenacao(&pilha, t.inicio + inicio[b], contagem[b], t.d + 1, 0);
+        }
+    }
+    free(pilha.tarefas);
+
+    qsort(f.tarefas, f.numTarefas, sizeof(TarefaOrdenacao), compararTarefasOrdenacao);
+    FilaOrdenacao *args[MAX_THREADS_ORDENACAO];
+    for (int t = 0; t < numThreads; ++t) args[t] = &f;
+    executarEmThreads(trabalhadorFilaOrdenacao, args, sizeof(args[0]), numThreads);
+    free(f.tarefas);
+}
+
+/*
+ ordenarItens: ordena pelos bytes da chave (a mais curta primeiro quando uma é prefixo da
+ outra) e, entre chaves idênticas, por desempate (NULL = posição original). threads: 1 =
+ sequencial, 0 = um por núcleo.
+*/
+void ordenarItens(ItemOrdenacao *itens, size_t n, int (*desempate)(uint32_t a, uint32_t b, void *ctx), void *ctx,
+                  int threads) {
+    if (n < 2) return;
+    Ordenador o = { desempate, ctx, itens, NULL, NULL };
+    o.aux = (ItemOrdenacao *) malloc(n * sizeof(ItemOrdenacao));
+    o.bytes = (uint16_t *) malloc(n * sizeof(uint16_t));
+    if (!o.aux || !o.bytes) {
+        fprintf(stderr, "Falha ao alocar memória para ordenação\n");
+        exit(EXIT_FAILURE);
+    }
+    int numThreads = numThreadsOrdenacao(threads);
+    if (numThreads > 1 && n >= 8 * RADIX_MIN) ordenarItensParalelo(&o, n, numThreads);
+    else radixMsd(&o, itens, n, 0);
+    free(o.aux);
+    free(o.bytes);
+}
+
+/* --- ordem alfabética: chaves de colação em arenas --- */
+typedef struct ArenaChaves {
+    unsigned char *dados;
+    size_t tam, cap;
+} ArenaChaves;
+
+typedef struct FatiaChaves {
+    const char **pistas;
+    ItemOrdenacao *itens;
+    size_t inicio, fim;
+    ArenaChaves arena;
+} FatiaChaves;
+
+/* gerarChavesFatia: chaves de pistas[inicio, fim) numa arena; itens apontam para ela */
+static void *gerarChavesFatia(void *arg) {
+    FatiaChaves *f = (FatiaChaves *) arg;
+    ArenaChaves *a = &f->arena;
+    a->cap = (f->fim - f->inicio) * 64 + 256;
+    a->dados = (unsigned char *) malloc(a->cap);
+    if (!a->dados) {
+        fprintf(stderr, "Falha ao alocar memória para chaves de colação\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = f->inicio; i < f->fim; ++i) {
+        size_t n = gerarChaveColacao(f->pistas[i], a->dados + a->tam, a->cap - a->tam);
+        if (n > a->cap - a->tam) {
+            while (n > a->cap - a->tam) a->cap *= 2;
+            a->dados = (unsigned char *) realloc(a->dados, a->cap);
+            if (!a->dados) {
+                fprintf(stderr, "Falha ao alocar memória para chaves de colação\n");
+                exit(EXIT_FAILURE);
+            }
+            gerarChaveColacao(f->pistas[i], a->dados + a->tam, n);
+        }
+        f->itens[i].tam = (uint32_t) n;
+        f->itens[i].indice = (uint32_t) i;
+        f->itens[i].chave = (const unsigned char *) (uintptr_t) a->tam;    // deslocamento até a arena parar de crescer
+        a->tam += n;
+    }
+    for (size_t i = f->inicio; i < f->fim; ++i) f->itens[i].chave = a->dados + (uintptr_t) f->itens[i].chave;
+    return NULL;
+}
+
+static int desempatarPorTexto(uint32_t a, uint32_t b, void *ctx) {
+    const char **pistas = (const char **) ctx;
+    return strcmp(pistas[a], pistas[b]);
+}
+
+/*
+ ordenarPistasColacao: reordena pistas na ordem de compararPistasColacao (a da BST e do
+ dicionário). threads: 1 = sequencial, 0 = um por núcleo.
+*/
+void ordenarPistasColacao(const char **pistas, size_t n, int threads) {
+    if (n < 2) return;
+    int numThreads = numThreadsOrdenacao(threads);
+    if ((size_t) numThreads > n / RADIX_MIN) numThreads = n / RADIX_MIN > 1 ? (int) (n / RADIX_MIN) : 1;
+    ItemOrdenacao *itens = (ItemOrdenacao *) malloc(n * sizeof(ItemOrdenacao));
+    const char **ordenadas = (const char **) malloc(n * sizeof(const char *));
+    FatiaChaves fatias[MAX_THREADS_ORDENACAO];
+    if (!itens || !ordenadas) {
+        fprintf(stderr, "Falha ao alocar memória para ordenação\n");
+        exit(EXIT_FAILURE);
+    }
+    if (!pesosAscii['a']) iniciarPesosAscii();      // antes de disparar os threads
+    for (int t = 0; t < numThreads; ++t) {
+        FatiaChaves f = { pistas, itens, n * (size_t) t / (size_t) numThreads,
+                          n * (size_t) (t + 1) / (size_t) numThreads, { NULL, 0, 0 } };
+        fatias[t] = f;
+    }
+    executarEmThreads(gerarChavesFatia, fatias, sizeof(fatias[0]), numThreads);
+    ordenarItens(itens, n, desempatarPorTexto, (void *) pistas, numThreads);
+    for (size_t i = 0; i < n; ++i) ordenadas[i] = pistas[itens[i].indice];
+    memcpy(pistas, ordenadas, n * sizeof(const char *));
+    for (int t = 0; t < numThreads; ++t) free(fatias[t].arena.dados);
+    free(ordenadas);
+    free(itens);
+}
+
+/* ordenarArquivoPistas: modo --ordenar-pistas; uma pista por linha, saída em ordem alfabética */
+int ordenarArquivoPistas(const char *caminho, int threads) {
+    FILE *in = fopen(caminho, "r");
+    if (!in) {
+        fprintf(stderr, "Erro ao abrir %s\n", caminho);
+        return -1;
+    }
+    char **pistas = NULL, *linha = NULL;
+    size_t n = 0, cap = 0, tamLinha = 0;
+    while (getline(&linha, &tamLinha, in) != -1) {
+        trim_nl(linha);
+        if (n == cap) {
+            cap = cap ? cap * 2 : 1024;
+            pistas = (char **) realloc(pistas, cap * sizeof(char *));
+            if (!pistas) {
+                fprintf(stderr, "Falha ao alocar memória para pistas\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        pistas[n++] = strdup_safe(linha);
+    }
+    free(linha);
+    fclose(in);
+    ordenarPistasColacao((const char **) pistas, n, threads);
+    for (size_t i = 0; i < n; ++i) {
+        puts(pistas[i]);
+        free(pistas[i]);
+    }
+    free(pistas);
+    return 0;
+}
+
+/* --- benchmark --- */
+static const char *palavrasCorpusOrdenacao[] = {
+    "Luva", "luva", "de", "couro", "manchada", "na", "biblioteca", "Pegada", "lama", "relógio", "parado",
+    "às", "três", "horas", "Ácido", "frasco", "vazio", "no", "escritório", "carta", "rasgada", "Faca",
+    "cozinha", "lenço", "bordado", "janela", "aberta", "cinzas", "lareira", "Zé", "anel", "botão", "escada"
+};
+#define NUM_PALAVRAS_CORPUS (sizeof(palavrasCorpusOrdenacao) / sizeof(palavrasCorpusOrdenacao[0]))
+
+/* corpus: 0 = sintético ("pista numero N encontrada na sala M"), 1 = frases com acentos e repetições */
+static char **gerarCorpusOrdenacao(int corpus, size_t n) {
+    char **pistas = (char **) malloc(n * sizeof(char *));
+    if (!pistas) {
+        fprintf(stderr, "Falha ao alocar memória para corpus\n");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t semente = 11 + (uint64_t) corpus;
+    char buf[256];
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t r = aleatorio(&semente);
+        if (corpus == 0) {
+            uint64_t id = r % (n * 4);
+            snprintf(buf, sizeof(buf), "pista numero %llu encontrada na sala %llu", (unsigned long long) id,
+                     (unsigned long long) (id % 131));
+        } else if (i > 0 && r % 10 == 0) {
+            snprintf(buf, sizeof(buf), "%s", pistas[(r >> 8) % i]);        // pista repetida
+        } else {
+            size_t tam = 0;
+            int palavras = 3 + (int) ((r >> 8) % 4);
+            for (int k = 0; k < palavras; ++k) {
+                tam += (size_t) snprintf(buf + tam, sizeof(buf) - tam, "%s%s", k ? " " : "",
+                                         palavrasCorpusOrdenacao[aleatorio(&semente) % NUM_PALAVRAS_CORPUS]);
+            }
+            if ((r >> 16) % 3 == 0) snprintf(buf + tam, sizeof(buf) - tam, " %u", (unsigned) ((r >> 24) % 1000));
+        }
+        pistas[i] = strdup_safe(buf);
+    }
+    return pistas;
+}
+
+static int compararPistasQsort(const void *a, const void *b) {
+    return compararPistasColacao(*(const char *const *) a, *(const char *const *) b);
+}
+
+static int compararStrcmpQsort(const void *a, const void *b) {
+    return strcmp(*(const char *const *) a, *(const char *const *) b);
+}
+
+/* qsort com chaves pré-calculadas: o que um chamador cuidadoso faria sem radix */
+typedef struct ChavePista {
+    const unsigned char *chave;
+    size_t tam;
+    const char *pista;
+} ChavePista;
+
+static int compararChavePista(const void *a, const void *b) {
+    const ChavePista *x = (const ChavePista *) a, *y = (const ChavePista *) b;
+    int cmp = compararChaves(x->chave, x->tam, y->chave, y->tam);
+    return cmp != 0 ? cmp : strcmp(x->pista, y->pista);
+}
+
+static size_t conferirOrdenacao(const char **a, const char **b, size_t n) {
+    size_t divergencias = 0;
+    for (size_t i = 0; i < n; ++i) divergencias += strcmp(a[i], b[i]) != 0;
+    return divergencias;
+}
+
+#define REPETICOES_ORDENACAO 3
+
+static double menorTempo(double a, double b) {
+    return a < b ? a : b;
+}
+
+/*
+ benchOrdenacao: para cada corpus, compara qsort (comparando pistas ou chaves
+ pré-calculadas) com o radix/multichave sequencial e paralelo; confere as saídas.
+*/
+int benchOrdenacao(size_t n, int threads) {
+    static const char *nomesCorpus[] = { "sintético", "frases" };
+    int numThreads = numThreadsOrdenacao(threads);
+    size_t divergencias = 0;
+    const char **ref = (const char **) malloc(n * sizeof(char *) + 1);
+    const char **v = (const char **) malloc(n * sizeof(char *) + 1);
+    ChavePista *chaves = (ChavePista *) malloc(n * sizeof(ChavePista) + 1);
+    ItemOrdenacao *itens = (ItemOrdenacao *) malloc(n * sizeof(ItemOrdenacao) + 1);
+    if (!ref || !v || !chaves || !itens) {
+        fprintf(stderr, "Falha ao alocar memória para benchmark\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int corpus = 0; corpus < 2; ++corpus) {
+        char **pistas = gerarCorpusOrdenacao(corpus, n);
+        printf("Corpus %s, %zu pistas:\n", nomesCorpus[corpus], n);
+
+        memcpy(ref, pistas, n * sizeof(char *));
+        double t0 = agoraSegundos();
+        qsort(ref, n, sizeof(char *), compararPistasQsort);
+        double tQsort = agoraSegundos() - t0;
+
+        /* demais variantes: melhor de REPETICOES_ORDENACAO seguidas (a primeira paga as falhas de página) */
+        double tQsortChaves = 1e30, tRadix = 1e30, tParalelo = 1e30;
+        for (int rep = 0; rep < REPETICOES_ORDENACAO; ++rep) {
+            t0 = agoraSegundos();
+            for (size_t i = 0; i < n; ++i) {
+                unsigned char tmp[1];
+                chaves[i].tam = gerarChaveColacao(pistas[i], tmp, 0);
+                unsigned char *k = (unsigned char *) malloc(chaves[i].tam);
+                if (!k) {
+                    fprintf(stderr, "Falha ao alocar memória para benchmark\n");
+                    exit(EXIT_FAILURE);
+                }
+                gerarChaveColacao(pistas[i], k, chaves[i].tam);
+                chaves[i].chave = k;
+                chaves[i].pista = pistas[i];
+            }
+            qsort(chaves, n, sizeof(ChavePista), compararChavePista);
+            tQsortChaves = menorTempo(tQsortChaves, agoraSegundos() - t0);
+            for (size_t i = 0; i < n; ++i) {
+                v[i] = chaves[i].pista;
+                free((void *) chaves[i].chave);
+            }
+            divergencias += conferirOrdenacao(ref, v, n);
+        }
+        for (int rep = 0; rep < REPETICOES_ORDENACAO; ++rep) {
+            memcpy(v, pistas, n * sizeof(char *));
+            t0 = agoraSegundos();
+            ordenarPistasColacao(v, n, 1);
+            tRadix = menorTempo(tRadix, agoraSegundos() - t0);
+            divergencias += conferirOrdenacao(ref, v, n);
+        }
+        for (int rep = 0; rep < REPETICOES_ORDENACAO; ++rep) {
+            memcpy(v, pistas, n * sizeof(char *));
+            t0 = agoraSegundos();
+            ordenarPistasColacao(v, n, numThreads);
+            tParalelo = menorTempo(tParalelo, agoraSegundos() - t0);
+            divergencias += conferirOrdenacao(ref, v, n);
+        }
+        printf("  ordem alfabética: qsort + compararPistasColacao %.3f s; qsort de chaves pré-calculadas %.3f s\n",
+               tQsort, tQsortChaves);
+        printf("                    radix/multichave %.3f s (%.1fx); com %d thread(s) %.3f s (%.1fx)\n", tRadix,
+               tQsortChaves / tRadix, numThreads, tParalelo, tQsortChaves / tParalelo);
+
+        /* ordem de bytes (strcmp), como a consolidação do registro de suspeitos */
+        double tStrcmp = 1e30, tBytes = 1e30;
+        for (int rep = 0; rep < REPETICOES_ORDENACAO; ++rep) {
+            memcpy(ref, pistas, n * sizeof(char *));
+            t0 = agoraSegundos();
+            qsort(ref, n, sizeof(char *), compararStrcmpQsort);
+            tStrcmp = menorTempo(tStrcmp, agoraSegundos() - t0);
+            t0 = agoraSegundos();
+            for (size_t i = 0; i < n; ++i) {
+                ItemOrdenacao it = { (const unsigned char *) pistas[i], (uint32_t) strlen(pistas[i]), (uint32_t) i };
+                itens[i] = it;
+            }
+            ordenarItens(itens, n, NULL, NULL, 1);
+            tBytes = menorTempo(tBytes, agoraSegundos() - t0);
+            for (size_t i = 0; i < n; ++i) v[i] = pistas[itens[i].indice];
+            divergencias += conferirOrdenacao(ref, v, n);
+        }
+        printf("  ordem de bytes:   qsort + strcmp %.3f s; radix/multichave %.3f s (%.1fx)\n", tStrcmp, tBytes,
+               tStrcmp / tBytes);
+
+        for (size_t i = 0; i < n; ++i) free(pistas[i]);
+        free(pistas);
+    }
+    printf("Saídas conferidas com qsort: %s\n", divergencias == 0 ? "idênticas" : "DIVERGENTES");
+    free(ref);
+    free(v);
+    free(chaves);
+    free(itens);
+    return divergencias == 0 ? 0 : -1;
+}
+
 /* =========================
    Funções BST (pistas coletadas)
    ========================= */
-/* criar nó da BST */
-PistaNode* novoNoPista(const char *pista) {
+/* criar nó da BST (a chave de colação é calculada uma única vez, aqui) */
+static PistaNode *novoNoPistaComChave(const char *pista, const ChaveColacao *chave) {
     PistaNode *n = (PistaNode *) malloc(sizeof(PistaNode));
-    if (!n) {
+    if (n) n->chave = (unsigned char *) malloc(chave->tam);
+    if (!n || !n->chave) {
         fprintf(stderr, "Falha ao alocar memória para nó de pista\n");
         exit(EXIT_FAILURE);
     }
     n->pista = strdup_safe(pista);
+    memcpy(n->chave, chave->dados, chave->tam);
+    n->tamChave = (uint32_t) chave->tam;
     n->contador = 1;
     n->esq = n->dir = NULL;
     return n;
 }
 
+PistaNode* novoNoPista(const char *pista) {
+    ChaveColacao chave;
+    prepararChave(&chave, pista);
+    PistaNode *n = novoNoPistaComChave(pista, &chave);
+    descartarChave(&chave);
+    return n;
+}
+
+/* compara uma pista (com sua chave) ao nó: chaves por memcmp, strcmp só em empate */
+static inline int compararComNo(const char *pista, const ChaveColacao *chave, const PistaNode *no) {
+    int cmp = compararChaves(chave->dados, chave->tam, no->chave, no->tamChave);
+    return cmp != 0 ? cmp : strcmp(pista, no->pista);
+}
+
 /* inserirPista: insere ou incrementa contador se já existir (ordenado alfabeticamente) */
 PistaNode* inserirPista(PistaNode *root, const char *pista) {
-    if (!root) return novoNoPista(pista);
-    int cmp = strcmp(pista, root->pista);
-    if (cmp == 0) {
-        root->contador++;
-    } else if (cmp < 0) {
-        root->esq = inserirPista(root->esq, pista);
-    } else {
-        root->dir = inserirPista(root->dir, pista);
+    ChaveColacao chave;
+    prepararChave(&chave, pista);
+    PistaNode **ligacao = &root;
+    while (*ligacao) {
+        int cmp = compararComNo(pista, &chave, *ligacao);
+        if (cmp == 0) {
+            (*ligacao)->contador++;
+            break;
+        }
+        ligacao = cmp < 0 ? &(*ligacao)->esq : &(*ligacao)->dir;
+    }
+    if (!*ligacao) *ligacao = novoNoPistaComChave(pista, &chave);
+    descartarChave(&chave);
+    return root;
+}
+
+/* buscarPista: retorna o nó da pista (ou NULL se ainda não foi coletada) */
+PistaNode *buscarPista(PistaNode *root, const char *pista) {
+    ChaveColacao chave;
+    prepararChave(&chave, pista);
+    while (root) {
+        int cmp = compararComNo(pista, &chave, root);
+        if (cmp == 0) break;
+        root = cmp < 0 ? root->esq : root->dir;
     }
+    descartarChave(&chave);
     return root;
 }
 
-/* exibirPistas: percurso em-ordem (alfabético) com contadores */
+/* exibirPistas: percurso em-ordem (alfabético, ver chaves de colação) com contadores */
 void exibirPistasInOrder(PistaNode *root) {
     if (!root) return;
     exibirPistasInOrder(root->esq);
@@ -137,12 +1075,19 @@ void exibirPistasInOrder(PistaNode *root) {
     exibirPistasInOrder(root->dir);
 }
 
+/* contarNosPistas: número de pistas distintas na BST */
+size_t contarNosPistas(PistaNode *root) {
+    if (!root) return 0;
+    return 1 + contarNosPistas(root->esq) + contarNosPistas(root->dir);
+}
+
 /* liberar BST */
 void liberarPistas(PistaNode *root) {
     if (!root) return;
     liberarPistas(root->esq);
     liberarPistas(root->dir);
     free(root->pista);
+    free(root->chave);
     free(root);
 }
 
@@ -158,6 +1103,23 @@ unsigned long hash_djb2(const char *str) {
     return hash;
 }
 
+/* índice invertido de palavras (seção própria, mais abaixo); mantido aqui quando ativo */
+typedef struct IndicePalavras IndicePalavras;
+extern IndicePalavras *indicePalavrasAtivo;
+void indexarEntradaPalavras(IndicePalavras *ind, HashEntry *e);
+void esquecerEntradaPalavras(IndicePalavras *ind, const HashEntry *e);
+void esvaziarIndicePalavras(IndicePalavras *ind);
+
+/* registro de suspeitos (seção seguinte): guarda o único exemplar de cada nome */
+uint32_t registrarSuspeito(const char *nome);
+void limparRegistroSuspeitos(void);
+char *nomeSuspeito(uint32_t id);
+
+/* resumo de evidências por subárvore (seção própria); reatribuições o atualizam quando ativo */
+typedef struct ResumoEvidencias ResumoEvidencias;
+extern ResumoEvidencias *resumoEvidenciasAtivo;
+void pistaReatribuidaResumo(ResumoEvidencias *r, const char *pista, uint32_t idSuspeito);
+
 /* inserirNaHash: associa pista -> suspeito */
 void inserirNaHash(const char *pista, const char *suspeito) {
     unsigned long h = hash_djb2(pista) % HASH_SIZE;
@@ -167,24 +1129,33 @@ void inserirNaHash(const char *pista, const char *suspeito) {
         exit(EXIT_FAILURE);
     }
     entry->pista = strdup_safe(pista);
-    entry->suspeito = strdup_safe(suspeito);
+    entry->id = totalPistasHash++;
+    entry->idSuspeito = registrarSuspeito(suspeito);
     entry->prox = tabelaHash[h];
     tabelaHash[h] = entry;
+    if (indicePalavrasAtivo) indexarEntradaPalavras(indicePalavrasAtivo, entry);
+    if (resumoEvidenciasAtivo) pistaReatribuidaResumo(resumoEvidenciasAtivo, entry->pista, entry->idSuspeito);
 }
 
-/* encontrarSuspeito: retorna nome do suspeito associado à pista (ou NULL se não existir) */
-char *encontrarSuspeito(const char *pista) {
+/* buscarEntradaHash: entrada vigente da pista (a inserida por último), ou NULL */
+HashEntry *buscarEntradaHash(const char *pista) {
     unsigned long h = hash_djb2(pista) % HASH_SIZE;
     HashEntry *cur = tabelaHash[h];
     while (cur) {
         if (strcmp(cur->pista, pista) == 0) {
-            return cur->suspeito;
+            return cur;
         }
         cur = cur->prox;
     }
     return NULL;
 }
 
+/* encontrarSuspeito: retorna nome do suspeito associado à pista (ou NULL se não existir) */
+char *encontrarSuspeito(const char *pista) {
+    HashEntry *e = buscarEntradaHash(pista);
+    return e ? nomeSuspeito(e->idSuspeito) : NULL;
+}
+
 /* liberar tabela hash */
 void liberarHash() {
     for (int i = 0; i < HASH_SIZE; ++i) {
@@ -192,91 +1163,8392 @@ void liberarHash() {
         while (cur) {
             HashEntry *next = cur->prox;
             free(cur->pista);
-            free(cur->suspeito);
             free(cur);
             cur = next;
         }
         tabelaHash[i] = NULL;
     }
+    totalPistasHash = 0;
+    limparRegistroSuspeitos();
+    if (indicePalavrasAtivo) esvaziarIndicePalavras(indicePalavrasAtivo);
 }
 
 /* =========================
-   Exploração das salas e coleta de pistas
+   Registro de suspeitos (estrutura de vetores)
    ========================= */
 /*
- explorarSalasComPistas:
-  - navega interativamente a partir do nó inicial
-  - comandos: e (esquerda), d (direita), s (sair)
-  - ao visitar sala com pista não coletada: exibe e adiciona à BST
+ Cada suspeito recebe um id denso na primeira vez que aparece em inserirNaHash
+ (HashEntry::idSuspeito). Os dados por suspeito ficam em vetores paralelos, um campo por
+ vetor, para que as passadas "para todo suspeito" (ranking, pontuação, listagem) sejam
+ varreduras sequenciais em vez de comparações de strings:
+  - nomes: uma única cópia de cada nome (as entradas da hash guardam só o id, e
+    encontrarSuspeito devolve nomes[idSuspeito]);
+  - numPistas: pistas vigentes que apontam para o suspeito;
+  - pontuacao: área de trabalho das passadas (ex.: pistas coletadas numa sessão);
+  - inicioPistas / idsPistas: lista (CSR) dos ids das pistas de cada suspeito.
+ numPistas e a lista CSR são consolidados sob demanda: inserirNaHash só marca o registro
+ como desatualizado, e consolidarRegistroSuspeitos descarta entradas sobrescritas.
 */
-void explorarSalasComPistas(Sala *inicio, PistaNode **rootPistas) {
-    Sala *atual = inicio;
-    char linha[128];
+#define SEM_SUSPEITO UINT32_MAX
 
-    printf("Começando a investigação a partir do Hall de Entrada.\n");
-    while (1) {
-        printf("\nVocê está na sala: %s\n", atual->nome);
-        if (atual->pista && !atual->pistaColetada) {
-            printf("Pista encontrada: \"%s\"\n", atual->pista);
-            *rootPistas = inserirPista(*rootPistas, atual->pista);
-            atual->pistaColetada = 1;
-        } else if (atual->pista && atual->pistaColetada) {
-            printf("Esta sala já teve sua pista coletada anteriormente.\n");
-        } else {
-            printf("Nenhuma pista nesta sala.\n");
-        }
+typedef struct RegistroSuspeitos {
+    uint32_t num, cap;
+    char **nomes;
+    uint32_t *numPistas;
+    uint32_t *pontuacao;
+    uint32_t *inicioPistas;     // num + 1 deslocamentos em idsPistas
+    uint32_t *idsPistas;        // ids de pista, crescentes dentro de cada suspeito
+    HashEntry **entradaPorId;   // id de pista -> entrada vigente (NULL se sobrescrita)
+    uint32_t numIds;            // totalPistasHash na última consolidação
+    uint32_t *vagas;            // nome -> id + 1 (endereçamento aberto); potência de 2
+    uint32_t capVagas;
+    int consolidado;
+} RegistroSuspeitos;
 
-        printf("\nOpções: (e) esquerda, (d) direita, (s) sair da exploração\n");
-        printf("Escolha: ");
-        if (!fgets(linha, sizeof(linha), stdin)) break;
-        trim_nl(linha);
-        if (strlen(linha) == 0) continue;
-        char cmd = (char) tolower((unsigned char)linha[0]);
-        if (cmd == 's') {
-            printf("Você optou por encerrar a exploração.\n");
-            break;
-        } else if (cmd == 'e') {
-            if (atual->esq) {
-                atual = atual->esq;
-            } else {
-                printf("Caminho à esquerda não existe a partir daqui.\n");
-            }
-        } else if (cmd == 'd') {
-            if (atual->dir) {
-                atual = atual->dir;
-            } else {
-                printf("Caminho à direita não existe a partir daqui.\n");
-            }
-        } else {
-            printf("Comando inválido. Use 'e', 'd' ou 's'.\n");
-        }
-    }
+RegistroSuspeitos registroSuspeitos;
+
+static void *alocarRegistro(void *p, size_t n, size_t tam) {
+    return alocar_safe(p, n, tam, "o registro de suspeitos");
 }
 
-/* =========================
+static uint32_t vagaNomeSuspeito(const char *nome, uint32_t cap) {
+    return (uint32_t) hash_djb2(nome) & (cap - 1);
+}
+
+/* buscarIdSuspeito: id do suspeito, ou SEM_SUSPEITO se o nome nunca foi registrado */
+uint32_t buscarIdSuspeito(const char *nome) {
+    RegistroSuspeitos *r = &registroSuspeitos;
+    if (!nome || r->capVagas == 0) return SEM_SUSPEITO;
+    for (uint32_t v = vagaNomeSuspeito(nome, r->capVagas); r->vagas[v]; v = (v + 1) & (r->capVagas - 1)) {
+        if (strcmp(r->nomes[r->vagas[v] - 1], nome) == 0) return r->vagas[v] - 1;
+    }
+    return SEM_SUSPEITO;
+}
+
+/*
+ registrarSuspeito: id do suspeito, criando-o se necessário. Chamado a cada associação
+ nova, marca numPistas e a lista CSR para reconsolidar.
+*/
+uint32_t registrarSuspeito(const char *nome) {
+    RegistroSuspeitos *r = &registroSuspeitos;
+    r->consolidado = 0;
+    uint32_t id = buscarIdSuspeito(nome);
+    if (id != SEM_SUSPEITO) return id;
+    if ((r->num + 1) * 2 > r->capVagas) {
+        uint32_t nova = r->capVagas ? r->capVagas * 2 : 64;
+        uint32_t *vagas = (uint32_t *) calloc(nova, sizeof(uint32_t));
+        if (!vagas) {
+            fprintf(stderr, "Falha ao alocar memória para o registro de suspeitos\n");
+            exit(EXIT_FAILURE);
+        }
+        for (uint32_t s = 0; s < r->num; ++s) {
+            uint32_t v = vagaNomeSuspeito(r->nomes[s], nova);
+            while (vagas[v]) v = (v + 1) & (nova - 1);
+            vagas[v] = s + 1;
+        }
+        free(r->vagas);
+        r->vagas = vagas;
+        r->capVagas = nova;
+    }
+    if (r->num == r->cap) {
+        r->cap = r->cap ? r->cap * 2 : 16;
+        r->nomes = (char **) alocarRegistro(r->nomes, r->cap, sizeof(char *));
+        r->numPistas = (uint32_t *) alocarRegistro(r->numPistas, r->cap, sizeof(uint32_t));
+        r->pontuacao = (uint32_t *) alocarRegistro(r->pontuacao, r->cap, sizeof(uint32_t));
+    }
+    id = r->num++;
+    r->nomes[id] = strdup_safe(nome);
+    r->numPistas[id] = 0;
+    r->pontuacao[id] = 0;
+    uint32_t v = vagaNomeSuspeito(nome, r->capVagas);
+    while (r->vagas[v]) v = (v + 1) & (r->capVagas - 1);
+    r->vagas[v] = id + 1;
+    return id;
+}
+
+/* nomeSuspeito: nome registrado (válido até liberarHash) */
+char *nomeSuspeito(uint32_t id) {
+    return registroSuspeitos.nomes[id];
+}
+
+/* limparRegistroSuspeitos: esquece todos os suspeitos (a tabela hash foi liberada) */
+void limparRegistroSuspeitos(void) {
+    RegistroSuspeitos *r = &registroSuspeitos;
+    for (uint32_t s = 0; s < r->num; ++s) free(r->nomes[s]);
+    free(r->nomes);
+    free(r->numPistas);
+    free(r->pontuacao);
+    free(r->inicioPistas);
+    free(r->idsPistas);
+    free(r->entradaPorId);
+    free(r->vagas);
+    memset(r, 0, sizeof(*r));
+}
+
+static int desempatarMaisNova(uint32_t a, uint32_t b, void *ctx) {
+    HashEntry *const *todas = (HashEntry *const *) ctx;
+    return (todas[a]->id < todas[b]->id) - (todas[a]->id > todas[b]->id);   // mais nova primeiro
+}
+
+/*
+ consolidarRegistroSuspeitos: recalcula numPistas e a lista CSR a partir das entradas
+ vigentes da tabela hash (de uma pista inserida duas vezes vale a mais nova).
+*/
+void consolidarRegistroSuspeitos(void) {
+    RegistroSuspeitos *r = &registroSuspeitos;
+    if (r->consolidado) return;
+    uint32_t n = totalPistasHash;
+    HashEntry **todas = (HashEntry **) alocarRegistro(NULL, n, sizeof(HashEntry *));
+    uint32_t k = 0;
+    for (int i = 0; i < HASH_SIZE; ++i) {
+        for (HashEntry *e = tabelaHash[i]; e; e = e->prox) todas[k++] = e;
+    }
+    /* por texto (ordem de bytes), a mais nova primeiro entre pistas iguais */
+    ItemOrdenacao *itens = (ItemOrdenacao *) alocarRegistro(NULL, k, sizeof(ItemOrdenacao));
+    for (uint32_t i = 0; i < k; ++i) {
+        ItemOrdenacao it = { (const unsigned char *) todas[i]->pista, (uint32_t) strlen(todas[i]->pista), i };
+        itens[i] = it;
+    }
+    ordenarItens(itens, k, desempatarMaisNova, todas, 0);
+    r->entradaPorId = (HashEntry **) alocarRegistro(r->entradaPorId, n, sizeof(HashEntry *));
+    memset(r->entradaPorId, 0, (size_t) n * sizeof(HashEntry *));
+    for (uint32_t i = 0; i < k; ++i) {
+        HashEntry *e = todas[itens[i].indice];
+        if (i == 0 || strcmp(e->pista, todas[itens[i - 1].indice]->pista) != 0) r->entradaPorId[e->id] = e;
+    }
+    free(itens);
+    free(todas);
+    r->numIds = n;
+
+    /* contagem e distribuição (em ordem de id, para listas crescentes) */
+    if (r->num) memset(r->numPistas, 0, r->num * sizeof(uint32_t));
+    for (uint32_t id = 0; id < n; ++id) {
+        if (r->entradaPorId[id]) r->numPistas[r->entradaPorId[id]->idSuspeito]++;
+    }
+    r->inicioPistas = (uint32_t *) alocarRegistro(r->inicioPistas, (size_t) r->num + 1, sizeof(uint32_t));
+    uint32_t soma = 0;
+    for (uint32_t s = 0; s < r->num; ++s) {
+        r->inicioPistas[s] = soma;
+        soma += r->numPistas[s];
+    }
+    r->inicioPistas[r->num] = soma;
+    r->idsPistas = (uint32_t *) alocarRegistro(r->idsPistas, soma, sizeof(uint32_t));
+    uint32_t *proximo = (uint32_t *) alocarRegistro(NULL, r->num, sizeof(uint32_t));
+    memcpy(proximo, r->inicioPistas, r->num * sizeof(uint32_t));
+    for (uint32_t id = 0; id < n; ++id) {
+        if (r->entradaPorId[id]) r->idsPistas[proximo[r->entradaPorId[id]->idSuspeito]++] = id;
+    }
+    free(proximo);
+    r->consolidado = 1;
+}
+
+/* suspeitoMaisCitado: suspeito com mais pistas vigentes (o de menor id em empate) */
+uint32_t suspeitoMaisCitado(void) {
+    consolidarRegistroSuspeitos();
+    const uint32_t *numPistas = registroSuspeitos.numPistas;
+    uint32_t melhor = SEM_SUSPEITO, maximo = 0;
+    for (uint32_t s = 0; s < registroSuspeitos.num; ++s) {
+        if (numPistas[s] > maximo) {
+            maximo = numPistas[s];
+            melhor = s;
+        }
+    }
+    return melhor;
+}
+
+/* pontuarColetadas: pontuacao[s] = pistas coletadas na BST que apontam para s (com repetições) */
+static void somarPontuacao(PistaNode *no, uint32_t *pontuacao) {
+    if (!no) return;
+    HashEntry *e = buscarEntradaHash(no->pista);
+    if (e) pontuacao[e->idSuspeito] += (uint32_t) no->contador;
+    somarPontuacao(no->esq, pontuacao);
+    somarPontuacao(no->dir, pontuacao);
+}
+
+void pontuarColetadas(PistaNode *pistas) {
+    if (registroSuspeitos.num) memset(registroSuspeitos.pontuacao, 0, registroSuspeitos.num * sizeof(uint32_t));
+    somarPontuacao(pistas, registroSuspeitos.pontuacao);
+}
+
+static int compararClassificacao(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    const RegistroSuspeitos *r = &registroSuspeitos;
+    if (r->pontuacao[x] != r->pontuacao[y]) return r->pontuacao[x] < r->pontuacao[y] ? 1 : -1;
+    if (r->numPistas[x] != r->numPistas[y]) return r->numPistas[x] < r->numPistas[y] ? 1 : -1;
+    return (x > y) - (x < y);
+}
+
+/*
+ classificarSuspeitos: ordem (num ids) por pontuação decrescente; desempate por pistas
+ vigentes e depois por id.
+*/
+void classificarSuspeitos(uint32_t *ordem) {
+    consolidarRegistroSuspeitos();
+    for (uint32_t s = 0; s < registroSuspeitos.num; ++s) ordem[s] = s;
+    qsort(ordem, registroSuspeitos.num, sizeof(uint32_t), compararClassificacao);
+}
+
+/* listarAssociacoes: cada suspeito com as pistas que apontam para ele */
+void listarAssociacoes(void) {
+    consolidarRegistroSuspeitos();
+    const RegistroSuspeitos *r = &registroSuspeitos;
+    for (uint32_t s = 0; s < r->num; ++s) {
+        printf("%s (%u pista%s):\n", r->nomes[s], r->numPistas[s], r->numPistas[s] == 1 ? "" : "s");
+        for (uint32_t i = r->inicioPistas[s]; i < r->inicioPistas[s + 1]; ++i) {
+            printf(" - \"%s\"\n", r->entradaPorId[r->idsPistas[i]]->pista);
+        }
+    }
+}
+
+/* contagem por nome, como antes do registro (referência para o benchmark) */
+static uint32_t contarPorNome(PistaNode *no, const char *nome) {
+    if (!no) return 0;
+    const char *sus = encontrarSuspeito(no->pista);
+    return (sus && strcmp(sus, nome) == 0 ? (uint32_t) no->contador : 0) +
+           contarPorNome(no->esq, nome) + contarPorNome(no->dir, nome);
+}
+
+/*
+ benchSuspeitos: catálogo sintético (suspeitos com frequências desiguais, 1% das pistas
+ reatribuídas) e uma sessão com pistas coletadas. Compara a pontuação por varredura do
+ registro com uma contagem por nome para cada suspeito.
+*/
+int benchSuspeitos(size_t numPistas, size_t numSuspeitos) {
+    if (numPistas == 0 || numSuspeitos == 0) {
+        fprintf(stderr, "Uso: --bench-suspeitos <pistas> <suspeitos>, ambos maiores que zero\n");
+        return -1;
+    }
+    uint64_t semente = 17;
+    char pista[64], suspeito[32];
+    for (size_t i = 0; i < numPistas + numPistas / 100; ++i) {
+        size_t p = i < numPistas ? i : (size_t) (aleatorio(&semente) % numPistas);
+        uint64_t a = aleatorio(&semente) % numSuspeitos, b = aleatorio(&semente) % numSuspeitos;
+        snprintf(pista, sizeof(pista), "pista sintetica %zu", p);
+        snprintf(suspeito, sizeof(suspeito), "Suspeito %llu", (unsigned long long) (a * b / numSuspeitos));
+        inserirNaHash(pista, suspeito);
+    }
+    double t0 = agoraSegundos();
+    consolidarRegistroSuspeitos();
+    double tConsolidar = agoraSegundos() - t0;
+    const RegistroSuspeitos *r = &registroSuspeitos;
+
+    /* conferência de numPistas com a contagem direta nos baldes (vigente = a que buscarEntradaHash acha) */
+    uint32_t *porNome = (uint32_t *) alocarRegistro(NULL, r->num, sizeof(uint32_t));
+    memset(porNome, 0, r->num * sizeof(uint32_t));
+    for (int i = 0; i < HASH_SIZE; ++i) {
+        for (HashEntry *e = tabelaHash[i]; e; e = e->prox) {
+            if (buscarEntradaHash(e->pista) == e) porNome[e->idSuspeito]++;
+        }
+    }
+    int divergencias = 0;
+    for (uint32_t s = 0; s < r->num; ++s) divergencias += porNome[s] != r->numPistas[s];
+
+    PistaNode *coletadas = NULL;
+    size_t numColetadas = numPistas < 2000 ? numPistas : 2000;
+    for (size_t i = 0; i < numColetadas; ++i) {
+        snprintf(pista, sizeof(pista), "pista sintetica %llu", (unsigned long long) (aleatorio(&semente) % numPistas));
+        coletadas = inserirPista(coletadas, pista);
+    }
+    int repeticoes = 20;
+    uint32_t *ordem = (uint32_t *) alocarRegistro(NULL, r->num, sizeof(uint32_t));
+    t0 = agoraSegundos();
+    for (int k = 0; k < repeticoes; ++k) {
+        pontuarColetadas(coletadas);
+        classificarSuspeitos(ordem);
+    }
+    double tRegistro = (agoraSegundos() - t0) / repeticoes;
+    t0 = agoraSegundos();
+    for (uint32_t s = 0; s < r->num; ++s) porNome[s] = contarPorNome(coletadas, r->nomes[s]);
+    double tPorNome = agoraSegundos() - t0;
+    for (uint32_t s = 0; s < r->num; ++s) divergencias += porNome[s] != r->pontuacao[s];
+
+    uint32_t topo = suspeitoMaisCitado();
+    printf("%zu pistas, %u suspeitos: consolidação em %.3f s", numPistas, r->num, tConsolidar);
+    if (topo != SEM_SUSPEITO) printf("; mais citado: %s (%u pistas)", r->nomes[topo], r->numPistas[topo]);
+    printf("\n");
+    printf("Pontuação de %zu pistas coletadas + ranking: %.1f us (registro) contra %.1f us (contagem por nome)\n",
+           numColetadas, tRegistro * 1e6, tPorNome * 1e6);
+    if (r->num > 0) printf("Mais pontuado na sessão: %s (%u)\n", r->nomes[ordem[0]], r->pontuacao[ordem[0]]);
+    printf("Conferência com a contagem por nome: %s\n", divergencias == 0 ? "ok" : "DIVERGENTE");
+    free(porNome);
+    free(ordem);
+    liberarPistas(coletadas);
+    liberarHash();
+    return divergencias == 0 ? 0 : -1;
+}
+
+/* =========================
+   Importação de cenários em JSON (parser em fluxo, estilo SAX)
+   ========================= */
+/*
+ Formato esperado:
+  {
+    "mansao": { "nome": "Hall de Entrada", "pista": null,
+                "esq": { ... }, "dir": { ... } },
+    "associacoes": [ { "pista": "...", "suspeito": "..." }, ... ]
+  }
+ O arquivo é lido em blocos; não existe DOM intermediário. A memória extra usada
+ pelo parser é proporcional à profundidade de aninhamento e à maior string, não
+ ao tamanho do arquivo. Chaves desconhecidas são ignoradas.
+*/
+
+/* eventos emitidos pelo parser */
+typedef struct EventosJson {
+    int (*inicioObjeto)(void *ctx);
+    int (*fimObjeto)(void *ctx);
+    int (*inicioArray)(void *ctx);
+    int (*fimArray)(void *ctx);
+    int (*chave)(void *ctx, const char *s, size_t n);
+    int (*string)(void *ctx, const char *s, size_t n);
+    int (*escalar)(void *ctx);      // número, true, false ou null
+} EventosJson;
+
+#define JSON_TAM_BLOCO 65536
+
+typedef struct LeitorJson {
+    FILE *arq;
+    unsigned char buf[JSON_TAM_BLOCO];
+    size_t pos, tam;
+    unsigned long long linha;
+    char *str;                      // buffer da string corrente (cresce conforme a maior string)
+    size_t strTam, strCap;
+} LeitorJson;
+
+static int lerByteJson(LeitorJson *l) {
+    if (l->pos == l->tam) {
+        l->tam = fread(l->buf, 1, sizeof(l->buf), l->arq);
+        l->pos = 0;
+        if (l->tam == 0) return EOF;
+    }
+    int c = l->buf[l->pos++];
+    if (c == '\n') l->linha++;
+    return c;
+}
+
+static int lerNaoBrancoJson(LeitorJson *l) {
+    int c;
+    do {
+        c = lerByteJson(l);
+    } while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+    return c;
+}
+
+static void acrescentarStrJson(LeitorJson *l, char c) {
+    if (l->strTam + 1 >= l->strCap) {
+        l->strCap = l->strCap ? l->strCap * 2 : 256;
+        l->str = (char *) realloc(l->str, l->strCap);
+        if (!l->str) {
+            fprintf(stderr, "Falha ao alocar memória para string JSON\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    l->str[l->strTam++] = c;
+}
+
+/* codifica um code point em UTF-8 no buffer da string */
+static void acrescentarUtf8Json(LeitorJson *l, unsigned long cp) {
+    if (cp < 0x80) {
+        acrescentarStrJson(l, (char) cp);
+    } else if (cp < 0x800) {
+        acrescentarStrJson(l, (char) (0xC0 | (cp >> 6)));
+        acrescentarStrJson(l, (char) (0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        acrescentarStrJson(l, (char) (0xE0 | (cp >> 12)));
+        acrescentarStrJson(l, (char) (0x80 | ((cp >> 6) & 0x3F)));
+        acrescentarStrJson(l, (char) (0x80 | (cp & 0x3F)));
+    } else {
+        acrescentarStrJson(l, (char) (0xF0 | (cp >> 18)));
+        acrescentarStrJson(l, (char) (0x80 | ((cp >> 12) & 0x3F)));
+        acrescentarStrJson(l, (char) (0x80 | ((cp >> 6) & 0x3F)));
+        acrescentarStrJson(l, (char) (0x80 | (cp & 0x3F)));
+    }
+}
+
+static long lerHex4Json(LeitorJson *l) {
+    long v = 0;
+    for (int i = 0; i < 4; ++i) {
+        int c = lerByteJson(l);
+        if (!isxdigit(c)) return -1;
+        v = v * 16 + (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+    }
+    return v;
+}
+
+/* lê uma string (a aspa de abertura já foi consumida) para l->str */
+static int lerStringJson(LeitorJson *l) {
+    l->strTam = 0;
+    while (1) {
+        int c = lerByteJson(l);
+        if (c == EOF || c == '\n') return -1;
+        if (c == '"') break;
+        if (c != '\\') {
+            acrescentarStrJson(l, (char) c);
+            continue;
+        }
+        c = lerByteJson(l);
+        switch (c) {
+            case '"': case '\\': case '/': acrescentarStrJson(l, (char) c); break;
+            case 'b': acrescentarStrJson(l, '\b'); break;
+            case 'f': acrescentarStrJson(l, '\f'); break;
+            case 'n': acrescentarStrJson(l, '\n'); break;
+            case 'r': acrescentarStrJson(l, '\r'); break;
+            case 't': acrescentarStrJson(l, '\t'); break;
+            case 'u': {
+                long cp = lerHex4Json(l);
+                if (cp < 0) return -1;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {      // par substituto
+                    if (lerByteJson(l) != '\\' || lerByteJson(l) != 'u') return -1;
+                    long baixo = lerHex4Json(l);
+                    if (baixo < 0xDC00 || baixo > 0xDFFF) return -1;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (baixo - 0xDC00);
+                }
+                acrescentarUtf8Json(l, (unsigned long) cp);
+                break;
+            }
+            default: return -1;
+        }
+    }
+    acrescentarStrJson(l, '\0');
+    l->strTam--;
+    return 0;
+}
+
+/* consome o restante de um literal ou número; devolve o primeiro byte seguinte */
+static int pularEscalarJson(LeitorJson *l, int c) {
+    if (c == 't' || c == 'f' || c == 'n') {
+        const char *lit = c == 't' ? "rue" : (c == 'f' ? "alse" : "ull");
+        for (; *lit; ++lit) {
+            if (lerByteJson(l) != *lit) return -2;
+        }
+        return lerNaoBrancoJson(l);
+    }
+    if (c != '-' && !isdigit(c)) return -2;
+    do {
+        c = lerByteJson(l);
+    } while (isdigit(c) || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-');
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r') c = lerNaoBrancoJson(l);
+    return c;
+}
+
+enum { JSON_VALOR, JSON_VALOR_OU_FIM, JSON_CHAVE, JSON_CHAVE_OU_FIM, JSON_DOIS_PONTOS, JSON_VIRGULA_OU_FIM };
+
+/*
+ percorrerJson: lê o documento inteiro emitindo eventos. A pilha de contêineres é
+ explícita (não recursiva), de modo que mansões muito profundas não estouram a pilha de C.
+ Retorna 0 em sucesso; -1 em erro de sintaxe ou se algum evento retornar diferente de 0.
+*/
+int percorrerJson(FILE *arq, const EventosJson *ev, void *ctx) {
+    LeitorJson *l = (LeitorJson *) malloc(sizeof(LeitorJson));
+    if (!l) {
+        fprintf(stderr, "Falha ao alocar memória para leitor JSON\n");
+        exit(EXIT_FAILURE);
+    }
+    l->arq = arq;
+    l->pos = l->tam = 0;
+    l->linha = 1;
+    l->str = NULL;
+    l->strTam = l->strCap = 0;
+
+    char *pilha = NULL;             // '{' ou '[' por nível
+    size_t topo = 0, capPilha = 0;
+    int estado = JSON_VALOR;
+    int ret = -1;
+    int c = lerNaoBrancoJson(l);
+
+    while (1) {
+        if (c == EOF) break;
+        if (estado == JSON_DOIS_PONTOS) {
+            if (c != ':') break;
+            estado = JSON_VALOR;
+            c = lerNaoBrancoJson(l);
+            continue;
+        }
+        if (estado == JSON_VIRGULA_OU_FIM || estado == JSON_VALOR_OU_FIM || estado == JSON_CHAVE_OU_FIM) {
+            char fecha = topo && pilha[topo - 1] == '{' ? '}' : ']';
+            if (c == fecha) {
+                topo--;
+                if ((fecha == '}' ? ev->fimObjeto(ctx) : ev->fimArray(ctx)) != 0) break;
+                c = lerNaoBrancoJson(l);
+                if (topo == 0) {
+                    ret = c == EOF ? 0 : -1;
+                    break;
+                }
+                estado = JSON_VIRGULA_OU_FIM;
+                continue;
+            }
+            if (estado == JSON_VIRGULA_OU_FIM) {
+                if (c != ',') break;
+                estado = pilha[topo - 1] == '{' ? JSON_CHAVE : JSON_VALOR;
+                c = lerNaoBrancoJson(l);
+                continue;
+            }
+            estado = estado == JSON_VALOR_OU_FIM ? JSON_VALOR : JSON_CHAVE;
+        }
+        if (estado == JSON_CHAVE) {
+            if (c != '"' || lerStringJson(l) != 0) break;
+            if (ev->chave(ctx, l->str, l->strTam) != 0) break;
+            estado = JSON_DOIS_PONTOS;
+            c = lerNaoBrancoJson(l);
+            continue;
+        }
+        /* estado == JSON_VALOR */
+        if (c == '{' || c == '[') {
+            if (topo == capPilha) {
+                capPilha = capPilha ? capPilha * 2 : 64;
+                pilha = (char *) realloc(pilha, capPilha);
+                if (!pilha) {
+                    fprintf(stderr, "Falha ao alocar memória para pilha JSON\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            pilha[topo++] = (char) c;
+            if ((c == '{' ? ev->inicioObjeto(ctx) : ev->inicioArray(ctx)) != 0) break;
+            estado = c == '{' ? JSON_CHAVE_OU_FIM : JSON_VALOR_OU_FIM;
+            c = lerNaoBrancoJson(l);
+            continue;
+        }
+        if (c == '"') {
+            if (lerStringJson(l) != 0) break;
+            if (ev->string(ctx, l->str, l->strTam) != 0) break;
+            c = lerNaoBrancoJson(l);
+        } else {
+            c = pularEscalarJson(l, c);
+            if (c == -2) break;
+            if (ev->escalar(ctx) != 0) break;
+        }
+        if (topo == 0) {
+            ret = c == EOF ? 0 : -1;
+            break;
+        }
+        estado = JSON_VIRGULA_OU_FIM;
+    }
+
+    if (ret != 0) fprintf(stderr, "JSON inválido perto da linha %llu\n", l->linha);
+    free(pilha);
+    free(l->str);
+    free(l);
+    return ret;
+}
+
+/* --- construção de salas e associações a partir dos eventos --- */
+typedef enum { QUADRO_IGNORAR, QUADRO_RAIZ, QUADRO_SALA, QUADRO_ASSOCS, QUADRO_ASSOC } TipoQuadro;
+
+typedef struct QuadroImport {
+    TipoQuadro tipo;
+    char chave[16];         // última chave lida no objeto ("" se desconhecida)
+    Sala *sala;             // QUADRO_SALA
+    char *pista;            // QUADRO_ASSOC
+    char *suspeito;         // QUADRO_ASSOC
+} QuadroImport;
+
+typedef struct Importador {
+    QuadroImport *pilha;
+    size_t topo, cap;
+    Sala *raiz;
+    size_t salas, associacoes;
+} Importador;
+
+static QuadroImport *quadroAtual(Importador *imp) {
+    return imp->topo ? &imp->pilha[imp->topo - 1] : NULL;
+}
+
+static QuadroImport *empilharQuadro(Importador *imp, TipoQuadro tipo) {
+    if (imp->topo == imp->cap) {
+        imp->cap = imp->cap ? imp->cap * 2 : 64;
+        imp->pilha = (QuadroImport *) realloc(imp->pilha, imp->cap * sizeof(QuadroImport));
+        if (!imp->pilha) {
+            fprintf(stderr, "Falha ao alocar memória para importador\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    QuadroImport *q = &imp->pilha[imp->topo++];
+    q->tipo = tipo;
+    q->chave[0] = '\0';
+    q->sala = NULL;
+    q->pista = q->suspeito = NULL;
+    return q;
+}
+
+static int importInicioObjeto(void *ctx) {
+    Importador *imp = (Importador *) ctx;
+    QuadroImport *pai = quadroAtual(imp);
+    if (!pai) {
+        empilharQuadro(imp, QUADRO_RAIZ);
+        return 0;
+    }
+    if ((pai->tipo == QUADRO_RAIZ && strcmp(pai->chave, "mansao") == 0 && !imp->raiz) ||
+        (pai->tipo == QUADRO_SALA && (strcmp(pai->chave, "esq") == 0 || strcmp(pai->chave, "dir") == 0))) {
+        Sala *s = criarSala(NULL, NULL);
+        imp->salas++;
+        if (pai->tipo == QUADRO_RAIZ) {
+            imp->raiz = s;
+        } else if (pai->chave[0] == 'e') {
+            if (pai->sala->esq) return -1;
+            pai->sala->esq = s;
+        } else {
+            if (pai->sala->dir) return -1;
+            pai->sala->dir = s;
+        }
+        empilharQuadro(imp, QUADRO_SALA)->sala = s;
+        return 0;
+    }
+    empilharQuadro(imp, pai->tipo == QUADRO_ASSOCS ? QUADRO_ASSOC : QUADRO_IGNORAR);
+    return 0;
+}
+
+static int importFimObjeto(void *ctx) {
+    Importador *imp = (Importador *) ctx;
+    QuadroImport *q = quadroAtual(imp);
+    int ret = 0;
+    if (q->tipo == QUADRO_SALA && !q->sala->nome) {
+        fprintf(stderr, "Sala sem \"nome\" no cenário\n");
+        ret = -1;
+    } else if (q->tipo == QUADRO_ASSOC) {
+        if (q->pista && q->suspeito) {
+            inserirNaHash(q->pista, q->suspeito);
+            imp->associacoes++;
+        } else {
+            fprintf(stderr, "Associação sem \"pista\" ou \"suspeito\" no cenário\n");
+            ret = -1;
+        }
+        free(q->pista);
+        free(q->suspeito);
+    }
+    imp->topo--;
+    return ret;
+}
+
+static int importInicioArray(void *ctx) {
+    Importador *imp = (Importador *) ctx;
+    QuadroImport *pai = quadroAtual(imp);
+    int assocs = pai && pai->tipo == QUADRO_RAIZ && strcmp(pai->chave, "associacoes") == 0;
+    empilharQuadro(imp, assocs ? QUADRO_ASSOCS : QUADRO_IGNORAR);
+    return 0;
+}
+
+static int importFimArray(void *ctx) {
+    ((Importador *) ctx)->topo--;
+    return 0;
+}
+
+static int importChave(void *ctx, const char *s, size_t n) {
+    QuadroImport *q = quadroAtual((Importador *) ctx);
+    if (n < sizeof(q->chave)) {
+        memcpy(q->chave, s, n + 1);
+    } else {
+        q->chave[0] = '\0';
+    }
+    return 0;
+}
+
+/* substitui *dest por uma cópia de s (campos repetidos: vale o último) */
+static void atribuirCampo(char **dest, const char *s) {
+    free(*dest);
+    *dest = strdup_safe(s);
+}
+
+static int importString(void *ctx, const char *s, size_t n) {
+    (void) n;
+    QuadroImport *q = quadroAtual((Importador *) ctx);
+    if (q->tipo == QUADRO_SALA) {
+        if (strcmp(q->chave, "nome") == 0) atribuirCampo(&q->sala->nome, s);
+        else if (strcmp(q->chave, "pista") == 0) atribuirCampo(&q->sala->pista, s);
+    } else if (q->tipo == QUADRO_ASSOC) {
+        if (strcmp(q->chave, "pista") == 0) atribuirCampo(&q->pista, s);
+        else if (strcmp(q->chave, "suspeito") == 0) atribuirCampo(&q->suspeito, s);
+    }
+    return 0;
+}
+
+static int importEscalar(void *ctx) {
+    (void) ctx;      // null em "pista" = sala sem pista; demais escalares são ignorados
+    return 0;
+}
+
+/*
+ descartarPistasDesde: desfaz as inserções na tabela hash com id >= marca. inserirNaHash
+ insere no início do balde, então essas entradas são sempre as primeiras de cada balde;
+ a pista volta a valer com a associação anterior (se havia). Com o índice de palavras
+ ativo os ids não são reaproveitados, pois as postagens antigas continuam nas listas.
+ Suspeitos registrados só por essas inserções ficam no registro, sem pistas.
+*/
+static void descartarPistasDesde(uint32_t marca) {
+    for (int i = 0; i < HASH_SIZE; ++i) {
+        while (tabelaHash[i] && tabelaHash[i]->id >= marca) {
+            HashEntry *e = tabelaHash[i];
+            tabelaHash[i] = e->prox;
+            if (indicePalavrasAtivo) esquecerEntradaPalavras(indicePalavrasAtivo, e);
+            if (resumoEvidenciasAtivo) {
+                HashEntry *anterior = buscarEntradaHash(e->pista);
+                pistaReatribuidaResumo(resumoEvidenciasAtivo, e->pista, anterior ? anterior->idSuspeito : SEM_SUSPEITO);
+            }
+            free(e->pista);
+            free(e);
+        }
+    }
+    if (!indicePalavrasAtivo) totalPistasHash = marca;
+    registroSuspeitos.consolidado = 0;
+}
+
+/*
+ importarCenarioJson: lê mansão e associações do arquivo; retorna a raiz da mansão
+ (ou NULL em erro). As associações vão direto para a tabela hash via inserirNaHash;
+ em erro, as já inseridas são desfeitas (a tabela fica como antes da chamada).
+*/
+Sala *importarCenarioJson(const char *caminho, size_t *numSalas, size_t *numAssociacoes) {
+    FILE *arq = fopen(caminho, "rb");
+    if (!arq) {
+        fprintf(stderr, "Não foi possível abrir o cenário %s\n", caminho);
+        return NULL;
+    }
+    static const EventosJson eventos = {
+        importInicioObjeto, importFimObjeto, importInicioArray, importFimArray,
+        importChave, importString, importEscalar
+    };
+    Importador imp = { NULL, 0, 0, NULL, 0, 0 };
+    uint32_t marca = totalPistasHash;
+    int ret = percorrerJson(arq, &eventos, &imp);
+    fclose(arq);
+
+    /* em caso de erro, liberar campos pendentes de associações abertas */
+    for (size_t i = 0; i < imp.topo; ++i) {
+        free(imp.pilha[i].pista);
+        free(imp.pilha[i].suspeito);
+    }
+    free(imp.pilha);
+    if (ret != 0 || !imp.raiz) {
+        if (ret == 0) fprintf(stderr, "Cenário sem objeto \"mansao\"\n");
+        liberarSalas(imp.raiz);
+        descartarPistasDesde(marca);
+        return NULL;
+    }
+    if (numSalas) *numSalas = imp.salas;
+    if (numAssociacoes) *numAssociacoes = imp.associacoes;
+    return imp.raiz;
+}
+
+/* gera um cenário sintético (árvore balanceada) para testes de carga do importador */
+static void gerarSalaJson(FILE *out, size_t id, size_t numSalas, size_t *numPistas) {
+    fprintf(out, "{\"nome\":\"Sala %zu\",\"pista\":", id);
+    if (id % 2 == 0) {
+        fprintf(out, "\"pista numero %zu encontrada na sala\"", id);
+        (*numPistas)++;
+    } else {
+        fputs("null", out);
+    }
+    if (2 * id + 1 < numSalas) {
+        fputs(",\"esq\":", out);
+        gerarSalaJson(out, 2 * id + 1, numSalas, numPistas);
+    }
+    if (2 * id + 2 < numSalas) {
+        fputs(",\"dir\":", out);
+        gerarSalaJson(out, 2 * id + 2, numSalas, numPistas);
+    }
+    fputc('}', out);
+}
+
+int gerarCenarioJson(const char *caminho, size_t numSalas) {
+    FILE *out = fopen(caminho, "wb");
+    if (!out) {
+        fprintf(stderr, "Não foi possível criar %s\n", caminho);
+        return -1;
+    }
+    size_t numPistas = 0;
+    fputs("{\"mansao\":", out);
+    if (numSalas > 0) gerarSalaJson(out, 0, numSalas, &numPistas);
+    else fputs("null", out);
+    fputs(",\n\"associacoes\":[", out);
+    for (size_t id = 0; id < numSalas; id += 2) {
+        fprintf(out, "%s\n{\"pista\":\"pista numero %zu encontrada na sala\",\"suspeito\":\"Suspeito %zu\"}",
+                id ? "," : "", id, (id / 2) % 97);
+    }
+    fputs("]}\n", out);
+    return fclose(out);
+}
+
+/* gerarMansaoSintetica: mesma forma do cenário gerado em JSON, construída em memória */
+Sala *gerarMansaoSintetica(size_t numSalas) {
+    if (numSalas == 0) return NULL;
+    Sala **salas = (Sala **) malloc(numSalas * sizeof(Sala *));
+    if (!salas) {
+        fprintf(stderr, "Falha ao alocar memória para mansão sintética\n");
+        exit(EXIT_FAILURE);
+    }
+    char nome[64], pista[64], suspeito[32];
+    for (size_t id = 0; id < numSalas; ++id) {
+        snprintf(nome, sizeof(nome), "Sala %zu", id);
+        if (id % 2 == 0) {
+            snprintf(pista, sizeof(pista), "pista numero %zu encontrada na sala", id);
+            snprintf(suspeito, sizeof(suspeito), "Suspeito %zu", (id / 2) % 97);
+            inserirNaHash(pista, suspeito);
+        }
+        salas[id] = criarSala(nome, id % 2 == 0 ? pista : NULL);
+        if (id > 0) {
+            if (id % 2 == 1) salas[(id - 1) / 2]->esq = salas[id];
+            else salas[(id - 1) / 2]->dir = salas[id];
+        }
+    }
+    Sala *raiz = salas[0];
+    free(salas);
+    return raiz;
+}
+
+/* =========================
+   Formato binário de cenário com CRC32C por seção
+   ========================= */
+/*
+ Layout (inteiros little-endian):
+  cabeçalho:  "DQCB" | versao u32 | numSecoes u32 | crcTabela u32
+  tabela:     numSecoes x { tipo u32 | crc u32 | deslocamento u64 | tamanho u64 }
+  seções:     fluxo de salas (pré-ordem) e fluxo de associações, cada um dividido
+              em seções de até BIN_TAM_SECAO bytes com CRC32C próprio.
+ Sala no fluxo: flags u8 (1 = tem pista, 2 = tem esq, 4 = tem dir) | nome | pista?
+ Associação:    pista | suspeito          (strings: tamanho u32 + bytes)
+ Dividir em seções pequenas permite verificar os checksums em paralelo.
+*/
+#define BIN_MAGICO "DQCB"
+#define BIN_VERSAO 1
+#define BIN_TAM_SECAO (4u << 20)
+#define BIN_SECAO_SALAS 1
+#define BIN_SECAO_ASSOCS 2
+
+/* buffer de bytes crescente (serialização) */
+typedef struct BufferBin {
+    unsigned char *dados;
+    size_t tam, cap;
+} BufferBin;
+
+/* garante espaço para mais n bytes sem alterar o tamanho */
+void reservarBin(BufferBin *b, size_t n) {
+    if (b->tam + n > b->cap) {
+        size_t cap = b->cap ? b->cap : 4096;
+        while (cap < b->tam + n) cap *= 2;
+        b->dados = (unsigned char *) realloc(b->dados, cap);
+        if (!b->dados) {
+            fprintf(stderr, "Falha ao alocar memória para buffer binário\n");
+            exit(EXIT_FAILURE);
+        }
+        b->cap = cap;
+    }
+}
+
+void anexarBin(BufferBin *b, const void *p, size_t n) {
+    if (n == 0) return;
+    reservarBin(b, n);
+    memcpy(b->dados + b->tam, p, n);
+    b->tam += n;
+}
+
+void anexarU32Bin(BufferBin *b, uint32_t v) { anexarBin(b, &v, sizeof(v)); }
+void anexarU64Bin(BufferBin *b, uint64_t v) { anexarBin(b, &v, sizeof(v)); }
+
+void anexarStrBin(BufferBin *b, const char *s) {
+    uint32_t n = (uint32_t) strlen(s);
+    anexarU32Bin(b, n);
+    anexarBin(b, s, n);
+}
+
+/* cursor de leitura com verificação de limites */
+typedef struct CursorBin {
+    const unsigned char *p, *fim;
+    int erro;
+} CursorBin;
+
+static const void *lerBin(CursorBin *c, size_t n) {
+    if (c->erro || (size_t) (c->fim - c->p) < n) {
+        c->erro = 1;
+        return NULL;
+    }
+    const void *r = c->p;
+    c->p += n;
+    return r;
+}
+
+uint32_t lerU32Bin(CursorBin *c) {
+    uint32_t v = 0;
+    const void *p = lerBin(c, sizeof(v));
+    if (p) memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint64_t lerU64Bin(CursorBin *c) {
+    uint64_t v = 0;
+    const void *p = lerBin(c, sizeof(v));
+    if (p) memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* lê string para um buffer recém-alocado (NULL em erro) */
+char *lerStrBin(CursorBin *c) {
+    uint32_t n = lerU32Bin(c);
+    const char *p = (const char *) lerBin(c, n);
+    if (!p) return NULL;
+    char *r = (char *) malloc((size_t) n + 1);
+    if (!r) {
+        fprintf(stderr, "Erro de memória\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(r, p, n);
+    r[n] = '\0';
+    return r;
+}
+
+/* --- CRC32C (Castagnoli): SSE4.2 quando disponível, tabela em software caso contrário --- */
+static uint32_t tabelaCrc32c[256];
+
+static void iniciarTabelaCrc32c(void) {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1)));
+        tabelaCrc32c[i] = c;
+    }
+}
+
+static uint32_t crc32cSoftware(uint32_t crc, const unsigned char *p, size_t n) {
+    while (n--) crc = tabelaCrc32c[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+__attribute__((target("sse4.2")))
+static uint32_t crc32cSse42(uint32_t crc, const unsigned char *p, size_t n) {
+    uint64_t c = crc;
+    for (; n >= 8; n -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = (uint32_t) c;
+    for (; n; --n) crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+#endif
+
+static uint32_t (*implCrc32c)(uint32_t, const unsigned char *, size_t);
+
+uint32_t crc32c(const void *dados, size_t n) {
+    if (!implCrc32c) {
+        iniciarTabelaCrc32c();
+        implCrc32c = crc32cSoftware;
+#if defined(__x86_64__)
+        if (__builtin_cpu_supports("sse4.2")) implCrc32c = crc32cSse42;
+#endif
+    }
+    return ~implCrc32c(~0u, (const unsigned char *) dados, n);
+}
+
+/* --- serialização --- */
+static void serializarSalas(BufferBin *b, Sala *raiz) {
+    Sala **pilha = NULL;
+    size_t topo = 0, cap = 0;
+    if (raiz) {
+        pilha = (Sala **) malloc(64 * sizeof(Sala *));
+        cap = 64;
+        if (!pilha) {
+            fprintf(stderr, "Erro de memória\n");
+            exit(EXIT_FAILURE);
+        }
+        pilha[topo++] = raiz;
+    }
+    while (topo) {
+        Sala *s = pilha[--topo];
+        unsigned char flags = (unsigned char) ((s->pista ? 1 : 0) | (s->esq ? 2 : 0) | (s->dir ? 4 : 0));
+        anexarBin(b, &flags, 1);
+        anexarStrBin(b, s->nome);
+        if (s->pista) anexarStrBin(b, s->pista);
+        if (topo + 2 > cap) {
+            cap *= 2;
+            pilha = (Sala **) realloc(pilha, cap * sizeof(Sala *));
+            if (!pilha) {
+                fprintf(stderr, "Erro de memória\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (s->dir) pilha[topo++] = s->dir;     // esq sai primeiro (pré-ordem)
+        if (s->esq) pilha[topo++] = s->esq;
+    }
+    free(pilha);
+}
+
+static void serializarAssociacoes(BufferBin *b) {
+    uint64_t total = 0;
+    size_t maior = 0;
+    for (int i = 0; i < HASH_SIZE; ++i) {
+        size_t n = 0;
+        for (HashEntry *e = tabelaHash[i]; e; e = e->prox) n++;
+        total += n;
+        if (n > maior) maior = n;
+    }
+    anexarU64Bin(b, total);
+    HashEntry **lista = (HashEntry **) malloc((maior ? maior : 1) * sizeof(HashEntry *));
+    if (!lista) {
+        fprintf(stderr, "Erro de memória\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < HASH_SIZE; ++i) {
+        /* grava cada balde do fim para o início: a recarga (que insere na cabeça) recria a mesma ordem */
+        size_t n = 0;
+        for (HashEntry *e = tabelaHash[i]; e; e = e->prox) lista[n++] = e;
+        while (n--) {
+            anexarStrBin(b, lista[n]->pista);
+            anexarStrBin(b, nomeSuspeito(lista[n]->idSuspeito));
+        }
+    }
+    free(lista);
+}
+
+static void anexarSecoes(BufferBin *tabela, BufferBin *corpo, uint32_t tipo, const BufferBin *fluxo, uint32_t *numSecoes) {
+    size_t pos = 0;
+    do {
+        size_t n = fluxo->tam - pos < BIN_TAM_SECAO ? fluxo->tam - pos : BIN_TAM_SECAO;
+        anexarU32Bin(tabela, tipo);
+        anexarU32Bin(tabela, crc32c(fluxo->dados + pos, n));
+        anexarU64Bin(tabela, corpo->tam);        // relativo ao início das seções; ajustado na gravação
+        anexarU64Bin(tabela, n);
+        anexarBin(corpo, fluxo->dados + pos, n);
+        pos += n;
+        (*numSecoes)++;
+    } while (pos < fluxo->tam);
+}
+
+/* salvarCenarioBinario: grava a mansão e a tabela hash atual; retorna 0 em sucesso */
+int salvarCenarioBinario(const char *caminho, Sala *raiz) {
+    BufferBin salas = { NULL, 0, 0 }, assocs = { NULL, 0, 0 };
+    BufferBin tabela = { NULL, 0, 0 }, corpo = { NULL, 0, 0 };
+    uint32_t numSecoes = 0;
+
+    serializarSalas(&salas, raiz);
+    serializarAssociacoes(&assocs);
+    anexarSecoes(&tabela, &corpo, BIN_SECAO_SALAS, &salas, &numSecoes);
+    anexarSecoes(&tabela, &corpo, BIN_SECAO_ASSOCS, &assocs, &numSecoes);
+
+    /* converte deslocamentos relativos em absolutos */
+    uint64_t inicio = 16 + (uint64_t) tabela.tam;
+    for (uint32_t i = 0; i < numSecoes; ++i) {
+        uint64_t desl;
+        memcpy(&desl, tabela.dados + i * 24 + 8, 8);
+        desl += inicio;
+        memcpy(tabela.dados + i * 24 + 8, &desl, 8);
+    }
+
+    BufferBin cab = { NULL, 0, 0 };
+    anexarBin(&cab, BIN_MAGICO, 4);
+    anexarU32Bin(&cab, BIN_VERSAO);
+    anexarU32Bin(&cab, numSecoes);
+    anexarU32Bin(&cab, crc32c(tabela.dados, tabela.tam));
+
+    int ret = -1;
+    FILE *out = fopen(caminho, "wb");
+    if (out) {
+        ret = fwrite(cab.dados, 1, cab.tam, out) == cab.tam &&
+              fwrite(tabela.dados, 1, tabela.tam, out) == tabela.tam &&
+              fwrite(corpo.dados, 1, corpo.tam, out) == corpo.tam ? 0 : -1;
+        if (fclose(out) != 0) ret = -1;
+    }
+    if (ret != 0) fprintf(stderr, "Falha ao gravar %s\n", caminho);
+    free(salas.dados);
+    free(assocs.dados);
+    free(tabela.dados);
+    free(corpo.dados);
+    free(cab.dados);
+    return ret;
+}
+
+/* --- verificação paralela --- */
+typedef struct SecaoBin {
+    uint32_t tipo, crc;
+    uint64_t deslocamento, tamanho;
+} SecaoBin;
+
+typedef struct VerificacaoBin {
+    const unsigned char *arquivo;
+    const SecaoBin *secoes;
+    uint32_t numSecoes;
+    _Atomic uint32_t proxima;       // próxima seção a verificar
+    _Atomic int falhas;
+} VerificacaoBin;
+
+static void *trabalhadorVerificacao(void *arg) {
+    VerificacaoBin *v = (VerificacaoBin *) arg;
+    uint32_t i;
+    while ((i = atomic_fetch_add(&v->proxima, 1)) < v->numSecoes) {
+        const SecaoBin *s = &v->secoes[i];
+        if (crc32c(v->arquivo + s->deslocamento, s->tamanho) != s->crc) {
+            fprintf(stderr, "Seção %u corrompida (CRC32C divergente)\n", i);
+            atomic_fetch_add(&v->falhas, 1);
+        }
+    }
+    return NULL;
+}
+
+/* verifica todas as seções usando até um thread por núcleo; retorna o número de falhas */
+static int verificarSecoes(const unsigned char *arquivo, const SecaoBin *secoes, uint32_t numSecoes) {
+    crc32c(NULL, 0);        // inicializa a implementação antes de disparar os threads
+    VerificacaoBin v;
+    v.arquivo = arquivo;
+    v.secoes = secoes;
+    v.numSecoes = numSecoes;
+    atomic_init(&v.proxima, 0);
+    atomic_init(&v.falhas, 0);
+
+    long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t numThreads = nucleos > 1 ? (uint32_t) nucleos : 1;
+    if (numThreads > numSecoes) numThreads = numSecoes ? numSecoes : 1;
+    pthread_t threads[64];
+    if (numThreads > 64) numThreads = 64;
+    uint32_t criados = 0;
+    for (uint32_t t = 1; t < numThreads; ++t) {
+        if (pthread_create(&threads[criados], NULL, trabalhadorVerificacao, &v) == 0) criados++;
+    }
+    trabalhadorVerificacao(&v);     // o thread chamador também trabalha
+    for (uint32_t t = 0; t < criados; ++t) pthread_join(threads[t], NULL);
+    return atomic_load(&v.falhas);
+}
+
+/* --- desserialização --- */
+typedef struct QuadroBin {
+    Sala *sala;
+    unsigned char flags;        // filhos ainda pendentes (2 = esq, 4 = dir)
+} QuadroBin;
+
+static Sala *lerSalaBin(CursorBin *c, unsigned char *flags) {
+    const unsigned char *f = (const unsigned char *) lerBin(c, 1);
+    if (!f) return NULL;
+    *flags = *f;
+    Sala *s = criarSala(NULL, NULL);
+    s->nome = lerStrBin(c);
+    if (*flags & 1) s->pista = lerStrBin(c);
+    if (!s->nome || ((*flags & 1) && !s->pista)) {
+        liberarSalas(s);
+        c->erro = 1;
+        return NULL;
+    }
+    return s;
+}
+
+static Sala *desserializarSalas(CursorBin *c) {
+    unsigned char flags;
+    Sala *raiz = lerSalaBin(c, &flags);
+    if (!raiz) return NULL;
+    size_t topo = 0, cap = 64;
+    QuadroBin *pilha = (QuadroBin *) malloc(cap * sizeof(QuadroBin));
+    if (!pilha) {
+        fprintf(stderr, "Erro de memória\n");
+        exit(EXIT_FAILURE);
+    }
+    pilha[topo].sala = raiz;
+    pilha[topo++].flags = flags & 6;
+    while (topo && !c->erro) {
+        QuadroBin *q = &pilha[topo - 1];
+        if (!q->flags) {
+            topo--;
+            continue;
+        }
+        Sala *filho = lerSalaBin(c, &flags);
+        if (!filho) break;
+        if (q->flags & 2) {
+            q->sala->esq = filho;
+            q->flags &= (unsigned char) ~2;
+        } else {
+            q->sala->dir = filho;
+            q->flags = 0;
+        }
+        if (topo == cap) {
+            cap *= 2;
+            pilha = (QuadroBin *) realloc(pilha, cap * sizeof(QuadroBin));
+            if (!pilha) {
+                fprintf(stderr, "Erro de memória\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        pilha[topo].sala = filho;
+        pilha[topo++].flags = flags & 6;
+    }
+    free(pilha);
+    if (c->erro) {
+        liberarSalas(raiz);
+        return NULL;
+    }
+    return raiz;
+}
+
+/* une seções consecutivas do mesmo tipo em um único fluxo contíguo do arquivo */
+static int intervaloFluxo(const unsigned char *dados, size_t tamArquivo, const SecaoBin *secoes,
+                          uint32_t numSecoes, uint32_t tipo, CursorBin *c) {
+    c->p = c->fim = NULL;
+    c->erro = 0;
+    for (uint32_t i = 0; i < numSecoes; ++i) {
+        const SecaoBin *s = &secoes[i];
+        if (s->deslocamento > tamArquivo || s->tamanho > tamArquivo - s->deslocamento) return -1;
+        if (s->tipo != tipo) continue;
+        if (c->p && dados + s->deslocamento != c->fim) return -1;
+        if (!c->p) c->p = dados + s->deslocamento;
+        c->fim = dados + s->deslocamento + s->tamanho;
+    }
+    return c->p ? 0 : -1;
+}
+
+/*
+ carregarCenarioBinario: lê o arquivo inteiro, opcionalmente verifica o CRC32C de
+ cada seção em paralelo e reconstrói a mansão e a tabela hash. Retorna NULL em erro.
+*/
+Sala *carregarCenarioBinario(const char *caminho, int verificar) {
+    FILE *arq = fopen(caminho, "rb");
+    if (!arq) {
+        fprintf(stderr, "Não foi possível abrir o cenário %s\n", caminho);
+        return NULL;
+    }
+    fseek(arq, 0, SEEK_END);
+    long tam = ftell(arq);
+    fseek(arq, 0, SEEK_SET);
+    unsigned char *dados = (unsigned char *) malloc(tam > 0 ? (size_t) tam : 1);
+    if (!dados) {
+        fprintf(stderr, "Falha ao alocar memória para cenário binário\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t lidos = tam > 0 ? fread(dados, 1, (size_t) tam, arq) : 0;
+    fclose(arq);
+
+    Sala *raiz = NULL;
+    SecaoBin *secoes = NULL;
+    CursorBin c = { dados, dados + lidos, 0 };
+    const char *magico = (const char *) lerBin(&c, 4);
+    uint32_t versao = lerU32Bin(&c);
+    uint32_t numSecoes = lerU32Bin(&c);
+    uint32_t crcTabela = lerU32Bin(&c);
+    const unsigned char *tabela = (const unsigned char *) lerBin(&c, (size_t) numSecoes * 24);
+    if (!magico || memcmp(magico, BIN_MAGICO, 4) != 0 || versao != BIN_VERSAO || !tabela) {
+        fprintf(stderr, "%s não é um cenário binário válido\n", caminho);
+        goto fim;
+    }
+    if (crc32c(tabela, (size_t) numSecoes * 24) != crcTabela) {
+        fprintf(stderr, "Tabela de seções corrompida em %s\n", caminho);
+        goto fim;
+    }
+    secoes = (SecaoBin *) malloc((numSecoes ? numSecoes : 1) * sizeof(SecaoBin));
+    if (!secoes) {
+        fprintf(stderr, "Erro de memória\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < numSecoes; ++i) {
+        memcpy(&secoes[i].tipo, tabela + i * 24, 4);
+        memcpy(&secoes[i].crc, tabela + i * 24 + 4, 4);
+        memcpy(&secoes[i].deslocamento, tabela + i * 24 + 8, 8);
+        memcpy(&secoes[i].tamanho, tabela + i * 24 + 16, 8);
+    }
+
+    CursorBin cs, ca;
+    if (intervaloFluxo(dados, lidos, secoes, numSecoes, BIN_SECAO_SALAS, &cs) != 0 ||
+        intervaloFluxo(dados, lidos, secoes, numSecoes, BIN_SECAO_ASSOCS, &ca) != 0) {
+        fprintf(stderr, "Seções inválidas em %s\n", caminho);
+        goto fim;
+    }
+    if (verificar && verificarSecoes(dados, secoes, numSecoes) != 0) goto fim;
+
+    raiz = desserializarSalas(&cs);
+    if (!raiz) {
+        fprintf(stderr, "Fluxo de salas inválido em %s\n", caminho);
+        goto fim;
+    }
+    uint64_t total = lerU64Bin(&ca);
+    for (uint64_t i = 0; i < total && !ca.erro; ++i) {
+        char *pista = lerStrBin(&ca);
+        char *suspeito = lerStrBin(&ca);
+        if (pista && suspeito) inserirNaHash(pista, suspeito);
+        free(pista);
+        free(suspeito);
+    }
+    if (ca.erro) {
+        fprintf(stderr, "Fluxo de associações inválido em %s\n", caminho);
+        liberarSalas(raiz);
+        liberarHash();
+        raiz = NULL;
+    }
+fim:
+    free(secoes);
+    free(dados);
+    return raiz;
+}
+
+/* =========================
+   Registro de diagnóstico assíncrono (anéis SPSC por thread)
+   ========================= */
+/*
+ Cada thread que registra ganha seu próprio anel (um produtor, um consumidor), criado
+ no primeiro uso e encadeado numa lista global por CAS. registrarLog só grava um
+ registro binário (instante, formato estático e até 4 argumentos inteiros) e publica
+ a cauda com release. Não formata, não trava e não faz E/S. Com o anel cheio, o registro
+ é descartado e contado. Um thread formatador drena os anéis e escreve no destino.
+ Enquanto iniciarLog não foi chamado, registrarLog custa uma leitura atômica.
+ O formato é um literal com até quatro %llu (argumentos excedentes são ignorados).
+*/
+#define LOG_CAPACIDADE 4096     // registros por anel (potência de 2)
+
+typedef struct RegistroLog {
+    uint64_t instanteNs;
+    const char *formato;
+    uint64_t args[4];
+} RegistroLog;
+
+typedef struct CanalLog {
+    _Alignas(64) _Atomic size_t cauda;      // escrita pelo produtor
+    size_t cabecaVista;                     // cópia local do produtor (evita ler a linha do consumidor)
+    uint64_t descartados;
+    _Alignas(64) _Atomic size_t cabeca;     // escrita pelo formatador
+    uint32_t numero;
+    struct CanalLog *prox;
+    RegistroLog registros[LOG_CAPACIDADE];
+} CanalLog;
+
+static _Atomic int logAtivo;
+static _Atomic int logParar;
+static _Atomic uint32_t logGeracao;                 // invalida canais de sessões de log anteriores
+static _Atomic(CanalLog *) logCanais;
+static _Atomic uint32_t logNumCanais;
+static FILE *logDestino;
+static pthread_t logFormatador;
+static uint64_t logEscritos, logDescartados;
+static _Thread_local CanalLog *logCanalLocal;
+static _Thread_local uint32_t logGeracaoLocal;
+
+static uint64_t instanteLogNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/* registrarCanalLog: cria o anel da thread atual e o publica na lista global */
+static CanalLog *registrarCanalLog(void) {
+    CanalLog *c = (CanalLog *) aligned_alloc(64, sizeof(CanalLog));
+    if (!c) {
+        fprintf(stderr, "Falha ao alocar memória para canal de log\n");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&c->cauda, 0);
+    atomic_init(&c->cabeca, 0);
+    c->cabecaVista = 0;
+    c->descartados = 0;
+    c->numero = atomic_fetch_add(&logNumCanais, 1);
+    CanalLog *topo = atomic_load(&logCanais);
+    do {
+        c->prox = topo;
+    } while (!atomic_compare_exchange_weak(&logCanais, &topo, c));
+    logCanalLocal = c;
+    logGeracaoLocal = atomic_load(&logGeracao);
+    return c;
+}
+
+/* registrarLog: enfileira um registro no anel da thread; nunca bloqueia */
+void registrarLog(const char *formato, uint64_t a, uint64_t b, uint64_t c, uint64_t d) {
+    if (!atomic_load_explicit(&logAtivo, memory_order_relaxed)) return;
+    CanalLog *canal = logCanalLocal;
+    if (!canal || logGeracaoLocal != atomic_load_explicit(&logGeracao, memory_order_relaxed)) {
+        canal = registrarCanalLog();
+    }
+    size_t cauda = atomic_load_explicit(&canal->cauda, memory_order_relaxed);
+    if (cauda - canal->cabecaVista == LOG_CAPACIDADE) {
+        canal->cabecaVista = atomic_load_explicit(&canal->cabeca, memory_order_acquire);
+        if (cauda - canal->cabecaVista == LOG_CAPACIDADE) {
+            canal->descartados++;
+            return;
+        }
+    }
+    RegistroLog *r = &canal->registros[cauda & (LOG_CAPACIDADE - 1)];
+    r->instanteNs = instanteLogNs();
+    r->formato = formato;
+    r->args[0] = a;
+    r->args[1] = b;
+    r->args[2] = c;
+    r->args[3] = d;
+    atomic_store_explicit(&canal->cauda, cauda + 1, memory_order_release);
+}
+
+/* drenarCanaisLog: formata tudo o que estiver publicado; retorna quantos registros */
+static size_t drenarCanaisLog(void) {
+    size_t total = 0;
+    for (CanalLog *c = atomic_load_explicit(&logCanais, memory_order_acquire); c; c = c->prox) {
+        size_t cabeca = atomic_load_explicit(&c->cabeca, memory_order_relaxed);
+        size_t cauda = atomic_load_explicit(&c->cauda, memory_order_acquire);
+        for (; cabeca != cauda; ++cabeca) {
+            const RegistroLog *r = &c->registros[cabeca & (LOG_CAPACIDADE - 1)];
+            fprintf(logDestino, "[%llu.%09llu t%u] ", (unsigned long long) (r->instanteNs / 1000000000ull),
+                    (unsigned long long) (r->instanteNs % 1000000000ull), c->numero);
+            fprintf(logDestino, r->formato, (unsigned long long) r->args[0], (unsigned long long) r->args[1],
+                    (unsigned long long) r->args[2], (unsigned long long) r->args[3]);
+            fputc('\n', logDestino);
+            total++;
+        }
+        atomic_store_explicit(&c->cabeca, cabeca, memory_order_release);
+    }
+    return total;
+}
+
+static void *executarFormatadorLog(void *arg) {
+    (void) arg;
+    struct timespec pausa = { 0, 200000 };
+    for (;;) {
+        int parar = atomic_load(&logParar);
+        size_t n = drenarCanaisLog();
+        logEscritos += n;
+        if (n == 0) {
+            if (parar) break;
+            fflush(logDestino);
+            nanosleep(&pausa, NULL);
+        }
+    }
+    return NULL;
+}
+
+/* iniciarLog: liga o registro e o thread formatador (destino continua do chamador) */
+int iniciarLog(FILE *destino) {
+    if (atomic_load(&logAtivo)) return -1;
+    logDestino = destino;
+    logEscritos = logDescartados = 0;
+    atomic_store(&logParar, 0);
+    if (pthread_create(&logFormatador, NULL, executarFormatadorLog, NULL) != 0) {
+        fprintf(stderr, "Falha ao criar thread de log\n");
+        return -1;
+    }
+    atomic_store(&logAtivo, 1);
+    return 0;
+}
+
+/*
+ encerrarLog: desliga o registro, drena o que falta e libera os anéis. Deve ser
+ chamado quando nenhuma outra thread estiver dentro de registrarLog.
+*/
+void encerrarLog(void) {
+    if (!atomic_load(&logAtivo)) return;
+    atomic_store(&logAtivo, 0);
+    atomic_store(&logParar, 1);
+    pthread_join(logFormatador, NULL);
+    CanalLog *c = atomic_exchange(&logCanais, NULL);
+    while (c) {
+        CanalLog *prox = c->prox;
+        logDescartados += c->descartados;
+        free(c);
+        c = prox;
+    }
+    atomic_store(&logNumCanais, 0);
+    atomic_fetch_add(&logGeracao, 1);
+    if (logDescartados) {
+        fprintf(logDestino, "[log] %llu registros descartados (anel cheio)\n", (unsigned long long) logDescartados);
+    }
+    fflush(logDestino);
+}
+
+typedef struct TarefaBenchLog {
+    size_t registros;
+    double segundos;
+} TarefaBenchLog;
+
+/*
+ rajadas de LOG_RAJADA registros; entre elas o produtor espera (fora da medição) até o
+ anel ter espaço para a rajada seguinte, como um hospedeiro que não gera mais log do
+ que o formatador escoa. Assim a medição só contém registros aceitos.
+*/
+#define LOG_RAJADA 1024
+
+static void *produzirBenchLog(void *arg) {
+    TarefaBenchLog *t = (TarefaBenchLog *) arg;
+    struct timespec pausa = { 0, 100000 };
+    double t0 = agoraSegundos(), parado = 0;
+    for (size_t i = 0; i < t->registros; ++i) {
+        registrarLog("sessao %llu passo %llu sala %llu", i >> 6, i, i * 7 % 1023, 0);
+        if ((i & (LOG_RAJADA - 1)) == LOG_RAJADA - 1) {
+            double p0 = agoraSegundos();
+            CanalLog *c = logCanalLocal;
+            while (atomic_load_explicit(&c->cauda, memory_order_relaxed) -
+                       atomic_load_explicit(&c->cabeca, memory_order_acquire) > LOG_CAPACIDADE - LOG_RAJADA) {
+                nanosleep(&pausa, NULL);
+            }
+            parado += agoraSegundos() - p0;
+        }
+    }
+    t->segundos = agoraSegundos() - t0 - parado;
+    return NULL;
+}
+
+int benchLog(int numThreads, size_t registros, const char *caminho) {
+    FILE *destino = fopen(caminho, "w");
+    if (!destino) {
+        fprintf(stderr, "Erro ao abrir %s\n", caminho);
+        return -1;
+    }
+    static char bufferDestino[1 << 20];
+    setvbuf(destino, bufferDestino, _IOFBF, sizeof(bufferDestino));
+
+    /* referência: fprintf direto, na mesma thread */
+    double t0 = agoraSegundos();
+    for (size_t i = 0; i < registros; ++i) {
+        fprintf(destino, "sessao %llu passo %llu sala %llu\n", (unsigned long long) (i >> 6),
+                (unsigned long long) i, (unsigned long long) (i * 7 % 1023));
+    }
+    fflush(destino);
+    double tDireto = agoraSegundos() - t0;
+
+    if (iniciarLog(destino) != 0) {
+        fclose(destino);
+        return -1;
+    }
+    pthread_t *threads = (pthread_t *) malloc((size_t) numThreads * sizeof(pthread_t));
+    TarefaBenchLog *tarefas = (TarefaBenchLog *) calloc((size_t) numThreads, sizeof(TarefaBenchLog));
+    if (!threads || !tarefas) {
+        fprintf(stderr, "Falha ao alocar memória para benchmark de log\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < numThreads; ++i) {
+        tarefas[i].registros = registros;
+        pthread_create(&threads[i], NULL, produzirBenchLog, &tarefas[i]);
+    }
+    double soma = 0;
+    for (int i = 0; i < numThreads; ++i) {
+        pthread_join(threads[i], NULL);
+        soma += tarefas[i].segundos;
+    }
+    encerrarLog();
+    fclose(destino);
+    printf("fprintf direto: %.1f ns por chamada\n", tDireto * 1e9 / (double) (registros ? registros : 1));
+    double chamadas = (double) registros * numThreads;
+    printf("%d threads x %zu registros: %.1f ns por chamada; %llu escritos, %llu descartados\n", numThreads,
+           registros, soma * 1e9 / (chamadas > 0 ? chamadas : 1),
+           (unsigned long long) logEscritos, (unsigned long long) logDescartados);
+    int completo = logDescartados == 0 && (double) logEscritos == chamadas;
+    printf("Conferência (todos os registros escritos): %s\n", completo ? "ok" : "DIVERGENTE");
+    free(threads);
+    free(tarefas);
+    return completo ? 0 : -1;
+}
+
+/* =========================
+   Perfilador por amostragem (SIGPROF)
+   ========================= */
+/*
+ Nem sempre dá para anexar o perf em produção. Com DQ_PERFIL=<arquivo> no ambiente, o
+ processo (jogo ou qualquer modo de linha de comando) amostra a si mesmo:
+  - ITIMER_PROF dispara SIGPROF a cada 1/DQ_PERFIL_HZ segundo de CPU (padrão 999 Hz);
+  - o tratador lê pc e ponteiro de quadro do contexto interrompido e sobe a cadeia de
+    ponteiros de quadro (compile com -fno-omit-frame-pointer), limitada à pilha da
+    thread; threads não registradas (registrarThreadPerfilador) dão só o pc;
+  - cada amostra ocupa uma vaga de um vetor pré-alocado reservada por fetch_add: nada
+    de travas, malloc ou E/S dentro do sinal; vetor cheio conta descartes;
+  - a fase do motor (faseMotor, por thread) vai junto com a amostra, atribuindo tempo a
+    carga, comandos, coleta de pistas, acusação etc.
+ Ao final, os endereços são resolvidos pela tabela de símbolos do próprio executável
+ (/proc/self/exe; funções static incluídas) e as pilhas são gravadas no formato
+ "dobrado" (fase;main;...;função contagem), entrada direta do flamegraph.pl.
+*/
+typedef enum {
+    FASE_OUTRA = 0,
+    FASE_CARGA,         // montagem/importação da mansão e das associações
+    FASE_EXPLORACAO,    // laço interativo (E/S e interpretação da linha)
+    FASE_COMANDO,       // passoSessao: aplicação do comando
+    FASE_PISTAS,        // coleta: inserção na BST da sessão
+    FASE_ACUSACAO,      // contagem de pistas do acusado
+    FASE_LIMPEZA,
+    NUM_FASES
+} FaseMotor;
+
+static const char *nomesFases[NUM_FASES] = { "outra", "carga", "exploracao", "comando", "pistas", "acusacao",
+                                              "limpeza" };
+
+static _Thread_local volatile int faseMotor = FASE_OUTRA;
+
+/* entrarFase: marca a fase da thread; retorna a anterior (para restaurar) */
+static inline int entrarFase(int fase) {
+    int anterior = faseMotor;
+    faseMotor = fase;
+    return anterior;
+}
+
+#define PERFIL_PROF_MAX 48
+#define PERFIL_CAPACIDADE (1u << 17)
+
+typedef struct AmostraPerfil {
+    uintptr_t pcs[PERFIL_PROF_MAX];     // pcs[0] = ponto interrompido; depois endereços de retorno
+    uint8_t profundidade;
+    uint8_t fase;
+    _Atomic uint8_t pronta;
+} AmostraPerfil;
+
+typedef struct Perfilador {
+    AmostraPerfil *amostras;
+    _Atomic size_t proxima;
+    _Atomic size_t descartadas;
+    int ativo;
+    unsigned hz;
+} Perfilador;
+
+static Perfilador perfil;
+static _Thread_local uintptr_t topoPilhaPerfil = 0;   // 0: thread não registrada
+
+/* registrarThreadPerfilador: habilita o desempilhamento completo nas amostras desta thread */
+void registrarThreadPerfilador(void) {
+#ifdef TEM_PERFILADOR
+    pthread_attr_t attr;
+    void *base;
+    size_t tam;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0) return;
+    if (pthread_attr_getstack(&attr, &base, &tam) == 0) topoPilhaPerfil = (uintptr_t) base + tam;
+    pthread_attr_destroy(&attr);
+#endif
+}
+
+#ifdef TEM_PERFILADOR
+static struct sigaction tratadorAnteriorPerfil;
+
+static void tratarSigprof(int sinal, siginfo_t *info, void *contexto) {
+    (void) sinal;
+    (void) info;
+    size_t i = atomic_fetch_add_explicit(&perfil.proxima, 1, memory_order_relaxed);
+    if (i >= PERFIL_CAPACIDADE) {
+        atomic_fetch_add_explicit(&perfil.descartadas, 1, memory_order_relaxed);
+        return;
+    }
+    const ucontext_t *uc = (const ucontext_t *) contexto;
+    uintptr_t pc, quadro, sp;
+#if defined(__x86_64__)
+    pc = (uintptr_t) uc->uc_mcontext.gregs[REG_RIP];
+    quadro = (uintptr_t) uc->uc_mcontext.gregs[REG_RBP];
+    sp = (uintptr_t) uc->uc_mcontext.gregs[REG_RSP];
+#else
+    pc = (uintptr_t) uc->uc_mcontext.pc;
+    quadro = (uintptr_t) uc->uc_mcontext.regs[29];
+    sp = (uintptr_t) uc->uc_mcontext.sp;
+#endif
+    AmostraPerfil *a = &perfil.amostras[i];
+    unsigned n = 0;
+    a->pcs[n++] = pc;
+    /* cada quadro: [0] = quadro do chamador, [1] = endereço de retorno */
+    uintptr_t topo = topoPilhaPerfil;
+    while (n < PERFIL_PROF_MAX && quadro >= sp && quadro + 2 * sizeof(uintptr_t) <= topo &&
+           (quadro & (sizeof(uintptr_t) - 1)) == 0) {
+        const uintptr_t *q = (const uintptr_t *) quadro;
+        if (q[1] == 0) break;
+        a->pcs[n++] = q[1];
+        if (q[0] <= quadro) break;       // a pilha cresce para baixo: o chamador está acima
+        quadro = q[0];
+    }
+    a->profundidade = (uint8_t) n;
+    a->fase = (uint8_t) faseMotor;
+    atomic_store_explicit(&a->pronta, 1, memory_order_release);
+}
+#endif
+
+/* iniciarPerfilador: começa a amostrar a hz amostras por segundo de CPU; -1 se indisponível */
+int iniciarPerfilador(unsigned hz) {
+#ifdef TEM_PERFILADOR
+    if (perfil.ativo) return 0;
+    perfil.amostras = (AmostraPerfil *) calloc(PERFIL_CAPACIDADE, sizeof(AmostraPerfil));
+    if (!perfil.amostras) {
+        fprintf(stderr, "Falha ao alocar memória para o perfilador\n");
+        exit(EXIT_FAILURE);
+    }
+    atomic_store(&perfil.proxima, 0);
+    atomic_store(&perfil.descartadas, 0);
+    perfil.hz = hz ? hz : 999;
+    registrarThreadPerfilador();
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = tratarSigprof;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, &tratadorAnteriorPerfil) != 0) {
+        fprintf(stderr, "Perfilador: sigaction falhou (%s)\n", strerror(errno));
+        free(perfil.amostras);
+        perfil.amostras = NULL;
+        return -1;
+    }
+    long us = 1000000L / (long) perfil.hz;
+    struct itimerval intervalo;
+    intervalo.it_interval.tv_sec = 0;
+    intervalo.it_interval.tv_usec = (suseconds_t) (us > 0 ? us : 1);
+    intervalo.it_value = intervalo.it_interval;
+    setitimer(ITIMER_PROF, &intervalo, NULL);
+    perfil.ativo = 1;
+    return 0;
+#else
+    (void) hz;
+    fprintf(stderr, "Perfilador indisponível nesta plataforma\n");
+    return -1;
+#endif
+}
+
+#ifdef TEM_PERFILADOR
+/* --- resolução de símbolos a partir do próprio executável --- */
+typedef struct SimboloPerfil {
+    uintptr_t inicio, fim;
+    const char *nome;
+} SimboloPerfil;
+
+typedef struct TabelaSimbolos {
+    SimboloPerfil *simbolos;
+    size_t num;
+    unsigned char *imagem;      // conteúdo de /proc/self/exe (os nomes apontam para cá)
+    uintptr_t base;             // deslocamento de carga (PIE)
+} TabelaSimbolos;
+
+static int baseDoExecutavel(struct dl_phdr_info *info, size_t tam, void *dados) {
+    (void) tam;
+    *(uintptr_t *) dados = (uintptr_t) info->dlpi_addr;
+    return 1;   // o primeiro objeto é o próprio programa
+}
+
+static int compararSimbolos(const void *a, const void *b) {
+    const SimboloPerfil *x = (const SimboloPerfil *) a, *y = (const SimboloPerfil *) b;
+    return (x->inicio > y->inicio) - (x->inicio < y->inicio);
+}
+
+static void carregarSimbolos(TabelaSimbolos *t) {
+    memset(t, 0, sizeof(*t));
+    dl_iterate_phdr(baseDoExecutavel, &t->base);
+    FILE *arq = fopen("/proc/self/exe", "rb");
+    if (!arq) return;
+    fseek(arq, 0, SEEK_END);
+    long tam = ftell(arq);
+    fseek(arq, 0, SEEK_SET);
+    t->imagem = (unsigned char *) malloc(tam > 0 ? (size_t) tam : 1);
+    if (!t->imagem || tam < (long) sizeof(Elf64_Ehdr) || fread(t->imagem, 1, (size_t) tam, arq) != (size_t) tam) {
+        fclose(arq);
+        return;
+    }
+    fclose(arq);
+    const Elf64_Ehdr *eh = (const Elf64_Ehdr *) t->imagem;
+    if (memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 || eh->e_ident[EI_CLASS] != ELFCLASS64 ||
+        eh->e_shoff + (size_t) eh->e_shnum * sizeof(Elf64_Shdr) > (size_t) tam) return;
+    const Elf64_Shdr *sh = (const Elf64_Shdr *) (t->imagem + eh->e_shoff);
+    /* .symtab (inclui funções static); sem ela (binário "stripado"), .dynsym */
+    int escolhida = -1;
+    for (int i = 0; i < eh->e_shnum; ++i) {
+        if (sh[i].sh_type == SHT_SYMTAB) escolhida = i;
+        else if (sh[i].sh_type == SHT_DYNSYM && escolhida < 0) escolhida = i;
+    }
+    if (escolhida < 0 || sh[escolhida].sh_link >= eh->e_shnum) return;
+    const Elf64_Shdr *tabela = &sh[escolhida], *nomes = &sh[tabela->sh_link];
+    if (tabela->sh_offset + tabela->sh_size > (size_t) tam || nomes->sh_offset + nomes->sh_size > (size_t) tam) return;
+    const Elf64_Sym *sym = (const Elf64_Sym *) (t->imagem + tabela->sh_offset);
+    size_t total = tabela->sh_size / sizeof(Elf64_Sym);
+    t->simbolos = (SimboloPerfil *) malloc((total ? total : 1) * sizeof(SimboloPerfil));
+    if (!t->simbolos) {
+        fprintf(stderr, "Falha ao alocar memória para o perfilador\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < total; ++i) {
+        if (ELF64_ST_TYPE(sym[i].st_info) != STT_FUNC || sym[i].st_value == 0 || sym[i].st_name >= nomes->sh_size) continue;
+        SimboloPerfil *s = &t->simbolos[t->num++];
+        s->inicio = t->base + sym[i].st_value;
+        s->fim = s->inicio + (sym[i].st_size ? sym[i].st_size : 1);
+        s->nome = (const char *) t->imagem + nomes->sh_offset + sym[i].st_name;
+    }
+    qsort(t->simbolos, t->num, sizeof(SimboloPerfil), compararSimbolos);
+}
+
+static const char *resolverSimbolo(const TabelaSimbolos *t, uintptr_t pc) {
+    size_t lo = 0, hi = t->num;
+    while (lo < hi) {       // último símbolo com inicio <= pc
+        size_t meio = lo + (hi - lo) / 2;
+        if (t->simbolos[meio].inicio <= pc) lo = meio + 1;
+        else hi = meio;
+    }
+    if (lo > 0 && pc < t->simbolos[lo - 1].fim) return t->simbolos[lo - 1].nome;
+    return "[externo]";     // bibliotecas compartilhadas (libc etc.)
+}
+
+static int compararLinhasPerfil(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+#endif
+
+/*
+ encerrarPerfilador: para a amostragem e grava as pilhas dobradas em destino (NULL
+ descarta). Retorna o número de amostras gravadas.
+*/
+size_t encerrarPerfilador(FILE *destino) {
+#ifdef TEM_PERFILADOR
+    if (!perfil.ativo) return 0;
+    struct itimerval parado;
+    memset(&parado, 0, sizeof(parado));
+    setitimer(ITIMER_PROF, &parado, NULL);
+    sigaction(SIGPROF, &tratadorAnteriorPerfil, NULL);
+    perfil.ativo = 0;
+    if (!destino) {
+        free(perfil.amostras);
+        perfil.amostras = NULL;
+        return 0;
+    }
+
+    size_t n = atomic_load(&perfil.proxima);
+    if (n > PERFIL_CAPACIDADE) n = PERFIL_CAPACIDADE;
+    TabelaSimbolos t;
+    carregarSimbolos(&t);
+    char **linhas = (char **) malloc((n ? n : 1) * sizeof(char *));
+    if (!linhas) {
+        fprintf(stderr, "Falha ao alocar memória para o perfilador\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t numLinhas = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const AmostraPerfil *a = &perfil.amostras[i];
+        if (!atomic_load_explicit(&a->pronta, memory_order_acquire)) continue;
+        char buf[PERFIL_PROF_MAX * 48];
+        size_t tam = (size_t) snprintf(buf, sizeof(buf), "%s", nomesFases[a->fase < NUM_FASES ? a->fase : 0]);
+        /* da raiz para a folha; endereços de retorno apontam após a chamada (-1) */
+        for (int k = a->profundidade - 1; k >= 0 && tam < sizeof(buf); --k) {
+            const char *nome = resolverSimbolo(&t, a->pcs[k] - (k > 0));
+            tam += (size_t) snprintf(buf + tam, sizeof(buf) - tam, ";%s", nome);
+        }
+        linhas[numLinhas++] = strdup_safe(buf);
+    }
+    qsort(linhas, numLinhas, sizeof(char *), compararLinhasPerfil);
+    for (size_t i = 0; i < numLinhas;) {
+        size_t j = i + 1;
+        while (j < numLinhas && strcmp(linhas[j], linhas[i]) == 0) j++;
+        fprintf(destino, "%s %zu\n", linhas[i], j - i);
+        i = j;
+    }
+    size_t descartadas = atomic_load(&perfil.descartadas);
+    if (descartadas) fprintf(stderr, "Perfilador: %zu amostras descartadas (vetor cheio)\n", descartadas);
+    for (size_t i = 0; i < numLinhas; ++i) free(linhas[i]);
+    free(linhas);
+    free(t.simbolos);
+    free(t.imagem);
+    free(perfil.amostras);
+    perfil.amostras = NULL;
+    return numLinhas;
+#else
+    (void) destino;
+    return 0;
+#endif
+}
+
+/* gravarPerfilAmbiente: encerra o perfilador ligado por DQ_PERFIL e grava o arquivo */
+static void gravarPerfilAmbiente(const char *caminho) {
+    FILE *arq = fopen(caminho, "w");
+    if (!arq) {
+        fprintf(stderr, "Perfilador: não foi possível criar %s\n", caminho);
+        encerrarPerfilador(NULL);
+        return;
+    }
+    size_t amostras = encerrarPerfilador(arq);
+    fclose(arq);
+    fprintf(stderr, "Perfil: %zu amostras gravadas em %s\n", amostras, caminho);
+}
+
+/* =========================
+   Contadores de hardware por fase (perf_event_open)
+   ========================= */
+/*
+ Só o tempo não diz se encontrarSuspeito ou os percursos de árvore esperam pela memória.
+ Com DQ_CONTADORES=1 no ambiente, um grupo perf_event (ciclos, instruções, falhas de LLC,
+ desvios mal previstos; só espaço de usuário) é aberto para o processo:
+  - no jogo, mudarFasePrincipal credita a diferença desde a última troca à fase que
+    termina, e relatorioFasesHw imprime (em stderr) IPC e falhas por fase;
+  - nos benchmarks, iniciarMedicaoHw/encerrarMedicaoHw envolvem o laço principal e
+    reportam IPC e falhas por operação.
+ Sem suporte (kernel, contêiner, perf_event_paranoid), avisa uma vez e segue só com o
+ relógio; contadores que o processador não tem aparecem como "n/d". Leituras são
+ escaladas por tempo habilitado/em execução quando o kernel multiplexa o grupo.
+*/
+typedef enum {
+    HW_CICLOS = 0,
+    HW_INSTRUCOES,
+    HW_FALHAS_LLC,
+    HW_DESVIOS_ERRADOS,
+    NUM_CONTADORES_HW
+} ContadorHw;
+
+typedef struct LeituraHw {
+    uint64_t v[NUM_CONTADORES_HW];
+} LeituraHw;
+
+typedef struct ContadoresHw {
+    int ativo;
+    int fds[NUM_CONTADORES_HW];         // fds[HW_CICLOS] é o líder do grupo
+    int posicao[NUM_CONTADORES_HW];     // posição na leitura do grupo (-1: indisponível)
+    int numNoGrupo;
+    int faseAtual;
+    LeituraHw ultima;
+    LeituraHw porFase[NUM_FASES];
+    double tempoPorFase[NUM_FASES];
+    double instanteUltima;
+} ContadoresHw;
+
+static ContadoresHw contadoresHw;
+
+#ifdef TEM_PERF_EVENT
+static int abrirEventoHw(uint64_t config, int lider) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = lider < 0;           // o grupo é ligado de uma vez pelo líder
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, lider, 0);
+}
+#endif
+
+/* abrirContadoresHw: 0 se ao menos os ciclos puderem ser medidos; -1 caso contrário */
+int abrirContadoresHw(void) {
+    ContadoresHw *c = &contadoresHw;
+    if (c->ativo) return 0;
+    memset(c, 0, sizeof(*c));
+#ifdef TEM_PERF_EVENT
+    static const uint64_t configs[NUM_CONTADORES_HW] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                         PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+    for (int i = 0; i < NUM_CONTADORES_HW; ++i) {
+        c->fds[i] = abrirEventoHw(configs[i], i == 0 ? -1 : c->fds[0]);
+        c->posicao[i] = c->fds[i] >= 0 ? c->numNoGrupo++ : -1;
+        if (i == 0 && c->fds[0] < 0) {
+            fprintf(stderr, "Contadores de hardware indisponíveis (%s); medindo só o tempo\n", strerror(errno));
+            return -1;
+        }
+    }
+    ioctl(c->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(c->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    c->ativo = 1;
+    c->instanteUltima = agoraSegundos();
+    return 0;
+#else
+    fprintf(stderr, "Contadores de hardware indisponíveis nesta plataforma; medindo só o tempo\n");
+    return -1;
+#endif
+}
+
+/* lerContadoresHw: valores acumulados desde a abertura (escalados se multiplexados) */
+int lerContadoresHw(LeituraHw *l) {
+    memset(l, 0, sizeof(*l));
+#ifdef TEM_PERF_EVENT
+    ContadoresHw *c = &contadoresHw;
+    if (!c->ativo) return -1;
+    uint64_t buf[3 + NUM_CONTADORES_HW];     // nr, habilitado, em execução, valores
+    if (read(c->fds[0], buf, sizeof(buf)) < (ssize_t) (3 * sizeof(uint64_t))) return -1;
+    double escala = buf[2] ? (double) buf[1] / (double) buf[2] : 1.0;
+    for (int i = 0; i < NUM_CONTADORES_HW; ++i) {
+        if (c->posicao[i] >= 0 && (uint64_t) c->posicao[i] < buf[0]) {
+            l->v[i] = (uint64_t) ((double) buf[3 + c->posicao[i]] * escala);
+        }
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+void fecharContadoresHw(void) {
+    ContadoresHw *c = &contadoresHw;
+    if (!c->ativo) return;
+    for (int i = NUM_CONTADORES_HW; i-- > 0;) {
+        if (c->fds[i] >= 0) close(c->fds[i]);
+    }
+    c->ativo = 0;
+}
+
+/* credita a diferença desde a última leitura à fase que termina */
+static void creditarFaseHw(void) {
+    ContadoresHw *c = &contadoresHw;
+    LeituraHw agora;
+    if (lerContadoresHw(&agora) != 0) return;
+    double t = agoraSegundos();
+    for (int i = 0; i < NUM_CONTADORES_HW; ++i) c->porFase[c->faseAtual].v[i] += agora.v[i] - c->ultima.v[i];
+    c->tempoPorFase[c->faseAtual] += t - c->instanteUltima;
+    c->ultima = agora;
+    c->instanteUltima = t;
+}
+
+/* mudarFasePrincipal: marca a fase (perfilador) e, com contadores ativos, fecha a anterior */
+void mudarFasePrincipal(int fase) {
+    entrarFase(fase);
+    if (!contadoresHw.ativo) return;
+    creditarFaseHw();
+    contadoresHw.faseAtual = fase;
+}
+
+/* imprime "valor por unidade" (ou n/d se o processador não tem o contador) */
+static void imprimirTaxaHw(FILE *f, int largura, ContadorHw k, uint64_t valor, double divisor) {
+    if (contadoresHw.posicao[k] < 0) fprintf(f, "%*s", largura, "n/d");
+    else fprintf(f, "%*.2f", largura, divisor > 0 ? (double) valor / divisor : 0.0);
+}
+
+/* relatorioFasesHw: tabela por fase (só fases com ciclos registrados) */
+void relatorioFasesHw(FILE *f) {
+    ContadoresHw *c = &contadoresHw;
+    if (!c->ativo) return;
+    creditarFaseHw();
+    fprintf(f, "%-12s %10s %14s %14s %8s %12s %12s\n", "fase", "tempo(ms)", "ciclos", "instruções", "IPC",
+            "LLC/1k inst", "desv/1k inst");
+    for (int fase = 0; fase < NUM_FASES; ++fase) {
+        const LeituraHw *l = &c->porFase[fase];
+        if (l->v[HW_CICLOS] == 0) continue;
+        fprintf(f, "%-12s %10.2f %14llu %14llu %8.2f", nomesFases[fase], c->tempoPorFase[fase] * 1e3,
+                (unsigned long long) l->v[HW_CICLOS], (unsigned long long) l->v[HW_INSTRUCOES],
+                l->v[HW_CICLOS] ? (double) l->v[HW_INSTRUCOES] / (double) l->v[HW_CICLOS] : 0.0);
+        imprimirTaxaHw(f, 12, HW_FALHAS_LLC, l->v[HW_FALHAS_LLC] * 1000, (double) l->v[HW_INSTRUCOES]);
+        imprimirTaxaHw(f, 12, HW_DESVIOS_ERRADOS, l->v[HW_DESVIOS_ERRADOS] * 1000, (double) l->v[HW_INSTRUCOES]);
+        fprintf(f, "\n");
+    }
+}
+
+/* --- medição de laços de benchmark --- */
+typedef struct MedicaoHw {
+    LeituraHw inicio;
+    double t0;
+} MedicaoHw;
+
+void iniciarMedicaoHw(MedicaoHw *m) {
+    lerContadoresHw(&m->inicio);
+    m->t0 = agoraSegundos();
+}
+
+/* encerrarMedicaoHw: com contadores ativos, imprime IPC e eventos por operação */
+void encerrarMedicaoHw(const MedicaoHw *m, const char *rotulo, uint64_t operacoes) {
+    if (!contadoresHw.ativo) return;
+    double t = agoraSegundos() - m->t0;
+    LeituraHw fim;
+    if (lerContadoresHw(&fim) != 0) return;
+    uint64_t d[NUM_CONTADORES_HW];
+    for (int i = 0; i < NUM_CONTADORES_HW; ++i) d[i] = fim.v[i] - m->inicio.v[i];
+    double ops = operacoes ? (double) operacoes : 1.0;
+    fprintf(stderr, "[contadores] %s: %.3f s, IPC %.2f, por operação: %.1f ciclos, %.1f instruções, falhas de LLC ",
+            rotulo, t, d[HW_CICLOS] ? (double) d[HW_INSTRUCOES] / (double) d[HW_CICLOS] : 0.0,
+            (double) d[HW_CICLOS] / ops, (double) d[HW_INSTRUCOES] / ops);
+    imprimirTaxaHw(stderr, 1, HW_FALHAS_LLC, d[HW_FALHAS_LLC], ops);
+    fprintf(stderr, ", desvios errados ");
+    imprimirTaxaHw(stderr, 1, HW_DESVIOS_ERRADOS, d[HW_DESVIOS_ERRADOS], ops);
+    fprintf(stderr, "\n");
+}
+
+/* =========================
+   Sessão de investigação (API passo a passo, sem E/S)
+   ========================= */
+/*
+ Uma Sessao guarda todo o estado de um jogador: sala atual, BST de pistas e os ids das
+ salas que já tiveram a pista coletada (vetor ordenado: o custo por sessão acompanha o
+ quanto ela explorou, não o tamanho da mansão). A mansão é compartilhada e somente
+ leitura, de modo que um hospedeiro pode conduzir muitas sessões sobre o mesmo mapa,
+ chamando passoSessao a partir do seu próprio laço de eventos. Nenhuma função desta
+ seção faz E/S ou formatação; o resultado de cada passo é devolvido em ResultadoPasso.
+*/
+typedef enum {
+    PASSO_OK,               // comando aplicado (ou consulta do estado atual)
+    PASSO_SEM_CAMINHO,      // não há sala na direção pedida; a sessão continua onde estava
+    PASSO_INVALIDO,         // comando desconhecido
+    PASSO_ENCERRADA         // sessão encerrada com 's' (ou já encerrada)
+} StatusPasso;
+
+typedef struct ResultadoPasso {
+    StatusPasso status;
+    const Sala *sala;           // sala em que a sessão está após o comando
+    const char *pistaNova;      // pista coletada neste passo (NULL se nenhuma)
+} ResultadoPasso;
+
+/* conjunto ordenado de ids de sala (estado de coleta de uma sessão) */
+typedef struct ConjuntoIds {
+    uint32_t *ids;
+    uint32_t n, cap;
+} ConjuntoIds;
+
+/* posição de id no conjunto (ou onde deveria ser inserido) */
+static uint32_t posicaoConjunto(const ConjuntoIds *c, uint32_t id) {
+    uint32_t lo = 0, hi = c->n;
+    while (lo < hi) {
+        uint32_t meio = lo + (hi - lo) / 2;
+        if (c->ids[meio] < id) lo = meio + 1;
+        else hi = meio;
+    }
+    return lo;
+}
+
+int contemConjunto(const ConjuntoIds *c, uint32_t id) {
+    uint32_t i = posicaoConjunto(c, id);
+    return i < c->n && c->ids[i] == id;
+}
+
+void inserirConjunto(ConjuntoIds *c, uint32_t id) {
+    uint32_t i = posicaoConjunto(c, id);
+    if (i < c->n && c->ids[i] == id) return;
+    if (c->n == c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 8;
+        c->ids = (uint32_t *) realloc(c->ids, c->cap * sizeof(uint32_t));
+        if (!c->ids) {
+            fprintf(stderr, "Falha ao alocar memória para sessão\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memmove(c->ids + i + 1, c->ids + i, (c->n - i) * sizeof(uint32_t));
+    c->ids[i] = id;
+    c->n++;
+}
+
+void liberarConjunto(ConjuntoIds *c) {
+    free(c->ids);
+    c->ids = NULL;
+    c->n = c->cap = 0;
+}
+
+typedef struct Sessao {
+    Sala *inicio;
+    Sala *atual;
+    PistaNode *pistas;
+    ConjuntoIds coletadas;      // ids das salas cuja pista já foi coletada
+    size_t numSalas;
+    int encerrada;
+} Sessao;
+
+/* pistaColetadaNaSessao: 1 se a sessão já coletou a pista da sala */
+int pistaColetadaNaSessao(const Sessao *s, const Sala *sala) {
+    return contemConjunto(&s->coletadas, sala->id);
+}
+
+static ResultadoPasso entrarSala(Sessao *s, Sala *sala) {
+    ResultadoPasso r = { PASSO_OK, sala, NULL };
+    s->atual = sala;
+    if (sala->pista && !pistaColetadaNaSessao(s, sala)) {
+        int fase = entrarFase(FASE_PISTAS);
+        s->pistas = inserirPista(s->pistas, sala->pista);
+        inserirConjunto(&s->coletadas, sala->id);
+        r.pistaNova = sala->pista;
+        entrarFase(fase);
+    }
+    return r;
+}
+
+/*
+ iniciarSessao: posiciona a sessão na sala inicial (coletando sua pista, se houver).
+ numSalas deve ser o valor retornado por numerarSalas para a mansão.
+*/
+ResultadoPasso iniciarSessao(Sessao *s, Sala *inicio, size_t numSalas) {
+    s->inicio = inicio;
+    s->pistas = NULL;
+    s->numSalas = numSalas;
+    s->encerrada = 0;
+    s->coletadas.ids = NULL;
+    s->coletadas.n = s->coletadas.cap = 0;
+    return entrarSala(s, inicio);
+}
+
+/* consultarSessao: estado atual, sem aplicar comando */
+ResultadoPasso consultarSessao(const Sessao *s) {
+    ResultadoPasso r = { s->encerrada ? PASSO_ENCERRADA : PASSO_OK, s->atual, NULL };
+    return r;
+}
+
+static ResultadoPasso aplicarComando(Sessao *s, char comando) {
+    ResultadoPasso r = consultarSessao(s);
+    if (s->encerrada) return r;
+    switch (comando) {
+        case 's': case 'S':
+            s->encerrada = 1;
+            r.status = PASSO_ENCERRADA;
+            return r;
+        case 'e': case 'E':
+            if (s->atual->esq) return entrarSala(s, s->atual->esq);
+            r.status = PASSO_SEM_CAMINHO;
+            return r;
+        case 'd': case 'D':
+            if (s->atual->dir) return entrarSala(s, s->atual->dir);
+            r.status = PASSO_SEM_CAMINHO;
+            return r;
+        default:
+            r.status = PASSO_INVALIDO;
+            return r;
+    }
+}
+
+/* passoSessao: aplica um comando ('e', 'd' ou 's', sem distinção de maiúsculas) */
+ResultadoPasso passoSessao(Sessao *s, char comando) {
+    int fase = entrarFase(FASE_COMANDO);
+    ResultadoPasso r = aplicarComando(s, comando);
+    entrarFase(fase);
+    return r;
+}
+
+/* encerrarSessao: libera o estado do jogador (a mansão não é tocada) */
+void encerrarSessao(Sessao *s) {
+    liberarPistas(s->pistas);
+    liberarConjunto(&s->coletadas);
+    s->pistas = NULL;
+}
+
+/*
+ benchSessoes: um "hospedeiro" mantém numSessoes sessões vivas sobre a mesma mansão e as
+ avança em rodízio, um comando por vez, como faria um escalonador de eventos.
+*/
+int benchSessoes(size_t numSalas, size_t numSessoes, size_t passos) {
+    Sala *mansao = gerarMansaoSintetica(numSalas);
+    size_t n = numerarSalas(mansao);
+    Sessao *sessoes = (Sessao *) malloc(numSessoes * sizeof(Sessao));
+    if (!sessoes) {
+        fprintf(stderr, "Falha ao alocar memória para sessões\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < numSessoes; ++i) iniciarSessao(&sessoes[i], mansao, n);
+
+    static const char comandos[4] = { 'e', 'd', 'e', 'x' };
+    uint64_t semente = 3, pistas = 0, reinicios = 0;
+    MedicaoHw medicao;
+    iniciarMedicaoHw(&medicao);
+    double t0 = agoraSegundos();
+    for (size_t p = 0; p < passos; ++p) {
+        Sessao *s = &sessoes[p % numSessoes];
+        ResultadoPasso r = passoSessao(s, comandos[aleatorio(&semente) & 3]);
+        if (r.pistaNova) pistas++;
+        if (r.status == PASSO_SEM_CAMINHO) {     // chegou a uma folha: recomeça a investigação
+            encerrarSessao(s);
+            iniciarSessao(s, mansao, n);
+            reinicios++;
+        }
+    }
+    double t = agoraSegundos() - t0;
+    encerrarMedicaoHw(&medicao, "passoSessao", passos);
+    printf("%zu sessões, %zu passos em %.3f s: %.1f ns por passo (%llu pistas, %llu reinícios)\n",
+           numSessoes, passos, t, t * 1e9 / (double) passos,
+           (unsigned long long) pistas, (unsigned long long) reinicios);
+    for (size_t i = 0; i < numSessoes; ++i) encerrarSessao(&sessoes[i]);
+    free(sessoes);
+    liberarSalas(mansao);
+    liberarHash();
+    return 0;
+}
+
+/* =========================
+   Exploração das salas e coleta de pistas
+   ========================= */
+/*
+ explorarSalasComPistas:
+  - navega interativamente a partir do nó inicial, conduzindo a sessão com passoSessao
+  - comandos: e (esquerda), d (direita), s (sair)
+  - ao visitar sala com pista não coletada: exibe e adiciona à BST da sessão
+*/
+void explorarSalasComPistas(Sessao *sessao, Sala *inicio, size_t numSalas) {
+    char linha[128];
+    ResultadoPasso r = iniciarSessao(sessao, inicio, numSalas);
+
+    printf("Começando a investigação a partir do Hall de Entrada.\n");
+    while (1) {
+        printf("\nVocê está na sala: %s\n", r.sala->nome);
+        if (r.pistaNova) {
+            printf("Pista encontrada: \"%s\"\n", r.pistaNova);
+        } else if (r.sala->pista) {
+            printf("Esta sala já teve sua pista coletada anteriormente.\n");
+        } else {
+            printf("Nenhuma pista nesta sala.\n");
+        }
+
+        printf("\nOpções: (e) esquerda, (d) direita, (s) sair da exploração\n");
+        printf("Escolha: ");
+        if (!fgets(linha, sizeof(linha), stdin)) break;
+        trim_nl(linha);
+        if (strlen(linha) == 0) {
+            r = consultarSessao(sessao);
+            continue;
+        }
+        char cmd = (char) tolower((unsigned char)linha[0]);
+        r = passoSessao(sessao, cmd);
+        if (r.status == PASSO_ENCERRADA) {
+            printf("Você optou por encerrar a exploração.\n");
+            break;
+        } else if (r.status == PASSO_SEM_CAMINHO) {
+            printf(cmd == 'e' ? "Caminho à esquerda não existe a partir daqui.\n"
+                              : "Caminho à direita não existe a partir daqui.\n");
+        } else if (r.status == PASSO_INVALIDO) {
+            printf("Comando inválido. Use 'e', 'd' ou 's'.\n");
+        }
+    }
+}
+
+/* =========================
    Função que percorre a BST e conta quantas pistas apontam para suspeito alvo
    ========================= */
-int contarPistasQueApontam(PistaNode *root, const char *suspeitoAlvo) {
-    if (!root) return 0;
-    int total = 0;
-    // verificar nó atual
-    char *sus = encontrarSuspeito(root->pista);
-    if (sus && strcmp(sus, suspeitoAlvo) == 0) {
-        total += root->contador;
+static int contarPistasDoSuspeito(PistaNode *root, uint32_t alvo) {
+    if (!root) return 0;
+    int total = 0;
+    // verificar nó atual (compara ids do registro, não nomes)
+    HashEntry *e = buscarEntradaHash(root->pista);
+    if (e && e->idSuspeito == alvo) {
+        total += root->contador;
+    }
+    total += contarPistasDoSuspeito(root->esq, alvo);
+    total += contarPistasDoSuspeito(root->dir, alvo);
+    return total;
+}
+
+int contarPistasQueApontam(PistaNode *root, const char *suspeitoAlvo) {
+    uint32_t alvo = buscarIdSuspeito(suspeitoAlvo);
+    return alvo == SEM_SUSPEITO ? 0 : contarPistasDoSuspeito(root, alvo);
+}
+
+/* =========================
+   Compressão de blocos (estilo LZ4), diário de sessão e instantâneos
+   ========================= */
+/*
+ Compressor LZ77 no formato de bloco do LZ4: sequências de
+   token (4 bits de literais | 4 bits de match) | literais | deslocamento u16 | extensões.
+ Matches têm no mínimo 4 bytes e distância até 64 KB; os últimos 5 bytes são sempre literais.
+ A compressão roda em um thread dedicado: o thread do jogo apenas entrega buffers prontos.
+*/
+#define LZ_MIN_MATCH 4
+#define LZ_BITS_HASH 12
+#define LZ_DIST_MAX 65535
+
+/* tamanho máximo do resultado comprimido para n bytes de entrada */
+size_t limiteComprimido(size_t n) {
+    return n + n / 255 + 16;
+}
+
+static uint32_t ler32Lz(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static unsigned char *gravarTamanhoLz(unsigned char *op, size_t n) {
+    for (; n >= 255; n -= 255) *op++ = 255;
+    *op++ = (unsigned char) n;
+    return op;
+}
+
+static unsigned char *gravarSequenciaLz(unsigned char *op, const unsigned char *literais, size_t numLiterais,
+                                        size_t deslocamento, size_t tamMatch) {
+    unsigned char *token = op++;
+    *token = (unsigned char) ((numLiterais >= 15 ? 15 : numLiterais) << 4);
+    if (numLiterais >= 15) op = gravarTamanhoLz(op, numLiterais - 15);
+    memcpy(op, literais, numLiterais);
+    op += numLiterais;
+    if (tamMatch == 0) return op;       // última sequência: apenas literais
+    *op++ = (unsigned char) (deslocamento & 0xFF);
+    *op++ = (unsigned char) (deslocamento >> 8);
+    tamMatch -= LZ_MIN_MATCH;
+    *token |= (unsigned char) (tamMatch >= 15 ? 15 : tamMatch);
+    if (tamMatch >= 15) op = gravarTamanhoLz(op, tamMatch - 15);
+    return op;
+}
+
+/* comprimirLz: dst deve ter ao menos limiteComprimido(n) bytes; retorna o tamanho comprimido */
+size_t comprimirLz(const unsigned char *src, size_t n, unsigned char *dst) {
+    uint32_t tabela[1 << LZ_BITS_HASH];
+    memset(tabela, 0, sizeof(tabela));
+    unsigned char *op = dst;
+    size_t ip = 0, ancora = 0;
+
+    if (n >= 13) {
+        size_t limiteInicio = n - 12;   // nenhum match começa depois daqui
+        size_t limiteFim = n - 5;       // nenhum match termina depois daqui
+        unsigned tentativas = 0;
+        ip = 1;
+        while (ip < limiteInicio) {
+            uint32_t seq = ler32Lz(src + ip);
+            uint32_t h = (seq * 2654435761u) >> (32 - LZ_BITS_HASH);
+            size_t ref = tabela[h];
+            tabela[h] = (uint32_t) ip;
+            if (ref >= ip || ip - ref > LZ_DIST_MAX || ler32Lz(src + ref) != seq) {
+                ip += 1 + (tentativas++ >> 6);  // acelera em trechos incompressíveis
+                continue;
+            }
+            tentativas = 0;
+            while (ip > ancora && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                ip--;
+                ref--;
+            }
+            size_t tam = LZ_MIN_MATCH;
+            while (ip + tam < limiteFim && src[ip + tam] == src[ref + tam]) tam++;
+            op = gravarSequenciaLz(op, src + ancora, ip - ancora, ip - ref, tam);
+            ip += tam;
+            ancora = ip;
+            if (ip < limiteInicio) {
+                tabela[(ler32Lz(src + ip - 2) * 2654435761u) >> (32 - LZ_BITS_HASH)] = (uint32_t) (ip - 2);
+            }
+        }
+    }
+    op = gravarSequenciaLz(op, src + ancora, n - ancora, 0, 0);
+    return (size_t) (op - dst);
+}
+
+/* descomprimirLz: retorna o tamanho descomprimido ou -1 se o bloco for inválido */
+long descomprimirLz(const unsigned char *src, size_t n, unsigned char *dst, size_t capDst) {
+    const unsigned char *ip = src, *fim = src + n;
+    unsigned char *op = dst, *fimDst = dst + capDst;
+    while (ip < fim) {
+        unsigned token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15) {
+            unsigned b;
+            do {
+                if (ip >= fim) return -1;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if ((size_t) (fim - ip) < lit || (size_t) (fimDst - op) < lit) return -1;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == fim) break;           // última sequência
+        if (fim - ip < 2) return -1;
+        size_t desl = (size_t) ip[0] | ((size_t) ip[1] << 8);
+        ip += 2;
+        if (desl == 0 || desl > (size_t) (op - dst)) return -1;
+        size_t tam = token & 15;
+        if (tam == 15) {
+            unsigned b;
+            do {
+                if (ip >= fim) return -1;
+                b = *ip++;
+                tam += b;
+            } while (b == 255);
+        }
+        tam += LZ_MIN_MATCH;
+        if ((size_t) (fimDst - op) < tam) return -1;
+        const unsigned char *ref = op - desl;
+        if (desl >= tam) {
+            memcpy(op, ref, tam);
+            op += tam;
+        } else {
+            while (tam--) *op++ = *ref++;   // byte a byte: a origem sobrepõe o destino
+        }
+    }
+    return (long) (op - dst);
+}
+
+/*
+ Arquivo de blocos comprimidos (diário e instantâneo):
+   { tamOriginal u32 | tamGravado u32 (bit 31 = bloco cru) | crc32c u32 do original | dados }*
+*/
+#define BLOCO_CRU 0x80000000u
+
+static int gravarBlocoComprimido(FILE *out, const unsigned char *dados, size_t tam, uint64_t *bytesSaida) {
+    unsigned char *comp = (unsigned char *) malloc(limiteComprimido(tam));
+    if (!comp) {
+        fprintf(stderr, "Falha ao alocar memória para compressão\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t n = comprimirLz(dados, tam, comp);
+    uint32_t cab[3] = { (uint32_t) tam, (uint32_t) n, crc32c(dados, tam) };
+    const unsigned char *corpo = comp;
+    if (n >= tam) {             // incompressível: grava cru
+        cab[1] = (uint32_t) tam | BLOCO_CRU;
+        corpo = dados;
+        n = tam;
+    }
+    int ret = fwrite(cab, sizeof(cab), 1, out) == 1 && fwrite(corpo, 1, n, out) == n ? 0 : -1;
+    *bytesSaida += sizeof(cab) + n;
+    free(comp);
+    return ret;
+}
+
+/* lerArquivoComprimido: descomprime todos os blocos do arquivo para saida; 0 em sucesso */
+int lerArquivoComprimido(const char *caminho, BufferBin *saida) {
+    FILE *arq = fopen(caminho, "rb");
+    if (!arq) {
+        fprintf(stderr, "Não foi possível abrir %s\n", caminho);
+        return -1;
+    }
+    uint32_t cab[3];
+    unsigned char *comp = NULL;
+    size_t capComp = 0;
+    int ret = 0;
+    while (fread(cab, sizeof(cab), 1, arq) == 1) {
+        size_t tamGravado = cab[1] & ~BLOCO_CRU;
+        if (tamGravado > capComp) {
+            capComp = tamGravado;
+            comp = (unsigned char *) realloc(comp, capComp);
+            if (!comp) {
+                fprintf(stderr, "Erro de memória\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (fread(comp, 1, tamGravado, arq) != tamGravado) {
+            ret = -1;
+            break;
+        }
+        size_t inicio = saida->tam;
+        if (cab[1] & BLOCO_CRU) {
+            if (tamGravado != cab[0]) {
+                ret = -1;
+                break;
+            }
+            anexarBin(saida, comp, tamGravado);
+        } else {
+            reservarBin(saida, cab[0]);
+            if (descomprimirLz(comp, tamGravado, saida->dados + inicio, cab[0]) != (long) cab[0]) {
+                ret = -1;
+                break;
+            }
+            saida->tam += cab[0];
+        }
+        if (crc32c(saida->dados + inicio, cab[0]) != cab[2]) {
+            ret = -1;
+            break;
+        }
+    }
+    if (ret != 0) fprintf(stderr, "Bloco comprimido inválido em %s\n", caminho);
+    free(comp);
+    fclose(arq);
+    return ret;
+}
+
+/* --- compressão assíncrona: fila de tarefas consumida por um thread dedicado --- */
+typedef struct TarefaCompressao {
+    unsigned char *dados;           // pertence à tarefa a partir do enfileiramento
+    size_t tam;
+    FILE *destino;
+    int fecharDestino;              // fecha o arquivo após gravar (instantâneos)
+    struct TarefaCompressao *prox;
+} TarefaCompressao;
+
+typedef struct Compressor {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t temTarefa, filaVazia;
+    TarefaCompressao *inicio, *fim;
+    int encerrar, ocupado;
+    uint64_t bytesEntrada, bytesSaida;  // estatísticas (protegidas pelo mutex)
+    double segundos;                    // tempo gasto comprimindo e gravando
+    int falhas;
+} Compressor;
+
+static void *executarCompressor(void *arg) {
+    Compressor *c = (Compressor *) arg;
+    pthread_mutex_lock(&c->mutex);
+    while (1) {
+        while (!c->inicio && !c->encerrar) pthread_cond_wait(&c->temTarefa, &c->mutex);
+        if (!c->inicio) break;
+        TarefaCompressao *t = c->inicio;
+        c->inicio = t->prox;
+        if (!c->inicio) c->fim = NULL;
+        c->ocupado = 1;
+        pthread_mutex_unlock(&c->mutex);
+
+        uint64_t saida = 0;
+        double t0 = agoraSegundos();
+        int ret = t->tam ? gravarBlocoComprimido(t->destino, t->dados, t->tam, &saida) : 0;
+        if (t->fecharDestino && fclose(t->destino) != 0) ret = -1;
+        double dt = agoraSegundos() - t0;
+
+        pthread_mutex_lock(&c->mutex);
+        c->bytesEntrada += t->tam;
+        c->bytesSaida += saida;
+        c->segundos += dt;
+        if (ret != 0) c->falhas++;
+        c->ocupado = 0;
+        if (!c->inicio) pthread_cond_broadcast(&c->filaVazia);
+        free(t->dados);
+        free(t);
+    }
+    pthread_mutex_unlock(&c->mutex);
+    return NULL;
+}
+
+void iniciarCompressor(Compressor *c) {
+    memset(c, 0, sizeof(*c));
+    pthread_mutex_init(&c->mutex, NULL);
+    pthread_cond_init(&c->temTarefa, NULL);
+    pthread_cond_init(&c->filaVazia, NULL);
+    if (pthread_create(&c->thread, NULL, executarCompressor, c) != 0) {
+        fprintf(stderr, "Falha ao criar thread de compressão\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* enfileirarCompressao: assume a posse de dados (alocado com malloc); não bloqueia em E/S.
+   Uma tarefa vazia com fecharDestino apenas fecha o arquivo, na ordem da fila. */
+void enfileirarCompressao(Compressor *c, unsigned char *dados, size_t tam, FILE *destino, int fecharDestino) {
+    TarefaCompressao *t = (TarefaCompressao *) malloc(sizeof(TarefaCompressao));
+    if (!t) {
+        fprintf(stderr, "Falha ao alocar memória para tarefa de compressão\n");
+        exit(EXIT_FAILURE);
+    }
+    t->dados = dados;
+    t->tam = tam;
+    t->destino = destino;
+    t->fecharDestino = fecharDestino;
+    t->prox = NULL;
+    pthread_mutex_lock(&c->mutex);
+    if (c->fim) c->fim->prox = t;
+    else c->inicio = t;
+    c->fim = t;
+    pthread_cond_signal(&c->temTarefa);
+    pthread_mutex_unlock(&c->mutex);
+}
+
+/* aguarda até que todas as tarefas enfileiradas tenham sido gravadas */
+void aguardarCompressor(Compressor *c) {
+    pthread_mutex_lock(&c->mutex);
+    while (c->inicio || c->ocupado) pthread_cond_wait(&c->filaVazia, &c->mutex);
+    pthread_mutex_unlock(&c->mutex);
+}
+
+/* encerra o thread depois de esvaziar a fila; retorna o número de gravações com falha */
+int encerrarCompressor(Compressor *c) {
+    pthread_mutex_lock(&c->mutex);
+    c->encerrar = 1;
+    pthread_cond_signal(&c->temTarefa);
+    pthread_mutex_unlock(&c->mutex);
+    pthread_join(c->thread, NULL);
+    pthread_mutex_destroy(&c->mutex);
+    pthread_cond_destroy(&c->temTarefa);
+    pthread_cond_destroy(&c->filaVazia);
+    return c->falhas;
+}
+
+/* --- diário de sessão: comandos acumulados em segmentos comprimidos --- */
+#define DIARIO_TAM_SEGMENTO (64u * 1024u)
+
+typedef struct Diario {
+    FILE *arq;
+    Compressor *compressor;
+    BufferBin segmento;
+    uint64_t movimentos;
+} Diario;
+
+int abrirDiario(Diario *d, const char *caminho, Compressor *compressor) {
+    d->arq = fopen(caminho, "ab");
+    if (!d->arq) {
+        fprintf(stderr, "Não foi possível abrir o diário %s\n", caminho);
+        return -1;
+    }
+    d->compressor = compressor;
+    d->segmento.dados = NULL;
+    d->segmento.tam = d->segmento.cap = 0;
+    d->movimentos = 0;
+    return 0;
+}
+
+/* entrega o segmento atual ao compressor (o buffer passa a pertencer à tarefa) */
+static void despacharSegmento(Diario *d) {
+    if (d->segmento.tam == 0) return;
+    enfileirarCompressao(d->compressor, d->segmento.dados, d->segmento.tam, d->arq, 0);
+    d->segmento.dados = NULL;
+    d->segmento.tam = d->segmento.cap = 0;
+}
+
+void registrarMovimentoDiario(Diario *d, char cmd) {
+    anexarBin(&d->segmento, &cmd, 1);
+    d->movimentos++;
+    if (d->segmento.tam >= DIARIO_TAM_SEGMENTO) despacharSegmento(d);
+}
+
+/* fecharDiario: despacha o segmento pendente; o arquivo é fechado pelo compressor */
+void fecharDiario(Diario *d) {
+    despacharSegmento(d);
+    enfileirarCompressao(d->compressor, NULL, 0, d->arq, 1);
+    d->arq = NULL;
+}
+
+/* --- instantâneo de sessão: sala atual, pistas coletadas (BST em pré-ordem) e salas coletadas --- */
+#define INSTANTANEO_MAGICO "DQSN"
+
+static void serializarPistasPreOrdem(BufferBin *b, PistaNode *root, uint32_t *total) {
+    if (!root) return;
+    anexarStrBin(b, root->pista);
+    anexarU32Bin(b, (uint32_t) root->contador);
+    (*total)++;
+    serializarPistasPreOrdem(b, root->esq, total);
+    serializarPistasPreOrdem(b, root->dir, total);
+}
+
+/* serializarInstantaneo: gera a imagem não comprimida do estado da sessão */
+void serializarInstantaneo(BufferBin *b, const Sessao *s) {
+    anexarBin(b, INSTANTANEO_MAGICO, 4);
+    anexarU32Bin(b, s->atual->id);
+    size_t posTotal = b->tam;
+    uint32_t total = 0;
+    anexarU32Bin(b, 0);
+    serializarPistasPreOrdem(b, s->pistas, &total);
+    memcpy(b->dados + posTotal, &total, sizeof(total));
+    anexarU32Bin(b, (uint32_t) s->numSalas);
+    anexarU32Bin(b, s->coletadas.n);
+    anexarBin(b, s->coletadas.ids, s->coletadas.n * sizeof(uint32_t));
+}
+
+/* salvarInstantaneo: serializa no thread chamador e comprime/grava no thread do compressor */
+int salvarInstantaneo(const char *caminho, const Sessao *s, Compressor *compressor) {
+    FILE *out = fopen(caminho, "wb");
+    if (!out) {
+        fprintf(stderr, "Não foi possível criar o instantâneo %s\n", caminho);
+        return -1;
+    }
+    BufferBin b = { NULL, 0, 0 };
+    serializarInstantaneo(&b, s);
+    enfileirarCompressao(compressor, b.dados, b.tam, out, 1);
+    return 0;
+}
+
+/*
+ restaurarInstantaneoSalas: recria o estado de uma sessão recém-iniciada (iniciarSessao) sobre
+ a mesma mansão; salas é a tabela id -> sala (NULL: coletada da mansão). Retorna 0 em sucesso.
+*/
+int restaurarInstantaneoSalas(const unsigned char *dados, size_t tam, Sessao *s, Sala *const *salas) {
+    CursorBin c = { dados, dados + tam, 0 };
+    const void *magico = lerBin(&c, 4);
+    if (!magico || memcmp(magico, INSTANTANEO_MAGICO, 4) != 0) return -1;
+    uint32_t idAtual = lerU32Bin(&c);
+    uint32_t total = lerU32Bin(&c);
+    liberarPistas(s->pistas);
+    s->pistas = NULL;
+    for (uint32_t i = 0; i < total && !c.erro; ++i) {
+        char *pista = lerStrBin(&c);
+        uint32_t contador = lerU32Bin(&c);
+        if (!pista) break;
+        s->pistas = inserirPista(s->pistas, pista);     // pré-ordem recria a mesma forma da árvore
+        buscarPista(s->pistas, pista)->contador = (int) contador;
+        free(pista);
+    }
+    uint32_t numSalas = lerU32Bin(&c);
+    uint32_t numColetadas = lerU32Bin(&c);
+    const void *ids = lerBin(&c, (size_t) numColetadas * sizeof(uint32_t));
+    if (!ids || numSalas != s->numSalas || idAtual >= numSalas) return -1;
+    s->coletadas.n = 0;
+    for (uint32_t i = 0; i < numColetadas; ++i) {
+        uint32_t id;
+        memcpy(&id, (const unsigned char *) ids + i * sizeof(uint32_t), sizeof(id));
+        if (id >= numSalas) return -1;
+        inserirConjunto(&s->coletadas, id);
+    }
+
+    if (salas) {
+        s->atual = salas[idAtual];
+        return 0;
+    }
+    size_t n;
+    Sala **todas = coletarSalasPreOrdem(s->inicio, &n);
+    s->atual = todas[idAtual];
+    free(todas);
+    return 0;
+}
+
+int restaurarInstantaneo(const unsigned char *dados, size_t tam, Sessao *s) {
+    return restaurarInstantaneoSalas(dados, tam, s, NULL);
+}
+
+/*
+ benchDiario: simula sessões que percorrem a mansão sintética registrando cada
+ comando no diário e um instantâneo ao final. Mede o custo no thread do jogo e a
+ razão/vazão do compressor (que roda em paralelo). Os instantâneos vão juntos para
+ <prefixo>.inst; o da última sessão também é salvo sozinho (salvarInstantaneo) em
+ <prefixo>.ultimo.inst, como faria um hospedeiro ao suspender a sessão.
+*/
+int benchDiario(size_t numSalas, size_t numSessoes, const char *prefixo) {
+    if (numSalas == 0 || numSessoes == 0) {
+        fprintf(stderr, "Uso: --bench-diario <salas> <sessoes> <prefixo>, salas e sessões maiores que zero\n");
+        return -1;
+    }
+    char caminhoDiario[512], caminhoInst[512], caminhoUltimo[512];
+    snprintf(caminhoDiario, sizeof(caminhoDiario), "%s.diario", prefixo);
+    snprintf(caminhoInst, sizeof(caminhoInst), "%s.inst", prefixo);
+    snprintf(caminhoUltimo, sizeof(caminhoUltimo), "%s.ultimo.inst", prefixo);
+    remove(caminhoDiario);
+    FILE *inst = fopen(caminhoInst, "wb");
+    if (!inst) {
+        fprintf(stderr, "Não foi possível criar %s\n", caminhoInst);
+        return -1;
+    }
+
+    Sala *mansao = gerarMansaoSintetica(numSalas);
+    numerarSalas(mansao);
+    Compressor comp;
+    iniciarCompressor(&comp);
+    Diario diario;
+    if (abrirDiario(&diario, caminhoDiario, &comp) != 0) {
+        fclose(inst);
+        encerrarCompressor(&comp);
+        liberarSalas(mansao);
+        liberarHash();
+        return -1;
+    }
+
+    uint64_t semente = 42, movimentos = 0, bytesInst = 0, pistasSessao0 = 0, pistasUltima = 0;
+    int ultimoSalvo = -1;
+    double tJogo = 0;
+    double t0 = agoraSegundos();
+    for (size_t s = 0; s < numSessoes; ++s) {
+        double ti = agoraSegundos();
+        Sessao sessao;
+        ResultadoPasso r = iniciarSessao(&sessao, mansao, numSalas);
+        while (r.status != PASSO_ENCERRADA) {
+            uint64_t sorteio = aleatorio(&semente) % 8;
+            char cmd = sorteio == 0 ? 's' : (sorteio < 4 ? 'e' : 'd');
+            if (!r.sala->esq && !r.sala->dir) cmd = 's';
+            registrarMovimentoDiario(&diario, cmd);
+            movimentos++;
+            r = passoSessao(&sessao, cmd);
+        }
+        BufferBin b = { NULL, 0, 0 };
+        serializarInstantaneo(&b, &sessao);
+        bytesInst += b.tam;
+        enfileirarCompressao(&comp, b.dados, b.tam, inst, 0);
+        tJogo += agoraSegundos() - ti;
+
+        if (s == 0) pistasSessao0 = contarNosPistas(sessao.pistas);
+        if (s + 1 == numSessoes) {
+            pistasUltima = contarNosPistas(sessao.pistas);
+            ultimoSalvo = salvarInstantaneo(caminhoUltimo, &sessao, &comp);
+        }
+        encerrarSessao(&sessao);
+    }
+    fecharDiario(&diario);
+    enfileirarCompressao(&comp, NULL, 0, inst, 1);
+    aguardarCompressor(&comp);
+    double tTotal = agoraSegundos() - t0;
+    int falhas = encerrarCompressor(&comp);
+
+    printf("Sessões: %zu, movimentos: %llu, instantâneos: %.1f MB\n", numSessoes,
+           (unsigned long long) movimentos, (double) bytesInst / 1048576.0);
+    printf("Thread do jogo: %.1f ns por movimento (inclui serializar instantâneos)\n",
+           tJogo * 1e9 / (double) movimentos);
+    printf("Compressor: %.1f MB -> %.1f MB (razão %.2f), %.1f MB/s; total %.3f s\n",
+           (double) comp.bytesEntrada / 1048576.0, (double) comp.bytesSaida / 1048576.0,
+           (double) comp.bytesEntrada / (double) (comp.bytesSaida ? comp.bytesSaida : 1),
+           (double) comp.bytesEntrada / 1048576.0 / comp.segundos, tTotal);
+
+    /* releitura: diário completo e primeiro instantâneo */
+    BufferBin lido = { NULL, 0, 0 };
+    double td = agoraSegundos();
+    int ret = lerArquivoComprimido(caminhoDiario, &lido);
+    td = agoraSegundos() - td;
+    if (ret == 0 && lido.tam == movimentos) {
+        printf("Diário relido: %llu comandos (%.1f MB/s descomprimindo)\n",
+               (unsigned long long) lido.tam, (double) lido.tam / 1048576.0 / td);
+    } else {
+        fprintf(stderr, "Diário relido não confere\n");
+        ret = -1;
+    }
+    lido.tam = 0;
+    if (ret == 0 && lerArquivoComprimido(caminhoInst, &lido) == 0) {
+        Sessao sessao;
+        iniciarSessao(&sessao, mansao, numSalas);
+        if (restaurarInstantaneo(lido.dados, lido.tam, &sessao) != 0 ||
+            contarNosPistas(sessao.pistas) != pistasSessao0) {
+            fprintf(stderr, "Instantâneo restaurado não confere\n");
+            ret = -1;
+        }
+        encerrarSessao(&sessao);
+    } else {
+        ret = -1;
+    }
+    lido.tam = 0;
+    if (ret == 0 && ultimoSalvo == 0 && lerArquivoComprimido(caminhoUltimo, &lido) == 0) {
+        Sessao sessao;
+        iniciarSessao(&sessao, mansao, numSalas);
+        if (restaurarInstantaneo(lido.dados, lido.tam, &sessao) != 0 ||
+            contarNosPistas(sessao.pistas) != pistasUltima) {
+            fprintf(stderr, "Instantâneo da última sessão não confere\n");
+            ret = -1;
+        }
+        encerrarSessao(&sessao);
+    } else if (ret == 0 && numSessoes > 0) {
+        ret = -1;
+    }
+    free(lido.dados);
+    liberarSalas(mansao);
+    liberarHash();
+    return ret == 0 && falhas == 0 ? 0 : -1;
+}
+
+/* =========================
+   Persistência assíncrona (io_uring, com fallback em threads)
+   ========================= */
+/*
+ O thread do jogo apenas enfileira buffers (append em descritores abertos com O_APPEND).
+ Cada canal tem um thread que drena a fila inteira de uma vez, agrupa as gravações por
+ descritor (preservando a ordem) e as emite como writev vetorizados:
+  - backend io_uring: um anel por canal; uma submissão contém um writev por descritor,
+    e o thread dorme no kernel até a rodada completar (novas gravações se acumulam no lote seguinte);
+  - fallback: writev síncrono no thread do canal; o descritor escolhe o canal (fd % canais),
+    de modo que gravações de um mesmo arquivo nunca são reordenadas.
+*/
+#define PERSIST_IOV_MAX 1024
+#define PERSIST_ANEL 256
+
+typedef struct GravacaoPendente {
+    int fd;
+    unsigned char *dados;
+    size_t tam;
+    struct GravacaoPendente *prox;
+} GravacaoPendente;
+
+#ifdef TEM_IO_URING
+typedef struct AnelUring {
+    int fd;
+    unsigned entradas;
+    void *memSq, *memCq;
+    size_t tamSq, tamCq;
+    struct io_uring_sqe *sqes;
+    unsigned *sqCauda, *sqMascara, *sqVetor;
+    unsigned *cqCabeca, *cqCauda, *cqMascara;
+    struct io_uring_cqe *cqes;
+} AnelUring;
+
+static int criarAnelUring(AnelUring *a, unsigned entradas) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    a->fd = (int) syscall(__NR_io_uring_setup, entradas, &p);
+    if (a->fd < 0) return -1;
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) {     // necessário para writev na posição corrente
+        close(a->fd);
+        return -1;
+    }
+    a->entradas = p.sq_entries;
+    a->tamSq = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    a->tamCq = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int unico = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (unico && a->tamCq > a->tamSq) a->tamSq = a->tamCq;
+    a->memSq = mmap(NULL, a->tamSq, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a->fd, IORING_OFF_SQ_RING);
+    a->memCq = unico ? a->memSq
+                     : mmap(NULL, a->tamCq, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a->fd, IORING_OFF_CQ_RING);
+    a->sqes = (struct io_uring_sqe *) mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_POPULATE, a->fd, IORING_OFF_SQES);
+    if (a->memSq == MAP_FAILED || a->memCq == MAP_FAILED || a->sqes == MAP_FAILED) {
+        /* desfaz apenas os mapeamentos que deram certo */
+        if (a->sqes != MAP_FAILED) munmap(a->sqes, p.sq_entries * sizeof(struct io_uring_sqe));
+        if (!unico && a->memCq != MAP_FAILED) munmap(a->memCq, a->tamCq);
+        if (a->memSq != MAP_FAILED) munmap(a->memSq, a->tamSq);
+        close(a->fd);
+        return -1;
+    }
+    char *sq = (char *) a->memSq, *cq = (char *) a->memCq;
+    a->sqCauda = (unsigned *) (sq + p.sq_off.tail);
+    a->sqMascara = (unsigned *) (sq + p.sq_off.ring_mask);
+    a->sqVetor = (unsigned *) (sq + p.sq_off.array);
+    a->cqCabeca = (unsigned *) (cq + p.cq_off.head);
+    a->cqCauda = (unsigned *) (cq + p.cq_off.tail);
+    a->cqMascara = (unsigned *) (cq + p.cq_off.ring_mask);
+    a->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    return 0;
+}
+
+/*
+ submeterAnelUring: entrega as k SQEs já publicadas na cauda e devolve quantas o kernel
+ consumiu. EINTR repete; EAGAIN/EBUSY (falta de recursos ou conclusões pendentes) esperam
+ uma conclusão e repetem algumas vezes; qualquer outro erro encerra a submissão.
+*/
+static unsigned submeterAnelUring(AnelUring *a, unsigned k) {
+    unsigned enviados = 0;
+    int tentativas = 0;
+    while (enviados < k) {
+        long r = syscall(__NR_io_uring_enter, a->fd, k - enviados, 0, 0, NULL, 0);
+        if (r > 0) {
+            enviados += (unsigned) r;
+            tentativas = 0;
+        } else if (r < 0 && errno == EINTR) {
+            continue;
+        } else if (r < 0 && (errno == EAGAIN || errno == EBUSY) && ++tentativas < 8) {
+            if (enviados > 0) syscall(__NR_io_uring_enter, a->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        } else {
+            break;
+        }
+    }
+    return enviados;
+}
+
+static void destruirAnelUring(AnelUring *a) {
+    munmap(a->sqes, a->entradas * sizeof(struct io_uring_sqe));
+    if (a->memCq != a->memSq) munmap(a->memCq, a->tamCq);
+    munmap(a->memSq, a->tamSq);
+    close(a->fd);
+}
+#endif
+
+typedef struct Persistencia Persistencia;
+
+typedef struct CanalPersistencia {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t temTrabalho, ocioso;
+    GravacaoPendente *pilha;        // LIFO; invertida ao drenar
+    int dormindo, ocupado, encerrar;
+    Persistencia *dono;
+#ifdef TEM_IO_URING
+    AnelUring anel;
+#endif
+} CanalPersistencia;
+
+struct Persistencia {
+    CanalPersistencia *canais;
+    int numCanais;
+    int usaUring;
+    _Atomic uint64_t bytes, submissoes, falhas;
+};
+
+/* grava todo o vetor, reemitindo após gravações parciais */
+static int gravarVetorCompleto(int fd, struct iovec *iov, int n) {
+    while (n > 0) {
+        ssize_t r = writev(fd, iov, n);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        while (n > 0 && (size_t) r >= iov->iov_len) {
+            r -= (ssize_t) iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (char *) iov->iov_base + r;
+            iov->iov_len -= (size_t) r;
+        }
+    }
+    return 0;
+}
+
+/* pedaço de um grupo: até PERSIST_IOV_MAX buffers consecutivos do mesmo descritor */
+typedef struct PedacoGravacao {
+    int fd;
+    struct iovec *iov;
+    int n;
+    size_t bytes;
+} PedacoGravacao;
+
+static int compararGravacao(const void *a, const void *b) {
+    const GravacaoPendente *x = *(const GravacaoPendente * const *) a;
+    const GravacaoPendente *y = *(const GravacaoPendente * const *) b;
+    if (x->fd != y->fd) return x->fd < y->fd ? -1 : 1;
+    return x < y ? -1 : (x > y ? 1 : 0);     // desempate pela ordem do lote (ver processarLote)
+}
+
+static void processarLote(CanalPersistencia *c, GravacaoPendente *lote) {
+    Persistencia *p = c->dono;
+    size_t n = 0;
+    for (GravacaoPendente *g = lote; g; g = g->prox) n++;
+    /* os nós vão para um único vetor na ordem de chegada; o endereço no vetor desempata a ordenação */
+    GravacaoPendente *vet = (GravacaoPendente *) malloc(n * sizeof(GravacaoPendente));
+    GravacaoPendente **ord = (GravacaoPendente **) malloc(n * sizeof(GravacaoPendente *));
+    struct iovec *iov = (struct iovec *) malloc(n * sizeof(struct iovec));
+    PedacoGravacao *pedacos = (PedacoGravacao *) malloc(n * sizeof(PedacoGravacao));
+    if (!vet || !ord || !iov || !pedacos) {
+        fprintf(stderr, "Falha ao alocar memória para lote de persistência\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t i = 0;
+    while (lote) {
+        GravacaoPendente *prox = lote->prox;
+        vet[i] = *lote;
+        ord[i] = &vet[i];
+        i++;
+        free(lote);
+        lote = prox;
+    }
+    qsort(ord, n, sizeof(GravacaoPendente *), compararGravacao);
+
+    size_t numPedacos = 0;
+    for (i = 0; i < n; ++i) {
+        iov[i].iov_base = ord[i]->dados;
+        iov[i].iov_len = ord[i]->tam;
+        PedacoGravacao *ult = numPedacos ? &pedacos[numPedacos - 1] : NULL;
+        if (ult && ult->fd == ord[i]->fd && ult->n < PERSIST_IOV_MAX) {
+            ult->n++;
+            ult->bytes += ord[i]->tam;
+        } else {
+            pedacos[numPedacos].fd = ord[i]->fd;
+            pedacos[numPedacos].iov = &iov[i];
+            pedacos[numPedacos].n = 1;
+            pedacos[numPedacos].bytes = ord[i]->tam;
+            numPedacos++;
+        }
+    }
+
+    size_t feitos = 0;
+#ifdef TEM_IO_URING
+    if (p->usaUring) {
+        /* rodadas com no máximo um pedaço por descritor, para não reordenar um mesmo arquivo */
+        size_t *rodada = (size_t *) malloc(c->anel.entradas * sizeof(size_t));
+        char *emitido = (char *) calloc(numPedacos, 1);
+        if (!rodada || !emitido) {
+            fprintf(stderr, "Falha ao alocar memória para lote de persistência\n");
+            exit(EXIT_FAILURE);
+        }
+        while (feitos < numPedacos) {
+            unsigned k = 0;
+            unsigned cauda = *c->anel.sqCauda;
+            int ultimoFd = -1;
+            for (size_t j = 0; j < numPedacos && k < c->anel.entradas; ++j) {
+                if (emitido[j]) continue;
+                if (pedacos[j].fd == ultimoFd) continue;    // pedaços do mesmo fd são consecutivos
+                ultimoFd = pedacos[j].fd;
+                unsigned idx = (cauda + k) & *c->anel.sqMascara;
+                struct io_uring_sqe *sqe = &c->anel.sqes[idx];
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_WRITEV;
+                sqe->fd = pedacos[j].fd;
+                sqe->addr = (uint64_t) (uintptr_t) pedacos[j].iov;
+                sqe->len = (unsigned) pedacos[j].n;
+                sqe->off = (uint64_t) -1;           // posição corrente (append com O_APPEND)
+                sqe->user_data = j;
+                c->anel.sqVetor[idx] = idx;
+                rodada[k++] = j;
+                emitido[j] = 1;
+            }
+            __atomic_store_n(c->anel.sqCauda, cauda + k, __ATOMIC_RELEASE);
+            unsigned enviados = submeterAnelUring(&c->anel, k);
+            if (enviados < k) {
+                /* sem SQPOLL o kernel só consome SQEs dentro do enter: as restantes saem do anel */
+                __atomic_store_n(c->anel.sqCauda, cauda + enviados, __ATOMIC_RELEASE);
+            }
+            atomic_fetch_add(&p->submissoes, 1);
+            unsigned completos = 0;
+            while (completos < enviados) {
+                unsigned cabeca = *c->anel.cqCabeca;
+                if (cabeca == __atomic_load_n(c->anel.cqCauda, __ATOMIC_ACQUIRE)) {
+                    syscall(__NR_io_uring_enter, c->anel.fd, 0, enviados - completos, IORING_ENTER_GETEVENTS, NULL, 0);
+                    continue;
+                }
+                struct io_uring_cqe *cqe = &c->anel.cqes[cabeca & *c->anel.cqMascara];
+                PedacoGravacao *pd = &pedacos[cqe->user_data];
+                if (cqe->res < 0 || (size_t) cqe->res < pd->bytes) {
+                    /* gravação parcial ou erro: conclui de forma síncrona a partir do ponto atingido */
+                    size_t gravado = cqe->res > 0 ? (size_t) cqe->res : 0;
+                    struct iovec *v = pd->iov;
+                    int m = pd->n;
+                    while (m > 0 && gravado >= v->iov_len) {
+                        gravado -= v->iov_len;
+                        v++;
+                        m--;
+                    }
+                    if (m > 0) {
+                        v->iov_base = (char *) v->iov_base + gravado;
+                        v->iov_len -= gravado;
+                    }
+                    if (gravarVetorCompleto(pd->fd, v, m) != 0) atomic_fetch_add(&p->falhas, 1);
+                }
+                atomic_fetch_add(&p->bytes, pd->bytes);
+                __atomic_store_n(c->anel.cqCabeca, cabeca + 1, __ATOMIC_RELEASE);
+                completos++;
+            }
+            /* pedaços não consumidos pelo kernel: descritores distintos dos já concluídos, grava em sequência */
+            for (unsigned q = enviados; q < k; ++q) {
+                PedacoGravacao *pd = &pedacos[rodada[q]];
+                if (gravarVetorCompleto(pd->fd, pd->iov, pd->n) != 0) atomic_fetch_add(&p->falhas, 1);
+                atomic_fetch_add(&p->bytes, pd->bytes);
+            }
+            feitos += k;
+        }
+        free(rodada);
+        free(emitido);
+    }
+#endif
+    for (; feitos < numPedacos; ++feitos) {
+        if (gravarVetorCompleto(pedacos[feitos].fd, pedacos[feitos].iov, pedacos[feitos].n) != 0) {
+            atomic_fetch_add(&p->falhas, 1);
+        }
+        atomic_fetch_add(&p->submissoes, 1);
+        atomic_fetch_add(&p->bytes, pedacos[feitos].bytes);
+    }
+
+    for (i = 0; i < n; ++i) free(vet[i].dados);
+    free(vet);
+    free(ord);
+    free(iov);
+    free(pedacos);
+}
+
+static void *executarCanalPersistencia(void *arg) {
+    CanalPersistencia *c = (CanalPersistencia *) arg;
+    pthread_mutex_lock(&c->mutex);
+    while (1) {
+        while (!c->pilha && !c->encerrar) {
+            c->dormindo = 1;
+            pthread_cond_wait(&c->temTrabalho, &c->mutex);
+            c->dormindo = 0;
+        }
+        if (!c->pilha) break;
+        GravacaoPendente *lifo = c->pilha, *lote = NULL;
+        c->pilha = NULL;
+        c->ocupado = 1;
+        pthread_mutex_unlock(&c->mutex);
+
+        while (lifo) {          // inverte para a ordem de chegada
+            GravacaoPendente *prox = lifo->prox;
+            lifo->prox = lote;
+            lote = lifo;
+            lifo = prox;
+        }
+        processarLote(c, lote);
+
+        pthread_mutex_lock(&c->mutex);
+        c->ocupado = 0;
+        if (!c->pilha) pthread_cond_broadcast(&c->ocioso);
+    }
+    pthread_mutex_unlock(&c->mutex);
+    return NULL;
+}
+
+/*
+ iniciarPersistencia: preferirUring = 1 tenta io_uring (um canal, lotes grandes) e cai
+ para o pool de threads (um canal por núcleo) se o kernel não oferecer suporte.
+*/
+void iniciarPersistencia(Persistencia *p, int preferirUring) {
+    memset(p, 0, sizeof(*p));
+    long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+    p->numCanais = nucleos > 1 ? (int) nucleos : 1;
+#ifdef TEM_IO_URING
+    AnelUring anel;
+    if (preferirUring && criarAnelUring(&anel, PERSIST_ANEL) == 0) {
+        p->usaUring = 1;
+        p->numCanais = 1;
+    }
+#else
+    (void) preferirUring;
+#endif
+    p->canais = (CanalPersistencia *) calloc((size_t) p->numCanais, sizeof(CanalPersistencia));
+    if (!p->canais) {
+        fprintf(stderr, "Falha ao alocar memória para persistência\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < p->numCanais; ++i) {
+        CanalPersistencia *c = &p->canais[i];
+        c->dono = p;
+#ifdef TEM_IO_URING
+        if (p->usaUring) c->anel = anel;
+#endif
+        pthread_mutex_init(&c->mutex, NULL);
+        pthread_cond_init(&c->temTrabalho, NULL);
+        pthread_cond_init(&c->ocioso, NULL);
+        if (pthread_create(&c->thread, NULL, executarCanalPersistencia, c) != 0) {
+            fprintf(stderr, "Falha ao criar thread de persistência\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/* agendarGravacao: assume a posse de dados; custo de um push sob mutex (sem syscall se o canal estiver ativo) */
+void agendarGravacao(Persistencia *p, int fd, unsigned char *dados, size_t tam) {
+    GravacaoPendente *g = (GravacaoPendente *) malloc(sizeof(GravacaoPendente));
+    if (!g) {
+        fprintf(stderr, "Falha ao alocar memória para gravação pendente\n");
+        exit(EXIT_FAILURE);
+    }
+    g->fd = fd;
+    g->dados = dados;
+    g->tam = tam;
+    CanalPersistencia *c = &p->canais[(unsigned) fd % (unsigned) p->numCanais];
+    pthread_mutex_lock(&c->mutex);
+    g->prox = c->pilha;
+    c->pilha = g;
+    if (c->dormindo) pthread_cond_signal(&c->temTrabalho);
+    pthread_mutex_unlock(&c->mutex);
+}
+
+/* aguarda até que tudo o que foi agendado esteja gravado */
+void sincronizarPersistencia(Persistencia *p) {
+    for (int i = 0; i < p->numCanais; ++i) {
+        CanalPersistencia *c = &p->canais[i];
+        pthread_mutex_lock(&c->mutex);
+        while (c->pilha || c->ocupado) pthread_cond_wait(&c->ocioso, &c->mutex);
+        pthread_mutex_unlock(&c->mutex);
+    }
+}
+
+/* encerra os canais após drenar as filas; retorna o número de gravações com falha */
+int encerrarPersistencia(Persistencia *p) {
+    for (int i = 0; i < p->numCanais; ++i) {
+        CanalPersistencia *c = &p->canais[i];
+        pthread_mutex_lock(&c->mutex);
+        c->encerrar = 1;
+        pthread_cond_signal(&c->temTrabalho);
+        pthread_mutex_unlock(&c->mutex);
+        pthread_join(c->thread, NULL);
+        pthread_mutex_destroy(&c->mutex);
+        pthread_cond_destroy(&c->temTrabalho);
+        pthread_cond_destroy(&c->ocioso);
+    }
+#ifdef TEM_IO_URING
+    if (p->usaUring) destruirAnelUring(&p->canais[0].anel);
+#endif
+    free(p->canais);
+    return (int) atomic_load(&p->falhas);
+}
+
+/*
+ benchPersistencia: cada sessão anexa um registro de 16 bytes ao seu diário por movimento
+ e, a cada 64 movimentos, um instantâneo de 4 KB. Mede a latência por movimento vista
+ pelo thread do jogo (média e p99) com gravação síncrona, pool de threads e io_uring.
+*/
+static int compararDouble(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+int benchPersistencia(size_t numSessoes, size_t movimentos, const char *dir) {
+    if (numSessoes == 0 || movimentos == 0) {
+        fprintf(stderr, "Uso: --bench-persistencia <sessoes> <movimentos> <dir>, ambos maiores que zero\n");
+        return -1;
+    }
+    int *fds = (int *) malloc(2 * numSessoes * sizeof(int));
+    size_t numAmostras = movimentos / 16 + 1;
+    double *amostras = (double *) malloc(numAmostras * sizeof(double));
+    if (!fds || !amostras) {
+        fprintf(stderr, "Falha ao alocar memória para benchmark\n");
+        exit(EXIT_FAILURE);
+    }
+    const char *nomes[3] = { "write sincrono", "pool de threads", "io_uring" };
+    int ret = 0;
+    for (int modo = 0; modo < 3 && ret == 0; ++modo) {
+        char caminho[512];
+        for (size_t s = 0; s < 2 * numSessoes; ++s) {
+            snprintf(caminho, sizeof(caminho), "%s/sessao%zu.%s", dir, s / 2, s % 2 ? "inst" : "diario");
+            fds[s] = open(caminho, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+            if (fds[s] < 0) {
+                fprintf(stderr, "Não foi possível criar %s\n", caminho);
+                while (s-- > 0) close(fds[s]);
+                free(fds);
+                free(amostras);
+                return -1;
+            }
+        }
+        Persistencia p;
+        if (modo > 0) {
+            iniciarPersistencia(&p, modo == 2);
+            if (modo == 2 && !p.usaUring) {
+                printf("%-16s: indisponível neste kernel\n", nomes[modo]);
+                encerrarPersistencia(&p);
+                for (size_t s = 0; s < 2 * numSessoes; ++s) close(fds[s]);
+                continue;
+            }
+        }
+        size_t amostra = 0;
+        double t0 = agoraSegundos();
+        for (size_t m = 0; m < movimentos; ++m) {
+            size_t s = m % numSessoes;
+            double ti = (m & 15) == 0 ? agoraSegundos() : 0;
+            size_t tam = (m / numSessoes) % 64 == 63 ? 4096 : 16;
+            int fd = fds[2 * s + (tam > 16)];
+            unsigned char *reg = (unsigned char *) malloc(tam);
+            if (!reg) {
+                fprintf(stderr, "Falha ao alocar memória para benchmark\n");
+                exit(EXIT_FAILURE);
+            }
+            memset(reg, (int) (m & 0xFF), tam);
+            if (modo == 0) {
+                if (write(fd, reg, tam) != (ssize_t) tam) ret = -1;
+                free(reg);
+            } else {
+                agendarGravacao(&p, fd, reg, tam);
+            }
+            if ((m & 15) == 0) amostras[amostra++] = agoraSegundos() - ti;
+        }
+        double tEnfileirar = agoraSegundos() - t0;
+        uint64_t submissoes = 0;
+        if (modo > 0) {
+            sincronizarPersistencia(&p);
+            submissoes = atomic_load(&p.submissoes);
+            if (encerrarPersistencia(&p) != 0) ret = -1;
+        }
+        double tTotal = agoraSegundos() - t0;
+        for (size_t s = 0; s < 2 * numSessoes; ++s) close(fds[s]);
+        qsort(amostras, amostra, sizeof(double), compararDouble);
+        printf("%-16s: %.2f us/movimento (p99 %.2f us), %llu submissões, total %.3f s\n", nomes[modo],
+               tEnfileirar * 1e6 / (double) movimentos, amostras[amostra * 99 / 100] * 1e6,
+               (unsigned long long) submissoes, tTotal);
+    }
+    free(fds);
+    free(amostras);
+    return ret;
+}
+
+/* =========================
+   Dicionário de pistas com codificação por prefixo (front coding)
+   ========================= */
+/*
+ Estrutura somente-leitura para catálogos congelados e instantâneos de inventário.
+ As pistas (em ordem) são agrupadas em blocos de DIC_TAM_BLOCO entradas; a primeira
+ entrada de cada bloco (ponto de reinício) é gravada por inteiro e as demais guardam
+ apenas o tamanho do prefixo comum com a anterior e o sufixo restante:
+   entrada = prefixo varint | tamSufixo varint | sufixo | contador varint
+ Busca: binária sobre os pontos de reinício, depois varredura linear dentro do bloco.
+ A ordem é a da BST (chaves de colação). As chaves dos pontos de reinício são
+ recalculadas ao construir/carregar (não vão para o disco), de modo que a busca binária
+ só faz memcmp; dentro do bloco basta procurar a pista exata.
+*/
+#define DIC_TAM_BLOCO 16
+
+typedef struct DicionarioPistas {
+    uint32_t numEntradas;
+    uint32_t numBlocos;
+    uint32_t *reinicios;        // deslocamento de cada bloco em dados
+    unsigned char *dados;
+    size_t tamDados;
+    size_t maiorPista;          // tamanho do buffer necessário para reconstruir uma entrada
+    unsigned char *chavesReinicio;  // chaves de colação dos pontos de reinício (só em memória)
+    uint32_t *inicioChaves;         // numBlocos + 1 deslocamentos em chavesReinicio
+} DicionarioPistas;
+
+static void anexarVarint(BufferBin *b, uint64_t v) {
+    unsigned char tmp[10];
+    int n = 0;
+    do {
+        tmp[n++] = (unsigned char) ((v & 0x7F) | (v >= 0x80 ? 0x80 : 0));
+        v >>= 7;
+    } while (v);
+    anexarBin(b, tmp, (size_t) n);
+}
+
+static uint64_t lerVarint(const unsigned char **p) {
+    uint64_t v = 0;
+    int desl = 0;
+    unsigned char c;
+    do {
+        c = *(*p)++;
+        v |= (uint64_t) (c & 0x7F) << desl;
+        desl += 7;
+    } while (c & 0x80);
+    return v;
+}
+
+/* lerVarintLimitado: como lerVarint, para bytes não confiáveis (-1 se passar de fim ou de 64 bits) */
+static int lerVarintLimitado(const unsigned char **p, const unsigned char *fim, uint64_t *v) {
+    uint64_t r = 0;
+    int desl = 0;
+    unsigned char c;
+    do {
+        if (*p >= fim || desl > 63) return -1;
+        c = *(*p)++;
+        r |= (uint64_t) (c & 0x7F) << desl;
+        desl += 7;
+    } while (c & 0x80);
+    *v = r;
+    return 0;
+}
+
+typedef struct ConstrutorDicionario {
+    BufferBin dados, reinicios;
+    char *anterior;
+    size_t tamAnterior, capAnterior;
+    uint32_t numEntradas;
+    size_t maiorPista;
+} ConstrutorDicionario;
+
+/* acrescenta uma pista; as chamadas devem vir em ordem estritamente crescente (a da BST) */
+static void acrescentarDicionario(ConstrutorDicionario *c, const char *pista, int contador) {
+    size_t tam = strlen(pista), prefixo = 0;
+    if (c->numEntradas % DIC_TAM_BLOCO == 0) {
+        anexarU32Bin(&c->reinicios, (uint32_t) c->dados.tam);
+    } else {
+        while (prefixo < tam && prefixo < c->tamAnterior && pista[prefixo] == c->anterior[prefixo]) prefixo++;
+    }
+    anexarVarint(&c->dados, prefixo);
+    anexarVarint(&c->dados, tam - prefixo);
+    anexarBin(&c->dados, pista + prefixo, tam - prefixo);
+    anexarVarint(&c->dados, (uint64_t) contador);
+    if (tam + 1 > c->capAnterior) {
+        c->capAnterior = tam + 1;
+        c->anterior = (char *) realloc(c->anterior, c->capAnterior);
+        if (!c->anterior) {
+            fprintf(stderr, "Falha ao alocar memória para dicionário\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(c->anterior, pista, tam + 1);
+    c->tamAnterior = tam;
+    if (tam > c->maiorPista) c->maiorPista = tam;
+    c->numEntradas++;
+}
+
+static void acrescentarPistasEmOrdem(ConstrutorDicionario *c, PistaNode *root) {
+    if (!root) return;
+    acrescentarPistasEmOrdem(c, root->esq);
+    acrescentarDicionario(c, root->pista, root->contador);
+    acrescentarPistasEmOrdem(c, root->dir);
+}
+
+static size_t decodificarEntrada(const unsigned char **p, char *buf, int *contador);
+
+/* indexarReinicios: calcula as chaves de colação dos pontos de reinício */
+static void indexarReinicios(DicionarioPistas *d) {
+    BufferBin chaves = { NULL, 0, 0 };
+    d->inicioChaves = (uint32_t *) malloc((d->numBlocos + 1) * sizeof(uint32_t));
+    char *buf = (char *) malloc(d->maiorPista + 1);
+    if (!d->inicioChaves || !buf) {
+        fprintf(stderr, "Falha ao alocar memória para dicionário\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t b = 0; b < d->numBlocos; ++b) {
+        const unsigned char *p = d->dados + d->reinicios[b];
+        int contador;
+        decodificarEntrada(&p, buf, &contador);
+        ChaveColacao chave;
+        prepararChave(&chave, buf);
+        d->inicioChaves[b] = (uint32_t) chaves.tam;
+        anexarBin(&chaves, chave.dados, chave.tam);
+        descartarChave(&chave);
+    }
+    d->inicioChaves[d->numBlocos] = (uint32_t) chaves.tam;
+    d->chavesReinicio = chaves.dados;
+    free(buf);
+}
+
+static DicionarioPistas *finalizarDicionario(ConstrutorDicionario *c) {
+    DicionarioPistas *d = (DicionarioPistas *) malloc(sizeof(DicionarioPistas));
+    if (!d) {
+        fprintf(stderr, "Falha ao alocar memória para dicionário\n");
+        exit(EXIT_FAILURE);
+    }
+    d->numEntradas = c->numEntradas;
+    d->numBlocos = (uint32_t) (c->reinicios.tam / sizeof(uint32_t));
+    d->reinicios = (uint32_t *) c->reinicios.dados;
+    d->dados = c->dados.dados;
+    d->tamDados = c->dados.tam;
+    d->maiorPista = c->maiorPista;
+    free(c->anterior);
+    indexarReinicios(d);
+    return d;
+}
+
+/* construirDicionario: congela o inventário (BST) em um dicionário compacto */
+DicionarioPistas *construirDicionario(PistaNode *root) {
+    ConstrutorDicionario c;
+    memset(&c, 0, sizeof(c));
+    acrescentarPistasEmOrdem(&c, root);
+    return finalizarDicionario(&c);
+}
+
+/* construirDicionarioOrdenado: para catálogos já ordenados por compararPistasColacao (contadores podem ser NULL) */
+DicionarioPistas *construirDicionarioOrdenado(const char **pistas, const int *contadores, size_t n) {
+    ConstrutorDicionario c;
+    memset(&c, 0, sizeof(c));
+    for (size_t i = 0; i < n; ++i) acrescentarDicionario(&c, pistas[i], contadores ? contadores[i] : 1);
+    return finalizarDicionario(&c);
+}
+
+/*
+ construirDicionarioDeCatalogo: catálogo em qualquer ordem e com repetições (cada
+ ocorrência conta 1 no contador); ordena em lote em vez de passar por uma BST.
+*/
+DicionarioPistas *construirDicionarioDeCatalogo(const char **pistas, size_t n, int threads) {
+    const char **ordem = (const char **) malloc(n * sizeof(const char *) + 1);
+    int *contadores = (int *) malloc(n * sizeof(int) + 1);
+    if (!ordem || !contadores) {
+        fprintf(stderr, "Falha ao alocar memória para dicionário\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(ordem, pistas, n * sizeof(const char *));
+    ordenarPistasColacao(ordem, n, threads);
+    size_t distintas = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (distintas > 0 && strcmp(ordem[i], ordem[distintas - 1]) == 0) {
+            contadores[distintas - 1]++;
+        } else {
+            ordem[distintas] = ordem[i];
+            contadores[distintas++] = 1;
+        }
+    }
+    DicionarioPistas *d = construirDicionarioOrdenado(ordem, contadores, distintas);
+    free(ordem);
+    free(contadores);
+    return d;
+}
+
+void liberarDicionario(DicionarioPistas *d) {
+    if (!d) return;
+    free(d->reinicios);
+    free(d->dados);
+    free(d->chavesReinicio);
+    free(d->inicioChaves);
+    free(d);
+}
+
+/*
+ decodifica a próxima entrada sobre buf (que contém a entrada anterior); devolve o tamanho.
+ Não confere limites: os dados vêm do construtor ou passaram por validarDadosDicionario.
+*/
+static size_t decodificarEntrada(const unsigned char **p, char *buf, int *contador) {
+    size_t prefixo = (size_t) lerVarint(p);
+    size_t sufixo = (size_t) lerVarint(p);
+    memcpy(buf + prefixo, *p, sufixo);
+    *p += sufixo;
+    buf[prefixo + sufixo] = '\0';
+    *contador = (int) lerVarint(p);
+    return prefixo + sufixo;
+}
+
+/* compara a pista (com sua chave) ao ponto de reinício do bloco: memcmp das chaves */
+static int compararReinicio(const DicionarioPistas *d, uint32_t bloco, const char *pista,
+                            const ChaveColacao *chave, char *buf) {
+    const unsigned char *k = d->chavesReinicio + d->inicioChaves[bloco];
+    int cmp = compararChaves(chave->dados, chave->tam, k, d->inicioChaves[bloco + 1] - d->inicioChaves[bloco]);
+    if (cmp != 0) return cmp;
+    const unsigned char *p = d->dados + d->reinicios[bloco];     // empate de chave: decide por strcmp
+    int contador;
+    decodificarEntrada(&p, buf, &contador);
+    return strcmp(pista, buf);
+}
+
+/* buscarDicionario: retorna o contador da pista (0 se ausente) */
+int buscarDicionario(const DicionarioPistas *d, const char *pista) {
+    if (d->numBlocos == 0) return 0;
+    char local[256];
+    char *buf = d->maiorPista < sizeof(local) ? local : (char *) malloc(d->maiorPista + 1);
+    if (!buf) {
+        fprintf(stderr, "Falha ao alocar memória para busca no dicionário\n");
+        exit(EXIT_FAILURE);
+    }
+    ChaveColacao chave;
+    prepararChave(&chave, pista);
+    /* último bloco cujo ponto de reinício é <= pista */
+    uint32_t lo = 0, hi = d->numBlocos;
+    while (hi - lo > 1) {
+        uint32_t meio = lo + (hi - lo) / 2;
+        if (compararReinicio(d, meio, pista, &chave, buf) >= 0) lo = meio;
+        else hi = meio;
+    }
+    const unsigned char *p = d->dados + d->reinicios[lo];
+    uint32_t fimBloco = (lo + 1) * DIC_TAM_BLOCO;
+    if (fimBloco > d->numEntradas) fimBloco = d->numEntradas;
+    int resultado = 0;
+    for (uint32_t i = lo * DIC_TAM_BLOCO; i < fimBloco; ++i) {
+        int contador;
+        decodificarEntrada(&p, buf, &contador);
+        if (strcmp(pista, buf) == 0) {
+            resultado = contador;
+            break;
+        }
+    }
+    descartarChave(&chave);
+    if (buf != local) free(buf);
+    return resultado;
+}
+
+/* percorrerDicionario: visita as entradas em ordem (mesma ordem de exibirPistasInOrder) */
+void percorrerDicionario(const DicionarioPistas *d, void (*visitar)(const char *pista, int contador, void *ctx), void *ctx) {
+    char *buf = (char *) malloc(d->maiorPista + 1);
+    if (!buf) {
+        fprintf(stderr, "Falha ao alocar memória para percurso do dicionário\n");
+        exit(EXIT_FAILURE);
+    }
+    const unsigned char *p = d->dados;
+    for (uint32_t i = 0; i < d->numEntradas; ++i) {
+        int contador;
+        decodificarEntrada(&p, buf, &contador);
+        visitar(buf, contador, ctx);
+    }
+    free(buf);
+}
+
+static void exibirEntradaDicionario(const char *pista, int contador, void *ctx) {
+    (void) ctx;
+    printf(" - \"%s\" (vezes coletada: %d)\n", pista, contador);
+}
+
+/* exibirDicionario: listagem idêntica à de exibirPistasInOrder */
+void exibirDicionario(const DicionarioPistas *d) {
+    percorrerDicionario(d, exibirEntradaDicionario, NULL);
+}
+
+/* serializarDicionario / carregarDicionario: a imagem em disco é a própria estrutura */
+void serializarDicionario(BufferBin *b, const DicionarioPistas *d) {
+    anexarU32Bin(b, d->numEntradas);
+    anexarU64Bin(b, d->tamDados);
+    anexarU64Bin(b, d->maiorPista);
+    anexarBin(b, d->reinicios, d->numBlocos * sizeof(uint32_t));
+    anexarBin(b, d->dados, d->tamDados);
+}
+
+/*
+ validarDadosDicionario: percorre uma imagem lida do disco conferindo cada entrada antes
+ que as buscas (sem conferência) a usem: varints dentro dos dados, prefixo que não excede
+ a entrada anterior (e nulo nos pontos de reinício), entrada que cabe em maiorPista e
+ pontos de reinício crescentes, dentro dos dados e no início do bloco correspondente.
+*/
+static int validarDadosDicionario(const DicionarioPistas *d) {
+    char *buf = (char *) malloc(d->maiorPista + 1);
+    if (!buf) {
+        fprintf(stderr, "Falha ao alocar memória para dicionário\n");
+        exit(EXIT_FAILURE);
+    }
+    const unsigned char *p = d->dados, *fim = d->dados + d->tamDados;
+    size_t tamAnterior = 0;
+    int ret = 0;
+    for (uint32_t i = 0; i < d->numEntradas && ret == 0; ++i) {
+        if (i % DIC_TAM_BLOCO == 0) {
+            uint32_t b = i / DIC_TAM_BLOCO;
+            if (d->reinicios[b] >= d->tamDados || (b > 0 && d->reinicios[b] <= d->reinicios[b - 1]) ||
+                d->reinicios[b] != (size_t) (p - d->dados)) {
+                ret = -1;
+                break;
+            }
+            tamAnterior = 0;
+        }
+        uint64_t prefixo, sufixo, contador;
+        if (lerVarintLimitado(&p, fim, &prefixo) != 0 || lerVarintLimitado(&p, fim, &sufixo) != 0 ||
+            prefixo > tamAnterior || sufixo > d->maiorPista - prefixo || sufixo > (uint64_t) (fim - p)) {
+            ret = -1;
+            break;
+        }
+        memcpy(buf + prefixo, p, (size_t) sufixo);
+        p += sufixo;
+        tamAnterior = (size_t) (prefixo + sufixo);
+        if (memchr(buf, '\0', tamAnterior) || lerVarintLimitado(&p, fim, &contador) != 0 || contador > INT32_MAX) {
+            ret = -1;
+        }
+    }
+    if (p != fim) ret = -1;
+    free(buf);
+    return ret;
+}
+
+DicionarioPistas *carregarDicionario(CursorBin *c) {
+    uint32_t numEntradas = lerU32Bin(c);
+    uint64_t tamDados = lerU64Bin(c);
+    uint64_t maiorPista = lerU64Bin(c);
+    uint32_t numBlocos = (numEntradas + DIC_TAM_BLOCO - 1) / DIC_TAM_BLOCO;
+    const void *reinicios = lerBin(c, numBlocos * sizeof(uint32_t));
+    const void *dados = lerBin(c, (size_t) tamDados);
+    if (!reinicios || !dados || maiorPista > tamDados) return NULL;     // nenhuma pista é maior que os dados
+    DicionarioPistas *d = (DicionarioPistas *) malloc(sizeof(DicionarioPistas));
+    if (d) {
+        d->reinicios = (uint32_t *) malloc(numBlocos * sizeof(uint32_t) + 1);
+        d->dados = (unsigned char *) malloc((size_t) tamDados + 1);
+    }
+    if (!d || !d->reinicios || !d->dados) {
+        fprintf(stderr, "Falha ao alocar memória para dicionário\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(d->reinicios, reinicios, numBlocos * sizeof(uint32_t));
+    memcpy(d->dados, dados, (size_t) tamDados);
+    d->numEntradas = numEntradas;
+    d->numBlocos = numBlocos;
+    d->tamDados = (size_t) tamDados;
+    d->maiorPista = (size_t) maiorPista;
+    if (validarDadosDicionario(d) != 0) {
+        free(d->reinicios);
+        free(d->dados);
+        free(d);
+        return NULL;
+    }
+    indexarReinicios(d);
+    return d;
+}
+
+/* benchDicionario: compara memória e busca da BST com o dicionário congelado */
+typedef struct VerificacaoOrdem {
+    char **esperadas;
+    size_t pos;
+    int divergencias;
+} VerificacaoOrdem;
+
+static void coletarEmOrdem(PistaNode *root, char **saida, size_t *n) {
+    if (!root) return;
+    coletarEmOrdem(root->esq, saida, n);
+    saida[(*n)++] = root->pista;
+    coletarEmOrdem(root->dir, saida, n);
+}
+
+static size_t bytesArvorePistas(PistaNode *root) {
+    if (!root) return 0;
+    /* nó + string + chave, cada um com ~16 bytes de cabeçalho do malloc */
+    return sizeof(PistaNode) + strlen(root->pista) + 1 + root->tamChave + 48 +
+           bytesArvorePistas(root->esq) + bytesArvorePistas(root->dir);
+}
+
+static void conferirOrdem(const char *pista, int contador, void *ctx) {
+    (void) contador;
+    VerificacaoOrdem *v = (VerificacaoOrdem *) ctx;
+    if (strcmp(pista, v->esperadas[v->pos++]) != 0) v->divergencias++;
+}
+
+int benchDicionario(size_t n) {
+    uint64_t semente = 7;
+    char pista[96];
+    char **consultas = (char **) malloc(n * sizeof(char *));
+    if (!consultas) return -1;
+    PistaNode *arvore = NULL;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t id = aleatorio(&semente) % (n * 4);
+        snprintf(pista, sizeof(pista), "pista numero %llu encontrada na sala %llu",
+                 (unsigned long long) id, (unsigned long long) (id % 131));
+        arvore = inserirPista(arvore, pista);
+        consultas[i] = strdup_safe(pista);
+    }
+    double t0 = agoraSegundos();
+    DicionarioPistas *d = construirDicionario(arvore);
+    double tConstrucao = agoraSegundos() - t0;
+
+    char **ordem = (char **) malloc(d->numEntradas * sizeof(char *));
+    size_t k = 0;
+    coletarEmOrdem(arvore, ordem, &k);
+    VerificacaoOrdem v = { ordem, 0, 0 };
+    percorrerDicionario(d, conferirOrdem, &v);
+
+    long somaA = 0, somaD = 0;
+    t0 = agoraSegundos();
+    for (size_t i = 0; i < n; ++i) somaA += buscarPista(arvore, consultas[i])->contador;
+    double tArvore = agoraSegundos() - t0;
+    t0 = agoraSegundos();
+    for (size_t i = 0; i < n; ++i) somaD += buscarDicionario(d, consultas[i]);
+    double tDic = agoraSegundos() - t0;
+
+    size_t bytesDic = d->tamDados + d->numBlocos * sizeof(uint32_t) + sizeof(*d) +
+                      d->inicioChaves[d->numBlocos] + (d->numBlocos + 1) * sizeof(uint32_t);
+    printf("%u pistas distintas; construção %.3f s\n", d->numEntradas, tConstrucao);
+    printf("Memória: BST ~%.1f MB, dicionário %.1f MB (%.1fx menor)\n",
+           (double) bytesArvorePistas(arvore) / 1048576.0, (double) bytesDic / 1048576.0,
+           (double) bytesArvorePistas(arvore) / (double) bytesDic);
+    printf("Busca: BST %.0f ns, dicionário %.0f ns por consulta\n",
+           tArvore * 1e9 / (double) n, tDic * 1e9 / (double) n);
+    printf("Ordem e contadores: %s\n", v.divergencias == 0 && somaA == somaD ? "idênticos" : "DIVERGENTES");
+
+    int ret = v.divergencias == 0 && somaA == somaD ? 0 : -1;
+    for (size_t i = 0; i < n; ++i) free(consultas[i]);
+    free(consultas);
+    free(ordem);
+    liberarDicionario(d);
+    liberarPistas(arvore);
+    return ret;
+}
+
+/* =========================
+   Expiração de sessões ociosas (roda de temporização hierárquica)
+   ========================= */
+/*
+ RODA_NIVEIS níveis de 64 baldes; o nível l cobre prazos de até 64^(l+1) ticks.
+ Reagendar uma sessão é remover/inserir em lista duplamente encadeada (O(1)); avançar
+ o relógio só visita o balde corrente do nível 0 e, quando ele dá a volta, redistribui
+ um único balde do nível seguinte. O custo de manutenção depende dos ticks e das
+ sessões que de fato vencem, nunca do total de sessões hospedadas.
+*/
+#define RODA_NIVEIS 4
+#define RODA_BITS 6
+#define RODA_BALDES (1u << RODA_BITS)
+#define RODA_HORIZONTE ((uint64_t) 1 << (RODA_BITS * RODA_NIVEIS))
+
+typedef struct NoTemporizador {
+    struct NoTemporizador *prox, *ant;      // lista circular do balde (NULL se não agendado)
+    uint64_t expira;
+} NoTemporizador;
+
+typedef struct RodaTemporizacao {
+    uint64_t agora;
+    size_t agendados;
+    NoTemporizador baldes[RODA_NIVEIS][RODA_BALDES];    // sentinelas
+} RodaTemporizacao;
+
+void iniciarRoda(RodaTemporizacao *r, uint64_t agora) {
+    r->agora = agora;
+    r->agendados = 0;
+    for (int l = 0; l < RODA_NIVEIS; ++l) {
+        for (unsigned b = 0; b < RODA_BALDES; ++b) {
+            r->baldes[l][b].prox = r->baldes[l][b].ant = &r->baldes[l][b];
+        }
+    }
+}
+
+void cancelarTemporizador(RodaTemporizacao *r, NoTemporizador *no) {
+    if (!no->prox) return;
+    no->ant->prox = no->prox;
+    no->prox->ant = no->ant;
+    no->prox = no->ant = NULL;
+    r->agendados--;
+}
+
+/* minimo: primeiro tick em que o nó ainda pode ser processado */
+static void inserirNaRoda(RodaTemporizacao *r, NoTemporizador *no, uint64_t minimo) {
+    uint64_t alvo = no->expira < minimo ? minimo : no->expira;
+    uint64_t delta = alvo - r->agora;
+    if (delta >= RODA_HORIZONTE) {          // além do horizonte: estaciona no último nível
+        delta = RODA_HORIZONTE - 1;
+        alvo = r->agora + delta;
+    }
+    int l = 0;
+    while (delta >= ((uint64_t) 1 << (RODA_BITS * (l + 1)))) l++;
+    NoTemporizador *cabeca = &r->baldes[l][(alvo >> (RODA_BITS * l)) & (RODA_BALDES - 1)];
+    no->prox = cabeca;
+    no->ant = cabeca->ant;
+    cabeca->ant->prox = no;
+    cabeca->ant = no;
+    r->agendados++;
+}
+
+/* agendarTemporizador: (re)agenda o nó para vencer no tick expira — O(1).
+   Prazos já vencidos disparam no próximo avanço do relógio. */
+void agendarTemporizador(RodaTemporizacao *r, NoTemporizador *no, uint64_t expira) {
+    cancelarTemporizador(r, no);
+    no->expira = expira;
+    inserirNaRoda(r, no, r->agora + 1);
+}
+
+/* redistribui um balde de nível superior pelos níveis de baixo */
+static void cascatearBalde(RodaTemporizacao *r, NoTemporizador *cabeca) {
+    NoTemporizador *no = cabeca->prox;
+    cabeca->prox = cabeca->ant = cabeca;
+    while (no != cabeca) {
+        NoTemporizador *prox = no->prox;
+        r->agendados--;
+        inserirNaRoda(r, no, r->agora);     // o balde corrente do nível 0 ainda será processado
+        no = prox;
+    }
+}
+
+/*
+ avancarRoda: move o relógio até o tick ate, chamando vencer(no, ctx) para cada
+ temporizador vencido (o nó já está desagendado quando o callback roda e pode ser
+ reagendado nele). Retorna quantos temporizadores venceram.
+*/
+size_t avancarRoda(RodaTemporizacao *r, uint64_t ate, void (*vencer)(NoTemporizador *no, void *ctx), void *ctx) {
+    size_t vencidos = 0;
+    while (r->agora < ate) {
+        if (r->agendados == 0) {            // nada agendado: salta direto
+            r->agora = ate;
+            break;
+        }
+        r->agora++;
+        for (int l = 1; l < RODA_NIVEIS; ++l) {
+            if (r->agora & (((uint64_t) 1 << (RODA_BITS * l)) - 1)) break;
+            cascatearBalde(r, &r->baldes[l][(r->agora >> (RODA_BITS * l)) & (RODA_BALDES - 1)]);
+        }
+        NoTemporizador *cabeca = &r->baldes[0][r->agora & (RODA_BALDES - 1)];
+        while (cabeca->prox != cabeca) {
+            NoTemporizador *no = cabeca->prox;
+            cancelarTemporizador(r, no);
+            if (no->expira > r->agora) {    // estacionado além do horizonte: ainda não venceu
+                inserirNaRoda(r, no, r->agora + 1);
+                continue;
+            }
+            vencidos++;
+            vencer(no, ctx);
+        }
+    }
+    return vencidos;
+}
+
+/* --- sessões hospedadas com expiração por inatividade --- */
+typedef struct SessaoHospedada {
+    Sessao sessao;
+    NoTemporizador temporizador;
+    int ativa;
+} SessaoHospedada;
+
+typedef struct HospedeiroSessoes {
+    RodaTemporizacao roda;
+    uint64_t ticksOcioso;           // prazo de inatividade
+    size_t ativas, expiradas;
+} HospedeiroSessoes;
+
+#define SESSAO_DO_TEMPORIZADOR(no) \
+    ((SessaoHospedada *) ((char *) (no) - offsetof(SessaoHospedada, temporizador)))
+
+void iniciarHospedeiro(HospedeiroSessoes *h, uint64_t agora, uint64_t ticksOcioso) {
+    iniciarRoda(&h->roda, agora);
+    h->ticksOcioso = ticksOcioso;
+    h->ativas = h->expiradas = 0;
+}
+
+/* abrirSessaoHospedada: inicia a sessão e agenda sua expiração */
+ResultadoPasso abrirSessaoHospedada(HospedeiroSessoes *h, SessaoHospedada *sh, Sala *inicio, size_t numSalas) {
+    sh->temporizador.prox = sh->temporizador.ant = NULL;
+    sh->ativa = 1;
+    h->ativas++;
+    agendarTemporizador(&h->roda, &sh->temporizador, h->roda.agora + h->ticksOcioso);
+    return iniciarSessao(&sh->sessao, inicio, numSalas);
+}
+
+/* passoHospedado: aplica o comando e adia a expiração (O(1)); sessões expiradas ficam encerradas */
+ResultadoPasso passoHospedado(HospedeiroSessoes *h, SessaoHospedada *sh, char comando) {
+    if (!sh->ativa) {
+        ResultadoPasso r = { PASSO_ENCERRADA, NULL, NULL };
+        return r;
+    }
+    agendarTemporizador(&h->roda, &sh->temporizador, h->roda.agora + h->ticksOcioso);
+    ResultadoPasso r = passoSessao(&sh->sessao, comando);
+    if (r.status == PASSO_INVALIDO) {
+        registrarLog("comando invalido %llu na sala %llu", (unsigned char) comando, sh->sessao.atual->id, 0, 0);
+    }
+    return r;
+}
+
+static void expirarSessao(NoTemporizador *no, void *ctx) {
+    HospedeiroSessoes *h = (HospedeiroSessoes *) ctx;
+    SessaoHospedada *sh = SESSAO_DO_TEMPORIZADOR(no);
+    registrarLog("sessao expirada na sala %llu com %llu pistas coletadas (tick %llu)", sh->sessao.atual->id,
+                 sh->sessao.coletadas.n, h->roda.agora, 0);
+    encerrarSessao(&sh->sessao);        // libera a BST de pistas (liberarPistas)
+    sh->ativa = 0;
+    h->ativas--;
+    h->expiradas++;
+}
+
+/* fecharSessaoHospedada: encerramento explícito (jogador saiu) */
+void fecharSessaoHospedada(HospedeiroSessoes *h, SessaoHospedada *sh) {
+    if (!sh->ativa) return;
+    cancelarTemporizador(&h->roda, &sh->temporizador);
+    encerrarSessao(&sh->sessao);
+    sh->ativa = 0;
+    h->ativas--;
+}
+
+/* manutencaoHospedeiro: avança o relógio e expira as sessões ociosas; retorna quantas expiraram */
+size_t manutencaoHospedeiro(HospedeiroSessoes *h, uint64_t agora) {
+    return avancarRoda(&h->roda, agora, expirarSessao, h);
+}
+
+/*
+ benchExpiracao: numSessoes sessões hospedadas; a cada tick uma fração delas recebe um
+ comando. Mede o custo da manutenção por tick, que não deve crescer com numSessoes.
+*/
+int benchExpiracao(size_t numSessoes, uint64_t ticks, uint64_t ticksOcioso) {
+    Sala *mansao = gerarMansaoSintetica(1023);
+    size_t n = numerarSalas(mansao);
+    SessaoHospedada *sessoes = (SessaoHospedada *) malloc(numSessoes * sizeof(SessaoHospedada));
+    if (!sessoes) {
+        fprintf(stderr, "Falha ao alocar memória para sessões\n");
+        exit(EXIT_FAILURE);
+    }
+    HospedeiroSessoes h;
+    iniciarHospedeiro(&h, 0, ticksOcioso);
+    for (size_t i = 0; i < numSessoes; ++i) abrirSessaoHospedada(&h, &sessoes[i], mansao, n);
+
+    uint64_t semente = 11, comandos = 0;
+    double tComandos = 0, tManutencao = 0;
+    size_t porTick = numSessoes / 100 + 1;
+    for (uint64_t t = 1; t <= ticks; ++t) {
+        double t0 = agoraSegundos();
+        for (size_t k = 0; k < porTick; ++k) {
+            /* atividade concentrada na primeira metade: a outra metade fica ociosa e expira */
+            SessaoHospedada *sh = &sessoes[aleatorio(&semente) % (numSessoes / 2 + 1)];
+            if (sh->ativa) {
+                passoHospedado(&h, sh, (aleatorio(&semente) & 1) ? 'e' : 'd');
+                comandos++;
+            }
+        }
+        double t1 = agoraSegundos();
+        manutencaoHospedeiro(&h, t);
+        tManutencao += agoraSegundos() - t1;
+        tComandos += t1 - t0;
+    }
+    printf("%zu sessões, %llu ticks: %zu expiradas, %zu ativas\n", numSessoes,
+           (unsigned long long) ticks, h.expiradas, h.ativas);
+    printf("Manutenção: %.2f us por tick (%.1f ns por sessão expirada); reagendamento: %.1f ns por comando\n",
+           tManutencao * 1e6 / (double) ticks, tManutencao * 1e9 / (double) (h.expiradas ? h.expiradas : 1),
+           tComandos * 1e9 / (double) (comandos ? comandos : 1));
+    for (size_t i = 0; i < numSessoes; ++i) fecharSessaoHospedada(&h, &sessoes[i]);
+    free(sessoes);
+    liberarSalas(mansao);
+    liberarHash();
+    return 0;
+}
+
+/* =========================
+   Mansão como grafo (adjacência CSR)
+   ========================= */
+/*
+ Generaliza o mapa: cada sala pode ter qualquer número de saídas (inclusive ciclos).
+ As portas ficam em formato CSR (compressed sparse row): as saídas da sala v são
+ destinos[inicioPortas[v] .. inicioPortas[v+1]), em um único vetor contíguo, na ordem
+ em que foram declaradas. Salas são identificadas por índices densos (uint32_t).
+*/
+typedef struct GrafoMansao {
+    uint32_t numSalas;
+    uint64_t numPortas;
+    uint64_t *inicioPortas;     // numSalas + 1 deslocamentos
+    uint32_t *destinos;         // numPortas destinos
+    char **nomes;               // por sala (NULL em grafos sintéticos)
+    char **pistas;              // por sala (NULL = sem pista)
+} GrafoMansao;
+
+static void *alocarGrafo(size_t n, size_t tam) {
+    return alocar_safe(NULL, n, tam, "grafo da mansão");
+}
+
+/*
+ construirGrafo: monta o CSR a partir de uma lista de portas (origem -> destino) por
+ contagem em duas passagens, O(salas + portas). A ordem das saídas de cada sala segue
+ a ordem da lista. Nomes e pistas começam vazios (ver definirSalaGrafo).
+*/
+GrafoMansao *construirGrafo(uint32_t numSalas, const uint32_t *origens, const uint32_t *destinos, uint64_t numPortas) {
+    GrafoMansao *g = (GrafoMansao *) alocarGrafo(1, sizeof(GrafoMansao));
+    g->numSalas = numSalas;
+    g->numPortas = numPortas;
+    g->inicioPortas = (uint64_t *) alocarGrafo((size_t) numSalas + 1, sizeof(uint64_t));
+    g->destinos = (uint32_t *) alocarGrafo((size_t) numPortas, sizeof(uint32_t));
+    g->nomes = (char **) alocarGrafo(numSalas, sizeof(char *));
+    g->pistas = (char **) alocarGrafo(numSalas, sizeof(char *));
+    for (uint64_t i = 0; i < numPortas; ++i) g->inicioPortas[origens[i] + 1]++;
+    for (uint32_t v = 0; v < numSalas; ++v) g->inicioPortas[v + 1] += g->inicioPortas[v];
+    uint64_t *cursor = (uint64_t *) alocarGrafo(numSalas, sizeof(uint64_t));
+    memcpy(cursor, g->inicioPortas, numSalas * sizeof(uint64_t));
+    for (uint64_t i = 0; i < numPortas; ++i) g->destinos[cursor[origens[i]]++] = destinos[i];
+    free(cursor);
+    return g;
+}
+
+void definirSalaGrafo(GrafoMansao *g, uint32_t sala, const char *nome, const char *pista) {
+    free(g->nomes[sala]);
+    free(g->pistas[sala]);
+    g->nomes[sala] = strdup_safe(nome);
+    g->pistas[sala] = strdup_safe(pista);
+}
+
+/* grafoDaArvore: converte o mapa binário (ids de numerarSalas); saída 0 = esq, 1 = dir */
+GrafoMansao *grafoDaArvore(Sala *raiz) {
+    size_t n;
+    Sala **salas = coletarSalasPreOrdem(raiz, &n);
+    uint32_t *origens = (uint32_t *) alocarGrafo(2 * n, sizeof(uint32_t));
+    uint32_t *destinos = (uint32_t *) alocarGrafo(2 * n, sizeof(uint32_t));
+    uint64_t m = 0;
+    for (size_t i = 0; i < n; ++i) salas[i]->id = (uint32_t) i;   // mesmos ids de numerarSalas
+    for (size_t i = 0; i < n; ++i) {
+        if (salas[i]->esq) { origens[m] = (uint32_t) i; destinos[m++] = salas[i]->esq->id; }
+        if (salas[i]->dir) { origens[m] = (uint32_t) i; destinos[m++] = salas[i]->dir->id; }
+    }
+    GrafoMansao *g = construirGrafo((uint32_t) n, origens, destinos, m);
+    for (size_t i = 0; i < n; ++i) definirSalaGrafo(g, (uint32_t) i, salas[i]->nome, salas[i]->pista);
+    free(origens);
+    free(destinos);
+    free(salas);
+    return g;
+}
+
+void liberarGrafo(GrafoMansao *g) {
+    if (!g) return;
+    for (uint32_t v = 0; v < g->numSalas; ++v) {
+        free(g->nomes[v]);
+        free(g->pistas[v]);
+    }
+    free(g->nomes);
+    free(g->pistas);
+    free(g->inicioPortas);
+    free(g->destinos);
+    free(g);
+}
+
+static inline uint32_t numSaidasGrafo(const GrafoMansao *g, uint32_t sala) {
+    return (uint32_t) (g->inicioPortas[sala + 1] - g->inicioPortas[sala]);
+}
+
+static inline const uint32_t *saidasGrafo(const GrafoMansao *g, uint32_t sala) {
+    return g->destinos + g->inicioPortas[sala];
+}
+
+/* --- roteamento por BFS --- */
+/*
+ Área de trabalho reutilizável: marcas por época evitam limpar vetores do tamanho do
+ grafo a cada busca (uma sala é "visitada" se marca[sala] == epoca).
+*/
+typedef struct BuscaGrafo {
+    uint32_t *marca, *pai, *fila;
+    uint32_t epoca;
+    uint32_t numSalas;
+} BuscaGrafo;
+
+void iniciarBuscaGrafo(BuscaGrafo *b, const GrafoMansao *g) {
+    b->numSalas = g->numSalas;
+    b->marca = (uint32_t *) alocarGrafo(g->numSalas, sizeof(uint32_t));
+    b->pai = (uint32_t *) alocarGrafo(g->numSalas, sizeof(uint32_t));
+    b->fila = (uint32_t *) alocarGrafo(g->numSalas, sizeof(uint32_t));
+    b->epoca = 0;
+}
+
+void liberarBuscaGrafo(BuscaGrafo *b) {
+    free(b->marca);
+    free(b->pai);
+    free(b->fila);
+}
+
+/*
+ rotaGrafo: menor caminho (em portas) de origem a destino. Grava até cap salas em
+ caminho (origem primeiro) e retorna o número de salas do caminho, ou 0 se inalcançável
+ (ou se origem/destino não forem salas do grafo). Com destino == UINT32_MAX, apenas
+ percorre tudo o que é alcançável e retorna quantas salas são.
+*/
+uint32_t rotaGrafo(const GrafoMansao *g, BuscaGrafo *b, uint32_t origem, uint32_t destino,
+                   uint32_t *caminho, uint32_t cap) {
+    if (origem >= g->numSalas || (destino != UINT32_MAX && destino >= g->numSalas)) return 0;
+    if (++b->epoca == 0) {              // a época deu a volta: limpa as marcas uma vez
+        memset(b->marca, 0, b->numSalas * sizeof(uint32_t));
+        b->epoca = 1;
+    }
+    uint32_t ini = 0, fim = 0;
+    b->marca[origem] = b->epoca;
+    b->pai[origem] = origem;
+    b->fila[fim++] = origem;
+    int achou = origem == destino;
+    while (ini < fim && !achou) {
+        uint32_t v = b->fila[ini++];
+        const uint32_t *saidas = saidasGrafo(g, v);
+        uint32_t k = numSaidasGrafo(g, v);
+        for (uint32_t i = 0; i < k; ++i) {
+            uint32_t w = saidas[i];
+            if (b->marca[w] == b->epoca) continue;
+            b->marca[w] = b->epoca;
+            b->pai[w] = v;
+            b->fila[fim++] = w;
+            if (w == destino) {         // para assim que o destino é descoberto
+                achou = 1;
+                break;
+            }
+        }
+    }
+    if (destino == UINT32_MAX) return fim;
+    if (b->marca[destino] != b->epoca) return 0;
+    uint32_t tam = 1;
+    for (uint32_t v = destino; v != origem; v = b->pai[v]) tam++;
+    uint32_t pos = tam;
+    for (uint32_t v = destino;; v = b->pai[v]) {
+        if (--pos < cap) caminho[pos] = v;
+        if (v == origem) break;
+    }
+    return tam;
+}
+
+/* --- sessão sobre o grafo --- */
+typedef struct ResultadoPassoGrafo {
+    StatusPasso status;
+    uint32_t sala;
+    const char *pistaNova;
+} ResultadoPassoGrafo;
+
+typedef struct SessaoGrafo {
+    const GrafoMansao *grafo;
+    uint32_t atual;
+    PistaNode *pistas;
+    ConjuntoIds coletadas;      // com ciclos, salas podem ser revisitadas
+    int encerrada;
+} SessaoGrafo;
+
+static ResultadoPassoGrafo entrarSalaGrafo(SessaoGrafo *s, uint32_t sala) {
+    ResultadoPassoGrafo r = { PASSO_OK, sala, NULL };
+    s->atual = sala;
+    const char *pista = s->grafo->pistas[sala];
+    if (pista && !contemConjunto(&s->coletadas, sala)) {
+        s->pistas = inserirPista(s->pistas, pista);
+        inserirConjunto(&s->coletadas, sala);
+        r.pistaNova = pista;
+    }
+    return r;
+}
+
+/* iniciarSessaoGrafo: sessão na sala inicio; uma sala inexistente devolve a sessão já encerrada */
+ResultadoPassoGrafo iniciarSessaoGrafo(SessaoGrafo *s, const GrafoMansao *g, uint32_t inicio) {
+    s->grafo = g;
+    s->pistas = NULL;
+    s->coletadas.ids = NULL;
+    s->coletadas.n = s->coletadas.cap = 0;
+    s->encerrada = inicio >= g->numSalas;
+    if (s->encerrada) {
+        ResultadoPassoGrafo r = { PASSO_ENCERRADA, 0, NULL };
+        s->atual = 0;
+        return r;
+    }
+    return entrarSalaGrafo(s, inicio);
+}
+
+/* passoGrafo: atravessa a porta de índice porta da sala atual (sem E/S) */
+ResultadoPassoGrafo passoGrafo(SessaoGrafo *s, uint32_t porta) {
+    ResultadoPassoGrafo r = { s->encerrada ? PASSO_ENCERRADA : PASSO_SEM_CAMINHO, s->atual, NULL };
+    if (s->encerrada || porta >= numSaidasGrafo(s->grafo, s->atual)) return r;
+    return entrarSalaGrafo(s, saidasGrafo(s->grafo, s->atual)[porta]);
+}
+
+void encerrarSessaoGrafo(SessaoGrafo *s) {
+    s->encerrada = 1;
+    liberarPistas(s->pistas);
+    liberarConjunto(&s->coletadas);
+    s->pistas = NULL;
+}
+
+/*
+ conferirSessaoGrafo: passeio aleatório de passos portas; com ciclos, cada pista deve
+ ser coletada uma única vez, na primeira visita à sua sala. Retorna as divergências.
+*/
+static size_t conferirSessaoGrafo(const GrafoMansao *g, size_t passos, uint64_t *semente) {
+    char *visitada = (char *) alocarGrafo(g->numSalas, 1);
+    SessaoGrafo s;
+    ResultadoPassoGrafo r = iniciarSessaoGrafo(&s, g, 0);
+    size_t divergencias = 0, novas = 0, esperadas = 0;
+    for (size_t i = 0;; ++i) {
+        int primeira = !visitada[r.sala];
+        visitada[r.sala] = 1;
+        if (primeira && g->pistas[r.sala]) esperadas++;
+        if (r.pistaNova) novas++;
+        if ((r.pistaNova != NULL) != (primeira && g->pistas[r.sala] != NULL)) divergencias++;
+        if (i == passos) break;
+        uint32_t k = numSaidasGrafo(g, s.atual);
+        r = passoGrafo(&s, k ? (uint32_t) (aleatorio(semente) % k) : 0);
+        if (r.status != (k ? PASSO_OK : PASSO_SEM_CAMINHO)) divergencias++;
+    }
+    if (novas != esperadas || contarNosPistas(s.pistas) != esperadas) divergencias++;
+    encerrarSessaoGrafo(&s);
+    if (passoGrafo(&s, 0).status != PASSO_ENCERRADA) divergencias++;
+    free(visitada);
+    return divergencias;
+}
+
+/*
+ conferirArvoreComoGrafo: a mesma sequência de comandos na árvore (passoSessao) e no
+ grafo de grafoDaArvore (porta 0 = primeira saída existente) leva às mesmas salas e
+ pistas. Retorna as divergências.
+*/
+static size_t conferirArvoreComoGrafo(size_t numSalas, size_t passos, uint64_t *semente) {
+    Sala *mansao = gerarMansaoSintetica(numSalas);
+    GrafoMansao *g = grafoDaArvore(mansao);
+    size_t divergencias = 0;
+    for (int rodada = 0; rodada < 8; ++rodada) {
+        Sessao arvore;
+        SessaoGrafo grafo;
+        ResultadoPasso ra = iniciarSessao(&arvore, mansao, numSalas);
+        ResultadoPassoGrafo rg = iniciarSessaoGrafo(&grafo, g, 0);
+        for (size_t i = 0;; ++i) {
+            const char *pa = ra.pistaNova, *pg = rg.pistaNova;
+            if (ra.sala->id != rg.sala || (pa == NULL) != (pg == NULL) || (pa && strcmp(pa, pg) != 0)) {
+                divergencias++;
+                break;
+            }
+            if (i == passos || ra.status == PASSO_SEM_CAMINHO) break;
+            char comando = (aleatorio(semente) & 1) ? 'd' : 'e';
+            const Sala *atual = ra.sala;
+            uint32_t porta = (comando == 'd' && atual->esq) ? 1 : 0;
+            ra = passoSessao(&arvore, comando);
+            rg = (comando == 'e' ? atual->esq : atual->dir) ? passoGrafo(&grafo, porta)
+                                                              : (ResultadoPassoGrafo) { PASSO_SEM_CAMINHO, grafo.atual, NULL };
+        }
+        if (contarNosPistas(arvore.pistas) != contarNosPistas(grafo.pistas)) divergencias++;
+        encerrarSessao(&arvore);
+        encerrarSessaoGrafo(&grafo);
+    }
+    liberarGrafo(g);
+    liberarSalas(mansao);
+    liberarHash();
+    return divergencias;
+}
+
+/*
+ benchGrafo: grafo aleatório com numSalas salas e grau médio grau (com ciclos). Mede a
+ construção do CSR, a vazão da BFS completa (portas/s) e rotas ponto a ponto; depois
+ confere sessões no grafo com ciclos e o grafo da árvore contra a sessão na árvore.
+*/
+int benchGrafo(uint32_t numSalas, uint32_t grau) {
+    if (numSalas == 0) {
+        fprintf(stderr, "Uso: --bench-grafo <salas> <grau>, salas maior que zero\n");
+        return -1;
+    }
+    uint64_t m = (uint64_t) numSalas * grau, semente = 5;
+    uint32_t *origens = (uint32_t *) alocarGrafo((size_t) m, sizeof(uint32_t));
+    uint32_t *destinos = (uint32_t *) alocarGrafo((size_t) m, sizeof(uint32_t));
+    for (uint64_t i = 0; i < m; ++i) {
+        origens[i] = (uint32_t) (aleatorio(&semente) % numSalas);
+        destinos[i] = (uint32_t) (aleatorio(&semente) % numSalas);
+    }
+    double t0 = agoraSegundos();
+    GrafoMansao *g = construirGrafo(numSalas, origens, destinos, m);
+    double tConstrucao = agoraSegundos() - t0;
+    free(origens);
+    free(destinos);
+
+    BuscaGrafo b;
+    iniciarBuscaGrafo(&b, g);
+    t0 = agoraSegundos();
+    uint32_t alcancaveis = rotaGrafo(g, &b, 0, UINT32_MAX, NULL, 0);
+    double tBfs = agoraSegundos() - t0;
+
+    uint32_t caminho[64];
+    uint64_t somaTam = 0;
+    int rotas = 20;
+    t0 = agoraSegundos();
+    for (int i = 0; i < rotas; ++i) {
+        somaTam += rotaGrafo(g, &b, (uint32_t) (aleatorio(&semente) % numSalas),
+                             (uint32_t) (aleatorio(&semente) % numSalas), caminho, 64);
+    }
+    double tRotas = agoraSegundos() - t0;
+
+    printf("%u salas, %llu portas: CSR em %.3f s (%.1f MB)\n", numSalas, (unsigned long long) m, tConstrucao,
+           (double) (m * sizeof(uint32_t) + ((uint64_t) numSalas + 1) * sizeof(uint64_t)) / 1048576.0);
+    printf("BFS completa: %u salas alcançáveis em %.3f s (%.1f M portas/s)\n", alcancaveis, tBfs,
+           (double) m / tBfs / 1e6);
+    printf("Rotas: %.2f ms por rota, %.1f salas em média\n", tRotas * 1e3 / rotas, (double) somaTam / rotas);
+
+    char nome[32], pista[48];
+    for (uint32_t v = 0; v < numSalas; v += 7) {
+        snprintf(nome, sizeof(nome), "Sala %u", v);
+        snprintf(pista, sizeof(pista), "pista da sala %u", v);
+        definirSalaGrafo(g, v, nome, pista);
+    }
+    size_t divergencias = 0;
+    if (numSalas > 0) divergencias += conferirSessaoGrafo(g, 4 * (size_t) numSalas, &semente);
+    if (rotaGrafo(g, &b, 0, numSalas, caminho, 64) != 0) divergencias++;     // destino fora do grafo
+    divergencias += conferirArvoreComoGrafo(numSalas < 4095 ? (numSalas ? numSalas : 1) : 4095, 64, &semente);
+    printf("Conferência (sessão com ciclos, árvore como grafo): %s\n", divergencias ? "DIVERGENTE" : "ok");
+    liberarBuscaGrafo(&b);
+    liberarGrafo(g);
+    return divergencias ? -1 : 0;
+}
+
+/* =========================
+   Resumos de evidências por subárvore
+   ========================= */
+/*
+ Para cada sala, quantas pistas de cada suspeito existem na subárvore que começa nela
+ (a própria sala incluída). Como a navegação só desce, isso é exatamente o que ainda
+ pode ser coletado a partir dali. Construído uma vez de baixo para cima em
+ O(salas x suspeitos); consultas são O(1) por suspeito e edições de pista ou novas
+ salas atualizam apenas o caminho até a raiz. As colunas são os ids do registro de
+ suspeitos.
+ O resumo construído por último fica ativo (resumoEvidenciasAtivo): quando inserirNaHash
+ reatribui uma pista a outro suspeito, as salas com essa pista (encontradas por um
+ índice texto -> salas) trocam de coluna e os ancestrais são corrigidos.
+*/
+
+struct ResumoEvidencias {
+    uint32_t numSalas, capSalas;
+    uint32_t numSuspeitos;      // colunas = ids de registroSuspeitos já conhecidos
+    uint32_t *contagem;         // capSalas x numSuspeitos, linha = id da sala
+    uint32_t *pai;              // id do pai (SEM_SUSPEITO na raiz)
+    uint32_t *suspeitoDaSala;   // coluna do suspeito apontado pela pista da sala
+    Sala **salas;               // id -> sala
+    uint32_t *primeiraComPista; // balde (hash do texto da pista) -> primeira sala, ou SEM_SUSPEITO
+    uint32_t *proximaComPista;  // sala -> próxima sala do mesmo balde
+    uint32_t mascaraBaldes;     // número de baldes - 1 (potência de 2)
+};
+
+ResumoEvidencias *resumoEvidenciasAtivo = NULL;
+
+static void *alocarResumo(size_t n, size_t tam) {
+    return alocar_safe(NULL, n, tam, "resumo de evidências");
+}
+
+/* indiceSuspeitoResumo: coluna do suspeito (SEM_SUSPEITO se desconhecido) */
+uint32_t indiceSuspeitoResumo(const ResumoEvidencias *r, const char *nome) {
+    uint32_t s = buscarIdSuspeito(nome);
+    return s < r->numSuspeitos ? s : SEM_SUSPEITO;
+}
+
+/* alarga a matriz (colunas zeradas) para os suspeitos registrados depois da construção */
+static void alargarResumo(ResumoEvidencias *r) {
+    uint32_t ns = r->numSuspeitos, novo = registroSuspeitos.num;
+    uint32_t *nova = (uint32_t *) alocarResumo((size_t) r->capSalas * novo, sizeof(uint32_t));
+    for (uint32_t v = 0; v < r->numSalas; ++v) {
+        memcpy(nova + (size_t) v * novo, r->contagem + (size_t) v * ns, ns * sizeof(uint32_t));
+    }
+    free(r->contagem);
+    r->contagem = nova;
+    r->numSuspeitos = novo;
+}
+
+static uint32_t suspeitoDaPista(ResumoEvidencias *r, const char *pista) {
+    HashEntry *e = pista ? buscarEntradaHash(pista) : NULL;
+    if (!e) return SEM_SUSPEITO;
+    if (e->idSuspeito >= r->numSuspeitos) alargarResumo(r);
+    return e->idSuspeito;
+}
+
+/* --- índice texto da pista -> salas (para reatribuições feitas pela tabela hash) --- */
+static void ligarSalaPorPista(ResumoEvidencias *r, uint32_t sala) {
+    if (!r->salas[sala]->pista) return;
+    uint32_t b = (uint32_t) hash_djb2(r->salas[sala]->pista) & r->mascaraBaldes;
+    r->proximaComPista[sala] = r->primeiraComPista[b];
+    r->primeiraComPista[b] = sala;
+}
+
+static void desligarSalaPorPista(ResumoEvidencias *r, uint32_t sala) {
+    if (!r->salas[sala]->pista) return;
+    uint32_t *ligacao = &r->primeiraComPista[(uint32_t) hash_djb2(r->salas[sala]->pista) & r->mascaraBaldes];
+    while (*ligacao != SEM_SUSPEITO && *ligacao != sala) ligacao = &r->proximaComPista[*ligacao];
+    if (*ligacao == sala) *ligacao = r->proximaComPista[sala];
+}
+
+/* refaz os baldes com o dobro do tamanho quando há mais salas que baldes */
+static void redimensionarBaldesResumo(ResumoEvidencias *r) {
+    uint32_t baldes = 16;
+    while (baldes < r->capSalas) baldes *= 2;
+    if (r->primeiraComPista && baldes == r->mascaraBaldes + 1) return;
+    free(r->primeiraComPista);
+    r->primeiraComPista = (uint32_t *) alocarResumo(baldes, sizeof(uint32_t));
+    memset(r->primeiraComPista, 0xFF, baldes * sizeof(uint32_t));
+    r->mascaraBaldes = baldes - 1;
+    for (uint32_t v = 0; v < r->numSalas; ++v) ligarSalaPorPista(r, v);
+}
+
+/* soma delta à coluna s de sala e de todos os seus ancestrais */
+static void propagarResumo(ResumoEvidencias *r, uint32_t sala, uint32_t s, int delta) {
+    if (s == SEM_SUSPEITO) return;
+    for (uint32_t v = sala; v != SEM_SUSPEITO; v = r->pai[v]) {
+        r->contagem[(size_t) v * r->numSuspeitos + s] += (uint32_t) delta;
+    }
+}
+
+/* construirResumo: numera as salas (como numerarSalas) e agrega de baixo para cima */
+ResumoEvidencias *construirResumo(Sala *raiz) {
+    ResumoEvidencias *r = (ResumoEvidencias *) alocarResumo(1, sizeof(ResumoEvidencias));
+    size_t n;
+    r->salas = coletarSalasPreOrdem(raiz, &n);
+    r->numSalas = r->capSalas = (uint32_t) n;
+    r->pai = (uint32_t *) alocarResumo(n, sizeof(uint32_t));
+    r->suspeitoDaSala = (uint32_t *) alocarResumo(n, sizeof(uint32_t));
+    for (uint32_t v = 0; v < n; ++v) {
+        r->salas[v]->id = v;
+        r->pai[v] = SEM_SUSPEITO;
+    }
+    for (uint32_t v = 0; v < n; ++v) {
+        if (r->salas[v]->esq) r->pai[r->salas[v]->esq->id] = v;
+        if (r->salas[v]->dir) r->pai[r->salas[v]->dir->id] = v;
+    }
+    r->numSuspeitos = registroSuspeitos.num;
+    for (uint32_t v = 0; v < n; ++v) {
+        HashEntry *e = r->salas[v]->pista ? buscarEntradaHash(r->salas[v]->pista) : NULL;
+        r->suspeitoDaSala[v] = e ? e->idSuspeito : SEM_SUSPEITO;
+    }
+    r->proximaComPista = (uint32_t *) alocarResumo(n, sizeof(uint32_t));
+    redimensionarBaldesResumo(r);
+    uint32_t ns = r->numSuspeitos;
+    r->contagem = (uint32_t *) alocarResumo(n * ns, sizeof(uint32_t));
+    /* em pré-ordem todo filho tem id maior que o pai: percorrer ao contrário agrega de baixo para cima */
+    for (uint32_t v = (uint32_t) n; v-- > 0;) {
+        uint32_t *linha = r->contagem + (size_t) v * ns;
+        if (r->suspeitoDaSala[v] != SEM_SUSPEITO) linha[r->suspeitoDaSala[v]]++;
+        if (r->pai[v] != SEM_SUSPEITO) {
+            uint32_t *linhaPai = r->contagem + (size_t) r->pai[v] * ns;
+            for (uint32_t s = 0; s < ns; ++s) linhaPai[s] += linha[s];
+        }
+    }
+    resumoEvidenciasAtivo = r;
+    return r;
+}
+
+void liberarResumo(ResumoEvidencias *r) {
+    if (!r) return;
+    if (resumoEvidenciasAtivo == r) resumoEvidenciasAtivo = NULL;
+    free(r->primeiraComPista);
+    free(r->proximaComPista);
+    free(r->contagem);
+    free(r->pai);
+    free(r->suspeitoDaSala);
+    free(r->salas);
+    free(r);
+}
+
+/* pistasNaSubarvore: pistas do suspeito s na subárvore da sala (O(1)) */
+static inline uint32_t pistasNaSubarvore(const ResumoEvidencias *r, uint32_t sala, uint32_t s) {
+    return r->contagem[(size_t) sala * r->numSuspeitos + s];
+}
+
+/*
+ pistasAindaAlcancaveis: pistas do suspeito s que a sessão ainda pode coletar a partir
+ da sala atual (a subárvore, descontada a pista da própria sala se já coletada).
+*/
+uint32_t pistasAindaAlcancaveis(const ResumoEvidencias *r, const Sessao *sessao, uint32_t s) {
+    uint32_t id = sessao->atual->id;
+    uint32_t total = pistasNaSubarvore(r, id, s);
+    if (r->suspeitoDaSala[id] == s && pistaColetadaNaSessao(sessao, sessao->atual)) total--;
+    return total;
+}
+
+/* contarColetadasPorSuspeito: preenche jaApontam[s] a partir da BST da sessão (O(pistas)) */
+static void somarColetadas(const ResumoEvidencias *r, PistaNode *no, uint32_t *jaApontam) {
+    if (!no) return;
+    HashEntry *e = buscarEntradaHash(no->pista);
+    if (e && e->idSuspeito < r->numSuspeitos) jaApontam[e->idSuspeito] += (uint32_t) no->contador;
+    somarColetadas(r, no->esq, jaApontam);
+    somarColetadas(r, no->dir, jaApontam);
+}
+
+void contarColetadasPorSuspeito(const ResumoEvidencias *r, const Sessao *sessao, uint32_t *jaApontam) {
+    memset(jaApontam, 0, r->numSuspeitos * sizeof(uint32_t));
+    somarColetadas(r, sessao->pistas, jaApontam);
+}
+
+/*
+ acusacaoAindaPossivel: "ainda dá para sustentar (>= minimo pistas) uma acusação contra s
+ daqui?" — O(1) dado jaApontam (mantido pelo hospedeiro a cada pista nova).
+*/
+int acusacaoAindaPossivel(const ResumoEvidencias *r, const Sessao *sessao, uint32_t s,
+                          uint32_t jaApontam, uint32_t minimo) {
+    return jaApontam + pistasAindaAlcancaveis(r, sessao, s) >= minimo;
+}
+
+/* --- manutenção incremental --- */
+/* alterarPistaSala: troca (ou remove, com NULL) a pista da sala e atualiza os ancestrais */
+void alterarPistaSala(ResumoEvidencias *r, Sala *sala, const char *novaPista) {
+    uint32_t antes = r->suspeitoDaSala[sala->id];
+    uint32_t depois = suspeitoDaPista(r, novaPista);
+    char *copia = novaPista ? strdup_safe(novaPista) : NULL;     // novaPista pode ser a própria sala->pista
+    desligarSalaPorPista(r, sala->id);
+    free(sala->pista);
+    sala->pista = copia;
+    ligarSalaPorPista(r, sala->id);
+    propagarResumo(r, sala->id, antes, -1);
+    propagarResumo(r, sala->id, depois, +1);
+    r->suspeitoDaSala[sala->id] = depois;
+}
+
+/*
+ pistaReatribuidaResumo: chamada por inserirNaHash (e ao desfazer inserções, quando a pista
+ pode voltar a não ter suspeito); move as salas com a pista para a nova coluna
+*/
+void pistaReatribuidaResumo(ResumoEvidencias *r, const char *pista, uint32_t idSuspeito) {
+    uint32_t b = (uint32_t) hash_djb2(pista) & r->mascaraBaldes;
+    for (uint32_t v = r->primeiraComPista[b]; v != SEM_SUSPEITO; v = r->proximaComPista[v]) {
+        if (strcmp(r->salas[v]->pista, pista) != 0 || r->suspeitoDaSala[v] == idSuspeito) continue;
+        if (idSuspeito != SEM_SUSPEITO && idSuspeito >= r->numSuspeitos) alargarResumo(r);
+        propagarResumo(r, v, r->suspeitoDaSala[v], -1);
+        propagarResumo(r, v, idSuspeito, +1);
+        r->suspeitoDaSala[v] = idSuspeito;
+    }
+}
+
+/* anexarSalaResumo: liga uma sala nova (folha) como filho esq (lado 0) ou dir (lado 1) */
+void anexarSalaResumo(ResumoEvidencias *r, Sala *pai, Sala *nova, int lado) {
+    if (r->numSalas == r->capSalas) {
+        uint32_t cap = r->capSalas ? r->capSalas * 2 : 8;
+        r->contagem = (uint32_t *) realloc(r->contagem, (size_t) cap * (r->numSuspeitos ? r->numSuspeitos : 1) * sizeof(uint32_t));
+        r->pai = (uint32_t *) realloc(r->pai, cap * sizeof(uint32_t));
+        r->suspeitoDaSala = (uint32_t *) realloc(r->suspeitoDaSala, cap * sizeof(uint32_t));
+        r->salas = (Sala **) realloc(r->salas, cap * sizeof(Sala *));
+        r->proximaComPista = (uint32_t *) realloc(r->proximaComPista, cap * sizeof(uint32_t));
+        if (!r->contagem || !r->pai || !r->suspeitoDaSala || !r->salas || !r->proximaComPista) {
+            fprintf(stderr, "Falha ao alocar memória para resumo de evidências\n");
+            exit(EXIT_FAILURE);
+        }
+        r->capSalas = cap;
+    }
+    if (lado == 0) pai->esq = nova;
+    else pai->dir = nova;
+    uint32_t id = r->numSalas++;
+    nova->id = id;
+    r->salas[id] = nova;
+    r->pai[id] = pai->id;
+    r->suspeitoDaSala[id] = SEM_SUSPEITO;
+    memset(r->contagem + (size_t) id * r->numSuspeitos, 0, r->numSuspeitos * sizeof(uint32_t));
+    uint32_t s = suspeitoDaPista(r, nova->pista);
+    r->suspeitoDaSala[id] = s;
+    propagarResumo(r, id, s, +1);
+    ligarSalaPorPista(r, id);
+    redimensionarBaldesResumo(r);
+}
+
+/* contagem direta na subárvore (referência para conferência e benchmark) */
+static uint32_t contarSubarvoreDireto(Sala *sala, const char *suspeito) {
+    if (!sala) return 0;
+    const char *sus = sala->pista ? encontrarSuspeito(sala->pista) : NULL;
+    return (sus && strcmp(sus, suspeito) == 0) +
+           contarSubarvoreDireto(sala->esq, suspeito) + contarSubarvoreDireto(sala->dir, suspeito);
+}
+
+int benchResumo(size_t numSalas) {
+    if (numSalas == 0) {
+        fprintf(stderr, "Uso: --bench-resumo <salas>, salas maior que zero\n");
+        return -1;
+    }
+    Sala *mansao = gerarMansaoSintetica(numSalas);
+    double t0 = agoraSegundos();
+    ResumoEvidencias *r = construirResumo(mansao);
+    double tConstrucao = agoraSegundos() - t0;
+
+    uint64_t semente = 9;
+    int consultas = r->numSuspeitos ? 2000 : 0, divergencias = 0;
+    uint64_t soma = 0;
+    double tResumo = 0, tDireto = 0;
+    for (int i = 0; i < consultas; ++i) {
+        uint32_t sala = (uint32_t) (aleatorio(&semente) % (numSalas < 64 ? numSalas : 64));  // salas altas: subárvores grandes
+        uint32_t s = (uint32_t) (aleatorio(&semente) % r->numSuspeitos);
+        double ti = agoraSegundos();
+        uint32_t a = pistasNaSubarvore(r, sala, s);
+        tResumo += agoraSegundos() - ti;
+        if (i < 50) {
+            ti = agoraSegundos();
+            uint32_t b = contarSubarvoreDireto(r->salas[sala], registroSuspeitos.nomes[s]);
+            tDireto += agoraSegundos() - ti;
+            if (a != b) divergencias++;
+        }
+        soma += a;
+    }
+    /* edições incrementais: troca pistas e confere contra a contagem direta */
+    for (int i = 0; i < 100; ++i) {
+        Sala *sala = r->salas[aleatorio(&semente) % r->numSalas];
+        const char *nova = r->salas[aleatorio(&semente) % r->numSalas]->pista;
+        alterarPistaSala(r, sala, nova);
+    }
+    /* reatribuições pela tabela hash: a pista continua na sala, mas aponta para outro suspeito */
+    for (int i = 0; i < 20; ++i) {
+        Sala *sala = r->salas[aleatorio(&semente) % r->numSalas];
+        if (!sala->pista || r->numSuspeitos == 0) continue;
+        inserirNaHash(sala->pista, registroSuspeitos.nomes[aleatorio(&semente) % r->numSuspeitos]);
+    }
+    /* sala nova numa folha, com pista de um suspeito ainda sem coluna */
+    Sala *folha = r->salas[r->numSalas - 1];
+    inserirNaHash("pista da sala anexada", "Suspeito Anexado");
+    anexarSalaResumo(r, folha, criarSala("Sala anexada", "pista da sala anexada"), 0);
+    for (uint32_t s = 0; s < r->numSuspeitos; ++s) {
+        if (s >= 10 && s != r->numSuspeitos - 1) continue;
+        if (pistasNaSubarvore(r, 0, s) != contarSubarvoreDireto(mansao, registroSuspeitos.nomes[s])) divergencias++;
+    }
+    printf("%zu salas, %u suspeitos: resumo em %.3f s (%.1f MB)\n", numSalas, r->numSuspeitos, tConstrucao,
+           (double) r->numSalas * r->numSuspeitos * sizeof(uint32_t) / 1048576.0);
+    printf("Consulta: resumo %.0f ns, varredura da subárvore %.0f us (%llu)\n",
+           tResumo * 1e9 / consultas, tDireto * 1e6 / 50, (unsigned long long) soma);
+    printf("Conferência com a varredura direta (inclui edições): %s\n", divergencias ? "DIVERGENTE" : "ok");
+    liberarResumo(r);
+    liberarSalas(mansao);
+    liberarHash();
+    return divergencias ? -1 : 0;
+}
+
+/* =========================
+   Regras de acusação compiladas
+   ========================= */
+/*
+ Gramática (espaços ignorados):
+   expr   := termo ('|' termo)*
+   termo  := fator ('&' fator)*
+   fator  := '!' fator | '(' expr ')' | "pista" | '@' "suspeito" '>=' N
+ "pista" é verdadeiro se a pista foi coletada; @"X">=N se ao menos N pistas distintas
+ coletadas apontam para X. A expressão vira uma árvore (NoRegra), que é compilada
+ para bytecode pós-fixo. A VM usa uma pilha de bits num único uint64_t e só lê
+ o conjunto de pistas da sessão (bitset indexado por HashEntry::id): nada é alocado
+ por avaliação. '&' e '|' viram saltos condicionais que deixam o operando na pilha
+ (A & B = A; SE_FALSO fim; B; fim:), de modo que um conjunto que já falhou não avalia
+ o resto. @"X">=N conta as pistas da sessão (lista de ids coletados, em geral poucas)
+ pela tabela pista -> suspeito citado, em vez de varrer uma máscara do tamanho do catálogo.
+*/
+#define REGRA_PILHA_MAX 64
+#define REGRA_ARG_MAX (1u << 28)        // argumentos ocupam os 28 bits altos da instrução
+
+typedef enum {
+    REGRA_PISTA,        // arg = id da pista
+    REGRA_SUSPEITO,     // arg = índice da máscara; palavra seguinte = mínimo
+    REGRA_E,
+    REGRA_OU,
+    REGRA_NAO,
+    REGRA_SE_FALSO,     // arg = destino; salta se o topo é 0 (mantendo-o), senão desempilha
+    REGRA_SE_VERDADE    // arg = destino; salta se o topo é 1 (mantendo-o), senão desempilha
+} OpRegra;
+
+typedef struct NoRegra {
+    OpRegra op;
+    uint32_t arg;
+    uint32_t minimo;
+    struct NoRegra *a, *b;
+} NoRegra;
+
+typedef struct RegraCompilada {
+    uint32_t *codigo;       // instruções: op nos 4 bits baixos, argumento nos 28 altos
+    size_t tam;
+    uint64_t *mascaras;     // numMascaras x palavras: pistas de cada suspeito citado
+    uint32_t numMascaras;
+    size_t palavras;        // tamanho do bitset de pistas em uint64_t
+    uint32_t *mascaraDaPista;   // id de pista -> máscara do seu suspeito (SEM_SUSPEITO se não citado)
+    uint32_t numIds;            // ids de pista cobertos por mascaraDaPista
+} RegraCompilada;
+
+typedef struct LeitorRegra {
+    const char *p;
+    const char *erro;
+    uint32_t *suspeitos;    // ids dos suspeitos citados (índice = máscara; SEM_SUSPEITO se desconhecido)
+    uint32_t numSuspeitos;
+} LeitorRegra;
+
+static NoRegra *novoNoRegra(OpRegra op, NoRegra *a, NoRegra *b) {
+    NoRegra *n = (NoRegra *) calloc(1, sizeof(NoRegra));
+    if (!n) {
+        fprintf(stderr, "Falha ao alocar memória para regra\n");
+        exit(EXIT_FAILURE);
+    }
+    n->op = op;
+    n->a = a;
+    n->b = b;
+    return n;
+}
+
+void liberarArvoreRegra(NoRegra *n) {
+    if (!n) return;
+    liberarArvoreRegra(n->a);
+    liberarArvoreRegra(n->b);
+    free(n);
+}
+
+static void pularEspacosRegra(LeitorRegra *l) {
+    while (isspace((unsigned char) *l->p)) l->p++;
+}
+
+/* lerTextoRegra: lê "..." (aceita \" e \\) para um buffer novo */
+static char *lerTextoRegra(LeitorRegra *l) {
+    pularEspacosRegra(l);
+    if (*l->p != '"') {
+        l->erro = "esperava texto entre aspas";
+        return NULL;
+    }
+    const char *ini = ++l->p;
+    size_t n = 0;
+    while (*l->p && *l->p != '"') {
+        if (*l->p == '\\' && l->p[1]) l->p++;
+        l->p++;
+        n++;
+    }
+    if (*l->p != '"') {
+        l->erro = "aspas não fechadas";
+        return NULL;
+    }
+    char *s = (char *) malloc(n + 1);
+    if (!s) {
+        fprintf(stderr, "Falha ao alocar memória para regra\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t k = 0;
+    for (const char *q = ini; q < l->p; ++q) {
+        if (*q == '\\' && q + 1 < l->p) q++;
+        s[k++] = *q;
+    }
+    s[k] = '\0';
+    l->p++;
+    return s;
+}
+
+static NoRegra *lerExprRegra(LeitorRegra *l);
+
+static NoRegra *lerFatorRegra(LeitorRegra *l) {
+    pularEspacosRegra(l);
+    if (*l->p == '!') {
+        l->p++;
+        NoRegra *a = lerFatorRegra(l);
+        return a ? novoNoRegra(REGRA_NAO, a, NULL) : NULL;
+    }
+    if (*l->p == '(') {
+        l->p++;
+        NoRegra *a = lerExprRegra(l);
+        if (!a) return NULL;
+        pularEspacosRegra(l);
+        if (*l->p != ')') {
+            l->erro = "esperava ')'";
+            liberarArvoreRegra(a);
+            return NULL;
+        }
+        l->p++;
+        return a;
+    }
+    if (*l->p == '@') {
+        l->p++;
+        char *nome = lerTextoRegra(l);
+        if (!nome) return NULL;
+        pularEspacosRegra(l);
+        if (l->p[0] != '>' || l->p[1] != '=') {
+            l->erro = "esperava '>=' após o suspeito";
+            free(nome);
+            return NULL;
+        }
+        l->p += 2;
+        pularEspacosRegra(l);
+        if (!isdigit((unsigned char) *l->p)) {
+            l->erro = "esperava um número";
+            free(nome);
+            return NULL;
+        }
+        uint32_t minimo = (uint32_t) strtoul(l->p, (char **) &l->p, 10);
+        uint32_t id = buscarIdSuspeito(nome), s = 0;
+        free(nome);
+        while (s < l->numSuspeitos && l->suspeitos[s] != id) s++;
+        if (s >= REGRA_ARG_MAX) {
+            l->erro = "suspeitos demais para a instrução";
+            return NULL;
+        }
+        NoRegra *n = novoNoRegra(REGRA_SUSPEITO, NULL, NULL);
+        n->minimo = minimo;
+        if (s == l->numSuspeitos) {
+            l->suspeitos = (uint32_t *) realloc(l->suspeitos, (s + 1) * sizeof(uint32_t));
+            if (!l->suspeitos) {
+                fprintf(stderr, "Falha ao alocar memória para regra\n");
+                exit(EXIT_FAILURE);
+            }
+            l->suspeitos[l->numSuspeitos++] = id;
+        }
+        n->arg = s;
+        return n;
+    }
+    char *pista = lerTextoRegra(l);
+    if (!pista) return NULL;
+    HashEntry *e = buscarEntradaHash(pista);
+    free(pista);
+    if (!e) {
+        l->erro = "pista desconhecida";
+        return NULL;
+    }
+    if (e->id >= REGRA_ARG_MAX) {
+        l->erro = "id de pista grande demais para a instrução";
+        return NULL;
+    }
+    NoRegra *n = novoNoRegra(REGRA_PISTA, NULL, NULL);
+    n->arg = e->id;
+    return n;
+}
+
+static NoRegra *lerTermoRegra(LeitorRegra *l) {
+    NoRegra *a = lerFatorRegra(l);
+    while (a) {
+        pularEspacosRegra(l);
+        if (*l->p != '&') break;
+        l->p++;
+        NoRegra *b = lerFatorRegra(l);
+        if (!b) {
+            liberarArvoreRegra(a);
+            return NULL;
+        }
+        a = novoNoRegra(REGRA_E, a, b);
+    }
+    return a;
+}
+
+static NoRegra *lerExprRegra(LeitorRegra *l) {
+    NoRegra *a = lerTermoRegra(l);
+    while (a) {
+        pularEspacosRegra(l);
+        if (*l->p != '|') break;
+        l->p++;
+        NoRegra *b = lerTermoRegra(l);
+        if (!b) {
+            liberarArvoreRegra(a);
+            return NULL;
+        }
+        a = novoNoRegra(REGRA_OU, a, b);
+    }
+    return a;
+}
+
+static void reservarCodigoRegra(RegraCompilada *r, size_t *cap) {
+    if (r->tam + 2 > *cap) {
+        *cap = *cap ? *cap * 2 : 16;
+        r->codigo = (uint32_t *) realloc(r->codigo, *cap * sizeof(uint32_t));
+        if (!r->codigo) {
+            fprintf(stderr, "Falha ao alocar memória para regra\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/*
+ emite a árvore (operandos antes do operador; '&'/'|' com salto de curto-circuito);
+ retorna a profundidade de pilha necessária. Destinos acima de REGRA_ARG_MAX são
+ recusados por compilarRegra.
+*/
+static size_t emitirRegra(const NoRegra *n, RegraCompilada *r, size_t *cap) {
+    if (n->op == REGRA_E || n->op == REGRA_OU) {
+        size_t pa = emitirRegra(n->a, r, cap);
+        reservarCodigoRegra(r, cap);
+        size_t salto = r->tam++;
+        size_t pb = emitirRegra(n->b, r, cap);     // o operando de a já saiu da pilha
+        OpRegra op = n->op == REGRA_E ? REGRA_SE_FALSO : REGRA_SE_VERDADE;
+        r->codigo[salto] = ((uint32_t) r->tam << 4) | (uint32_t) op;
+        return pa > pb ? pa : pb;
+    }
+    size_t prof = n->op == REGRA_NAO ? emitirRegra(n->a, r, cap) : 1;
+    reservarCodigoRegra(r, cap);
+    uint32_t arg = (n->op == REGRA_PISTA || n->op == REGRA_SUSPEITO) ? n->arg : 0;
+    r->codigo[r->tam++] = (arg << 4) | (uint32_t) n->op;
+    if (n->op == REGRA_SUSPEITO) r->codigo[r->tam++] = n->minimo;
+    return prof;
+}
+
+/* contagem de bits em (mascara & coletadas): POPCNT quando disponível, como no CRC32C */
+static uint32_t contarMascaraGenerico(const uint64_t *mascara, const uint64_t *coletadas, size_t palavras) {
+    uint32_t total = 0;
+    for (size_t w = 0; w < palavras; ++w) total += (uint32_t) __builtin_popcountll(mascara[w] & coletadas[w]);
+    return total;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("popcnt")))
+static uint32_t contarMascaraPopcnt(const uint64_t *mascara, const uint64_t *coletadas, size_t palavras) {
+    uint32_t total = 0;
+    for (size_t w = 0; w < palavras; ++w) total += (uint32_t) __builtin_popcountll(mascara[w] & coletadas[w]);
+    return total;
+}
+#endif
+
+static uint32_t (*implContarMascara)(const uint64_t *, const uint64_t *, size_t) = contarMascaraGenerico;
+
+static void escolherContagemMascara(void) {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("popcnt")) implContarMascara = contarMascaraPopcnt;
+#endif
+}
+
+static inline uint32_t contarComMascara(const uint64_t *mascara, const uint64_t *coletadas, size_t palavras) {
+    return implContarMascara(mascara, coletadas, palavras);
+}
+
+/*
+ compilarRegra: analisa o texto e gera o programa. As pistas e suspeitos são resolvidos
+ contra a tabela hash atual; retorna NULL (com mensagem) em erro de sintaxe ou pista
+ desconhecida. Se arvore != NULL, devolve também a árvore (para conferência).
+*/
+RegraCompilada *compilarRegra(const char *texto, NoRegra **arvore) {
+    LeitorRegra l = { texto, NULL, NULL, 0 };
+    NoRegra *raiz = lerExprRegra(&l);
+    if (raiz) {
+        pularEspacosRegra(&l);
+        if (*l.p) {
+            l.erro = "texto inesperado após a expressão";
+            liberarArvoreRegra(raiz);
+            raiz = NULL;
+        }
+    }
+    RegraCompilada *r = NULL;
+    escolherContagemMascara();
+    if (raiz) {
+        r = (RegraCompilada *) calloc(1, sizeof(RegraCompilada));
+        if (!r) {
+            fprintf(stderr, "Falha ao alocar memória para regra\n");
+            exit(EXIT_FAILURE);
+        }
+        size_t cap = 0;
+        if (emitirRegra(raiz, r, &cap) > REGRA_PILHA_MAX || r->tam >= REGRA_ARG_MAX) {
+            l.erro = r->tam >= REGRA_ARG_MAX ? "expressão longa demais" : "expressão aninhada demais";
+            free(r->codigo);
+            free(r);
+            r = NULL;
+        }
+    }
+    if (r) {
+        r->palavras = (totalPistasHash + 63) / 64;
+        r->numMascaras = l.numSuspeitos;
+        r->mascaras = (uint64_t *) calloc((size_t) l.numSuspeitos * r->palavras + 1, sizeof(uint64_t));
+        r->numIds = totalPistasHash;
+        r->mascaraDaPista = (uint32_t *) malloc(((size_t) r->numIds + 1) * sizeof(uint32_t));
+        if (!r->mascaras || !r->mascaraDaPista) {
+            fprintf(stderr, "Falha ao alocar memória para regra\n");
+            exit(EXIT_FAILURE);
+        }
+        /* a lista de pistas de cada suspeito no registro já exclui entradas sobrescritas */
+        consolidarRegistroSuspeitos();
+        memset(r->mascaraDaPista, 0xFF, ((size_t) r->numIds + 1) * sizeof(uint32_t));
+        for (uint32_t s = 0; s < l.numSuspeitos; ++s) {
+            uint32_t id = l.suspeitos[s];
+            if (id == SEM_SUSPEITO) continue;
+            uint64_t *mascara = r->mascaras + (size_t) s * r->palavras;
+            for (uint32_t i = registroSuspeitos.inicioPistas[id]; i < registroSuspeitos.inicioPistas[id + 1]; ++i) {
+                uint32_t pista = registroSuspeitos.idsPistas[i];
+                mascara[pista >> 6] |= 1ull << (pista & 63);
+                r->mascaraDaPista[pista] = s;
+            }
+        }
+    } else {
+        fprintf(stderr, "Regra inválida (%s) perto de: %.20s\n", l.erro ? l.erro : "erro", l.p);
+    }
+    free(l.suspeitos);
+    if (arvore && r) *arvore = raiz;
+    else liberarArvoreRegra(raiz);
+    return r;
+}
+
+void liberarRegra(RegraCompilada *r) {
+    if (!r) return;
+    free(r->codigo);
+    free(r->mascaras);
+    free(r->mascaraDaPista);
+    free(r);
+}
+
+/*
+ avaliarRegra: executa o programa sobre o bitset de pistas coletadas (r->palavras palavras).
+ ids (numIds ids distintos, os mesmos do bitset) é opcional: com ele, @ conta só as
+ pistas da sessão; sem ele (NULL), cai na contagem pela máscara do catálogo.
+*/
+int avaliarRegra(const RegraCompilada *r, const uint64_t *coletadas, const uint32_t *ids, size_t numIds) {
+    uint64_t pilha = 0;   // bit 0 = topo
+    for (size_t pc = 0; pc < r->tam; ++pc) {
+        uint32_t ins = r->codigo[pc];
+        uint32_t arg = ins >> 4;
+        switch ((OpRegra) (ins & 0xF)) {
+        case REGRA_PISTA:
+            pilha = (pilha << 1) | ((coletadas[arg >> 6] >> (arg & 63)) & 1);
+            break;
+        case REGRA_SUSPEITO: {
+            uint32_t total = 0;
+            if (ids) {
+                for (size_t i = 0; i < numIds; ++i) {
+                    total += ids[i] < r->numIds && r->mascaraDaPista[ids[i]] == arg;
+                }
+            } else {
+                total = contarComMascara(r->mascaras + (size_t) arg * r->palavras, coletadas, r->palavras);
+            }
+            pilha = (pilha << 1) | (total >= r->codigo[++pc]);
+            break;
+        }
+        case REGRA_E:
+            pilha = (pilha >> 1) & (pilha | ~1ull);
+            break;
+        case REGRA_OU:
+            pilha = (pilha >> 1) | (pilha & 1);
+            break;
+        case REGRA_NAO:
+            pilha ^= 1;
+            break;
+        case REGRA_SE_FALSO:
+            if (pilha & 1) pilha >>= 1;
+            else pc = arg - 1;
+            break;
+        case REGRA_SE_VERDADE:
+            if (pilha & 1) pc = arg - 1;
+            else pilha >>= 1;
+            break;
+        }
+    }
+    return (int) (pilha & 1);
+}
+
+/*
+ avaliarRegraLote: uma regra sobre muitas sessões, bitsets contíguos de r->palavras cada;
+ os ids coletados da sessão i são ids[inicioIds[i] .. inicioIds[i+1]) (inicioIds NULL: sem lista)
+*/
+size_t avaliarRegraLote(const RegraCompilada *r, const uint64_t *coletadas, const uint32_t *ids,
+                        const size_t *inicioIds, size_t numSessoes, uint8_t *resultado) {
+    size_t aceitas = 0;
+    for (size_t i = 0; i < numSessoes; ++i) {
+        resultado[i] = (uint8_t) (inicioIds ? avaliarRegra(r, coletadas + i * r->palavras, ids + inicioIds[i],
+                                                            inicioIds[i + 1] - inicioIds[i])
+                                            : avaliarRegra(r, coletadas + i * r->palavras, NULL, 0));
+        aceitas += resultado[i];
+    }
+    return aceitas;
+}
+
+/* avaliarArvoreRegra: interpretação direta da árvore (referência) */
+int avaliarArvoreRegra(const NoRegra *n, const RegraCompilada *r, const uint64_t *coletadas) {
+    switch (n->op) {
+    case REGRA_PISTA: return (int) ((coletadas[n->arg >> 6] >> (n->arg & 63)) & 1);
+    case REGRA_SUSPEITO:
+        return contarComMascara(r->mascaras + (size_t) n->arg * r->palavras, coletadas, r->palavras) >= n->minimo;
+    case REGRA_E: return avaliarArvoreRegra(n->a, r, coletadas) && avaliarArvoreRegra(n->b, r, coletadas);
+    case REGRA_OU: return avaliarArvoreRegra(n->a, r, coletadas) || avaliarArvoreRegra(n->b, r, coletadas);
+    case REGRA_NAO: return !avaliarArvoreRegra(n->a, r, coletadas);
+    default: break;
+    }
+    return 0;
+}
+
+/* marcarPistasColetadas: converte a BST de uma sessão para o bitset de ids de pista */
+void marcarPistasColetadas(PistaNode *no, uint64_t *bits) {
+    if (!no) return;
+    HashEntry *e = buscarEntradaHash(no->pista);
+    if (e) bits[e->id >> 6] |= 1ull << (e->id & 63);
+    marcarPistasColetadas(no->esq, bits);
+    marcarPistasColetadas(no->dir, bits);
+}
+
+/* regraValeParaPistas: avalia a regra sobre a BST de pistas de uma sessão (veredito do jogo) */
+int regraValeParaPistas(const RegraCompilada *r, PistaNode *pistas) {
+    uint64_t *bits = (uint64_t *) calloc(r->palavras + 1, sizeof(uint64_t));
+    if (!bits) {
+        fprintf(stderr, "Falha ao alocar memória para regra\n");
+        exit(EXIT_FAILURE);
+    }
+    marcarPistasColetadas(pistas, bits);
+    int vale = avaliarRegra(r, bits, NULL, 0);
+    free(bits);
+    return vale;
+}
+
+int benchRegras(size_t numSalas, size_t numSessoes, const char *texto) {
+    Sala *mansao = gerarMansaoSintetica(numSalas);
+    NoRegra *arvore = NULL;
+    RegraCompilada *r = compilarRegra(texto, &arvore);
+    if (!r) {
+        liberarSalas(mansao);
+        liberarHash();
+        return -1;
+    }
+    /* id de pista por sala (pré-ordem), para simular o replay sem consultar a hash */
+    size_t n;
+    Sala **salas = coletarSalasPreOrdem(mansao, &n);
+    uint32_t *pistaDaSala = (uint32_t *) malloc(n * sizeof(uint32_t));
+    uint64_t *coletadas = (uint64_t *) calloc(numSessoes * r->palavras + 1, sizeof(uint64_t));
+    uint8_t *resultado = (uint8_t *) malloc(numSessoes ? numSessoes : 1);
+    size_t *inicioIds = (size_t *) malloc((numSessoes + 1) * sizeof(size_t));
+    size_t capIds = numSessoes * 8 + 16;
+    uint32_t *ids = (uint32_t *) calloc(capIds, sizeof(uint32_t));
+    if (!pistaDaSala || !coletadas || !resultado || !inicioIds || !ids) {
+        fprintf(stderr, "Falha ao alocar memória para benchmark de regras\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        salas[i]->id = (uint32_t) i;
+        HashEntry *e = salas[i]->pista ? buscarEntradaHash(salas[i]->pista) : NULL;
+        pistaDaSala[i] = e ? e->id : UINT32_MAX;
+    }
+    /* cada sessão desce do hall por um caminho aleatório coletando as pistas */
+    uint64_t semente = 77;
+    size_t totalIds = 0;
+    for (size_t i = 0; i < numSessoes; ++i) {
+        uint64_t *bits = coletadas + i * r->palavras;
+        inicioIds[i] = totalIds;
+        for (Sala *s = mansao; s; s = (aleatorio(&semente) & 1) ? s->esq : s->dir) {
+            uint32_t id = pistaDaSala[s->id];
+            if (id == UINT32_MAX || (bits[id >> 6] >> (id & 63)) & 1) continue;
+            bits[id >> 6] |= 1ull << (id & 63);
+            if (totalIds == capIds) {
+                capIds *= 2;
+                ids = (uint32_t *) realloc(ids, capIds * sizeof(uint32_t));
+                if (!ids) {
+                    fprintf(stderr, "Falha ao alocar memória para benchmark de regras\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            ids[totalIds++] = id;
+        }
+    }
+    inicioIds[numSessoes] = totalIds;
+    double t0 = agoraSegundos();
+    size_t aceitas = avaliarRegraLote(r, coletadas, ids, inicioIds, numSessoes, resultado);
+    double tVm = agoraSegundos() - t0;
+    size_t divergencias = 0;
+    t0 = agoraSegundos();
+    for (size_t i = 0; i < numSessoes; ++i) {
+        if (avaliarArvoreRegra(arvore, r, coletadas + i * r->palavras) != resultado[i]) divergencias++;
+    }
+    double tArvore = agoraSegundos() - t0;
+    printf("Regra: %zu instruções, %u máscaras de %zu palavras\n", r->tam, r->numMascaras, r->palavras);
+    printf("%zu sessões: bytecode %.1f ns/sessão, árvore %.1f ns/sessão; %zu sustentadas\n", numSessoes,
+           tVm * 1e9 / (numSessoes ? numSessoes : 1), tArvore * 1e9 / (numSessoes ? numSessoes : 1), aceitas);
+    printf("Conferência com a árvore: %s\n", divergencias ? "DIVERGENTE" : "ok");
+    free(ids);
+    free(inicioIds);
+    free(resultado);
+    free(coletadas);
+    free(pistaDaSala);
+    free(salas);
+    liberarArvoreRegra(arvore);
+    liberarRegra(r);
+    liberarSalas(mansao);
+    liberarHash();
+    return divergencias ? -1 : 0;
+}
+
+/* =========================
+   Armazenamento de sessões em camadas (memória + arquivo)
+   ========================= */
+/*
+ Um hospedeiro com milhões de investigações paradas não precisa manter a BST de pistas
+ e o conjunto de coletas de todas em RAM. O ArmazemSessoes mantém residentes só as
+ sessões usadas recentemente, dentro de um orçamento de bytes. Quando o orçamento
+ estoura, o ponteiro do relógio (CLOCK) percorre as entradas: sessões com o bit de
+ referência ligado ganham uma segunda chance, as demais são serializadas (o mesmo
+ formato dos instantâneos), comprimidas e gravadas no arquivo. A próxima chamada
+ a passoArmazem reidrata a sessão de forma transparente. A struct Sessao fica sempre
+ na tabela (pequena e de tamanho fixo); só o estado alocado no heap vai para o disco.
+ Cada sessão ocupa uma vaga no arquivo, reaproveitada se a nova imagem couber.
+*/
+typedef struct EntradaArmazem {
+    Sessao sessao;
+    uint64_t deslocamento;      // vaga no arquivo (válida se capImagem > 0)
+    uint32_t tamImagem;         // bytes da última imagem gravada
+    uint32_t capImagem;         // tamanho da vaga
+    size_t bytes;               // estimativa de memória enquanto residente
+    uint8_t residente;
+    uint8_t referenciada;       // bit do relógio
+} EntradaArmazem;
+
+typedef struct ArmazemSessoes {
+    EntradaArmazem *entradas;
+    size_t numEntradas, capEntradas;
+    Sala *inicio;
+    Sala **salas;               // id -> sala (para reidratar sem percorrer a mansão)
+    size_t numSalas;
+    int fd;
+    uint64_t fimArquivo;
+    size_t orcamento;           // bytes de estado residente permitidos
+    size_t bytesResidentes;
+    size_t residentes;
+    size_t ponteiro;            // posição do relógio
+    uint64_t despejos, reidratacoes;
+    BufferBin imagem, comprimida;   // reaproveitados entre despejos
+} ArmazemSessoes;
+
+/* custo aproximado de um nó alocado (cabeçalho do malloc incluído) */
+#define ARMAZEM_SOBRECUSTO_MALLOC 16
+
+static size_t memoriaPistas(const PistaNode *no) {
+    if (!no) return 0;
+    return sizeof(PistaNode) + strlen(no->pista) + 1 + no->tamChave + 3 * ARMAZEM_SOBRECUSTO_MALLOC +
+           memoriaPistas(no->esq) + memoriaPistas(no->dir);
+}
+
+/* memoriaSessao: bytes de heap ocupados pelo estado da sessão */
+size_t memoriaSessao(const Sessao *s) {
+    return memoriaPistas(s->pistas) + s->coletadas.cap * sizeof(uint32_t) +
+           (s->coletadas.cap ? ARMAZEM_SOBRECUSTO_MALLOC : 0);
+}
+
+int abrirArmazem(ArmazemSessoes *a, const char *caminho, Sala *inicio, size_t orcamento) {
+    memset(a, 0, sizeof(*a));
+    a->fd = open(caminho, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (a->fd < 0) {
+        fprintf(stderr, "Não foi possível abrir o armazenamento %s: %s\n", caminho, strerror(errno));
+        return -1;
+    }
+    a->inicio = inicio;
+    a->salas = coletarSalasPreOrdem(inicio, &a->numSalas);
+    for (size_t i = 0; i < a->numSalas; ++i) a->salas[i]->id = (uint32_t) i;
+    a->orcamento = orcamento;
+    return 0;
+}
+
+/* despejarEntrada: grava a imagem comprimida da sessão e libera seu estado */
+static int despejarEntrada(ArmazemSessoes *a, EntradaArmazem *e) {
+    a->imagem.tam = 0;
+    serializarInstantaneo(&a->imagem, &e->sessao);
+    a->comprimida.tam = 0;
+    reservarBin(&a->comprimida, 4 + limiteComprimido(a->imagem.tam));
+    anexarU32Bin(&a->comprimida, (uint32_t) a->imagem.tam);
+    a->comprimida.tam += comprimirLz(a->imagem.dados, a->imagem.tam, a->comprimida.dados + a->comprimida.tam);
+
+    if (a->comprimida.tam > e->capImagem) {
+        e->deslocamento = a->fimArquivo;
+        e->capImagem = (uint32_t) a->comprimida.tam;
+        a->fimArquivo += e->capImagem;
+    }
+    if (pwrite(a->fd, a->comprimida.dados, a->comprimida.tam, (off_t) e->deslocamento) != (ssize_t) a->comprimida.tam) {
+        fprintf(stderr, "Erro ao gravar sessão no armazenamento: %s\n", strerror(errno));
+        return -1;
+    }
+    e->tamImagem = (uint32_t) a->comprimida.tam;
+    encerrarSessao(&e->sessao);
+    e->residente = 0;
+    a->bytesResidentes -= e->bytes;
+    a->residentes--;
+    a->despejos++;
+    return 0;
+}
+
+/* reidratarEntrada: lê a imagem da sessão e recria seu estado em memória */
+static int reidratarEntrada(ArmazemSessoes *a, EntradaArmazem *e) {
+    a->comprimida.tam = 0;
+    reservarBin(&a->comprimida, e->tamImagem);
+    if (pread(a->fd, a->comprimida.dados, e->tamImagem, (off_t) e->deslocamento) != (ssize_t) e->tamImagem) {
+        fprintf(stderr, "Erro ao ler sessão do armazenamento: %s\n", strerror(errno));
+        return -1;
+    }
+    uint32_t tamOriginal;
+    memcpy(&tamOriginal, a->comprimida.dados, sizeof(tamOriginal));
+    a->imagem.tam = 0;
+    reservarBin(&a->imagem, tamOriginal);
+    long n = descomprimirLz(a->comprimida.dados + 4, e->tamImagem - 4, a->imagem.dados, tamOriginal);
+    if (n != (long) tamOriginal ||
+        restaurarInstantaneoSalas(a->imagem.dados, tamOriginal, &e->sessao, a->salas) != 0) {
+        fprintf(stderr, "Imagem de sessão corrompida no armazenamento\n");
+        return -1;
+    }
+    e->residente = 1;
+    e->bytes = memoriaSessao(&e->sessao);
+    a->bytesResidentes += e->bytes;
+    a->residentes++;
+    a->reidratacoes++;
+    return 0;
+}
+
+/* aplicarOrcamento: gira o relógio despejando sessões até caber no orçamento (poupa 'manter') */
+static void aplicarOrcamento(ArmazemSessoes *a, const EntradaArmazem *manter) {
+    size_t voltas = 0;
+    while (a->bytesResidentes > a->orcamento && a->residentes > 1 && voltas < 2 * a->numEntradas) {
+        EntradaArmazem *e = &a->entradas[a->ponteiro];
+        a->ponteiro = (a->ponteiro + 1) % a->numEntradas;
+        voltas++;
+        if (!e->residente || e == manter) continue;
+        if (e->referenciada) {
+            e->referenciada = 0;
+            continue;
+        }
+        if (despejarEntrada(a, e) != 0) return;
+        voltas = 0;
+    }
+}
+
+/* novaSessaoArmazem: inicia uma sessão residente; retorna seu índice */
+size_t novaSessaoArmazem(ArmazemSessoes *a) {
+    if (a->numEntradas == a->capEntradas) {
+        a->capEntradas = a->capEntradas ? a->capEntradas * 2 : 64;
+        a->entradas = (EntradaArmazem *) realloc(a->entradas, a->capEntradas * sizeof(EntradaArmazem));
+        if (!a->entradas) {
+            fprintf(stderr, "Falha ao alocar memória para armazenamento de sessões\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    size_t idx = a->numEntradas++;
+    EntradaArmazem *e = &a->entradas[idx];
+    memset(e, 0, sizeof(*e));
+    iniciarSessao(&e->sessao, a->inicio, a->numSalas);
+    e->residente = 1;
+    e->referenciada = 1;
+    e->bytes = memoriaSessao(&e->sessao);
+    a->bytesResidentes += e->bytes;
+    a->residentes++;
+    aplicarOrcamento(a, e);
+    return idx;
+}
+
+/* sessaoArmazem: garante que a sessão está residente e a devolve (NULL em erro de E/S) */
+Sessao *sessaoArmazem(ArmazemSessoes *a, size_t idx) {
+    EntradaArmazem *e = &a->entradas[idx];
+    if (!e->residente) {
+        if (reidratarEntrada(a, e) != 0) return NULL;
+        aplicarOrcamento(a, e);
+    }
+    e->referenciada = 1;
+    return &e->sessao;
+}
+
+/* passoArmazem: passoSessao sobre uma sessão do armazenamento, reidratando se preciso */
+ResultadoPasso passoArmazem(ArmazemSessoes *a, size_t idx, char comando) {
+    Sessao *s = sessaoArmazem(a, idx);
+    if (!s) {
+        ResultadoPasso r = { PASSO_ENCERRADA, NULL, NULL };
+        return r;
+    }
+    EntradaArmazem *e = &a->entradas[idx];
+    ResultadoPasso r = passoSessao(s, comando);
+    if (r.pistaNova) {
+        size_t antes = e->bytes;
+        e->bytes = memoriaSessao(s);
+        a->bytesResidentes += e->bytes - antes;
+        aplicarOrcamento(a, e);
+    }
+    return r;
+}
+
+void fecharArmazem(ArmazemSessoes *a) {
+    for (size_t i = 0; i < a->numEntradas; ++i) {
+        if (a->entradas[i].residente) encerrarSessao(&a->entradas[i].sessao);
+    }
+    free(a->entradas);
+    free(a->salas);
+    free(a->imagem.dados);
+    free(a->comprimida.dados);
+    if (a->fd >= 0) close(a->fd);
+    a->fd = -1;
+}
+
+/*
+ benchArmazem: numSessoes sessões; a maioria fica parada depois de alguns passos e uma
+ fração pequena continua ativa. Mede memória residente, despejos/reidratações e o
+ custo por comando, conferindo o estado final contra sessões mantidas em RAM.
+*/
+int benchArmazem(size_t numSessoes, size_t orcamentoKb, const char *caminho) {
+    Sala *mansao = gerarMansaoSintetica(4095);
+    ArmazemSessoes a;
+    if (abrirArmazem(&a, caminho, mansao, orcamentoKb * 1024) != 0) {
+        liberarSalas(mansao);
+        liberarHash();
+        return -1;
+    }
+    uint64_t semente = 5, comandos = 0;
+    double t0 = agoraSegundos();
+    for (size_t i = 0; i < numSessoes; ++i) {
+        size_t idx = novaSessaoArmazem(&a);
+        for (int k = 0; k < 6; ++k) passoArmazem(&a, idx, (aleatorio(&semente) & 1) ? 'e' : 'd');
+        comandos += 6;
+    }
+    /* depois, poucos jogadores ativos voltam a jogar (o resto segue parado) */
+    size_t ativos = numSessoes / 50 + 1;
+    for (size_t rodada = 0; rodada < 4; ++rodada) {
+        for (size_t k = 0; k < ativos; ++k) {
+            passoArmazem(&a, (k * 7919) % numSessoes, (aleatorio(&semente) & 1) ? 'e' : 'd');
+            comandos++;
+        }
+    }
+    double tTotal = agoraSegundos() - t0;
+
+    /* conferência: refaz as mesmas sessões em RAM e compara as pistas coletadas */
+    size_t divergencias = 0;
+    semente = 5;
+    Sessao *ref = (Sessao *) malloc(numSessoes * sizeof(Sessao));
+    if (!ref) {
+        fprintf(stderr, "Falha ao alocar memória para sessões\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t bytesSemArmazem = 0;
+    for (size_t i = 0; i < numSessoes; ++i) {
+        iniciarSessao(&ref[i], mansao, a.numSalas);
+        for (int k = 0; k < 6; ++k) passoSessao(&ref[i], (aleatorio(&semente) & 1) ? 'e' : 'd');
+    }
+    for (size_t rodada = 0; rodada < 4; ++rodada) {
+        for (size_t k = 0; k < ativos; ++k) {
+            passoSessao(&ref[(k * 7919) % numSessoes], (aleatorio(&semente) & 1) ? 'e' : 'd');
+        }
+    }
+    size_t bytesResidentes = a.bytesResidentes, residentes = a.residentes;
+    for (size_t i = 0; i < numSessoes; ++i) {
+        bytesSemArmazem += memoriaSessao(&ref[i]);
+        if (i % 97 == 0) {
+            Sessao *s = sessaoArmazem(&a, i);
+            if (!s || s->atual != ref[i].atual || s->coletadas.n != ref[i].coletadas.n ||
+                contarNosPistas(s->pistas) != contarNosPistas(ref[i].pistas)) {
+                divergencias++;
+            }
+        }
+        encerrarSessao(&ref[i]);
+    }
+    free(ref);
+    printf("%zu sessões, orçamento %zu KB: %zu residentes (%.1f KB) contra %.1f KB tudo em RAM\n", numSessoes,
+           orcamentoKb, residentes, bytesResidentes / 1024.0, bytesSemArmazem / 1024.0);
+    printf("%llu despejos, %llu reidratações, arquivo %.1f KB; %.2f us por comando\n",
+           (unsigned long long) a.despejos, (unsigned long long) a.reidratacoes, a.fimArquivo / 1024.0,
+           tTotal * 1e6 / (double) (comandos ? comandos : 1));
+    printf("Conferência com sessões em RAM: %s\n", divergencias ? "DIVERGENTE" : "ok");
+    fecharArmazem(&a);
+    liberarSalas(mansao);
+    liberarHash();
+    return divergencias ? -1 : 0;
+}
+
+/* =========================
+   Sessões em memória compartilhada entre processos
+   ========================= */
+/*
+ Uma região POSIX (shm_open + mmap) guarda as sessões de modo que qualquer processo
+ trabalhador possa atender qualquer sessão sem copiá-la. Como cada processo mapeia a
+ região em um endereço diferente, nada lá dentro é ponteiro: tudo é deslocamento a
+ partir do início. A mansão não vai para a região; cada processo carrega o mesmo
+ cenário, e o cabeçalho guarda o número de salas e um CRC32C dos nomes e pistas para
+ recusar processos com outro mapa.
+
+  cabeçalho | índice (capIndice slots chave -> deslocamento) | blocos de sessão
+
+ Cada bloco de sessão tem tamanho fixo: sala atual, contadores e o bitset das salas
+ cuja pista foi coletada, que serve ao mesmo tempo de conjunto de pistas (o texto vem
+ da mansão) e de estado de visita. Os blocos vêm de um alocador sem travas: uma pilha
+ de blocos livres (Treiber, com etiqueta contra ABA) e, quando ela está vazia, um
+ incremento atômico no topo. O índice usa endereçamento aberto; buscas não travam,
+ e só abrir/fechar (raros) passam por uma trava de giro no cabeçalho. Fechar deixa uma
+ lápide no slot: a busca continua além dela e a criação a reaproveita, de modo que
+ chaves que giram não esgotam o índice. Os passos também não usam travas: a sala atual
+ muda por CAS e a coleta é um fetch_or no bitset.
+*/
+#define SHM_MAGICO 0x51434344u          // "DCCQ"
+#define SHM_VERSAO 2
+#define SHM_ALINHAMENTO 64
+#define SHM_LAPIDE UINT64_MAX           // chave de slot cuja sessão foi fechada
+
+typedef struct SlotCompartilhado {
+    _Atomic uint64_t chave;             // 0 = nunca usado, SHM_LAPIDE = reaproveitável
+    _Atomic uint64_t deslocamento;      // 0 = sessão removida (ou ainda sendo publicada)
+} SlotCompartilhado;
+
+typedef struct CabecalhoCompartilhado {
+    _Atomic uint32_t pronto;            // SHM_MAGICO quando a inicialização terminou
+    uint32_t versao;
+    uint64_t tamanho;                   // bytes da região
+    uint32_t numSalas;
+    uint32_t impressaoMansao;           // CRC32C de nomes e pistas em pré-ordem
+    uint32_t tamBloco;
+    uint32_t palavras;                  // uint64_t do bitset por sessão
+    uint64_t capIndice;                 // potência de 2
+    uint64_t inicioBlocos;
+    _Atomic uint64_t topo;              // próximo byte livre (alocação por incremento)
+    _Atomic uint64_t livres;            // (etiqueta << 32) | (deslocamento / 64) do topo da pilha
+    _Atomic uint64_t sessoes;
+    _Atomic uint64_t passos;
+    _Atomic uint32_t travaIndice;       // serializa criação e remoção de chaves
+    uint32_t reservado;
+    SlotCompartilhado indice[];
+} CabecalhoCompartilhado;
+
+typedef struct SessaoCompartilhada {
+    uint64_t proxLivre;                 // encadeamento enquanto o bloco está na pilha livre
+    uint64_t chave;
+    _Atomic uint32_t atual;             // id (pré-ordem) da sala atual
+    _Atomic uint32_t encerrada;
+    _Atomic uint32_t numColetadas;
+    uint32_t reservado;
+    _Atomic uint64_t coletadas[];       // bitset por id de sala
+} SessaoCompartilhada;
+
+/* visão local (por processo) da região */
+typedef struct ArmazemCompartilhado {
+    CabecalhoCompartilhado *cab;
+    size_t tamanho;
+    Sala **salas;                       // id -> sala da mansão deste processo
+    size_t numSalas;
+} ArmazemCompartilhado;
+
+static inline void *emCompartilhado(const ArmazemCompartilhado *a, uint64_t deslocamento) {
+    return (char *) a->cab + deslocamento;
+}
+
+static uint64_t misturarChave(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/* impressaoMansao: CRC32C dos nomes e pistas em pré-ordem (identifica o cenário) */
+static uint32_t impressaoMansao(Sala **salas, size_t n) {
+    BufferBin b = { NULL, 0, 0 };
+    for (size_t i = 0; i < n; ++i) {
+        anexarStrBin(&b, salas[i]->nome);
+        anexarStrBin(&b, salas[i]->pista ? salas[i]->pista : "");
+    }
+    uint32_t crc = crc32c(b.dados, b.tam);
+    free(b.dados);
+    return crc;
+}
+
+static int mapearCompartilhado(ArmazemCompartilhado *a, int fd, size_t tamanho, Sala *mansao) {
+    void *base = mmap(NULL, tamanho, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Erro ao mapear memória compartilhada: %s\n", strerror(errno));
+        return -1;
+    }
+    a->cab = (CabecalhoCompartilhado *) base;
+    a->tamanho = tamanho;
+    a->salas = coletarSalasPreOrdem(mansao, &a->numSalas);
+    for (size_t i = 0; i < a->numSalas; ++i) a->salas[i]->id = (uint32_t) i;
+    return 0;
+}
+
+/*
+ criarArmazemCompartilhado: cria a região "nome" (falha se já existir) com espaço para
+ capSessoes sessões simultâneas.
+*/
+int criarArmazemCompartilhado(ArmazemCompartilhado *a, const char *nome, Sala *mansao, size_t capSessoes) {
+    size_t numSalas;
+    Sala **salas = coletarSalasPreOrdem(mansao, &numSalas);
+    uint32_t impressao = impressaoMansao(salas, numSalas);
+    free(salas);
+
+    uint64_t capIndice = 16;
+    while (capIndice < capSessoes * 2) capIndice <<= 1;
+    uint32_t palavras = (uint32_t) ((numSalas + 63) / 64);
+    uint64_t tamBloco = (sizeof(SessaoCompartilhada) + palavras * sizeof(uint64_t) + SHM_ALINHAMENTO - 1) &
+                        ~(uint64_t) (SHM_ALINHAMENTO - 1);
+    uint64_t inicioBlocos = (sizeof(CabecalhoCompartilhado) + capIndice * sizeof(SlotCompartilhado) +
+                             SHM_ALINHAMENTO - 1) & ~(uint64_t) (SHM_ALINHAMENTO - 1);
+    uint64_t tamanho = inicioBlocos + tamBloco * capSessoes;
+
+    int fd = shm_open(nome, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "Não foi possível criar %s: %s\n", nome, strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, (off_t) tamanho) != 0) {
+        fprintf(stderr, "Não foi possível dimensionar %s: %s\n", nome, strerror(errno));
+        close(fd);
+        shm_unlink(nome);
+        return -1;
+    }
+    if (mapearCompartilhado(a, fd, tamanho, mansao) != 0) {
+        shm_unlink(nome);
+        return -1;
+    }
+    CabecalhoCompartilhado *c = a->cab;     // ftruncate zerou a região
+    c->versao = SHM_VERSAO;
+    c->tamanho = tamanho;
+    c->numSalas = (uint32_t) numSalas;
+    c->impressaoMansao = impressao;
+    c->tamBloco = (uint32_t) tamBloco;
+    c->palavras = palavras;
+    c->capIndice = capIndice;
+    c->inicioBlocos = inicioBlocos;
+    atomic_store(&c->topo, inicioBlocos);
+    atomic_store_explicit(&c->pronto, SHM_MAGICO, memory_order_release);
+    return 0;
+}
+
+/* anexarArmazemCompartilhado: abre uma região existente; a mansão precisa ser a mesma */
+int anexarArmazemCompartilhado(ArmazemCompartilhado *a, const char *nome, Sala *mansao) {
+    int fd = shm_open(nome, O_RDWR, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Não foi possível abrir %s: %s\n", nome, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(CabecalhoCompartilhado)) {
+        fprintf(stderr, "Região compartilhada %s inválida\n", nome);
+        close(fd);
+        return -1;
+    }
+    if (mapearCompartilhado(a, fd, (size_t) st.st_size, mansao) != 0) return -1;
+    CabecalhoCompartilhado *c = a->cab;
+    if (atomic_load_explicit(&c->pronto, memory_order_acquire) != SHM_MAGICO || c->versao != SHM_VERSAO ||
+        c->tamanho != a->tamanho || c->numSalas != a->numSalas ||
+        c->impressaoMansao != impressaoMansao(a->salas, a->numSalas)) {
+        fprintf(stderr, "Região compartilhada %s não corresponde a esta mansão\n", nome);
+        munmap(a->cab, a->tamanho);
+        free(a->salas);
+        return -1;
+    }
+    return 0;
+}
+
+void desanexarArmazemCompartilhado(ArmazemCompartilhado *a) {
+    if (a->cab) munmap(a->cab, a->tamanho);
+    free(a->salas);
+    a->cab = NULL;
+    a->salas = NULL;
+}
+
+/* alocarBlocoCompartilhado: retira da pilha livre ou avança o topo; 0 se a região encheu */
+static uint64_t alocarBlocoCompartilhado(ArmazemCompartilhado *a) {
+    CabecalhoCompartilhado *c = a->cab;
+    uint64_t topo = atomic_load_explicit(&c->livres, memory_order_acquire);
+    while ((uint32_t) topo != 0) {
+        uint64_t desl = (uint64_t) (uint32_t) topo * SHM_ALINHAMENTO;
+        uint64_t prox = ((SessaoCompartilhada *) emCompartilhado(a, desl))->proxLivre;
+        uint64_t novo = ((topo >> 32) + 1) << 32 | (prox / SHM_ALINHAMENTO);
+        if (atomic_compare_exchange_weak_explicit(&c->livres, &topo, novo, memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+            return desl;
+        }
+    }
+    uint64_t desl = atomic_fetch_add(&c->topo, c->tamBloco);
+    if (desl + c->tamBloco > c->tamanho) {
+        atomic_fetch_sub(&c->topo, c->tamBloco);
+        return 0;
+    }
+    return desl;
+}
+
+static void liberarBlocoCompartilhado(ArmazemCompartilhado *a, uint64_t desl) {
+    CabecalhoCompartilhado *c = a->cab;
+    SessaoCompartilhada *s = (SessaoCompartilhada *) emCompartilhado(a, desl);
+    uint64_t topo = atomic_load_explicit(&c->livres, memory_order_acquire);
+    uint64_t novo;
+    do {
+        s->proxLivre = (uint64_t) (uint32_t) topo * SHM_ALINHAMENTO;
+        novo = ((topo >> 32) + 1) << 32 | (desl / SHM_ALINHAMENTO);
+    } while (!atomic_compare_exchange_weak_explicit(&c->livres, &topo, novo, memory_order_acq_rel,
+                                                    memory_order_acquire));
+}
+
+static void travarIndiceCompartilhado(CabecalhoCompartilhado *c) {
+    uint32_t livre = 0;
+    while (!atomic_compare_exchange_weak_explicit(&c->travaIndice, &livre, 1, memory_order_acquire,
+                                                  memory_order_relaxed)) {
+        livre = 0;
+    }
+}
+
+static void destravarIndiceCompartilhado(CabecalhoCompartilhado *c) {
+    atomic_store_explicit(&c->travaIndice, 0, memory_order_release);
+}
+
+/*
+ slotCompartilhado: slot da chave; NULL se não achou/cheio. A sondagem passa por lápides
+ e para no primeiro slot nunca usado. criar (só com a trava do índice) grava a chave na
+ primeira lápide do caminho, ou no slot vazio, quando ela ainda não existe.
+*/
+static SlotCompartilhado *slotCompartilhado(ArmazemCompartilhado *a, uint64_t chave, int criar) {
+    CabecalhoCompartilhado *c = a->cab;
+    uint64_t mascara = c->capIndice - 1;
+    SlotCompartilhado *livre = NULL;
+    for (uint64_t i = misturarChave(chave) & mascara, k = 0; k < c->capIndice; i = (i + 1) & mascara, ++k) {
+        SlotCompartilhado *slot = &c->indice[i];
+        uint64_t atual = atomic_load_explicit(&slot->chave, memory_order_acquire);
+        if (atual == chave) return slot;
+        if (atual == SHM_LAPIDE) {
+            if (!livre) livre = slot;
+        } else if (atual == 0) {
+            if (!livre) livre = slot;
+            break;
+        }
+    }
+    if (!criar || !livre) return NULL;
+    atomic_store_explicit(&livre->chave, chave, memory_order_release);
+    return livre;
+}
+
+/* colocar a sessão na sala id (coleta a pista, se houver e ainda não coletada) */
+static const char *entrarSalaCompartilhada(ArmazemCompartilhado *a, SessaoCompartilhada *s, uint32_t id) {
+    const Sala *sala = a->salas[id];
+    if (!sala->pista) return NULL;
+    uint64_t bit = 1ull << (id & 63);
+    if (atomic_fetch_or(&s->coletadas[id >> 6], bit) & bit) return NULL;
+    atomic_fetch_add(&s->numColetadas, 1);
+    return sala->pista;
+}
+
+/*
+ abrirSessaoCompartilhada: cria a sessão "chave" (!= 0) no hall; retorna o deslocamento
+ do bloco ou 0 se a chave já existe ou não há espaço.
+*/
+uint64_t abrirSessaoCompartilhada(ArmazemCompartilhado *a, uint64_t chave) {
+    if (chave == 0 || chave == SHM_LAPIDE) return 0;
+    travarIndiceCompartilhado(a->cab);
+    SlotCompartilhado *slot = slotCompartilhado(a, chave, 1);
+    if (!slot || atomic_load(&slot->deslocamento) != 0) {
+        destravarIndiceCompartilhado(a->cab);
+        return 0;
+    }
+    uint64_t desl = alocarBlocoCompartilhado(a);
+    if (!desl) {
+        atomic_store_explicit(&slot->chave, SHM_LAPIDE, memory_order_release);
+        destravarIndiceCompartilhado(a->cab);
+        return 0;
+    }
+    SessaoCompartilhada *s = (SessaoCompartilhada *) emCompartilhado(a, desl);
+    memset(s, 0, a->cab->tamBloco);
+    s->chave = chave;
+    entrarSalaCompartilhada(a, s, 0);
+    atomic_store_explicit(&slot->deslocamento, desl, memory_order_release);
+    destravarIndiceCompartilhado(a->cab);
+    atomic_fetch_add(&a->cab->sessoes, 1);
+    return desl;
+}
+
+/* buscarSessaoCompartilhada: deslocamento da sessão (0 se não existe) */
+uint64_t buscarSessaoCompartilhada(ArmazemCompartilhado *a, uint64_t chave) {
+    SlotCompartilhado *slot = chave ? slotCompartilhado(a, chave, 0) : NULL;
+    return slot ? atomic_load_explicit(&slot->deslocamento, memory_order_acquire) : 0;
+}
+
+/*
+ fecharSessaoCompartilhada: remove a sessão do índice e devolve o bloco. O slot vira
+ lápide (reaproveitado pela próxima chave criada naquele caminho de sondagem). Chamar só
+ quando nenhum outro processo estiver usando a sessão.
+*/
+void fecharSessaoCompartilhada(ArmazemCompartilhado *a, uint64_t chave) {
+    if (chave == 0 || chave == SHM_LAPIDE) return;
+    travarIndiceCompartilhado(a->cab);
+    SlotCompartilhado *slot = slotCompartilhado(a, chave, 0);
+    uint64_t desl = 0;
+    if (slot) {
+        desl = atomic_exchange(&slot->deslocamento, 0);
+        atomic_store_explicit(&slot->chave, SHM_LAPIDE, memory_order_release);
+    }
+    destravarIndiceCompartilhado(a->cab);
+    if (!desl) return;
+    atomic_fetch_sub(&a->cab->sessoes, 1);
+    liberarBlocoCompartilhado(a, desl);
+}
+
+/* passoCompartilhado: mesma semântica de passoSessao, sem travas */
+ResultadoPasso passoCompartilhado(ArmazemCompartilhado *a, uint64_t desl, char comando) {
+    SessaoCompartilhada *s = (SessaoCompartilhada *) emCompartilhado(a, desl);
+    ResultadoPasso r = { PASSO_OK, NULL, NULL };
+    atomic_fetch_add_explicit(&a->cab->passos, 1, memory_order_relaxed);
+    uint32_t atual = atomic_load_explicit(&s->atual, memory_order_acquire);
+    r.sala = a->salas[atual];
+    if (atomic_load_explicit(&s->encerrada, memory_order_acquire)) {
+        r.status = PASSO_ENCERRADA;
+        return r;
+    }
+    switch (comando) {
+    case 'e':
+    case 'E':
+    case 'd':
+    case 'D':
+        for (;;) {
+            const Sala *sala = a->salas[atual];
+            const Sala *prox = (comando == 'e' || comando == 'E') ? sala->esq : sala->dir;
+            if (!prox) {
+                r.status = PASSO_SEM_CAMINHO;
+                r.sala = sala;
+                return r;
+            }
+            if (atomic_compare_exchange_weak_explicit(&s->atual, &atual, prox->id, memory_order_acq_rel,
+                                                      memory_order_acquire)) {
+                r.sala = prox;
+                r.pistaNova = entrarSalaCompartilhada(a, s, prox->id);
+                return r;
+            }
+        }
+    case 's':
+    case 'S':
+        atomic_store(&s->encerrada, 1);
+        r.status = PASSO_ENCERRADA;
+        return r;
+    default:
+        r.status = PASSO_INVALIDO;
+        return r;
+    }
+}
+
+/* pistasSessaoCompartilhada: BST de pistas (para a acusação) a partir do bitset */
+PistaNode *pistasSessaoCompartilhada(const ArmazemCompartilhado *a, uint64_t desl) {
+    SessaoCompartilhada *s = (SessaoCompartilhada *) emCompartilhado(a, desl);
+    PistaNode *raiz = NULL;
+    for (size_t id = 0; id < a->numSalas; ++id) {
+        if (atomic_load_explicit(&s->coletadas[id >> 6], memory_order_acquire) >> (id & 63) & 1) {
+            raiz = inserirPista(raiz, a->salas[id]->pista);
+        }
+    }
+    return raiz;
+}
+
+/* processo trabalhador do benchmark: atende sessões quaisquer, escolhidas ao acaso */
+static int trabalhadorCompartilhado(const char *nome, Sala *mansao, size_t numSessoes, size_t passos, uint64_t semente) {
+    ArmazemCompartilhado a;
+    if (anexarArmazemCompartilhado(&a, nome, mansao) != 0) return -1;
+    for (size_t i = 0; i < passos; ++i) {
+        uint64_t chave = aleatorio(&semente) % numSessoes + 1;
+        uint64_t desl = buscarSessaoCompartilhada(&a, chave);
+        if (!desl) {
+            desanexarArmazemCompartilhado(&a);
+            return -1;
+        }
+        passoCompartilhado(&a, desl, (aleatorio(&semente) & 1) ? 'e' : 'd');
+    }
+    desanexarArmazemCompartilhado(&a);
+    return 0;
+}
+
+/*
+ benchCompartilhado: o processo pai cria a região e as sessões; numProcessos filhos
+ (fork) anexam a região e aplicam passos a sessões escolhidas ao acaso, sem dono fixo.
+ Ao final confere que cada sessão coletou exatamente as pistas do caminho até a sala
+ atual e que nenhum passo se perdeu.
+*/
+int benchCompartilhado(int numProcessos, size_t numSessoes, size_t passos) {
+    if (numSessoes == 0) {
+        fprintf(stderr, "Uso: --bench-compartilhado <processos> <sessoes> <passos>, sessões maior que zero\n");
+        return -1;
+    }
+    char nome[64];
+    snprintf(nome, sizeof(nome), "/detective-quest-%ld", (long) getpid());
+    Sala *mansao = gerarMansaoSintetica(4095);
+    ArmazemCompartilhado a;
+    if (criarArmazemCompartilhado(&a, nome, mansao, numSessoes) != 0) {
+        liberarSalas(mansao);
+        liberarHash();
+        return -1;
+    }
+    for (size_t i = 0; i < numSessoes; ++i) {
+        if (!abrirSessaoCompartilhada(&a, i + 1)) {
+            fprintf(stderr, "Não foi possível abrir a sessão %zu\n", i + 1);
+            desanexarArmazemCompartilhado(&a);
+            shm_unlink(nome);
+            liberarSalas(mansao);
+            liberarHash();
+            return -1;
+        }
+    }
+    fflush(stdout);
+    double t0 = agoraSegundos();
+    int falhas = 0;
+    for (int p = 0; p < numProcessos; ++p) {
+        pid_t pid = fork();
+        if (pid == 0) _exit(trabalhadorCompartilhado(nome, mansao, numSessoes, passos, 1000 + (uint64_t) p) == 0 ? 0 : 1);
+        if (pid < 0) falhas++;
+    }
+    int status;
+    while (wait(&status) > 0) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) falhas++;
+    }
+    double tPassos = agoraSegundos() - t0;
+
+    size_t divergencias = 0;
+    for (size_t i = 0; i < numSessoes; ++i) {
+        uint64_t desl = buscarSessaoCompartilhada(&a, i + 1);
+        if (!desl) {    // deslocamento 0 é o cabeçalho, não uma sessão
+            divergencias++;
+            continue;
+        }
+        SessaoCompartilhada *s = (SessaoCompartilhada *) emCompartilhado(&a, desl);
+        /* pistas esperadas: salas com pista no caminho do hall até a sala atual */
+        uint32_t esperadas = 0;
+        size_t destino = atomic_load(&s->atual), id = 0;
+        for (const Sala *sala = a.salas[0];; ) {
+            id = sala->id;
+            if (sala->pista) {
+                esperadas++;
+                if (!(atomic_load(&s->coletadas[id >> 6]) >> (id & 63) & 1)) divergencias++;
+            }
+            if (id == destino) break;
+            /* desce pelo filho cuja subárvore contém o destino (ids em pré-ordem) */
+            sala = (sala->dir && destino >= sala->dir->id) ? sala->dir : sala->esq;
+            if (!sala) {
+                divergencias++;
+                break;
+            }
+        }
+        if (atomic_load(&s->numColetadas) != esperadas) divergencias++;
+    }
+    /* reutilização de blocos: fecha e reabre metade das sessões */
+    uint64_t topoAntes = atomic_load(&a.cab->topo);
+    for (size_t i = 0; i < numSessoes; i += 2) fecharSessaoCompartilhada(&a, i + 1);
+    for (size_t i = 0; i < numSessoes; i += 2) {
+        if (!abrirSessaoCompartilhada(&a, i + 1)) divergencias++;
+    }
+    if (atomic_load(&a.cab->topo) != topoAntes) divergencias++;
+    /* rotação de chaves: metade das sessões é trocada por chaves novas várias vezes (lápides reaproveitadas) */
+    uint64_t proximaChave = numSessoes + 1;
+    for (int rodada = 0; rodada < 4; ++rodada) {
+        for (size_t i = 0; i < numSessoes; i += 2) {
+            uint64_t antiga = rodada == 0 ? i + 1 : proximaChave - numSessoes / 2 - numSessoes % 2 + i / 2;
+            fecharSessaoCompartilhada(&a, antiga);
+            if (buscarSessaoCompartilhada(&a, antiga)) divergencias++;
+        }
+        for (size_t i = 0; i < numSessoes; i += 2) {
+            if (!abrirSessaoCompartilhada(&a, proximaChave++)) divergencias++;
+        }
+    }
+    for (size_t i = 1; i < numSessoes; i += 2) {
+        if (!buscarSessaoCompartilhada(&a, i + 1)) divergencias++;
+    }
+
+    uint64_t totalPassos = atomic_load(&a.cab->passos);
+    printf("%d processos, %zu sessões (%u bytes cada, região de %.1f MB)\n", numProcessos, numSessoes,
+           a.cab->tamBloco, a.tamanho / 1048576.0);
+    printf("%llu passos em %.3f s: %.0f ns por passo (incluindo busca no índice)\n",
+           (unsigned long long) totalPassos, tPassos, tPassos * 1e9 / (double) (totalPassos ? totalPassos : 1));
+    printf("Conferência (coletas x caminho, passos, reuso de blocos e slots): %s\n",
+           divergencias || falhas || totalPassos != (uint64_t) numProcessos * passos ? "DIVERGENTE" : "ok");
+    desanexarArmazemCompartilhado(&a);
+    shm_unlink(nome);
+    liberarSalas(mansao);
+    liberarHash();
+    return divergencias || falhas ? -1 : 0;
+}
+
+/* =========================
+   Replays compactos (2 bits por movimento)
+   ========================= */
+/*
+ Um replay é a sequência de comandos de cada sessão. Em texto (prompts, quebras de
+ linha) isso custa vários bytes por movimento; aqui cada movimento ocupa 2 bits:
+   0 = esquerda, 1 = direita, 2 = sair, 3 = comando inválido (ignorado, como no jogo)
+ Layout (little-endian):
+   cabeçalho: "DQRP" | versao u32 | numSalas u32 | impressao u32 | numSessoes u64 | movimentos u64
+   sessão:    numMovimentos u32 | reservado u32 | ceil(numMovimentos / 32) palavras u64
+ 32 movimentos por palavra, o primeiro nos bits baixos. A reprodução usa uma tabela
+ indexada por id de sala (pré-ordem): proximo[2*id + lado] = (destino << 1) | temPista.
+ Sem caminho, o destino é a própria sala e o bit de pista fica zerado, o que reproduz
+ PASSO_SEM_CAMINHO. Como a navegação só desce, cada sala com pista alcançada é uma
+ pista nova: não é preciso conjunto de coletadas.
+*/
+#define REPLAY_MAGICO "DQRP"
+#define REPLAY_VERSAO 1
+#define REPLAY_TAM_CABECALHO 32
+
+enum { MOV_ESQUERDA = 0, MOV_DIREITA = 1, MOV_SAIR = 2, MOV_INVALIDO = 3 };
+
+/* lerArquivoInteiro: carrega o arquivo em b (b->tam = bytes lidos) */
+static int lerArquivoInteiro(const char *caminho, BufferBin *b) {
+    FILE *in = fopen(caminho, "rb");
+    if (!in) {
+        fprintf(stderr, "Erro ao abrir %s\n", caminho);
+        return -1;
+    }
+    char bloco[1 << 16];
+    size_t lidos;
+    while ((lidos = fread(bloco, 1, sizeof(bloco), in)) > 0) anexarBin(b, bloco, lidos);
+    fclose(in);
+    return 0;
+}
+
+typedef struct GravadorReplay {
+    FILE *out;
+    BufferBin palavras;         // palavras da sessão em andamento
+    uint64_t palavra;
+    uint32_t movimentos;        // da sessão em andamento
+    uint64_t numSessoes, totalMovimentos;
+} GravadorReplay;
+
+int iniciarGravadorReplay(GravadorReplay *g, const char *caminho, Sala *mansao) {
+    memset(g, 0, sizeof(*g));
+    g->out = fopen(caminho, "wb");
+    if (!g->out) {
+        fprintf(stderr, "Não foi possível criar o replay %s\n", caminho);
+        return -1;
+    }
+    size_t n;
+    Sala **salas = coletarSalasPreOrdem(mansao, &n);
+    BufferBin cab = { NULL, 0, 0 };
+    anexarBin(&cab, REPLAY_MAGICO, 4);
+    anexarU32Bin(&cab, REPLAY_VERSAO);
+    anexarU32Bin(&cab, (uint32_t) n);
+    anexarU32Bin(&cab, impressaoMansao(salas, n));
+    anexarU64Bin(&cab, 0);
+    anexarU64Bin(&cab, 0);
+    fwrite(cab.dados, 1, cab.tam, g->out);
+    free(cab.dados);
+    free(salas);
+    return 0;
+}
+
+static int codigoMovimento(char c) {
+    switch (c) {
+    case 'e': case 'E': return MOV_ESQUERDA;
+    case 'd': case 'D': return MOV_DIREITA;
+    case 's': case 'S': return MOV_SAIR;
+    default: return MOV_INVALIDO;
+    }
+}
+
+/* anexarMovimentoReplay: acrescenta um comando à sessão em andamento */
+void anexarMovimentoReplay(GravadorReplay *g, char comando) {
+    g->palavra |= (uint64_t) codigoMovimento(comando) << (2 * (g->movimentos & 31));
+    if ((++g->movimentos & 31) == 0) {
+        anexarU64Bin(&g->palavras, g->palavra);
+        g->palavra = 0;
+    }
+}
+
+/* fecharSessaoReplay: grava o cabeçalho e as palavras da sessão em andamento */
+void fecharSessaoReplay(GravadorReplay *g) {
+    if (g->movimentos & 31) anexarU64Bin(&g->palavras, g->palavra);
+    uint32_t cab[2] = { g->movimentos, 0 };
+    fwrite(cab, sizeof(uint32_t), 2, g->out);
+    fwrite(g->palavras.dados, 1, g->palavras.tam, g->out);
+    g->numSessoes++;
+    g->totalMovimentos += g->movimentos;
+    g->palavras.tam = 0;
+    g->palavra = 0;
+    g->movimentos = 0;
+}
+
+int encerrarGravadorReplay(GravadorReplay *g) {
+    if (g->movimentos) fecharSessaoReplay(g);
+    uint64_t totais[2] = { g->numSessoes, g->totalMovimentos };
+    int erro = fseek(g->out, 16, SEEK_SET) != 0 || fwrite(totais, sizeof(uint64_t), 2, g->out) != 2;
+    if (fclose(g->out) != 0) erro = 1;
+    free(g->palavras.dados);
+    return erro ? -1 : 0;
+}
+
+/*
+ converterReplayTexto: lê um replay em texto e grava o formato compacto. Só contam como
+ comandos as palavras de uma letra e/d/s (maiúsculas ou minúsculas); prompts e outras
+ palavras ("Escolha:", "Hall") são ignorados. Cada 's' fecha uma sessão.
+*/
+int converterReplayTexto(const char *caminhoTexto, const char *caminhoSaida, Sala *mansao) {
+    FILE *in = fopen(caminhoTexto, "r");
+    if (!in) {
+        fprintf(stderr, "Erro ao abrir %s\n", caminhoTexto);
+        return -1;
+    }
+    GravadorReplay g;
+    if (iniciarGravadorReplay(&g, caminhoSaida, mansao) != 0) {
+        fclose(in);
+        return -1;
+    }
+    int c, anterior = ' ', candidato = 0;
+    do {
+        c = fgetc(in);
+        if (c != EOF && isalpha((unsigned char) c)) {
+            /* primeira letra de uma palavra vira candidata; uma segunda letra a descarta */
+            candidato = isalpha((unsigned char) anterior) ? 0 : c;
+        } else if (candidato) {
+            int mov = codigoMovimento((char) candidato);
+            if (mov != MOV_INVALIDO) {
+                anexarMovimentoReplay(&g, (char) candidato);
+                if (mov == MOV_SAIR) fecharSessaoReplay(&g);
+            }
+            candidato = 0;
+        }
+        anterior = c;
+    } while (c != EOF);
+    fclose(in);
+    printf("%llu sessões, %llu movimentos\n", (unsigned long long) g.numSessoes,
+           (unsigned long long) (g.totalMovimentos + g.movimentos));
+    return encerrarGravadorReplay(&g);
+}
+
+typedef struct TabelaReplay {
+    uint32_t *proximo;          // 2 por sala
+    uint32_t numSalas;
+    uint32_t impressao;
+    uint8_t pistaNoInicio;
+} TabelaReplay;
+
+int construirTabelaReplay(TabelaReplay *t, Sala *mansao) {
+    size_t n;
+    Sala **salas = coletarSalasPreOrdem(mansao, &n);
+    if (n >= (1u << 31)) {
+        free(salas);
+        return -1;
+    }
+    for (size_t i = 0; i < n; ++i) salas[i]->id = (uint32_t) i;
+    t->numSalas = (uint32_t) n;
+    t->impressao = impressaoMansao(salas, n);
+    t->pistaNoInicio = salas[0]->pista != NULL;
+    t->proximo = (uint32_t *) malloc(2 * n * sizeof(uint32_t));
+    if (!t->proximo) {
+        fprintf(stderr, "Falha ao alocar memória para tabela de replay\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const Sala *filhos[2] = { salas[i]->esq, salas[i]->dir };
+        for (int lado = 0; lado < 2; ++lado) {
+            t->proximo[2 * i + lado] = filhos[lado] ? (filhos[lado]->id << 1) | (filhos[lado]->pista != NULL)
+                                                    : (uint32_t) i << 1;
+        }
+    }
+    free(salas);
+    return 0;
+}
+
+void liberarTabelaReplay(TabelaReplay *t) {
+    free(t->proximo);
+    t->proximo = NULL;
+}
+
+typedef struct TotaisReplay {
+    uint64_t sessoes, movimentos, pistas;
+} TotaisReplay;
+
+/*
+ reproduzirReplay: executa todas as sessões do arquivo (já em memória). aoFim, se não
+ for NULL, recebe sala final e pistas coletadas de cada sessão. Retorna -1 se o arquivo
+ estiver truncado ou for de outra mansão.
+*/
+int reproduzirReplay(const unsigned char *dados, size_t tam, const TabelaReplay *t, TotaisReplay *totais,
+                     void (*aoFim)(uint64_t sessao, uint32_t sala, uint32_t pistas, void *ctx), void *ctx) {
+    CursorBin c = { dados, dados + tam, 0 };
+    const void *magico = lerBin(&c, 4);
+    uint32_t versao = lerU32Bin(&c), numSalas = lerU32Bin(&c), impressao = lerU32Bin(&c);
+    uint64_t numSessoes = lerU64Bin(&c);
+    lerU64Bin(&c);
+    if (!magico || memcmp(magico, REPLAY_MAGICO, 4) != 0 || versao != REPLAY_VERSAO || c.erro) {
+        fprintf(stderr, "Arquivo de replay inválido\n");
+        return -1;
+    }
+    if (numSalas != t->numSalas || impressao != t->impressao) {
+        fprintf(stderr, "Replay gravado para outra mansão\n");
+        return -1;
+    }
+    memset(totais, 0, sizeof(*totais));
+    const uint32_t *proximo = t->proximo;
+    for (uint64_t sessao = 0; sessao < numSessoes; ++sessao) {
+        uint32_t movimentos = lerU32Bin(&c);
+        lerU32Bin(&c);
+        size_t numPalavras = ((size_t) movimentos + 31) / 32;
+        const unsigned char *p = (const unsigned char *) lerBin(&c, numPalavras * sizeof(uint64_t));
+        if (c.erro || (numPalavras && !p)) {
+            fprintf(stderr, "Replay truncado na sessão %llu\n", (unsigned long long) sessao);
+            return -1;
+        }
+        uint32_t atual = 0, pistas = t->pistaNoInicio;
+        uint32_t restantes = movimentos;
+        for (size_t w = 0; w < numPalavras; ++w) {
+            uint64_t palavra;
+            memcpy(&palavra, p + w * sizeof(uint64_t), sizeof(palavra));
+            uint32_t k = restantes < 32 ? restantes : 32;
+            restantes -= k;
+            if (k == 32 && !(palavra & 0xAAAAAAAAAAAAAAAAull)) {
+                /* caminho rápido: 32 movimentos só de esquerda/direita */
+                for (int i = 0; i < 32; ++i, palavra >>= 2) {
+                    uint32_t v = proximo[2 * atual + (palavra & 1)];
+                    atual = v >> 1;
+                    pistas += v & 1;
+                }
+                continue;
+            }
+            for (uint32_t i = 0; i < k; ++i, palavra >>= 2) {
+                uint32_t mov = (uint32_t) (palavra & 3);
+                if (mov == MOV_SAIR) {
+                    restantes = 0;
+                    w = numPalavras;
+                    break;
+                }
+                if (mov == MOV_INVALIDO) continue;
+                uint32_t v = proximo[2 * atual + mov];
+                atual = v >> 1;
+                pistas += v & 1;
+            }
+        }
+        totais->sessoes++;
+        totais->movimentos += movimentos;
+        totais->pistas += pistas;
+        if (aoFim) aoFim(sessao, atual, pistas, ctx);
+    }
+    return 0;
+}
+
+/* reproduzirArquivoReplay: carrega o arquivo inteiro e reproduz sobre a mansão dada */
+int reproduzirArquivoReplay(const char *caminho, Sala *mansao) {
+    BufferBin arquivo = { NULL, 0, 0 };
+    if (lerArquivoInteiro(caminho, &arquivo) != 0) return -1;
+    TabelaReplay t;
+    TotaisReplay totais;
+    int r = construirTabelaReplay(&t, mansao);
+    double t0 = agoraSegundos();
+    if (r == 0) r = reproduzirReplay(arquivo.dados, arquivo.tam, &t, &totais, NULL, NULL);
+    double dt = agoraSegundos() - t0;
+    if (r == 0) {
+        printf("%llu sessões, %llu movimentos, %llu pistas coletadas (%.3f s)\n",
+               (unsigned long long) totais.sessoes, (unsigned long long) totais.movimentos,
+               (unsigned long long) totais.pistas, dt);
+    }
+    liberarTabelaReplay(&t);
+    free(arquivo.dados);
+    return r;
+}
+
+typedef struct ConferenciaReplay {
+    uint32_t *salaFinal, *pistas;
+} ConferenciaReplay;
+
+static void guardarFimReplay(uint64_t sessao, uint32_t sala, uint32_t pistas, void *ctx) {
+    ConferenciaReplay *c = (ConferenciaReplay *) ctx;
+    c->salaFinal[sessao] = sala;
+    c->pistas[sessao] = pistas;
+}
+
+/*
+ benchReplay: grava numSessoes sessões aleatórias com movimentosPorSessao comandos cada
+ (alguns inválidos, 's' no fim), relê o arquivo e reproduz. Confere com passoSessao
+ uma amostra das sessões.
+*/
+int benchReplay(size_t numSessoes, uint32_t movimentosPorSessao, const char *caminho) {
+    Sala *mansao = gerarMansaoSintetica(1u << 20);
+    static const char comandos[4] = { 'e', 'd', 's', 'x' };
+    GravadorReplay g;
+    if (iniciarGravadorReplay(&g, caminho, mansao) != 0) {
+        liberarSalas(mansao);
+        liberarHash();
+        return -1;
+    }
+    uint64_t semente = 8;
+    double t0 = agoraSegundos();
+    for (size_t i = 0; i < numSessoes; ++i) {
+        for (uint32_t k = 0; k + 1 < movimentosPorSessao; ++k) {
+            uint64_t r = aleatorio(&semente);
+            anexarMovimentoReplay(&g, comandos[(r & 255) == 0 ? 3 : (r >> 8) & 1]);
+        }
+        anexarMovimentoReplay(&g, 's');
+        fecharSessaoReplay(&g);
+    }
+    uint64_t totalMovimentos = g.totalMovimentos;
+    if (encerrarGravadorReplay(&g) != 0) {
+        liberarSalas(mansao);
+        liberarHash();
+        return -1;
+    }
+    double tGravar = agoraSegundos() - t0;
+
+    BufferBin arquivo = { NULL, 0, 0 };
+    if (lerArquivoInteiro(caminho, &arquivo) != 0) {
+        liberarSalas(mansao);
+        liberarHash();
+        return -1;
+    }
+
+    TabelaReplay t;
+    construirTabelaReplay(&t, mansao);
+    ConferenciaReplay conf;
+    conf.salaFinal = (uint32_t *) malloc(numSessoes * sizeof(uint32_t) + 1);
+    conf.pistas = (uint32_t *) malloc(numSessoes * sizeof(uint32_t) + 1);
+    if (!conf.salaFinal || !conf.pistas) {
+        fprintf(stderr, "Falha ao alocar memória para conferência do replay\n");
+        exit(EXIT_FAILURE);
+    }
+    TotaisReplay totais;
+    t0 = agoraSegundos();
+    int erro = reproduzirReplay(arquivo.dados, arquivo.tam, &t, &totais, guardarFimReplay, &conf);
+    double tReproduzir = agoraSegundos() - t0;
+
+    /* conferência: refaz as sessões de uma amostra com passoSessao */
+    size_t divergencias = 0;
+    semente = 8;
+    for (size_t i = 0; i < numSessoes && !erro; ++i) {
+        int conferir = i % 1009 == 0;
+        Sessao s;
+        if (conferir) iniciarSessao(&s, mansao, t.numSalas);
+        for (uint32_t k = 0; k + 1 < movimentosPorSessao; ++k) {
+            uint64_t r = aleatorio(&semente);
+            if (conferir) passoSessao(&s, comandos[(r & 255) == 0 ? 3 : (r >> 8) & 1]);
+        }
+        if (conferir) {
+            if (s.atual->id != conf.salaFinal[i] || s.coletadas.n != conf.pistas[i]) divergencias++;
+            encerrarSessao(&s);
+        }
+    }
+    printf("%zu sessões, %llu movimentos: %.1f MB (%.2f bits por movimento), gravado em %.2f s\n", numSessoes,
+           (unsigned long long) totalMovimentos, arquivo.tam / 1048576.0,
+           arquivo.tam * 8.0 / (double) (totalMovimentos ? totalMovimentos : 1), tGravar);
+    printf("Reprodução: %.3f s, %.0f M movimentos/s (%.0f MB/s); %llu pistas coletadas\n", tReproduzir,
+           totais.movimentos / tReproduzir / 1e6, arquivo.tam / tReproduzir / 1048576.0,
+           (unsigned long long) totais.pistas);
+    printf("Conferência com passoSessao: %s\n", erro || divergencias ? "DIVERGENTE" : "ok");
+    free(conf.salaFinal);
+    free(conf.pistas);
+    free(arquivo.dados);
+    liberarTabelaReplay(&t);
+    liberarSalas(mansao);
+    liberarHash();
+    return erro || divergencias ? -1 : 0;
+}
+
+/* =========================
+   Pistas citadas em teorias (Aho-Corasick)
+   ========================= */
+/*
+ Um autômato sobre os textos de todas as pistas encontra, numa única passada pela
+ teoria digitada pelo jogador, todas as pistas citadas nela, em O(tamanho + citações),
+ em vez de um strstr por pista. Maiúsculas/minúsculas não importam (ASCII e letras
+ acentuadas em UTF-8).
+ Tabela compacta:
+  - alfabeto reduzido: cada byte vira uma classe; bytes que não aparecem em nenhuma
+    pista caem na classe 0, que sempre volta à raiz;
+  - estados numerados em largura (BFS), de modo que os rasos (os mais visitados)
+    ficam juntos na memória;
+  - transições em formato CSR: os filhos de cada estado ficam contíguos e ordenados
+    por classe; só a raiz tem um vetor denso (uma entrada por classe);
+  - ligações de falha e de saída (próximo estado terminal na cadeia de falha).
+*/
+#define AC_SEM_PADRAO UINT32_MAX
+
+typedef struct AutomatoPistas {
+    uint8_t classe[256];
+    uint32_t numClasses;
+    uint32_t numEstados;
+    uint32_t *inicioFilhos;     // numEstados + 1
+    uint8_t *classeFilho;       // por aresta, ordenado dentro de cada estado
+    uint32_t *destinoFilho;
+    uint32_t *raiz;             // numClasses: transição densa da raiz
+    uint32_t *falha;
+    uint32_t *saidaSeguinte;    // próximo estado terminal na cadeia de falha (0 = nenhum)
+    uint32_t *padrao;           // padrão que termina no estado (AC_SEM_PADRAO se nenhum)
+    uint32_t *mesmoTexto;       // padrão seguinte com o mesmo texto normalizado
+    const char **pistas;        // padrão -> texto da pista (aponta para a tabela hash)
+    uint32_t *tamPadrao;
+    uint32_t numPadroes;
+} AutomatoPistas;
+
+static void *alocarAutomato(size_t n, size_t tam) {
+    return alocar_safe(NULL, n, tam, "o autômato de pistas");
+}
+
+/* normalizarByte: minúscula ASCII; em UTF-8, À..Þ (C3 80..9E, exceto ×) viram à..þ */
+static inline unsigned char normalizarByte(unsigned char anterior, unsigned char c) {
+    if (c >= 'A' && c <= 'Z') return (unsigned char) (c + 32);
+    if (anterior == 0xC3 && c >= 0x80 && c <= 0x9E && c != 0x97) return (unsigned char) (c + 0x20);
+    return c;
+}
+
+/* trie temporária da construção: filhos em lista (primeiro filho / irmão) */
+typedef struct NoTrieAc {
+    uint32_t primeiroFilho, irmao;
+    uint32_t padrao;
+    uint8_t classe;
+} NoTrieAc;
+
+/*
+ construirAutomatoDaHash: um padrão por pista da tabela hash (entradas sobrescritas
+ ficam com pistas[p] == NULL). O autômato aponta para os textos da tabela; reconstruir
+ se ela mudar.
+*/
+AutomatoPistas *construirAutomatoDaHash(void) {
+    AutomatoPistas *a = (AutomatoPistas *) alocarAutomato(1, sizeof(AutomatoPistas));
+    size_t cap = 0;
+    for (int i = 0; i < HASH_SIZE; ++i) {
+        for (HashEntry *e = tabelaHash[i]; e; e = e->prox) cap++;
+    }
+    a->pistas = (const char **) alocarAutomato(cap, sizeof(char *));
+    a->tamPadrao = (uint32_t *) alocarAutomato(cap, sizeof(uint32_t));
+    size_t totalBytes = 0;
+    for (int i = 0; i < HASH_SIZE; ++i) {
+        for (HashEntry *e = tabelaHash[i]; e; e = e->prox) {
+            if (!e->pista[0]) continue;
+            a->pistas[a->numPadroes] = e->pista;
+            a->tamPadrao[a->numPadroes] = (uint32_t) strlen(e->pista);
+            totalBytes += a->tamPadrao[a->numPadroes++];
+        }
+    }
+
+    /* alfabeto reduzido: classes na ordem dos bytes normalizados */
+    uint8_t presente[256] = { 0 };
+    for (uint32_t p = 0; p < a->numPadroes; ++p) {
+        unsigned char ant = 0;
+        for (const unsigned char *s = (const unsigned char *) a->pistas[p]; *s; ant = *s++) {
+            presente[normalizarByte(ant, *s)] = 1;
+        }
+    }
+    a->numClasses = 1;
+    for (int c = 0; c < 256; ++c) a->classe[c] = presente[c] ? (uint8_t) a->numClasses++ : 0;
+
+    /* trie (raiz densa já na construção, para não percorrer uma lista enorme de irmãos) */
+    NoTrieAc *nos = (NoTrieAc *) alocarAutomato(totalBytes + 1, sizeof(NoTrieAc));
+    uint32_t *filhoRaiz = (uint32_t *) alocarAutomato(a->numClasses, sizeof(uint32_t));
+    a->mesmoTexto = (uint32_t *) alocarAutomato(a->numPadroes, sizeof(uint32_t));
+    uint32_t numNos = 1;
+    nos[0].padrao = AC_SEM_PADRAO;
+    for (uint32_t p = 0; p < a->numPadroes; ++p) {
+        uint32_t atual = 0;
+        unsigned char ant = 0;
+        for (const unsigned char *s = (const unsigned char *) a->pistas[p]; *s; ant = *s++) {
+            uint8_t cl = a->classe[normalizarByte(ant, *s)];
+            uint32_t filho = 0;
+            if (atual == 0) {
+                filho = filhoRaiz[cl];
+            } else {
+                for (uint32_t f = nos[atual].primeiroFilho; f; f = nos[f].irmao) {
+                    if (nos[f].classe == cl) {
+                        filho = f;
+                        break;
+                    }
+                }
+            }
+            if (!filho) {
+                filho = numNos++;
+                nos[filho].classe = cl;
+                nos[filho].padrao = AC_SEM_PADRAO;
+                if (atual == 0) {
+                    filhoRaiz[cl] = filho;
+                } else {
+                    nos[filho].irmao = nos[atual].primeiroFilho;
+                    nos[atual].primeiroFilho = filho;
+                }
+            }
+            atual = filho;
+        }
+        /* a tabela insere no início da lista: a primeira ocorrência vista é a vigente */
+        int repetida = 0;
+        for (uint32_t q = nos[atual].padrao; q != AC_SEM_PADRAO && !repetida; q = a->mesmoTexto[q]) {
+            repetida = strcmp(a->pistas[q], a->pistas[p]) == 0;
+        }
+        if (repetida) {
+            a->pistas[p] = NULL;
+            continue;
+        }
+        a->mesmoTexto[p] = nos[atual].padrao;
+        nos[atual].padrao = p;
+    }
+    nos[0].primeiroFilho = 0;
+    for (uint32_t cl = a->numClasses; cl-- > 1;) {
+        if (filhoRaiz[cl]) {
+            nos[filhoRaiz[cl]].irmao = nos[0].primeiroFilho;
+            nos[0].primeiroFilho = filhoRaiz[cl];
+        }
+    }
+    free(filhoRaiz);
+
+    /* renumeração em largura; filhos de cada estado ordenados por classe */
+    a->numEstados = numNos;
+    uint32_t *ordem = (uint32_t *) alocarAutomato(numNos, sizeof(uint32_t));   // novo -> antigo
+    uint32_t *novoId = (uint32_t *) alocarAutomato(numNos, sizeof(uint32_t));
+    a->inicioFilhos = (uint32_t *) alocarAutomato((size_t) numNos + 1, sizeof(uint32_t));
+    a->classeFilho = (uint8_t *) alocarAutomato(numNos, sizeof(uint8_t));
+    a->destinoFilho = (uint32_t *) alocarAutomato(numNos, sizeof(uint32_t));
+    uint32_t *filhos = (uint32_t *) alocarAutomato(a->numClasses, sizeof(uint32_t));
+    uint32_t fim = 1, arestas = 0;
+    for (uint32_t i = 0; i < fim; ++i) {
+        uint32_t antigo = ordem[i];
+        uint32_t k = 0;
+        for (uint32_t f = nos[antigo].primeiroFilho; f; f = nos[f].irmao) filhos[k++] = f;
+        /* ordenação por inserção (poucos filhos por estado) */
+        for (uint32_t x = 1; x < k; ++x) {
+            uint32_t v = filhos[x], y = x;
+            while (y > 0 && nos[filhos[y - 1]].classe > nos[v].classe) {
+                filhos[y] = filhos[y - 1];
+                y--;
+            }
+            filhos[y] = v;
+        }
+        a->inicioFilhos[i] = arestas;
+        for (uint32_t x = 0; x < k; ++x) {
+            novoId[filhos[x]] = fim;
+            ordem[fim++] = filhos[x];
+            a->classeFilho[arestas] = nos[filhos[x]].classe;
+            a->destinoFilho[arestas++] = novoId[filhos[x]];
+        }
+    }
+    a->inicioFilhos[numNos] = arestas;
+    free(filhos);
+
+    a->padrao = (uint32_t *) alocarAutomato(numNos, sizeof(uint32_t));
+    for (uint32_t i = 0; i < numNos; ++i) a->padrao[i] = nos[ordem[i]].padrao;
+    free(nos);
+    free(ordem);
+    free(novoId);
+
+    /* raiz densa, falhas e saídas em largura (a ordem dos estados já é BFS) */
+    a->raiz = (uint32_t *) alocarAutomato(a->numClasses, sizeof(uint32_t));
+    for (uint32_t e = a->inicioFilhos[0]; e < a->inicioFilhos[1]; ++e) a->raiz[a->classeFilho[e]] = a->destinoFilho[e];
+    a->falha = (uint32_t *) alocarAutomato(numNos, sizeof(uint32_t));
+    a->saidaSeguinte = (uint32_t *) alocarAutomato(numNos, sizeof(uint32_t));
+    for (uint32_t s = 0; s < numNos; ++s) {
+        for (uint32_t e = a->inicioFilhos[s]; e < a->inicioFilhos[s + 1]; ++e) {
+            uint32_t filho = a->destinoFilho[e];
+            uint8_t cl = a->classeFilho[e];
+            uint32_t f = 0;
+            if (s != 0) {
+                uint32_t t = a->falha[s];
+                for (;;) {
+                    uint32_t prox = 0;
+                    if (t == 0) {
+                        prox = a->raiz[cl];
+                    } else {
+                        for (uint32_t g = a->inicioFilhos[t]; g < a->inicioFilhos[t + 1]; ++g) {
+                            if (a->classeFilho[g] == cl) {
+                                prox = a->destinoFilho[g];
+                                break;
+                            }
+                        }
+                    }
+                    if (prox || t == 0) {
+                        f = prox;
+                        break;
+                    }
+                    t = a->falha[t];
+                }
+            }
+            a->falha[filho] = f;
+            a->saidaSeguinte[filho] = a->padrao[f] != AC_SEM_PADRAO ? f : a->saidaSeguinte[f];
+        }
+    }
+    return a;
+}
+
+void liberarAutomato(AutomatoPistas *a) {
+    if (!a) return;
+    free(a->inicioFilhos);
+    free(a->classeFilho);
+    free(a->destinoFilho);
+    free(a->raiz);
+    free(a->falha);
+    free(a->saidaSeguinte);
+    free(a->padrao);
+    free(a->mesmoTexto);
+    free(a->pistas);
+    free(a->tamPadrao);
+    free(a);
+}
+
+/* transição de s pela classe cl (0 se não houver aresta); s != 0 */
+static inline uint32_t filhoAutomato(const AutomatoPistas *a, uint32_t s, uint8_t cl) {
+    uint32_t lo = a->inicioFilhos[s], hi = a->inicioFilhos[s + 1];
+    if (hi - lo <= 8) {
+        for (; lo < hi; ++lo) {
+            if (a->classeFilho[lo] == cl) return a->destinoFilho[lo];
+        }
+        return 0;
+    }
+    while (lo < hi) {
+        uint32_t meio = lo + (hi - lo) / 2;
+        if (a->classeFilho[meio] < cl) lo = meio + 1;
+        else hi = meio;
+    }
+    return lo < a->inicioFilhos[s + 1] && a->classeFilho[lo] == cl ? a->destinoFilho[lo] : 0;
+}
+
+/*
+ casarTeoria: percorre o texto uma vez e chama aoCasar(padrão, posição final) para cada
+ ocorrência de pista. Retorna o número de ocorrências.
+*/
+size_t casarTeoria(const AutomatoPistas *a, const char *texto,
+                   void (*aoCasar)(uint32_t padrao, size_t fim, void *ctx), void *ctx) {
+    size_t ocorrencias = 0;
+    uint32_t s = 0;
+    unsigned char ant = 0;
+    for (size_t i = 0; texto[i]; ++i) {
+        unsigned char c = (unsigned char) texto[i];
+        uint8_t cl = a->classe[normalizarByte(ant, c)];
+        ant = c;
+        if (cl == 0) {
+            s = 0;
+            continue;
+        }
+        while (s != 0) {
+            uint32_t prox = filhoAutomato(a, s, cl);
+            if (prox) break;
+            s = a->falha[s];
+        }
+        s = s == 0 ? a->raiz[cl] : filhoAutomato(a, s, cl);
+        for (uint32_t t = a->padrao[s] != AC_SEM_PADRAO ? s : a->saidaSeguinte[s]; t; t = a->saidaSeguinte[t]) {
+            for (uint32_t p = a->padrao[t]; p != AC_SEM_PADRAO; p = a->mesmoTexto[p]) {
+                ocorrencias++;
+                if (aoCasar) aoCasar(p, i + 1, ctx);
+            }
+        }
+    }
+    return ocorrencias;
+}
+
+static void exibirPistaCitada(uint32_t padrao, size_t fim, void *ctx) {
+    const AutomatoPistas *a = (const AutomatoPistas *) ctx;
+    const char *suspeito = encontrarSuspeito(a->pistas[padrao]);
+    printf(" - \"%s\" (posição %zu), aponta para %s\n", a->pistas[padrao], fim - a->tamPadrao[padrao],
+           suspeito ? suspeito : "ninguém");
+}
+
+/* analisarTeoria: lista as pistas conhecidas citadas no texto */
+void analisarTeoria(const char *teoria) {
+    AutomatoPistas *a = construirAutomatoDaHash();
+    printf("Pistas citadas na teoria:\n");
+    if (casarTeoria(a, teoria, exibirPistaCitada, a) == 0) printf(" (nenhuma)\n");
+    liberarAutomato(a);
+}
+
+/* contagem de referência com strstr (sem distinguir maiúsculas: ASCII) */
+static size_t contarComStrstr(const AutomatoPistas *a, const char *texto) {
+    size_t n = 0;
+    for (uint32_t p = 0; p < a->numPadroes; ++p) {
+        if (!a->pistas[p]) continue;
+        for (const char *s = strcasestr(texto, a->pistas[p]); s; s = strcasestr(s + 1, a->pistas[p])) n++;
+    }
+    return n;
+}
+
+/*
+ benchTeorias: pistas sintéticas ("pista numero N encontrada na sala") e teorias que
+ citam algumas delas no meio de texto livre; compara com strstr pista a pista.
+*/
+int benchTeorias(size_t numSalas, size_t numTeorias) {
+    Sala *mansao = gerarMansaoSintetica(numSalas);
+    double t0 = agoraSegundos();
+    AutomatoPistas *a = construirAutomatoDaHash();
+    double tConstrucao = agoraSegundos() - t0;
+    size_t bytesTabela = (a->numEstados + 1) * sizeof(uint32_t) * 4 + a->inicioFilhos[a->numEstados] * 5 +
+                         a->numClasses * sizeof(uint32_t);
+
+    uint64_t semente = 3;
+    char **teorias = (char **) alocarAutomato(numTeorias, sizeof(char *));
+    size_t bytesTeorias = 0;
+    for (size_t i = 0; i < numTeorias; ++i) {
+        char buf[512];
+        size_t id1 = (aleatorio(&semente) % (numSalas / 2 + 1)) * 2, id2 = (aleatorio(&semente) % (numSalas / 2 + 1)) * 2;
+        snprintf(buf, sizeof(buf), "Acho que a PISTA NUMERO %zu encontrada na sala prova tudo; já a pista numero %zu "
+                 "encontrada na sala foi plantada pelo mordomo, que estava no jardim durante o jantar.", id1, id2);
+        teorias[i] = strdup_safe(buf);
+        bytesTeorias += strlen(buf);
+    }
+    size_t total = 0;
+    MedicaoHw medicao;
+    iniciarMedicaoHw(&medicao);
+    t0 = agoraSegundos();
+    for (size_t i = 0; i < numTeorias; ++i) total += casarTeoria(a, teorias[i], NULL, NULL);
+    double tAutomato = agoraSegundos() - t0;
+    encerrarMedicaoHw(&medicao, "casarTeoria", numTeorias);
+
+    size_t amostra = numTeorias < 20 ? numTeorias : 20, totalRef = 0, totalAmostra = 0;
+    t0 = agoraSegundos();
+    for (size_t i = 0; i < amostra; ++i) {
+        totalRef += contarComStrstr(a, teorias[i]);
+        totalAmostra += casarTeoria(a, teorias[i], NULL, NULL);
+    }
+    double tStrstr = agoraSegundos() - t0;
+
+    printf("%u pistas: %u estados, %u classes, tabela ~%.1f MB, construída em %.3f s\n", a->numPadroes,
+           a->numEstados, a->numClasses, bytesTabela / 1048576.0, tConstrucao);
+    printf("%zu teorias: autômato %.2f us por teoria (%.0f MB/s), strstr por pista %.0f us por teoria; %zu citações\n",
+           numTeorias, tAutomato * 1e6 / (double) numTeorias, bytesTeorias / tAutomato / 1048576.0,
+           tStrstr * 1e6 / (double) amostra, total);
+    printf("Conferência com strstr (amostra): %s\n", totalRef == totalAmostra ? "ok" : "DIVERGENTE");
+    for (size_t i = 0; i < numTeorias; ++i) free(teorias[i]);
+    free(teorias);
+    liberarAutomato(a);
+    liberarSalas(mansao);
+    liberarHash();
+    return totalRef == totalAmostra ? 0 : -1;
+}
+
+/* =========================
+   Índice invertido de palavras das pistas
+   ========================= */
+/*
+ Ferramentas de suporte perguntam "quais pistas mencionam 'luva'?" sobre catálogos com
+ milhões de pistas. O índice associa cada palavra normalizada (minúscula, acentos
+ preservados) à lista dos ids das pistas que a contêm:
+  - dicionário de termos em endereçamento aberto (sondagem linear);
+  - lista de postagens com os ids em ordem crescente, codificados como deltas varint
+    (1 byte para ids próximos); como os ids da tabela hash só crescem, inserir uma
+    pista nova é sempre um acréscimo no fim da lista;
+  - a cada POSTAGENS_POR_SALTO ids, um ponto de salto (id + deslocamento) permite que a
+    interseção avance por busca galopante sem decodificar a lista inteira.
+ Consultas com vários termos partem da lista mais curta e galopam nas demais.
+ ativarIndicePalavras constrói o índice de uma vez a partir da tabela; depois disso,
+ inserirNaHash mantém o índice atualizado.
+*/
+#define POSTAGENS_POR_SALTO 64
+#define PALAVRA_MAX 64
+
+typedef struct ListaPostagens {
+    unsigned char *bytes;       // deltas varint
+    size_t tam, cap;
+    uint32_t ultimo;            // último id acrescentado
+    uint32_t quantos;
+    uint32_t *saltoId;          // id da postagem k * POSTAGENS_POR_SALTO
+    uint32_t *saltoPos;         // deslocamento logo após o varint dessa postagem
+    uint32_t numSaltos, capSaltos;
+} ListaPostagens;
+
+struct IndicePalavras {
+    char **termos;
+    ListaPostagens *listas;
+    uint32_t numTermos, capTermos;
+    uint32_t *vagas;            // índice do termo + 1 (0 = vaga livre); potência de 2
+    uint32_t capVagas;
+    HashEntry **porId;          // id da pista -> entrada (NULL se ainda não indexada)
+    uint32_t capIds;
+};
+
+IndicePalavras *indicePalavrasAtivo = NULL;
+
+static void *alocarIndice(void *p, size_t n, size_t tam) {
+    return alocar_safe(p, n, tam, "o índice de palavras");
+}
+
+static uint64_t hashTermo(const char *s, size_t n) {
+    uint64_t h = 1469598103934665603ULL;   // FNV-1a
+    for (size_t i = 0; i < n; ++i) h = (h ^ (unsigned char) s[i]) * 1099511628211ULL;
+    return h;
+}
+
+/*
+ proximaPalavra: extrai a próxima palavra normalizada de *texto (letras, dígitos e bytes
+ UTF-8 não ASCII). Palavras maiores que PALAVRA_MAX - 1 bytes são truncadas. Retorna o
+ tamanho (0 no fim do texto).
+*/
+static size_t proximaPalavra(const char **texto, char *palavra) {
+    const unsigned char *s = (const unsigned char *) *texto;
+    while (*s && !(isalnum(*s) || *s >= 0x80)) s++;
+    size_t n = 0;
+    unsigned char ant = 0;
+    for (; *s && (isalnum(*s) || *s >= 0x80); ant = *s++) {
+        if (n < PALAVRA_MAX - 1) palavra[n++] = (char) normalizarByte(ant, *s);
+    }
+    palavra[n] = '\0';
+    *texto = (const char *) s;
+    return n;
+}
+
+/* buscarTermo: índice do termo, ou UINT32_MAX; com criar, insere se não existir */
+static uint32_t buscarTermo(IndicePalavras *ind, const char *palavra, size_t n, int criar) {
+    if (ind->capVagas == 0 && !criar) return UINT32_MAX;
+    if (criar && (ind->numTermos + 1) * 2 > ind->capVagas) {
+        uint32_t nova = ind->capVagas ? ind->capVagas * 2 : 1024;
+        uint32_t *vagas = (uint32_t *) calloc(nova, sizeof(uint32_t));
+        if (!vagas) {
+            fprintf(stderr, "Falha ao alocar memória para o índice de palavras\n");
+            exit(EXIT_FAILURE);
+        }
+        for (uint32_t t = 0; t < ind->numTermos; ++t) {
+            uint32_t v = (uint32_t) hashTermo(ind->termos[t], strlen(ind->termos[t])) & (nova - 1);
+            while (vagas[v]) v = (v + 1) & (nova - 1);
+            vagas[v] = t + 1;
+        }
+        free(ind->vagas);
+        ind->vagas = vagas;
+        ind->capVagas = nova;
+    }
+    uint32_t v = (uint32_t) hashTermo(palavra, n) & (ind->capVagas - 1);
+    for (; ind->vagas[v]; v = (v + 1) & (ind->capVagas - 1)) {
+        uint32_t t = ind->vagas[v] - 1;
+        if (strncmp(ind->termos[t], palavra, n) == 0 && ind->termos[t][n] == '\0') return t;
+    }
+    if (!criar) return UINT32_MAX;
+    if (ind->numTermos == ind->capTermos) {
+        ind->capTermos = ind->capTermos ? ind->capTermos * 2 : 256;
+        ind->termos = (char **) alocarIndice(ind->termos, ind->capTermos, sizeof(char *));
+        ind->listas = (ListaPostagens *) alocarIndice(ind->listas, ind->capTermos, sizeof(ListaPostagens));
+    }
+    uint32_t t = ind->numTermos++;
+    ind->termos[t] = strdup_safe(palavra);
+    memset(&ind->listas[t], 0, sizeof(ListaPostagens));
+    ind->vagas[v] = t + 1;
+    return t;
+}
+
+/* acrescentarPostagem: ids chegam em ordem crescente; repetições da mesma pista são ignoradas */
+static void acrescentarPostagem(ListaPostagens *l, uint32_t id) {
+    if (l->quantos > 0 && id <= l->ultimo) return;
+    uint32_t delta = l->quantos > 0 ? id - l->ultimo : id;
+    if (l->tam + 5 > l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 8;
+        l->bytes = (unsigned char *) alocarIndice(l->bytes, l->cap, 1);
+    }
+    while (delta >= 0x80) {
+        l->bytes[l->tam++] = (unsigned char) (delta | 0x80);
+        delta >>= 7;
+    }
+    l->bytes[l->tam++] = (unsigned char) delta;
+    if (l->quantos % POSTAGENS_POR_SALTO == 0) {
+        if (l->numSaltos == l->capSaltos) {
+            l->capSaltos = l->capSaltos ? l->capSaltos * 2 : 1;
+            l->saltoId = (uint32_t *) alocarIndice(l->saltoId, l->capSaltos, sizeof(uint32_t));
+            l->saltoPos = (uint32_t *) alocarIndice(l->saltoPos, l->capSaltos, sizeof(uint32_t));
+        }
+        l->saltoId[l->numSaltos] = id;
+        l->saltoPos[l->numSaltos++] = (uint32_t) l->tam;
+    }
+    l->ultimo = id;
+    l->quantos++;
+}
+
+/* indexarEntradaPalavras: acrescenta a pista às listas de cada palavra do seu texto */
+void indexarEntradaPalavras(IndicePalavras *ind, HashEntry *e) {
+    if (e->id >= ind->capIds) {
+        uint32_t nova = ind->capIds ? ind->capIds : 1024;
+        while (nova <= e->id) nova *= 2;
+        ind->porId = (HashEntry **) alocarIndice(ind->porId, nova, sizeof(HashEntry *));
+        memset(ind->porId + ind->capIds, 0, (nova - ind->capIds) * sizeof(HashEntry *));
+        ind->capIds = nova;
+    }
+    ind->porId[e->id] = e;
+    char palavra[PALAVRA_MAX];
+    const char *s = e->pista;
+    size_t n;
+    while ((n = proximaPalavra(&s, palavra)) > 0) {
+        uint32_t t = buscarTermo(ind, palavra, n, 1);   // pode realocar ind->listas
+        acrescentarPostagem(&ind->listas[t], e->id);
+    }
+}
+
+/* esquecerEntradaPalavras: a entrada saiu da tabela; suas postagens ficam, mas o id não é mais vigente */
+void esquecerEntradaPalavras(IndicePalavras *ind, const HashEntry *e) {
+    if (e->id < ind->capIds) ind->porId[e->id] = NULL;
+}
+
+/* esvaziarIndicePalavras: descarta termos e postagens (a tabela hash foi liberada) */
+void esvaziarIndicePalavras(IndicePalavras *ind) {
+    for (uint32_t t = 0; t < ind->numTermos; ++t) {
+        free(ind->termos[t]);
+        free(ind->listas[t].bytes);
+        free(ind->listas[t].saltoId);
+        free(ind->listas[t].saltoPos);
+    }
+    free(ind->termos);
+    free(ind->listas);
+    free(ind->vagas);
+    free(ind->porId);
+    memset(ind, 0, sizeof(*ind));
+}
+
+/*
+ ativarIndicePalavras: constrói o índice de uma vez (pistas em ordem de id, para que
+ as listas saiam ordenadas) e o torna o índice mantido por inserirNaHash.
+*/
+IndicePalavras *ativarIndicePalavras(void) {
+    IndicePalavras *ind = (IndicePalavras *) calloc(1, sizeof(IndicePalavras));
+    if (!ind) {
+        fprintf(stderr, "Falha ao alocar memória para o índice de palavras\n");
+        exit(EXIT_FAILURE);
+    }
+    HashEntry **porId = (HashEntry **) calloc(totalPistasHash ? totalPistasHash : 1, sizeof(HashEntry *));
+    if (!porId) {
+        fprintf(stderr, "Falha ao alocar memória para o índice de palavras\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < HASH_SIZE; ++i) {
+        for (HashEntry *e = tabelaHash[i]; e; e = e->prox) porId[e->id] = e;
+    }
+    for (uint32_t id = 0; id < totalPistasHash; ++id) {
+        if (porId[id]) indexarEntradaPalavras(ind, porId[id]);
+    }
+    free(porId);
+    indicePalavrasAtivo = ind;
+    return ind;
+}
+
+void desativarIndicePalavras(void) {
+    if (!indicePalavrasAtivo) return;
+    esvaziarIndicePalavras(indicePalavrasAtivo);
+    free(indicePalavrasAtivo);
+    indicePalavrasAtivo = NULL;
+}
+
+/* cursor de leitura de uma lista de postagens */
+typedef struct CursorPostagens {
+    const ListaPostagens *l;
+    uint32_t salto;             // bloco atual
+    size_t pos;
+    uint32_t atual;
+    uint32_t lidos;             // postagens já lidas (para detectar o fim)
+} CursorPostagens;
+
+static inline int avancarCursor(CursorPostagens *c) {
+    if (c->lidos >= c->l->quantos) return 0;
+    uint32_t delta = 0;
+    int desloc = 0;
+    unsigned char b;
+    do {
+        b = c->l->bytes[c->pos++];
+        delta |= (uint32_t) (b & 0x7F) << desloc;
+        desloc += 7;
+    } while (b & 0x80);
+    c->atual = c->lidos == 0 ? delta : c->atual + delta;
+    c->lidos++;
+    return 1;
+}
+
+/* avancarAte: primeira postagem >= alvo, galopando sobre os pontos de salto; 0 no fim da lista */
+static int avancarAte(CursorPostagens *c, uint32_t alvo) {
+    const ListaPostagens *l = c->l;
+    if (c->lidos > 0 && c->atual >= alvo) return 1;
+    /* maior bloco k >= c->salto com saltoId[k] <= alvo: galope e depois busca binária */
+    uint32_t lo = c->salto, passo = 1;
+    while (lo + passo < l->numSaltos && l->saltoId[lo + passo] <= alvo) {
+        lo += passo;
+        passo *= 2;
+    }
+    uint32_t hi = lo + passo < l->numSaltos ? lo + passo : l->numSaltos;
+    while (lo + 1 < hi) {
+        uint32_t meio = lo + (hi - lo) / 2;
+        if (l->saltoId[meio] <= alvo) lo = meio;
+        else hi = meio;
+    }
+    if (c->lidos == 0 || lo > c->salto) {
+        c->salto = lo;
+        c->pos = l->saltoPos[lo];
+        c->atual = l->saltoId[lo];
+        c->lidos = lo * POSTAGENS_POR_SALTO + 1;
+    }
+    while (c->atual < alvo) {
+        if (!avancarCursor(c)) return 0;
+    }
+    c->salto = (c->lidos - 1) / POSTAGENS_POR_SALTO;
+    return 1;
+}
+
+static int compararQuantos(const void *a, const void *b) {
+    uint32_t x = (*(const ListaPostagens *const *) a)->quantos, y = (*(const ListaPostagens *const *) b)->quantos;
+    return (x > y) - (x < y);
+}
+
+#define CONSULTA_PALAVRAS_MAX 32
+
+/*
+ buscarPalavras: ids (crescentes) das pistas que contêm todas as palavras da consulta.
+ *ids é alocado aqui e liberado pelo chamador. Pistas sobrescritas na tabela também
+ aparecem; ver pistaVigenteIndice. Consultas com mais de CONSULTA_PALAVRAS_MAX palavras
+ distintas são recusadas (0 resultados e aviso em stderr), em vez de ignorar o excesso.
+*/
+size_t buscarPalavras(IndicePalavras *ind, const char *consulta, uint32_t **ids) {
+    *ids = NULL;
+    const ListaPostagens *listas[CONSULTA_PALAVRAS_MAX];
+    size_t numListas = 0;
+    char palavra[PALAVRA_MAX];
+    size_t n;
+    while ((n = proximaPalavra(&consulta, palavra)) > 0) {
+        uint32_t t = buscarTermo(ind, palavra, n, 0);
+        if (t == UINT32_MAX) return 0;
+        int repetida = 0;
+        for (size_t i = 0; i < numListas; ++i) repetida |= listas[i] == &ind->listas[t];
+        if (repetida) continue;
+        if (numListas == CONSULTA_PALAVRAS_MAX) {
+            fprintf(stderr, "Consulta com mais de %d palavras distintas\n", CONSULTA_PALAVRAS_MAX);
+            return 0;
+        }
+        listas[numListas++] = &ind->listas[t];
+    }
+    if (numListas == 0) return 0;
+    qsort(listas, numListas, sizeof(listas[0]), compararQuantos);
+
+    uint32_t *res = (uint32_t *) alocarIndice(NULL, listas[0]->quantos, sizeof(uint32_t));
+    size_t total = 0;
+    CursorPostagens menor = { listas[0], 0, 0, 0, 0 };
+    while (avancarCursor(&menor)) res[total++] = menor.atual;
+    for (size_t i = 1; i < numListas && total > 0; ++i) {
+        CursorPostagens c = { listas[i], 0, 0, 0, 0 };
+        size_t mantidos = 0;
+        for (size_t k = 0; k < total; ++k) {
+            if (!avancarAte(&c, res[k])) break;
+            if (c.atual == res[k]) res[mantidos++] = res[k];
+        }
+        total = mantidos;
+    }
+    if (total == 0) {
+        free(res);
+        return 0;
+    }
+    *ids = res;
+    return total;
+}
+
+/* pistaVigenteIndice: entrada do id, ou NULL se a pista foi sobrescrita por outra inserção */
+HashEntry *pistaVigenteIndice(const IndicePalavras *ind, uint32_t id) {
+    HashEntry *e = id < ind->capIds ? ind->porId[id] : NULL;
+    return e && buscarEntradaHash(e->pista) == e ? e : NULL;
+}
+
+/* listarPistasComPalavras: modo --buscar-palavras sobre a tabela hash atual */
+void listarPistasComPalavras(const char *consulta) {
+    IndicePalavras *ind = indicePalavrasAtivo ? indicePalavrasAtivo : ativarIndicePalavras();
+    uint32_t *ids;
+    size_t n = buscarPalavras(ind, consulta, &ids), exibidas = 0;
+    printf("Pistas com \"%s\":\n", consulta);
+    for (size_t i = 0; i < n; ++i) {
+        HashEntry *e = pistaVigenteIndice(ind, ids[i]);
+        if (!e) continue;
+        printf(" - \"%s\" -> %s\n", e->pista, nomeSuspeito(e->idSuspeito));
+        exibidas++;
+    }
+    if (exibidas == 0) printf(" (nenhuma)\n");
+    free(ids);
+}
+
+/* contém todas as palavras da consulta? (referência para o benchmark) */
+static int contemPalavras(const char *texto, char palavras[][PALAVRA_MAX], size_t numPalavras) {
+    char palavra[PALAVRA_MAX];
+    uint32_t achadas = 0;
+    while (proximaPalavra(&texto, palavra) > 0) {
+        for (size_t i = 0; i < numPalavras; ++i) {
+            if (strcmp(palavra, palavras[i]) == 0) achadas |= 1u << i;
+        }
+    }
+    return achadas == (1u << numPalavras) - 1;
+}
+
+static const char *raizesSinteticas[] = { "luva", "poeira", "copo", "chave", "carta", "faca", "lenço", "pegada",
+                                           "vela", "livro", "relógio", "anel", "botão", "frasco", "mancha", "corda" };
+#define NUM_RAIZES_SINTETICAS (sizeof(raizesSinteticas) / sizeof(raizesSinteticas[0]))
+#define VOCABULARIO_SINTETICO 50000
+
+/* palavraSintetica: palavra de posto k; as 16 primeiras são raízes comuns, o resto raiz_k */
+static void palavraSintetica(char *buf, size_t tam, size_t k) {
+    if (k < NUM_RAIZES_SINTETICAS) snprintf(buf, tam, "%s", raizesSinteticas[k]);
+    else snprintf(buf, tam, "%s_%zu", raizesSinteticas[k % NUM_RAIZES_SINTETICAS], k);
+}
+
+/* postoSintetico: posto com distribuição concentrada nos primeiros (u^3) */
+static size_t postoSintetico(uint64_t *semente) {
+    double u = (double) (aleatorio(semente) >> 11) * 0x1p-53;
+    return (size_t) (u * u * u * VOCABULARIO_SINTETICO);
+}
+
+/*
+ benchPalavras: catálogo sintético de pistas com vocabulário de frequência desigual
+ (poucas palavras muito comuns, muitas raras). Metade entra pela construção em bloco e
+ metade por inserirNaHash com o índice ativo. Consultas de 1 a 3 palavras; uma amostra
+ é conferida contra a varredura de todas as pistas.
+*/
+int benchPalavras(size_t numPistas, size_t numConsultas) {
+    uint64_t semente = 11;
+    char pista[160], suspeito[32];
+    double t0 = agoraSegundos(), tBloco = 0;
+    for (size_t i = 0; i < numPistas; ++i) {
+        if (i == numPistas / 2) {
+            double t1 = agoraSegundos();
+            ativarIndicePalavras();
+            tBloco = agoraSegundos() - t1;
+        }
+        size_t tam = 0;
+        for (int w = 0; w < 6; ++w) {
+            char p[48];
+            palavraSintetica(p, sizeof(p), postoSintetico(&semente));
+            tam += (size_t) snprintf(pista + tam, sizeof(pista) - tam, "%s%s", w ? " " : "", p);
+        }
+        snprintf(suspeito, sizeof(suspeito), "Suspeito %zu", i % 97);
+        inserirNaHash(pista, suspeito);
+    }
+    double tCarga = agoraSegundos() - t0;
+    IndicePalavras *ind = indicePalavrasAtivo ? indicePalavrasAtivo : ativarIndicePalavras();  // catálogo vazio
+
+    size_t bytesPostagens = 0, numPostagens = 0;
+    for (uint32_t t = 0; t < ind->numTermos; ++t) {
+        bytesPostagens += ind->listas[t].tam + ind->listas[t].numSaltos * 8;
+        numPostagens += ind->listas[t].quantos;
+    }
+
+    char (*consultas)[160] = (char (*)[160]) alocarIndice(NULL, numConsultas, 160);
+    for (size_t q = 0; q < numConsultas; ++q) {
+        size_t tam = 0;
+        int palavras = 1 + (int) (aleatorio(&semente) % 3);
+        for (int w = 0; w < palavras; ++w) {
+            char p[48];
+            palavraSintetica(p, sizeof(p), postoSintetico(&semente));
+            tam += (size_t) snprintf(consultas[q] + tam, 160 - tam, "%s%s", w ? " " : "", p);
+        }
+    }
+    size_t resultados = 0;
+    MedicaoHw medicao;
+    iniciarMedicaoHw(&medicao);
+    t0 = agoraSegundos();
+    for (size_t q = 0; q < numConsultas; ++q) {
+        uint32_t *ids;
+        resultados += buscarPalavras(ind, consultas[q], &ids);
+        free(ids);
+    }
+    double tConsultas = agoraSegundos() - t0;
+    encerrarMedicaoHw(&medicao, "buscarPalavras", numConsultas);
+
+    /* conferência: varredura de todas as pistas */
+    size_t amostra = numConsultas < 20 ? numConsultas : 20, divergencias = 0;
+    t0 = agoraSegundos();
+    for (size_t q = 0; q < amostra; ++q) {
+        char palavras[CONSULTA_PALAVRAS_MAX][PALAVRA_MAX];
+        size_t numPalavras = 0;
+        const char *s = consultas[q];
+        while (numPalavras < CONSULTA_PALAVRAS_MAX && proximaPalavra(&s, palavras[numPalavras]) > 0) numPalavras++;
+        uint32_t *ids;
+        size_t n = buscarPalavras(ind, consultas[q], &ids), k = 0;
+        for (uint32_t id = 0; id < totalPistasHash; ++id) {
+            if (!contemPalavras(ind->porId[id]->pista, palavras, numPalavras)) continue;
+            if (k >= n || ids[k] != id) divergencias++;
+            k++;
+        }
+        if (k != n) divergencias++;
+        free(ids);
+    }
+    double tVarredura = agoraSegundos() - t0;
+
+    printf("%zu pistas, %u termos, %zu postagens em %.1f MB (%.2f bytes por postagem)\n", numPistas,
+           ind->numTermos, numPostagens, bytesPostagens / 1048576.0, (double) bytesPostagens / (double) numPostagens);
+    printf("Construção em bloco (%zu pistas): %.3f s; carga total com inserções indexadas: %.3f s\n",
+           numPistas / 2, tBloco, tCarga);
+    printf("%zu consultas: %.2f us por consulta, %zu resultados; varredura completa: %.0f us por consulta\n",
+           numConsultas, tConsultas * 1e6 / (double) numConsultas, resultados, tVarredura * 1e6 / (double) amostra);
+    printf("Conferência com a varredura (amostra): %s\n", divergencias == 0 ? "ok" : "DIVERGENTE");
+    free(consultas);
+    desativarIndicePalavras();
+    liberarHash();
+    return divergencias == 0 ? 0 : -1;
+}
+
+/* =========================
+   Suspeitos com evidências quase idênticas (MinHash + LSH)
+   ========================= */
+/*
+ Na revisão de cenários, dois suspeitos cujas pistas dizem praticamente a mesma coisa
+ tornam o mistério ambíguo. Como cada pista aponta para um único suspeito, os conjuntos
+ de ids nunca se repetem; compara-se o conteúdo: o conjunto das palavras (normalizadas,
+ com 3 bytes ou mais) das pistas vigentes de cada suspeito.
+  - assinatura MinHash de MINHASH_K mínimos por suspeito (hash multiplicativo por
+    função); a fração de posições iguais estima a similaridade de Jaccard;
+  - LSH: a assinatura é cortada em MINHASH_BANDAS faixas de MINHASH_LINHAS valores;
+    suspeitos com alguma faixa idêntica viram candidatos (ordenando as chaves de cada
+    faixa), e só os candidatos têm a similaridade estimada.
+ Com 32 faixas de 4 linhas, pares com Jaccard 0,5 viram candidatos com probabilidade
+ ~87% e pares com 0,8 com probabilidade ~100%; pares com 0,2 quase nunca.
+*/
+#define MINHASH_K 128
+#define MINHASH_LINHAS 4
+#define MINHASH_BANDAS (MINHASH_K / MINHASH_LINHAS)
+#define MINHASH_PALAVRA_MIN 3
+
+typedef struct ParSimilar {
+    uint32_t a, b;              // ids do registro de suspeitos (a < b)
+    double similaridade;        // Jaccard estimado pela assinatura
+} ParSimilar;
+
+static void *alocarMinHash(size_t n, size_t tam) {
+    return alocar_safe(NULL, n, tam, "assinaturas MinHash");
+}
+
+/* coeficientes (ímpares) das funções de hash, fixos para que assinaturas sejam comparáveis */
+static uint64_t coefMinHash[MINHASH_K][2];
+
+static void prepararCoefMinHash(void) {
+    static int prontos = 0;
+    if (prontos) return;
+    uint64_t semente = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < MINHASH_K; ++i) {
+        coefMinHash[i][0] = aleatorio(&semente) | 1;
+        coefMinHash[i][1] = aleatorio(&semente);
+    }
+    prontos = 1;
+}
+
+/* acumularMinHash: incorpora as palavras de um texto à assinatura */
+static void acumularMinHash(const char *texto, uint32_t *assinatura) {
+    char palavra[PALAVRA_MAX];
+    size_t n;
+    while ((n = proximaPalavra(&texto, palavra)) > 0) {
+        if (n < MINHASH_PALAVRA_MIN) continue;
+        uint64_t x = hashTermo(palavra, n);
+        for (int i = 0; i < MINHASH_K; ++i) {
+            uint32_t h = (uint32_t) ((coefMinHash[i][0] * x + coefMinHash[i][1]) >> 32);
+            if (h < assinatura[i]) assinatura[i] = h;
+        }
+    }
+}
+
+/*
+ assinaturasSuspeitos: MINHASH_K valores por suspeito do registro (num x MINHASH_K).
+ Suspeitos sem palavras ficam com todos os valores em UINT32_MAX.
+*/
+uint32_t *assinaturasSuspeitos(void) {
+    prepararCoefMinHash();
+    consolidarRegistroSuspeitos();
+    const RegistroSuspeitos *r = &registroSuspeitos;
+    uint32_t *sig = (uint32_t *) alocarMinHash((size_t) r->num * MINHASH_K, sizeof(uint32_t));
+    for (uint32_t s = 0; s < r->num; ++s) {
+        uint32_t *linha = sig + (size_t) s * MINHASH_K;
+        for (int i = 0; i < MINHASH_K; ++i) linha[i] = UINT32_MAX;
+        for (uint32_t i = r->inicioPistas[s]; i < r->inicioPistas[s + 1]; ++i) {
+            acumularMinHash(r->entradaPorId[r->idsPistas[i]]->pista, linha);
+        }
+    }
+    return sig;
+}
+
+static double similaridadeAssinaturas(const uint32_t *x, const uint32_t *y) {
+    int iguais = 0;
+    for (int i = 0; i < MINHASH_K; ++i) iguais += x[i] == y[i];
+    return (double) iguais / MINHASH_K;
+}
+
+typedef struct ChaveFaixa {
+    uint64_t chave;
+    uint32_t suspeito;
+} ChaveFaixa;
+
+static int compararChaveFaixa(const void *a, const void *b) {
+    const ChaveFaixa *x = (const ChaveFaixa *) a, *y = (const ChaveFaixa *) b;
+    if (x->chave != y->chave) return x->chave < y->chave ? -1 : 1;
+    return (x->suspeito > y->suspeito) - (x->suspeito < y->suspeito);
+}
+
+static int compararU64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static int compararParSimilar(const void *a, const void *b) {
+    const ParSimilar *x = (const ParSimilar *) a, *y = (const ParSimilar *) b;
+    if (x->similaridade != y->similaridade) return x->similaridade < y->similaridade ? 1 : -1;
+    if (x->a != y->a) return x->a < y->a ? -1 : 1;
+    return (x->b > y->b) - (x->b < y->b);
+}
+
+/*
+ buscarSuspeitosSimilares: pares com similaridade estimada >= limiar, do mais parecido
+ para o menos. *pares é alocado aqui; retorna a quantidade. Em *candidatos (se não
+ NULL), o número de pares que passaram pelo LSH.
+*/
+size_t buscarSuspeitosSimilares(const uint32_t *sig, double limiar, ParSimilar **pares, size_t *candidatos) {
+    uint32_t num = registroSuspeitos.num;
+    ChaveFaixa *faixa = (ChaveFaixa *) alocarMinHash(num, sizeof(ChaveFaixa));
+    uint64_t *cand = NULL;
+    size_t numCand = 0, capCand = 0;
+    for (int b = 0; b < MINHASH_BANDAS; ++b) {
+        uint32_t k = 0;
+        for (uint32_t s = 0; s < num; ++s) {
+            const uint32_t *v = sig + (size_t) s * MINHASH_K + b * MINHASH_LINHAS;
+            if (v[0] == UINT32_MAX) continue;   // suspeito sem palavras
+            uint64_t h = (uint64_t) b * 0x9E3779B97F4A7C15ULL;
+            for (int i = 0; i < MINHASH_LINHAS; ++i) h = (h ^ v[i]) * 0x100000001B3ULL;
+            faixa[k].chave = h;
+            faixa[k++].suspeito = s;
+        }
+        qsort(faixa, k, sizeof(ChaveFaixa), compararChaveFaixa);
+        for (uint32_t i = 0; i < k;) {
+            uint32_t j = i + 1;
+            while (j < k && faixa[j].chave == faixa[i].chave) j++;
+            for (uint32_t x = i; x < j; ++x) {
+                for (uint32_t y = x + 1; y < j; ++y) {
+                    if (numCand == capCand) {
+                        capCand = capCand ? capCand * 2 : 256;
+                        cand = (uint64_t *) realloc(cand, capCand * sizeof(uint64_t));
+                        if (!cand) {
+                            fprintf(stderr, "Falha ao alocar memória para assinaturas MinHash\n");
+                            exit(EXIT_FAILURE);
+                        }
+                    }
+                    cand[numCand++] = (uint64_t) faixa[x].suspeito << 32 | faixa[y].suspeito;
+                }
+            }
+            i = j;
+        }
+    }
+    free(faixa);
+    qsort(cand, numCand, sizeof(uint64_t), compararU64);
+    size_t unicos = 0;
+    for (size_t i = 0; i < numCand; ++i) {
+        if (i == 0 || cand[i] != cand[i - 1]) cand[unicos++] = cand[i];
+    }
+    if (candidatos) *candidatos = unicos;
+
+    ParSimilar *res = (ParSimilar *) alocarMinHash(unicos, sizeof(ParSimilar));
+    size_t n = 0;
+    for (size_t i = 0; i < unicos; ++i) {
+        uint32_t a = (uint32_t) (cand[i] >> 32), b = (uint32_t) cand[i];
+        double sim = similaridadeAssinaturas(sig + (size_t) a * MINHASH_K, sig + (size_t) b * MINHASH_K);
+        if (sim >= limiar) {
+            res[n].a = a;
+            res[n].b = b;
+            res[n++].similaridade = sim;
+        }
+    }
+    free(cand);
+    qsort(res, n, sizeof(ParSimilar), compararParSimilar);
+    *pares = res;
+    return n;
+}
+
+/* relatorioSuspeitosSimilares: modo --suspeitos-similares sobre o cenário carregado */
+void relatorioSuspeitosSimilares(double limiar) {
+    uint32_t *sig = assinaturasSuspeitos();
+    ParSimilar *pares;
+    size_t n = buscarSuspeitosSimilares(sig, limiar, &pares, NULL);
+    printf("Pares de suspeitos com evidências parecidas (Jaccard estimado >= %.2f):\n", limiar);
+    for (size_t i = 0; i < n; ++i) {
+        printf(" - %s / %s: %.2f\n", registroSuspeitos.nomes[pares[i].a], registroSuspeitos.nomes[pares[i].b],
+               pares[i].similaridade);
+    }
+    if (n == 0) printf(" (nenhum)\n");
+    free(pares);
+    free(sig);
+}
+
+/* --- referência exata (quadrática) para o benchmark --- */
+/* conjunto ordenado de hashes de palavras do suspeito s */
+static size_t conjuntoPalavras(uint32_t s, uint64_t **conj) {
+    const RegistroSuspeitos *r = &registroSuspeitos;
+    size_t n = 0, cap = 16;
+    uint64_t *v = (uint64_t *) alocarMinHash(cap, sizeof(uint64_t));
+    char palavra[PALAVRA_MAX];
+    for (uint32_t i = r->inicioPistas[s]; i < r->inicioPistas[s + 1]; ++i) {
+        const char *t = r->entradaPorId[r->idsPistas[i]]->pista;
+        size_t tam;
+        while ((tam = proximaPalavra(&t, palavra)) > 0) {
+            if (tam < MINHASH_PALAVRA_MIN) continue;
+            if (n == cap) {
+                cap *= 2;
+                v = (uint64_t *) realloc(v, cap * sizeof(uint64_t));
+                if (!v) {
+                    fprintf(stderr, "Falha ao alocar memória para assinaturas MinHash\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            v[n++] = hashTermo(palavra, tam);
+        }
+    }
+    qsort(v, n, sizeof(uint64_t), compararU64);
+    size_t u = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (i == 0 || v[i] != v[i - 1]) v[u++] = v[i];
+    }
+    *conj = v;
+    return u;
+}
+
+static double jaccardExato(const uint64_t *x, size_t nx, const uint64_t *y, size_t ny) {
+    size_t i = 0, j = 0, comuns = 0;
+    while (i < nx && j < ny) {
+        if (x[i] == y[j]) {
+            comuns++;
+            i++;
+            j++;
+        } else if (x[i] < y[j]) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+    size_t uniao = nx + ny - comuns;
+    return uniao ? (double) comuns / (double) uniao : 0.0;
+}
+
+/*
+ benchSimilares: suspeitos sintéticos com pistas de palavras aleatórias de um
+ vocabulário grande; um em cada 50 ganha um "gêmeo" que repete suas pistas trocando
+ uma palavra por pista. Compara o LSH com todos os pares exatos (limiar 0,5).
+*/
+int benchSimilares(size_t numSuspeitos, size_t pistasPorSuspeito) {
+    uint64_t semente = 23;
+    char pista[256], suspeito[32];
+    size_t gemeos = 0;
+    for (size_t s = 0; s < numSuspeitos; ++s) {
+        int gemeo = s > 0 && s % 50 == 0;
+        semente = (gemeo ? s - 1 : s) * 7919 + 1;   // o gêmeo refaz as pistas do anterior
+        snprintf(suspeito, sizeof(suspeito), "Suspeito %zu", s);
+        for (size_t p = 0; p < pistasPorSuspeito; ++p) {
+            size_t tam = 0;
+            for (int w = 0; w < 6; ++w) {
+                uint64_t r = aleatorio(&semente);
+                if (gemeo && w == (int) (p % 6)) r ^= 0xABCDEF;
+                tam += (size_t) snprintf(pista + tam, sizeof(pista) - tam, "%spal%llu", w ? " " : "",
+                                         (unsigned long long) (r % 200000));
+            }
+            inserirNaHash(pista, suspeito);
+        }
+        gemeos += gemeo;
+    }
+    double t0 = agoraSegundos();
+    uint32_t *sig = assinaturasSuspeitos();
+    double tAssinaturas = agoraSegundos() - t0;
+    t0 = agoraSegundos();
+    ParSimilar *pares;
+    size_t candidatos, n = buscarSuspeitosSimilares(sig, 0.5, &pares, &candidatos);
+    double tLsh = agoraSegundos() - t0;
+
+    uint32_t num = registroSuspeitos.num;
+    uint64_t **conj = (uint64_t **) alocarMinHash(num, sizeof(uint64_t *));
+    size_t *tamConj = (size_t *) alocarMinHash(num, sizeof(size_t));
+    t0 = agoraSegundos();
+    for (uint32_t s = 0; s < num; ++s) tamConj[s] = conjuntoPalavras(s, &conj[s]);
+    size_t exatos = 0, achados = 0;
+    for (uint32_t a = 0; a < num; ++a) {
+        for (uint32_t b = a + 1; b < num; ++b) {
+            if (jaccardExato(conj[a], tamConj[a], conj[b], tamConj[b]) < 0.5) continue;
+            exatos++;
+            for (size_t i = 0; i < n; ++i) {
+                if (pares[i].a == a && pares[i].b == b) {
+                    achados++;
+                    break;
+                }
+            }
+        }
+    }
+    double tExato = agoraSegundos() - t0;
+    printf("%u suspeitos, %zu pistas cada, %zu gêmeos plantados\n", num, pistasPorSuspeito, gemeos);
+    printf("MinHash: assinaturas em %.3f s; LSH %.3f s (%zu candidatos, %zu pares >= 0.5)\n", tAssinaturas, tLsh,
+           candidatos, n);
+    printf("Todos os pares exatos: %.3f s, %zu pares >= 0.5; LSH encontrou %zu (revocação %.1f%%)\n", tExato, exatos,
+           achados, exatos ? 100.0 * (double) achados / (double) exatos : 100.0);
+    for (uint32_t s = 0; s < num; ++s) free(conj[s]);
+    free(conj);
+    free(tamConj);
+    free(pares);
+    free(sig);
+    liberarHash();
+    return exatos == 0 || achados * 10 >= exatos * 9 ? 0 : -1;
+}
+
+/* =========================
+   Comparação de benchmarks com uma linha de base
+   ========================= */
+/*
+ Para saber se uma mudança deixou inserirPista ou as consultas à hash mais lentas:
+ --bench-base <arquivo> roda um conjunto fixo de núcleos (cada um algumas dezenas de
+ milissegundos) várias vezes e grava as amostras (ns por operação) com metadados do
+ ambiente; --bench-comparar <arquivo> roda de novo e compara núcleo a núcleo:
+  - média e intervalo de 95% (t de Student) de cada lado;
+  - teste t de Welch (variâncias diferentes, graus de liberdade de Welch-Satterthwaite);
+  - REGRESSÃO se a diferença é significativa e a versão atual é mais de
+    LIMIAR_REGRESSAO_PCT % mais lenta; "melhoria" no caso simétrico.
+ O código de saída é 1 se houver regressão, para uso em integração contínua.
+ Sem libm: a raiz quadrada é por Newton e os valores críticos de t vêm de tabela.
+*/
+#define MAX_REPETICOES_BENCH 64
+#define LIMIAR_REGRESSAO_PCT 3.0
+
+typedef struct AmostrasNucleo {
+    char nome[48];
+    int n;
+    double ns[MAX_REPETICOES_BENCH];
+} AmostrasNucleo;
+
+typedef struct EstatisticaNucleo {
+    double media, variancia, semiIntervalo;
+} EstatisticaNucleo;
+
+static double raizQuadrada(double x) {
+    if (x <= 0) return 0;
+    double r = x > 1 ? x : 1;
+    for (int i = 0; i < 64; ++i) {
+        double prox = 0.5 * (r + x / r);
+        if (prox == r) break;
+        r = prox;
     }
-    total += contarPistasQueApontam(root->esq, suspeitoAlvo);
-    total += contarPistasQueApontam(root->dir, suspeitoAlvo);
-    return total;
+    return r;
+}
+
+/* valor crítico bicaudal de t a 95% para gl graus de liberdade (interpolado) */
+static double tCritico95(double gl) {
+    static const double tabela[] = { 0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                     2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                     2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+    if (gl < 1) gl = 1;
+    if (gl <= 30) {
+        int i = (int) gl;
+        double f = gl - i;
+        return i >= 30 ? tabela[30] : tabela[i] + f * (tabela[i + 1] - tabela[i]);
+    }
+    if (gl <= 60) return 2.042 + (gl - 30) / 30 * (2.000 - 2.042);
+    if (gl <= 120) return 2.000 + (gl - 60) / 60 * (1.980 - 2.000);
+    return 1.960;
+}
+
+static EstatisticaNucleo estatisticaNucleo(const AmostrasNucleo *a) {
+    EstatisticaNucleo e = { 0, 0, 0 };
+    for (int i = 0; i < a->n; ++i) e.media += a->ns[i];
+    e.media /= a->n > 0 ? a->n : 1;
+    for (int i = 0; i < a->n; ++i) e.variancia += (a->ns[i] - e.media) * (a->ns[i] - e.media);
+    e.variancia = a->n > 1 ? e.variancia / (a->n - 1) : 0;
+    e.semiIntervalo = a->n > 1 ? tCritico95(a->n - 1) * raizQuadrada(e.variancia / a->n) : 0;
+    return e;
+}
+
+/* --- núcleos: cada um devolve ns por operação de uma execução --- */
+typedef struct DadosNucleos {
+    Sala *mansao;
+    size_t numSalas;
+    char **pistas;          // textos das pistas da mansão (para BST e hash)
+    size_t numPistas;
+    PistaNode *bst;         // BST com todas as pistas (consultas)
+} DadosNucleos;
+
+static double nucleoInserirPista(DadosNucleos *d) {
+    double t0 = agoraSegundos();
+    PistaNode *raiz = NULL;
+    for (size_t i = 0; i < d->numPistas; ++i) raiz = inserirPista(raiz, d->pistas[i]);
+    double t = agoraSegundos() - t0;
+    liberarPistas(raiz);
+    return t * 1e9 / (double) d->numPistas;
+}
+
+static double nucleoBuscarPista(DadosNucleos *d) {
+    size_t achadas = 0, ops = d->numPistas * 4;
+    double t0 = agoraSegundos();
+    for (size_t i = 0; i < ops; ++i) achadas += buscarPista(d->bst, d->pistas[(i * 7919) % d->numPistas]) != NULL;
+    double t = agoraSegundos() - t0;
+    if (achadas != ops) fprintf(stderr, "Núcleo buscarPista: %zu de %zu pistas achadas\n", achadas, ops);
+    return t * 1e9 / (double) ops;
+}
+
+static double nucleoEncontrarSuspeito(DadosNucleos *d) {
+    size_t achadas = 0, ops = d->numPistas * 4;
+    double t0 = agoraSegundos();
+    for (size_t i = 0; i < ops; ++i) achadas += encontrarSuspeito(d->pistas[(i * 7919) % d->numPistas]) != NULL;
+    double t = agoraSegundos() - t0;
+    if (achadas != ops) fprintf(stderr, "Núcleo encontrarSuspeito: %zu de %zu pistas achadas\n", achadas, ops);
+    return t * 1e9 / (double) ops;
+}
+
+static double nucleoContarPistas(DadosNucleos *d) {
+    int ops = 20;
+    long total = 0;
+    double t0 = agoraSegundos();
+    for (int i = 0; i < ops; ++i) total += contarPistasQueApontam(d->bst, "Suspeito 7");
+    double t = agoraSegundos() - t0;
+    (void) total;
+    return t * 1e9 / (double) ops / (double) d->numPistas;    // por pista percorrida
+}
+
+static double nucleoPassoSessao(DadosNucleos *d) {
+    static const char comandos[4] = { 'e', 'd', 'e', 'x' };
+    Sessao s;
+    iniciarSessao(&s, d->mansao, d->numSalas);
+    uint64_t semente = 5;
+    size_t ops = 400000;
+    double t0 = agoraSegundos();
+    for (size_t p = 0; p < ops; ++p) {
+        ResultadoPasso r = passoSessao(&s, comandos[aleatorio(&semente) & 3]);
+        if (r.status == PASSO_SEM_CAMINHO) {
+            encerrarSessao(&s);
+            iniciarSessao(&s, d->mansao, d->numSalas);
+        }
+    }
+    double t = agoraSegundos() - t0;
+    encerrarSessao(&s);
+    return t * 1e9 / (double) ops;
+}
+
+typedef struct NucleoBench {
+    const char *nome;
+    double (*executar)(DadosNucleos *d);
+} NucleoBench;
+
+static const NucleoBench nucleosBench[] = {
+    { "inserirPista", nucleoInserirPista },
+    { "buscarPista", nucleoBuscarPista },
+    { "encontrarSuspeito", nucleoEncontrarSuspeito },
+    { "contarPistasQueApontam", nucleoContarPistas },
+    { "passoSessao", nucleoPassoSessao },
+};
+#define NUM_NUCLEOS_BENCH ((int) (sizeof(nucleosBench) / sizeof(nucleosBench[0])))
+
+static void coletarPistasMansao(Sala *sala, DadosNucleos *d, size_t *cap) {
+    if (!sala) return;
+    if (sala->pista) {
+        if (d->numPistas == *cap) {
+            *cap = *cap ? *cap * 2 : 256;
+            d->pistas = (char **) realloc(d->pistas, *cap * sizeof(char *));
+            if (!d->pistas) {
+                fprintf(stderr, "Falha ao alocar memória para benchmarks\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        d->pistas[d->numPistas++] = sala->pista;
+    }
+    coletarPistasMansao(sala->esq, d, cap);
+    coletarPistasMansao(sala->dir, d, cap);
+}
+
+static int repeticoesBench(const char *arg) {
+    int r = arg ? atoi(arg) : 10;
+    if (r < 2) r = 2;
+    return r > MAX_REPETICOES_BENCH ? MAX_REPETICOES_BENCH : r;
+}
+
+/* rodarNucleos: repeticoes execuções de cada núcleo, intercaladas (reduz efeito de deriva) */
+static void rodarNucleos(AmostrasNucleo *amostras, int repeticoes) {
+    DadosNucleos d;
+    memset(&d, 0, sizeof(d));
+    size_t cap = 0;
+    d.mansao = gerarMansaoSintetica(4000);
+    d.numSalas = numerarSalas(d.mansao);
+    coletarPistasMansao(d.mansao, &d, &cap);
+    for (size_t i = 0; i < d.numPistas; ++i) d.bst = inserirPista(d.bst, d.pistas[i]);
+    for (int k = 0; k < NUM_NUCLEOS_BENCH; ++k) {
+        snprintf(amostras[k].nome, sizeof(amostras[k].nome), "%s", nucleosBench[k].nome);
+        amostras[k].n = 0;
+        nucleosBench[k].executar(&d);       // aquecimento
+    }
+    for (int r = 0; r < repeticoes; ++r) {
+        for (int k = 0; k < NUM_NUCLEOS_BENCH; ++k) amostras[k].ns[amostras[k].n++] = nucleosBench[k].executar(&d);
+    }
+    liberarPistas(d.bst);
+    free(d.pistas);
+    liberarSalas(d.mansao);
+    liberarHash();
+}
+
+/* metadados do ambiente: uma linha "prefixo chave: valor" por item ("# " no arquivo) */
+static void escreverAmbienteBench(FILE *f, const char *prefixo) {
+    char host[128] = "?", cpu[160] = "?";
+    gethostname(host, sizeof(host) - 1);
+    FILE *info = fopen("/proc/cpuinfo", "r");
+    if (info) {
+        char linha[256];
+        while (fgets(linha, sizeof(linha), info)) {
+            if (strncmp(linha, "model name", 10) == 0 && strchr(linha, ':')) {
+                snprintf(cpu, sizeof(cpu), "%s", strchr(linha, ':') + 2);
+                trim_nl(cpu);
+                break;
+            }
+        }
+        fclose(info);
+    }
+    time_t agora = time(NULL);
+    char data[32];
+    strftime(data, sizeof(data), "%Y-%m-%d %H:%M:%S", localtime(&agora));
+    fprintf(f, "%shost: %s\n%scpu: %s\n%scpus: %ld\n%scompilador: %s\n%sotimizado: %s\n%sdata: %s\n",
+            prefixo, host, prefixo, cpu, prefixo, sysconf(_SC_NPROCESSORS_ONLN), prefixo,
+#ifdef __VERSION__
+            __VERSION__,
+#else
+            "?",
+#endif
+            prefixo,
+#ifdef __OPTIMIZE__
+            "sim",
+#else
+            "não",
+#endif
+            prefixo, data);
+}
+
+/* gravarBaseBench: "nome n amostra1 amostra2 ..." por núcleo, após os metadados */
+int gravarBaseBench(const char *caminho, int repeticoes) {
+    AmostrasNucleo amostras[NUM_NUCLEOS_BENCH];
+    rodarNucleos(amostras, repeticoes);
+    FILE *f = fopen(caminho, "w");
+    if (!f) {
+        fprintf(stderr, "Não foi possível criar %s\n", caminho);
+        return -1;
+    }
+    escreverAmbienteBench(f, "# ");
+    for (int k = 0; k < NUM_NUCLEOS_BENCH; ++k) {
+        EstatisticaNucleo e = estatisticaNucleo(&amostras[k]);
+        fprintf(f, "%s %d", amostras[k].nome, amostras[k].n);
+        for (int i = 0; i < amostras[k].n; ++i) fprintf(f, " %.3f", amostras[k].ns[i]);
+        fprintf(f, "\n");
+        printf("%-24s %10.2f ns/op ± %.2f (95%%, %d execuções)\n", amostras[k].nome, e.media, e.semiIntervalo,
+               amostras[k].n);
+    }
+    fclose(f);
+    printf("Linha de base gravada em %s\n", caminho);
+    return 0;
+}
+
+/* lerBaseBench: metadados vão para stdout; retorna o número de núcleos lidos (-1 em erro) */
+static int lerBaseBench(const char *caminho, AmostrasNucleo *base, int max) {
+    FILE *f = fopen(caminho, "r");
+    if (!f) {
+        fprintf(stderr, "Não foi possível abrir %s\n", caminho);
+        return -1;
+    }
+    char linha[8192];
+    int n = 0;
+    while (fgets(linha, sizeof(linha), f)) {
+        if (linha[0] == '#') {
+            printf("  base  %s", linha[1] == ' ' ? linha + 2 : linha + 1);
+            continue;
+        }
+        if (n == max) break;
+        char *p = linha;
+        int lidos;
+        if (sscanf(p, "%47s %d%n", base[n].nome, &base[n].n, &lidos) != 2 || base[n].n < 0 ||
+            base[n].n > MAX_REPETICOES_BENCH) continue;
+        p += lidos;
+        int i = 0;
+        for (; i < base[n].n && sscanf(p, "%lf%n", &base[n].ns[i], &lidos) == 1; ++i) p += lidos;
+        base[n].n = i;
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+/* compararBaseBench: tabela por núcleo; retorna 1 se algum núcleo regrediu, -1 em erro */
+int compararBaseBench(const char *caminho, int repeticoes) {
+    AmostrasNucleo base[NUM_NUCLEOS_BENCH], atual[NUM_NUCLEOS_BENCH];
+    printf("Ambiente:\n");
+    int numBase = lerBaseBench(caminho, base, NUM_NUCLEOS_BENCH);
+    if (numBase < 0) return -1;
+    escreverAmbienteBench(stdout, "  atual ");
+    rodarNucleos(atual, repeticoes);
+
+    int regressoes = 0;
+    printf("\n%-24s %20s %20s %9s %7s  %s\n", "núcleo", "base (ns/op)", "atual (ns/op)", "variação", "t", "veredito");
+    for (int k = 0; k < NUM_NUCLEOS_BENCH; ++k) {
+        const AmostrasNucleo *b = NULL;
+        for (int j = 0; j < numBase; ++j) {
+            if (strcmp(base[j].nome, atual[k].nome) == 0) b = &base[j];
+        }
+        EstatisticaNucleo ea = estatisticaNucleo(&atual[k]);
+        if (!b || b->n < 2) {
+            printf("%-24s %20s %12.2f ± %5.2f %9s %7s  sem base\n", atual[k].nome, "-", ea.media, ea.semiIntervalo,
+                   "-", "-");
+            continue;
+        }
+        EstatisticaNucleo eb = estatisticaNucleo(b);
+        /* Welch: t = (ma - mb) / sqrt(va/na + vb/nb) */
+        double qa = ea.variancia / atual[k].n, qb = eb.variancia / b->n;
+        double erro = raizQuadrada(qa + qb);
+        double t = erro > 0 ? (ea.media - eb.media) / erro : 0;
+        int significativo = 0;
+        if (erro > 0) {
+            double gl = (qa + qb) * (qa + qb) / (qa * qa / (atual[k].n - 1) + qb * qb / (b->n - 1));
+            significativo = t > tCritico95(gl) || -t > tCritico95(gl);
+        }
+        double variacao = eb.media > 0 ? 100.0 * (ea.media - eb.media) / eb.media : 0;
+        const char *veredito = "=";
+        if (significativo && variacao > LIMIAR_REGRESSAO_PCT) {
+            veredito = "REGRESSÃO";
+            regressoes++;
+        } else if (significativo && variacao < -LIMIAR_REGRESSAO_PCT) {
+            veredito = "melhoria";
+        } else if (significativo) {
+            veredito = "= (diferença pequena)";
+        }
+        printf("%-24s %12.2f ± %5.2f %12.2f ± %5.2f %+8.1f%% %7.2f  %s\n", atual[k].nome, eb.media, eb.semiIntervalo,
+               ea.media, ea.semiIntervalo, variacao, t, veredito);
+    }
+    printf("\n%d regressão(ões) significativa(s) (Welch, 95%%, limiar %.0f%%)\n", regressoes, LIMIAR_REGRESSAO_PCT);
+    return regressoes > 0 ? 1 : 0;
 }
 
 /* =========================
-   Função principal (main)
+   Carga de treino para otimização guiada por perfil (PGO)
    ========================= */
-int main() {
-    /* Inicializações */
-    for (int i = 0; i < HASH_SIZE; ++i) tabelaHash[i] = NULL;
-    PistaNode *rootPistas = NULL;
+/*
+ Com -fprofile-generate o gcc instrumenta desvios e chamadas; o perfil só ajuda se a
+ carga que roda nesse binário se parecer com o uso real. --treino-pgo monta essa carga
+ a partir de replays:
+  - algumas mansões sintéticas de tamanhos diferentes (árvores de alturas diferentes);
+  - em cada uma, um lote de sessões aleatórias gravado como replay compacto, relido e
+    reproduzido pela tabela de salas;
+  - as mesmas sessões refeitas com passoSessao (exploração e inserção na BST), com
+    buscarPista e encontrarSuspeito a cada pista nova (consultas à BST e à hash) e, no
+    fim, a acusação do suspeito da primeira pista com contarPistasQueApontam, como no jogo;
+  - a reprodução e as sessões refeitas precisam chegar à mesma sala e ao mesmo número
+    de pistas, o que também confere o binário instrumentado.
+ Os comandos de build (gerar perfil, treinar, recompilar com -fprofile-use) estão no
+ README; o ganho é medido com --bench-base / --bench-comparar. Função que a carga não
+ exercita o gcc trata como fria e otimiza para tamanho: sem buscarPista no treino, o
+ núcleo buscarPista do --bench-comparar fica mais lento que no -O2 puro.
+*/
+#define TREINO_PGO_MANSOES 3
+
+/* treinoMansaoPgo: uma mansão do treino; soma sessões, pistas e acusações sustentadas */
+static int treinoMansaoPgo(size_t numSalas, size_t numSessoes, const char *caminho, uint64_t semente,
+                           uint64_t *pistas, uint64_t *sustentadas) {
+    static const char comandos[4] = { 'e', 'd', 's', 'x' };
+    Sala *mansao = gerarMansaoSintetica(numSalas);
+    size_t n = numerarSalas(mansao);
+    uint32_t altura = 1;
+    while (((size_t) 1 << altura) <= n) altura++;
+
+    /* 1. grava o lote de sessões */
+    GravadorReplay g;
+    if (iniciarGravadorReplay(&g, caminho, mansao) != 0) {
+        liberarSalas(mansao);
+        liberarHash();
+        return -1;
+    }
+    uint64_t estado = semente;
+    for (size_t i = 0; i < numSessoes; ++i) {
+        uint32_t movimentos = altura + (uint32_t) (aleatorio(&estado) % altura);
+        for (uint32_t k = 0; k < movimentos; ++k) {
+            uint64_t r = aleatorio(&estado);
+            anexarMovimentoReplay(&g, comandos[(r & 63) == 0 ? 3 : (r >> 8) & 1]);
+        }
+        anexarMovimentoReplay(&g, 's');
+        fecharSessaoReplay(&g);
+    }
+    BufferBin arquivo = { NULL, 0, 0 };
+    if (encerrarGravadorReplay(&g) != 0 || lerArquivoInteiro(caminho, &arquivo) != 0) {
+        free(arquivo.dados);
+        liberarSalas(mansao);
+        liberarHash();
+        return -1;
+    }
+
+    /* 2. reprodução pela tabela */
+    TabelaReplay t;
+    construirTabelaReplay(&t, mansao);
+    ConferenciaReplay conf;
+    conf.salaFinal = (uint32_t *) malloc(numSessoes * sizeof(uint32_t) + 1);
+    conf.pistas = (uint32_t *) malloc(numSessoes * sizeof(uint32_t) + 1);
+    if (!conf.salaFinal || !conf.pistas) {
+        fprintf(stderr, "Falha ao alocar memória para o treino PGO\n");
+        exit(EXIT_FAILURE);
+    }
+    TotaisReplay totais;
+    int erro = reproduzirReplay(arquivo.dados, arquivo.tam, &t, &totais, guardarFimReplay, &conf) != 0;
+
+    /* 3. as mesmas sessões pelo caminho do jogo: passoSessao, hash e acusação */
+    size_t divergencias = 0;
+    estado = semente;
+    for (size_t i = 0; i < numSessoes && !erro; ++i) {
+        Sessao s;
+        iniciarSessao(&s, mansao, n);
+        const char *acusado = s.pistas ? encontrarSuspeito(s.pistas->pista) : NULL;
+        uint32_t movimentos = altura + (uint32_t) (aleatorio(&estado) % altura);
+        for (uint32_t k = 0; k < movimentos; ++k) {
+            uint64_t r = aleatorio(&estado);
+            ResultadoPasso p = passoSessao(&s, comandos[(r & 63) == 0 ? 3 : (r >> 8) & 1]);
+            if (p.pistaNova && buscarPista(s.pistas, p.pistaNova)) {
+                const char *suspeito = encontrarSuspeito(p.pistaNova);
+                if (!acusado) acusado = suspeito;
+            }
+        }
+        passoSessao(&s, 's');
+        if (acusado && contarPistasQueApontam(s.pistas, acusado) >= 2) (*sustentadas)++;
+        if (s.atual->id != conf.salaFinal[i] || s.coletadas.n != conf.pistas[i]) divergencias++;
+        *pistas += s.coletadas.n;
+        encerrarSessao(&s);
+    }
+    if (divergencias) fprintf(stderr, "Treino PGO: %zu sessões divergentes na mansão de %zu salas\n", divergencias, n);
+    free(conf.salaFinal);
+    free(conf.pistas);
+    free(arquivo.dados);
+    liberarTabelaReplay(&t);
+    liberarSalas(mansao);
+    liberarHash();
+    return erro || divergencias ? -1 : 0;
+}
+
+/* treinoPgo: roda a carga de treino sobre TREINO_PGO_MANSOES mansões (numSalas, 1/4, 1/16) */
+int treinoPgo(size_t numSalas, size_t numSessoes, const char *caminho) {
+    uint64_t pistas = 0, sustentadas = 0;
+    double t0 = agoraSegundos();
+    for (int m = 0; m < TREINO_PGO_MANSOES; ++m) {
+        size_t salas = numSalas >> (2 * m);
+        if (salas < 3) salas = 3;
+        if (treinoMansaoPgo(salas, numSessoes, caminho, 0x5047u + (uint64_t) m, &pistas, &sustentadas) != 0) return -1;
+    }
+    double t = agoraSegundos() - t0;
+    printf("Treino PGO: %d mansões, %zu sessões cada, %llu pistas, %llu acusações sustentadas em %.3f s\n",
+           TREINO_PGO_MANSOES, numSessoes, (unsigned long long) pistas, (unsigned long long) sustentadas, t);
+    return 0;
+}
+
+/* =========================
+   Testes diferenciais (referência contra motores otimizados)
+   ========================= */
+/*
+ Todo motor otimizado precisa se comportar exatamente como as estruturas originais.
+ --diferencial sorteia sequências de operações (coletar, associar, contar, consultar
+ palavras, analisar teorias, recomeçar sessão ou catálogo) e, ao longo delas, compara a
+ referência com cada motor:
+   referência                                motor conferido
+   BST de inserirPista (em-ordem, contador)  dicionário por prefixo: construído pela BST,
+                                             por lista ordenada, relido após serializar e
+                                             por catálogo embaralhado (ordenação em lote)
+   contagem por nome (encontrarSuspeito)     contarPistasQueApontam e pontuarColetadas
+                                             (ids do registro)
+   varredura das entradas vigentes da hash   registro consolidado (contagens, listas CSR,
+                                             suspeitoMaisCitado) e índice invertido
+   busca ingênua no texto normalizado        autômato Aho-Corasick (casarTeoria)
+ O vocabulário é pequeno e cheio de armadilhas (acentos, caixa, prefixos comuns, nomes
+ que só diferem na caixa), para que repetições e sobrescritas sejam frequentes. Cada
+ divergência mostra semente, operação e motor; a mesma semente refaz a sequência.
+*/
+#define DIF_VOCABULARIO 48
+#define DIF_MAX_RELATOS 20
+
+static const char *fragmentosDiferencial[] = {
+    "luva", "Luva", "LUVA", "ácido", "Ácido", "acido", "copo", "copo quebrado", "relógio",
+    "Relógio parado", "zebra", "Zé", "pegada", "pegada de lama", "lama", "abajur", "adaga", "ÉTER"
+};
+#define NUM_FRAGMENTOS_DIF (sizeof(fragmentosDiferencial) / sizeof(fragmentosDiferencial[0]))
+
+static const char *suspeitosDiferencial[] = { "Sra. Beatriz", "Sr. Álvaro", "Zé", "Ana", "ana", "Mordomo" };
+#define NUM_SUSPEITOS_DIF (sizeof(suspeitosDiferencial) / sizeof(suspeitosDiferencial[0]))
+
+static const char *palavrasDiferencial[] = { "luva", "ácido", "acido", "copo", "quebrado", "relógio", "parado",
+                                             "zebra", "zé", "pegada", "lama", "de", "3", "éter", "inexistente" };
+#define NUM_PALAVRAS_DIF (sizeof(palavrasDiferencial) / sizeof(palavrasDiferencial[0]))
+
+typedef struct EstadoDiferencial {
+    uint64_t semente, aleatorio;
+    size_t operacao;
+    size_t divergencias, verificacoes;
+    char vocabulario[DIF_VOCABULARIO][96];
+    const char *suspeitoDe[DIF_VOCABULARIO];    // última associação de cada texto (referência do registro)
+    PistaNode *coletadas;
+} EstadoDiferencial;
+
+static void divergenciaDiferencial(EstadoDiferencial *d, const char *motor, const char *detalhe) {
+    static size_t relatadas = 0;
+    if (relatadas++ < DIF_MAX_RELATOS) {
+        fprintf(stderr, "Semente %llu, operação %zu: %s divergiu da referência (%s)\n",
+                (unsigned long long) d->semente, d->operacao, motor, detalhe);
+    }
+    d->divergencias++;
+}
+
+/* entrada vigente: a que buscarEntradaHash devolve para o seu texto */
+static int entradaVigente(HashEntry *e) {
+    return buscarEntradaHash(e->pista) == e;
+}
+
+/* --- BST contra o dicionário por prefixo --- */
+typedef struct ListagemDiferencial {
+    const char **pistas;
+    int *contadores;
+    size_t n, pos;
+    int iguais;
+} ListagemDiferencial;
+
+static void listarEmOrdemDiferencial(PistaNode *no, ListagemDiferencial *l) {
+    if (!no) return;
+    listarEmOrdemDiferencial(no->esq, l);
+    l->pistas[l->n] = no->pista;
+    l->contadores[l->n++] = no->contador;
+    listarEmOrdemDiferencial(no->dir, l);
+}
+
+static void conferirEntradaListagem(const char *pista, int contador, void *ctx) {
+    ListagemDiferencial *l = (ListagemDiferencial *) ctx;
+    if (l->pos >= l->n || strcmp(pista, l->pistas[l->pos]) != 0 || contador != l->contadores[l->pos]) l->iguais = 0;
+    l->pos++;
+}
+
+static void conferirDicionarioDiferencial(EstadoDiferencial *d, ListagemDiferencial *l, const DicionarioPistas *dic,
+                                          const char *motor) {
+    l->pos = 0;
+    l->iguais = dic->numEntradas == l->n;
+    percorrerDicionario(dic, conferirEntradaListagem, l);
+    if (!l->iguais || l->pos != l->n) divergenciaDiferencial(d, motor, "listagem em ordem");
+    for (size_t v = 0; v < DIF_VOCABULARIO; ++v) {
+        PistaNode *no = buscarPista(d->coletadas, d->vocabulario[v]);
+        if (buscarDicionario(dic, d->vocabulario[v]) != (no ? no->contador : 0)) {
+            divergenciaDiferencial(d, motor, d->vocabulario[v]);
+            break;
+        }
+    }
+}
+
+static void conferirListagemDiferencial(EstadoDiferencial *d) {
+    ListagemDiferencial l;
+    size_t n = contarNosPistas(d->coletadas);
+    l.pistas = (const char **) malloc(n * sizeof(const char *) + 1);
+    l.contadores = (int *) malloc(n * sizeof(int) + 1);
+    if (!l.pistas || !l.contadores) {
+        fprintf(stderr, "Falha ao alocar memória para testes diferenciais\n");
+        exit(EXIT_FAILURE);
+    }
+    l.n = 0;
+    listarEmOrdemDiferencial(d->coletadas, &l);
+    for (size_t i = 1; i < l.n; ++i) {
+        if (compararPistasColacao(l.pistas[i - 1], l.pistas[i]) >= 0) {
+            divergenciaDiferencial(d, "BST (em-ordem)", l.pistas[i]);
+            break;
+        }
+    }
+
+    DicionarioPistas *dic = construirDicionario(d->coletadas);
+    conferirDicionarioDiferencial(d, &l, dic, "dicionário (da BST)");
+    BufferBin b = { NULL, 0, 0 };
+    serializarDicionario(&b, dic);
+    CursorBin c = { b.dados, b.dados + b.tam, 0 };
+    DicionarioPistas *relido = carregarDicionario(&c);
+    if (!relido || c.erro) divergenciaDiferencial(d, "dicionário (relido)", "carga");
+    else conferirDicionarioDiferencial(d, &l, relido, "dicionário (relido)");
+    /* imagem truncada deve ser recusada; com um byte corrompido a carga pode passar, mas sem ler fora dos dados */
+    if (b.tam > 0) {
+        CursorBin t = { b.dados, b.dados + aleatorio(&d->aleatorio) % b.tam, 0 };
+        DicionarioPistas *truncado = carregarDicionario(&t);
+        if (truncado && !t.erro) divergenciaDiferencial(d, "dicionário (truncado)", "imagem aceita");
+        liberarDicionario(truncado);
+        b.dados[aleatorio(&d->aleatorio) % b.tam] ^= (unsigned char) (1 + aleatorio(&d->aleatorio) % 255);
+        CursorBin r = { b.dados, b.dados + b.tam, 0 };
+        DicionarioPistas *corrompido = carregarDicionario(&r);
+        if (corrompido && l.n > 0) buscarDicionario(corrompido, l.pistas[l.n / 2]);
+        liberarDicionario(corrompido);
+    }
+    DicionarioPistas *ordenado = construirDicionarioOrdenado(l.pistas, l.contadores, l.n);
+    conferirDicionarioDiferencial(d, &l, ordenado, "dicionário (lista ordenada)");
+
+    /* catálogo embaralhado, uma ocorrência por coleta: ordenação em lote */
+    size_t total = 0;
+    for (size_t i = 0; i < l.n; ++i) total += (size_t) l.contadores[i];
+    const char **catalogo = (const char **) malloc(total * sizeof(const char *) + 1);
+    if (!catalogo) {
+        fprintf(stderr, "Falha ao alocar memória para testes diferenciais\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t k = 0;
+    for (size_t i = 0; i < l.n; ++i) {
+        for (int vez = 0; vez < l.contadores[i]; ++vez) catalogo[k++] = l.pistas[i];
+    }
+    for (size_t i = total; i > 1; --i) {
+        size_t j = (size_t) (aleatorio(&d->aleatorio) % i);
+        const char *t = catalogo[i - 1];
+        catalogo[i - 1] = catalogo[j];
+        catalogo[j] = t;
+    }
+    DicionarioPistas *catalogado = construirDicionarioDeCatalogo(catalogo, total, 1 + (int) (total % 3));
+    conferirDicionarioDiferencial(d, &l, catalogado, "dicionário (ordenação em lote)");
+    free(catalogo);
+    liberarDicionario(catalogado);
+    if (relido) liberarDicionario(relido);
+    liberarDicionario(ordenado);
+    liberarDicionario(dic);
+    free(b.dados);
+    free(l.pistas);
+    free(l.contadores);
+    d->verificacoes++;
+}
+
+/* --- contagem por nome contra o registro de suspeitos --- */
+static void conferirContagemDiferencial(EstadoDiferencial *d, const char *nome) {
+    if ((int) contarPorNome(d->coletadas, nome) != contarPistasQueApontam(d->coletadas, nome)) {
+        divergenciaDiferencial(d, "contarPistasQueApontam", nome);
+    }
+    d->verificacoes++;
+}
+
+static void conferirRegistroDiferencial(EstadoDiferencial *d) {
+    consolidarRegistroSuspeitos();
+    pontuarColetadas(d->coletadas);
+    const RegistroSuspeitos *r = &registroSuspeitos;
+    uint32_t *vigentes = (uint32_t *) calloc((size_t) r->num + 1, sizeof(uint32_t));
+    if (!vigentes) {
+        fprintf(stderr, "Falha ao alocar memória para testes diferenciais\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < HASH_SIZE; ++i) {
+        for (HashEntry *e = tabelaHash[i]; e; e = e->prox) {
+            if (e->idSuspeito >= r->num) {
+                divergenciaDiferencial(d, "registro (id do suspeito)", e->pista);
+                continue;
+            }
+            if (!entradaVigente(e)) continue;
+            vigentes[e->idSuspeito]++;
+            size_t v = 0;
+            while (v < DIF_VOCABULARIO && strcmp(d->vocabulario[v], e->pista) != 0) v++;
+            if (v == DIF_VOCABULARIO || !d->suspeitoDe[v] || strcmp(r->nomes[e->idSuspeito], d->suspeitoDe[v]) != 0) {
+                divergenciaDiferencial(d, "registro (nome do suspeito)", e->pista);
+            }
+        }
+    }
+    uint32_t melhor = SEM_SUSPEITO, maximo = 0;
+    for (uint32_t s = 0; s < r->num; ++s) {
+        if (vigentes[s] > maximo) {
+            maximo = vigentes[s];
+            melhor = s;
+        }
+        if (r->numPistas[s] != vigentes[s]) divergenciaDiferencial(d, "registro (pistas vigentes)", r->nomes[s]);
+        if (r->pontuacao[s] != contarPorNome(d->coletadas, r->nomes[s])) {
+            divergenciaDiferencial(d, "pontuarColetadas", r->nomes[s]);
+        }
+        for (uint32_t i = r->inicioPistas[s]; i < r->inicioPistas[s + 1]; ++i) {
+            HashEntry *e = r->entradaPorId[r->idsPistas[i]];
+            if (!e || !entradaVigente(e) || e->idSuspeito != s ||
+                (i > r->inicioPistas[s] && r->idsPistas[i - 1] >= r->idsPistas[i])) {
+                divergenciaDiferencial(d, "registro (lista CSR)", r->nomes[s]);
+                break;
+            }
+        }
+    }
+    if (suspeitoMaisCitado() != melhor) divergenciaDiferencial(d, "suspeitoMaisCitado", "máximo de pistas vigentes");
+    free(vigentes);
+    d->verificacoes++;
+}
+
+/* --- varredura da hash contra o índice invertido --- */
+static int compararIdsDiferencial(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+static void conferirPalavrasDiferencial(EstadoDiferencial *d, const char *consulta) {
+    char palavras[4][PALAVRA_MAX];
+    size_t numPalavras = 0;
+    const char *p = consulta;
+    while (numPalavras < 4 && proximaPalavra(&p, palavras[numPalavras]) > 0) numPalavras++;
+
+    uint32_t *esperados = (uint32_t *) malloc((size_t) totalPistasHash * sizeof(uint32_t) + 1);
+    if (!esperados) {
+        fprintf(stderr, "Falha ao alocar memória para testes diferenciais\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t numEsperados = 0;
+    for (int i = 0; i < HASH_SIZE; ++i) {
+        for (HashEntry *e = tabelaHash[i]; e; e = e->prox) {
+            if (entradaVigente(e) && contemPalavras(e->pista, palavras, numPalavras)) esperados[numEsperados++] = e->id;
+        }
+    }
+    qsort(esperados, numEsperados, sizeof(uint32_t), compararIdsDiferencial);
+
+    uint32_t *ids;
+    size_t n = buscarPalavras(indicePalavrasAtivo, consulta, &ids), achados = 0;
+    int iguais = 1;
+    for (size_t i = 0; i < n; ++i) {
+        if (!pistaVigenteIndice(indicePalavrasAtivo, ids[i])) continue;
+        if (achados >= numEsperados || esperados[achados] != ids[i]) iguais = 0;
+        achados++;
+    }
+    if (!iguais || achados != numEsperados) divergenciaDiferencial(d, "índice invertido", consulta);
+    free(ids);
+    free(esperados);
+    d->verificacoes++;
+}
+
+/* --- busca ingênua contra o autômato --- */
+static size_t normalizarTextoDiferencial(const char *texto, char *saida) {
+    unsigned char ant = 0;
+    size_t n = 0;
+    for (; texto[n]; ++n) {
+        saida[n] = (char) normalizarByte(ant, (unsigned char) texto[n]);
+        ant = (unsigned char) texto[n];
+    }
+    saida[n] = '\0';
+    return n;
+}
+
+static void contarCitacaoDiferencial(uint32_t padrao, size_t fim, void *ctx) {
+    (void) fim;
+    ((size_t *) ctx)[padrao]++;
+}
+
+static void conferirTeoriaDiferencial(EstadoDiferencial *d) {
+    /* teoria: pistas do vocabulário (caixa ASCII trocada ao acaso) entre palavras soltas */
+    char teoria[1024], normalTeoria[1024], normalPista[128];
+    size_t tam = 0;
+    int partes = 1 + (int) (aleatorio(&d->aleatorio) % 5);
+    for (int k = 0; k < partes; ++k) {
+        uint64_t r = aleatorio(&d->aleatorio);
+        const char *parte = r & 1 ? d->vocabulario[(r >> 8) % DIF_VOCABULARIO]
+                                  : palavrasDiferencial[(r >> 8) % NUM_PALAVRAS_DIF];
+        if (r & 2) teoria[tam++] = ' ';
+        for (size_t i = 0; parte[i] && tam < sizeof(teoria) - 1; ++i) {
+            char c = parte[i];
+            if (isalpha((unsigned char) c) && (aleatorio(&d->aleatorio) & 3) == 0) c = (char) (c ^ 0x20);
+            teoria[tam++] = c;
+        }
+    }
+    teoria[tam] = '\0';
+    size_t tamTeoria = normalizarTextoDiferencial(teoria, normalTeoria);
+
+    AutomatoPistas *a = construirAutomatoDaHash();
+    size_t *contagem = (size_t *) calloc((size_t) a->numPadroes + 1, sizeof(size_t));
+    if (!contagem) {
+        fprintf(stderr, "Falha ao alocar memória para testes diferenciais\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t total = casarTeoria(a, teoria, contarCitacaoDiferencial, contagem), soma = 0;
+    for (uint32_t p = 0; p < a->numPadroes; ++p) {
+        size_t esperado = 0;
+        if (a->pistas[p] && strlen(a->pistas[p]) < sizeof(normalPista)) {
+            size_t tamPista = normalizarTextoDiferencial(a->pistas[p], normalPista);
+            for (size_t i = 0; tamPista && i + tamPista <= tamTeoria; ++i) {
+                esperado += memcmp(normalTeoria + i, normalPista, tamPista) == 0;
+            }
+        }
+        if (contagem[p] != esperado) {
+            divergenciaDiferencial(d, "autômato Aho-Corasick", a->pistas[p] ? a->pistas[p] : "(pista sobrescrita)");
+            break;
+        }
+        soma += contagem[p];
+    }
+    if (total != soma) divergenciaDiferencial(d, "autômato Aho-Corasick", "total de citações");
+    free(contagem);
+    liberarAutomato(a);
+    d->verificacoes++;
+}
+
+/* sortearVocabulario: 1 a 3 fragmentos, às vezes com um número no fim */
+static void sortearVocabulario(EstadoDiferencial *d) {
+    for (size_t v = 0; v < DIF_VOCABULARIO; ++v) {
+        char *s = d->vocabulario[v];
+        size_t tam = 0;
+        int partes = 1 + (int) (aleatorio(&d->aleatorio) % 3);
+        for (int k = 0; k < partes; ++k) {
+            tam += (size_t) snprintf(s + tam, sizeof(d->vocabulario[v]) - tam, "%s%s", k ? " " : "",
+                                     fragmentosDiferencial[aleatorio(&d->aleatorio) % NUM_FRAGMENTOS_DIF]);
+        }
+        if (aleatorio(&d->aleatorio) % 3 == 0) {
+            snprintf(s + tam, sizeof(d->vocabulario[v]) - tam, " %u", (unsigned) (aleatorio(&d->aleatorio) % 10));
+        }
+    }
+}
+
+/*
+ rodarDiferencial: uma sequência de numOperacoes operações sobre a tabela hash global
+ (esvaziada antes e depois). Retorna o número de divergências.
+*/
+size_t rodarDiferencial(uint64_t semente, size_t numOperacoes, size_t *verificacoes) {
+    EstadoDiferencial *d = (EstadoDiferencial *) calloc(1, sizeof(EstadoDiferencial));
+    if (!d) {
+        fprintf(stderr, "Falha ao alocar memória para testes diferenciais\n");
+        exit(EXIT_FAILURE);
+    }
+    d->semente = semente;
+    d->aleatorio = semente * 0x9E3779B97F4A7C15ull + 1;
+    sortearVocabulario(d);
+    liberarHash();
+    ativarIndicePalavras();
+
+    for (d->operacao = 0; d->operacao < numOperacoes; ++d->operacao) {
+        uint64_t r = aleatorio(&d->aleatorio);
+        const char *pista = d->vocabulario[(r >> 8) % DIF_VOCABULARIO];
+        const char *suspeito = suspeitosDiferencial[(r >> 24) % NUM_SUSPEITOS_DIF];
+        unsigned tipo = (unsigned) (r % 100);
+        if (tipo < 35) {
+            d->coletadas = inserirPista(d->coletadas, pista);
+        } else if (tipo < 55) {
+            inserirNaHash(pista, suspeito);
+            for (size_t v = 0; v < DIF_VOCABULARIO; ++v) {
+                if (strcmp(d->vocabulario[v], pista) == 0) d->suspeitoDe[v] = suspeito;
+            }
+            HashEntry *e = buscarEntradaHash(pista);
+            if (!e || strcmp(encontrarSuspeito(pista), suspeito) != 0 ||
+                strcmp(registroSuspeitos.nomes[e->idSuspeito], suspeito) != 0) {
+                divergenciaDiferencial(d, "inserirNaHash", pista);
+            }
+        } else if (tipo < 70) {
+            conferirContagemDiferencial(d, (r >> 40) % 8 == 0 ? "Ninguém" : suspeito);
+        } else if (tipo < 82) {
+            char consulta[3 * PALAVRA_MAX];
+            int n = 1 + (int) ((r >> 32) % 3);
+            size_t tam = 0;
+            for (int k = 0; k < n; ++k) {
+                tam += (size_t) snprintf(consulta + tam, sizeof(consulta) - tam, "%s%s", k ? " " : "",
+                                         palavrasDiferencial[aleatorio(&d->aleatorio) % NUM_PALAVRAS_DIF]);
+            }
+            conferirPalavrasDiferencial(d, consulta);
+        } else if (tipo < 90) {
+            conferirTeoriaDiferencial(d);
+        } else if (tipo < 94) {
+            conferirListagemDiferencial(d);
+            conferirRegistroDiferencial(d);
+        } else if (tipo < 97) {
+            liberarPistas(d->coletadas);        // nova sessão
+            d->coletadas = NULL;
+        } else if (tipo == 97) {
+            liberarHash();                      // novo catálogo (registro e índice recomeçam)
+            memset(d->suspeitoDe, 0, sizeof(d->suspeitoDe));
+        } else {
+            conferirRegistroDiferencial(d);
+        }
+    }
+    conferirListagemDiferencial(d);
+    conferirRegistroDiferencial(d);
+    conferirTeoriaDiferencial(d);
+
+    size_t divergencias = d->divergencias;
+    *verificacoes += d->verificacoes;
+    liberarPistas(d->coletadas);
+    desativarIndicePalavras();
+    liberarHash();
+    free(d);
+    return divergencias;
+}
+
+/* testesDiferenciais: sementes 1..numSementes; retorna 0 se nenhuma divergiu */
+int testesDiferenciais(size_t numSementes, size_t numOperacoes) {
+    size_t verificacoes = 0, divergentes = 0;
+    double t0 = agoraSegundos();
+    for (uint64_t s = 1; s <= numSementes; ++s) {
+        if (rodarDiferencial(s, numOperacoes, &verificacoes) > 0) divergentes++;
+    }
+    printf("%zu sementes x %zu operações, %zu verificações em %.2f s: %zu semente(s) divergente(s)\n", numSementes,
+           numOperacoes, verificacoes, agoraSegundos() - t0, divergentes);
+    return divergentes > 0 ? -1 : 0;
+}
 
+/* =========================
+   Mansão padrão e modos de linha de comando
+   ========================= */
+/* montarMansaoPadrao: monta o mapa de exemplo e preenche a tabela hash */
+Sala *montarMansaoPadrao(void) {
     /* Montagem manual do mapa da mansão (árvore binária)
        Exemplo de mapa (pode ser alterado):
                  Hall de Entrada
@@ -318,10 +9590,326 @@ int main() {
     inserirNaHash("notas rasgadas com iniciais A.B.", "Sra. Beatriz");
     inserirNaHash("peça de chave inglesa com verniz", "Sr. Almeida");
 
+    return hall;
+}
+
+/*
+ executarFerramenta: modos não interativos.
+  --gerar-json <arquivo> <salas>   gera cenário sintético em JSON
+  --bench-importar <arquivo>       mede a vazão do importador JSON
+  --exportar-binario <json> <bin>  converte um cenário JSON para o formato binário
+  --bench-binario <arquivo>        mede a carga binária com e sem verificação de CRC
+  --bench-diario <salas> <sessoes> <prefixo>
+                                   mede diário/instantâneos comprimidos em segundo plano
+  --bench-persistencia <sessoes> <movimentos> <dir>
+                                   compara write síncrono, pool de threads e io_uring
+  --bench-dicionario <pistas>      compara a BST de pistas com o dicionário por prefixo
+  --bench-sessoes <salas> <sessoes> <passos>
+                                   conduz muitas sessões em rodízio pela API de passos
+  --bench-expiracao <sessoes> <ticks> <ticksOcioso>
+                                   mede a expiração de sessões ociosas pela roda de temporização
+  --bench-grafo <salas> <grau>     constrói um grafo CSR aleatório e mede BFS/rotas
+  --bench-resumo <salas>           compara resumos por subárvore com a varredura direta
+  --bench-regras <salas> <sessoes> <regra>
+                                   compila a regra e a avalia sobre sessões simuladas
+  --bench-log <threads> <registros> <arquivo>
+                                   mede o custo por chamada do registro assíncrono
+  --bench-armazem <sessoes> <orcamentoKB> <arquivo>
+                                   sessões paradas despejadas para arquivo (CLOCK) e reidratadas
+  --bench-compartilhado <processos> <sessoes> <passos>
+                                   processos trabalhadores atendem sessões em memória compartilhada
+  --converter-replay <texto> <saida>
+                                   converte um replay em texto (mansão padrão) para 2 bits por movimento
+  --reproduzir-replay <arquivo>    reproduz um replay compacto sobre a mansão padrão
+  --bench-replay <sessoes> <movimentos> <arquivo>
+                                   grava e reproduz um corpus de replays compactos
+  --teoria "<texto>"               lista as pistas da mansão padrão citadas na teoria
+  --bench-teorias <salas> <teorias>
+                                   Aho-Corasick sobre todas as pistas contra strstr
+  --buscar-palavras "<termos>"     pistas da mansão padrão que contêm todas as palavras
+  --bench-palavras <pistas> <consultas>
+                                   índice invertido contra a varredura das pistas
+  --suspeitos                      lista as pistas de cada suspeito e o mais citado
+  --bench-suspeitos <pistas> <suspeitos>
+                                   pontuação pelo registro de suspeitos contra contagem por nome
+  --suspeitos-similares <cenario.json> <limiar>
+                                   pares de suspeitos com pistas quase idênticas (MinHash + LSH)
+  --bench-similares <suspeitos> <pistasPorSuspeito>
+                                   LSH contra a comparação exata de todos os pares
+  --bench-base <arquivo> [repeticoes]
+                                   roda os núcleos de referência e grava a linha de base
+  --bench-comparar <arquivo> [repeticoes]
+                                   compara com a linha de base (Welch, 95%); sai com 1 se regrediu
+  --treino-pgo <salas> <sessoes> <replay>
+                                   carga de treino para -fprofile-generate (replays, hash, acusação)
+  --diferencial <sementes> <operacoes>
+                                   operações aleatórias: estruturas de referência contra os motores
+  --ordenar-pistas <arquivo> [threads]
+                                   imprime as pistas do arquivo (uma por linha) em ordem alfabética
+  --bench-ordenacao <pistas> [threads]
+                                   radix MSD / quicksort multichave contra qsort
+ Retorna o código de saída do processo.
+*/
+int executarFerramenta(int argc, char **argv) {
+    if (argc == 4 && strcmp(argv[1], "--gerar-json") == 0) {
+        return gerarCenarioJson(argv[2], strtoull(argv[3], NULL, 10)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 3 && strcmp(argv[1], "--bench-importar") == 0) {
+        FILE *arq = fopen(argv[2], "rb");
+        if (!arq) {
+            fprintf(stderr, "Não foi possível abrir %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        fseek(arq, 0, SEEK_END);
+        double mb = (double) ftell(arq) / (1024.0 * 1024.0);
+        fclose(arq);
+
+        size_t salas = 0, assocs = 0;
+        double t0 = agoraSegundos();
+        Sala *raiz = importarCenarioJson(argv[2], &salas, &assocs);
+        double t = agoraSegundos() - t0;
+        if (!raiz) return EXIT_FAILURE;
+        printf("Importados %.1f MB: %zu salas, %zu associações em %.3f s (%.1f MB/s)\n",
+               mb, salas, assocs, t, mb / t);
+        liberarSalas(raiz);
+        liberarHash();
+        return EXIT_SUCCESS;
+    }
+    if (argc == 4 && strcmp(argv[1], "--exportar-binario") == 0) {
+        Sala *raiz = importarCenarioJson(argv[2], NULL, NULL);
+        if (!raiz) return EXIT_FAILURE;
+        int ret = salvarCenarioBinario(argv[3], raiz);
+        liberarSalas(raiz);
+        liberarHash();
+        return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 3 && strcmp(argv[1], "--bench-binario") == 0) {
+        for (int verificar = 0; verificar <= 1; ++verificar) {
+            double t0 = agoraSegundos();
+            Sala *raiz = carregarCenarioBinario(argv[2], verificar);
+            double t = agoraSegundos() - t0;
+            if (!raiz) return EXIT_FAILURE;
+            FILE *arq = fopen(argv[2], "rb");
+            fseek(arq, 0, SEEK_END);
+            double mb = (double) ftell(arq) / (1024.0 * 1024.0);
+            fclose(arq);
+            printf("Carga %s verificação: %.1f MB em %.3f s (%.1f MB/s)\n",
+                   verificar ? "com" : "sem", mb, t, mb / t);
+            liberarSalas(raiz);
+            liberarHash();
+        }
+        size_t n = 256u << 20;
+        unsigned char *bloco = (unsigned char *) calloc(n, 1);
+        if (!bloco) return EXIT_FAILURE;
+        double t0 = agoraSegundos();
+        uint32_t crc = crc32c(bloco, n);
+        printf("CRC32C (%s): %.0f MB/s [%08x]\n", implCrc32c == crc32cSoftware ? "software" : "SSE4.2",
+               256.0 / (agoraSegundos() - t0), (unsigned) crc);
+        free(bloco);
+        return EXIT_SUCCESS;
+    }
+    if (argc == 5 && strcmp(argv[1], "--bench-diario") == 0) {
+        return benchDiario(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10), argv[4]) == 0
+               ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 5 && strcmp(argv[1], "--bench-persistencia") == 0) {
+        return benchPersistencia(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10), argv[4]) == 0
+               ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 3 && strcmp(argv[1], "--bench-dicionario") == 0) {
+        return benchDicionario(strtoull(argv[2], NULL, 10)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 5 && strcmp(argv[1], "--bench-sessoes") == 0) {
+        return benchSessoes(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10),
+                            strtoull(argv[4], NULL, 10)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 5 && strcmp(argv[1], "--bench-expiracao") == 0) {
+        return benchExpiracao(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10),
+                              strtoull(argv[4], NULL, 10)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 4 && strcmp(argv[1], "--bench-grafo") == 0) {
+        return benchGrafo((uint32_t) strtoul(argv[2], NULL, 10), (uint32_t) strtoul(argv[3], NULL, 10)) == 0
+               ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 3 && strcmp(argv[1], "--bench-resumo") == 0) {
+        return benchResumo(strtoull(argv[2], NULL, 10)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 5 && strcmp(argv[1], "--bench-regras") == 0) {
+        return benchRegras(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10), argv[4]) == 0
+               ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 5 && strcmp(argv[1], "--bench-log") == 0) {
+        return benchLog(atoi(argv[2]), strtoull(argv[3], NULL, 10), argv[4]) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 5 && strcmp(argv[1], "--bench-armazem") == 0) {
+        return benchArmazem(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10), argv[4]) == 0
+               ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 5 && strcmp(argv[1], "--bench-compartilhado") == 0) {
+        return benchCompartilhado(atoi(argv[2]), strtoull(argv[3], NULL, 10), strtoull(argv[4], NULL, 10)) == 0
+               ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 4 && strcmp(argv[1], "--converter-replay") == 0) {
+        Sala *mansao = montarMansaoPadrao();
+        int r = converterReplayTexto(argv[2], argv[3], mansao);
+        liberarSalas(mansao);
+        liberarHash();
+        return r == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 3 && strcmp(argv[1], "--reproduzir-replay") == 0) {
+        Sala *mansao = montarMansaoPadrao();
+        int r = reproduzirArquivoReplay(argv[2], mansao);
+        liberarSalas(mansao);
+        liberarHash();
+        return r == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 5 && strcmp(argv[1], "--bench-replay") == 0) {
+        return benchReplay(strtoull(argv[2], NULL, 10), (uint32_t) strtoul(argv[3], NULL, 10), argv[4]) == 0
+               ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 3 && strcmp(argv[1], "--teoria") == 0) {
+        Sala *mansao = montarMansaoPadrao();
+        analisarTeoria(argv[2]);
+        liberarSalas(mansao);
+        liberarHash();
+        return EXIT_SUCCESS;
+    }
+    if (argc == 4 && strcmp(argv[1], "--bench-teorias") == 0) {
+        return benchTeorias(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 2 && strcmp(argv[1], "--suspeitos") == 0) {
+        Sala *mansao = montarMansaoPadrao();
+        listarAssociacoes();
+        uint32_t topo = suspeitoMaisCitado();
+        if (topo != SEM_SUSPEITO) printf("Suspeito mais citado: %s\n", registroSuspeitos.nomes[topo]);
+        liberarSalas(mansao);
+        liberarHash();
+        return EXIT_SUCCESS;
+    }
+    if (argc == 4 && strcmp(argv[1], "--bench-suspeitos") == 0) {
+        return benchSuspeitos(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 4 && strcmp(argv[1], "--suspeitos-similares") == 0) {
+        Sala *raiz = importarCenarioJson(argv[2], NULL, NULL);
+        if (!raiz) return EXIT_FAILURE;
+        relatorioSuspeitosSimilares(strtod(argv[3], NULL));
+        liberarSalas(raiz);
+        liberarHash();
+        return EXIT_SUCCESS;
+    }
+    if (argc == 4 && strcmp(argv[1], "--bench-similares") == 0) {
+        return benchSimilares(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--bench-base") == 0) {
+        return gravarBaseBench(argv[2], repeticoesBench(argc == 4 ? argv[3] : NULL)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--bench-comparar") == 0) {
+        return compararBaseBench(argv[2], repeticoesBench(argc == 4 ? argv[3] : NULL)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 5 && strcmp(argv[1], "--treino-pgo") == 0) {
+        return treinoPgo(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10), argv[4]) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 4 && strcmp(argv[1], "--diferencial") == 0) {
+        return testesDiferenciais(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--ordenar-pistas") == 0) {
+        return ordenarArquivoPistas(argv[2], argc == 4 ? atoi(argv[3]) : 0) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--bench-ordenacao") == 0) {
+        return benchOrdenacao(strtoull(argv[2], NULL, 10), argc == 4 ? atoi(argv[3]) : 0) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc == 3 && strcmp(argv[1], "--buscar-palavras") == 0) {
+        Sala *mansao = montarMansaoPadrao();
+        listarPistasComPalavras(argv[2]);
+        desativarIndicePalavras();
+        liberarSalas(mansao);
+        liberarHash();
+        return EXIT_SUCCESS;
+    }
+    if (argc == 4 && strcmp(argv[1], "--bench-palavras") == 0) {
+        return benchPalavras(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    fprintf(stderr, "Uso: %s [--cenario <arquivo.json> | --cenario-binario <arquivo>]\n"
+                    "Ferramentas:\n"
+                    "  --gerar-json <arquivo> <salas>\n"
+                    "  --bench-importar <arquivo>\n"
+                    "  --exportar-binario <json> <bin>\n"
+                    "  --bench-binario <arquivo>\n"
+                    "  --bench-diario <salas> <sessoes> <prefixo>\n"
+                    "  --bench-persistencia <sessoes> <movimentos> <dir>\n"
+                    "  --bench-dicionario <pistas>\n"
+                    "  --bench-sessoes <salas> <sessoes> <passos>\n"
+                    "  --bench-expiracao <sessoes> <ticks> <ticksOcioso>\n"
+                    "  --bench-grafo <salas> <grau>\n"
+                    "  --bench-resumo <salas>\n"
+                    "  --bench-regras <salas> <sessoes> <regra>\n"
+                    "  --bench-log <threads> <registros> <arquivo>\n"
+                    "  --bench-armazem <sessoes> <orcamentoKB> <arquivo>\n"
+                    "  --bench-compartilhado <processos> <sessoes> <passos>\n"
+                    "  --converter-replay <texto> <saida>\n"
+                    "  --reproduzir-replay <arquivo>\n"
+                    "  --bench-replay <sessoes> <movimentos> <arquivo>\n"
+                    "  --teoria \"<texto>\"\n"
+                    "  --bench-teorias <salas> <teorias>\n"
+                    "  --buscar-palavras \"<termos>\"\n"
+                    "  --bench-palavras <pistas> <consultas>\n"
+                    "  --suspeitos\n"
+                    "  --bench-suspeitos <pistas> <suspeitos>\n"
+                    "  --suspeitos-similares <cenario.json> <limiar>\n"
+                    "  --bench-similares <suspeitos> <pistasPorSuspeito>\n"
+                    "  --bench-base <arquivo> [repeticoes]\n"
+                    "  --bench-comparar <arquivo> [repeticoes]\n"
+                    "  --treino-pgo <salas> <sessoes> <replay>\n"
+                    "  --diferencial <sementes> <operacoes>\n"
+                    "  --ordenar-pistas <arquivo> [threads]\n"
+                    "  --bench-ordenacao <pistas> [threads]\n", argv[0]);
+    return EXIT_FAILURE;
+}
+
+/* =========================
+   Função principal (main)
+   ========================= */
+int main(int argc, char **argv) {
+    /* Inicializações */
+    for (int i = 0; i < HASH_SIZE; ++i) tabelaHash[i] = NULL;
+    Sessao sessao;
+
+    /* perfilador opcional: DQ_PERFIL=<arquivo> [DQ_PERFIL_HZ=<hz>] */
+    const char *arquivoPerfil = getenv("DQ_PERFIL");
+    if (arquivoPerfil && iniciarPerfilador(getenv("DQ_PERFIL_HZ") ? (unsigned) strtoul(getenv("DQ_PERFIL_HZ"), NULL, 10) : 999) != 0) {
+        arquivoPerfil = NULL;
+    }
+
+    /* contadores de hardware opcionais: DQ_CONTADORES=1 (relatório em stderr) */
+    if (getenv("DQ_CONTADORES")) abrirContadoresHw();
+
+    Sala *hall;
+    mudarFasePrincipal(FASE_CARGA);
+    if (argc == 3 && strcmp(argv[1], "--cenario") == 0) {
+        hall = importarCenarioJson(argv[2], NULL, NULL);
+    } else if (argc == 3 && strcmp(argv[1], "--cenario-binario") == 0) {
+        hall = carregarCenarioBinario(argv[2], 1);
+    } else if (argc > 1) {
+        mudarFasePrincipal(FASE_OUTRA);
+        int codigo = executarFerramenta(argc, argv);
+        fecharContadoresHw();
+        if (arquivoPerfil) gravarPerfilAmbiente(arquivoPerfil);
+        return codigo;
+    } else {
+        hall = montarMansaoPadrao();
+    }
+    if (!hall) {
+        fecharContadoresHw();
+        if (arquivoPerfil) gravarPerfilAmbiente(arquivoPerfil);
+        return EXIT_FAILURE;
+    }
+
     /* Início da exploração */
     printf("=== Detective Quest - Investigação na Mansão ===\n");
     printf("Instruções: navegue entre salas com 'e' (esq), 'd' (dir) e saia com 's'.\n");
-    explorarSalasComPistas(hall, &rootPistas);
+    mudarFasePrincipal(FASE_EXPLORACAO);
+    explorarSalasComPistas(&sessao, hall, numerarSalas(hall));
+    PistaNode *rootPistas = sessao.pistas;
 
     /* Exibir pistas coletadas em ordem alfabética */
     printf("\n=== PISTAS COLETADAS (ordem alfabética) ===\n");
@@ -343,20 +9931,33 @@ int main() {
         printf("Nenhum nome fornecido. Encerrando sem acusação.\n");
     } else {
         /* comparar com as strings dos suspeitos na tabela hash - contagem de pistas que apontam para o acusado */
+        mudarFasePrincipal(FASE_ACUSACAO);
         int totalQueApontam = contarPistasQueApontam(rootPistas, acusacao);
         printf("\nVocê acusou: %s\n", acusacao);
         printf("Número de pistas coletadas que apontam para %s: %d\n", acusacao, totalQueApontam);
-        if (totalQueApontam >= 2) {
+        /* condição extra do caso (opcional): DQ_REGRA=<regra>, na sintaxe de compilarRegra */
+        const char *textoRegra = getenv("DQ_REGRA");
+        RegraCompilada *regra = textoRegra ? compilarRegra(textoRegra, NULL) : NULL;
+        int regraVale = regra ? regraValeParaPistas(regra, rootPistas) : 1;
+        if (regra) printf("Condição do caso (%s): %s\n", textoRegra, regraVale ? "satisfeita" : "não satisfeita");
+        if (totalQueApontam >= 2 && regraVale) {
             printf("Resultado: ACUSAÇÃO SUSTENTADA! Existem evidências suficientes (>= 2 pistas).\n");
+        } else if (totalQueApontam >= 2) {
+            printf("Resultado: ACUSAÇÃO FRACA. As pistas apontam para o acusado, mas a condição do caso não foi satisfeita.\n");
         } else {
             printf("Resultado: ACUSAÇÃO FRACA. Não há pistas suficientes para sustentar a acusação.\n");
         }
+        liberarRegra(regra);
     }
 
     /* limpeza */
-    liberarPistas(rootPistas);
+    mudarFasePrincipal(FASE_LIMPEZA);
+    encerrarSessao(&sessao);
     liberarHash();
     liberarSalas(hall);
+    relatorioFasesHw(stderr);
+    fecharContadoresHw();
+    if (arquivoPerfil) gravarPerfilAmbiente(arquivoPerfil);
 
     printf("\nEncerrando Detective Quest. Obrigado por jogar!\n");
     return 0;